@@ -24,6 +24,7 @@ extern "C" {
 #include "mfu_util.h"
 #include "mfu_path.h"
 #include "mfu_io.h"
+#include "mfu_progress.h"
 #include "mfu_param_path.h"
 #include "mfu_flist.h"
 
@@ -209,6 +209,66 @@ void mfu_flist_write_cache(
     mfu_flist flist
 );
 
+/* options to control how a list is written to a cache file */
+typedef struct {
+    int shards;              /* number of shard files to write, 0 for a single file */
+    int stripe_count;        /* striping_factor hint, 0 stripes across writers */
+    uint64_t stripe_size;    /* striping_unit hint in bytes, 0 leaves default */
+    uint64_t cb_buffer_size; /* cb_buffer_size hint in bytes, 0 leaves default */
+} mfu_cache_opts_t;
+
+/* write file list to file using given options, if shards is set,
+ * records are written to files named <name>.<shard> and name
+ * holds a small manifest, mfu_flist_read_cache reads either form
+ * with any number of ranks */
+void mfu_flist_write_cache_opts(
+    const char* name,
+    mfu_flist flist,
+    const mfu_cache_opts_t* opts
+);
+
+/* compute inclusive and exclusive item counts, bytes, and max mtime
+ * for each directory in list and write them to named file,
+ * sorted by inclusive bytes from largest to smallest, the file
+ * holds a header of version, record count, and name width followed
+ * by fixed-size records, see mfu_flist_dirindex.c for the layout,
+ * an empty list writes a header with no records */
+void mfu_flist_write_dirindex(
+    const char* name,
+    mfu_flist flist
+);
+
+/* one directory record from a directory index */
+typedef struct {
+    char* name;          /* full path of directory */
+    uint64_t depth;      /* depth of directory */
+    uint64_t incl_items; /* number of items beneath directory */
+    uint64_t incl_bytes; /* bytes in regular files beneath directory */
+    uint64_t incl_mtime; /* max mtime of anything beneath directory */
+    uint64_t excl_items; /* number of items directly in directory */
+    uint64_t excl_bytes; /* bytes in regular files directly in directory */
+    uint64_t excl_mtime; /* max mtime of directory and its entries */
+} mfu_dirindex_elem_t;
+
+/* read the n directories with the most inclusive bytes from an index
+ * written by mfu_flist_write_dirindex, or all directories if n is 0,
+ * collective, every rank gets the same records in descending order,
+ * returns MFU_SUCCESS with count 0 for an index of a list with no
+ * directories and MFU_FAILURE if the file is missing or invalid,
+ * free records with mfu_flist_free_dirindex */
+int mfu_flist_read_dirindex(
+    const char* name,
+    uint64_t n,
+    uint64_t* count,
+    mfu_dirindex_elem_t** elems
+);
+
+/* free records returned by mfu_flist_read_dirindex */
+void mfu_flist_free_dirindex(
+    uint64_t count,
+    mfu_dirindex_elem_t** elems
+);
+
 /* write file list to text file */
 void mfu_flist_write_text(
     const char* name,
@@ -364,6 +424,27 @@ mfu_flist mfu_flist_spread(mfu_flist flist);
  *   char fields[] = "size,-name"; */
 int mfu_flist_sort(const char* fields, mfu_flist* flist);
 
+/* returns 1 if field is valid for mfu_flist_topk or mfu_flist_quantiles,
+ * allowing a leading '-' if allow_minus is set, fields are:
+ *   size,atime,mtime,ctime,uid,gid */
+int mfu_flist_select_field_valid(const char* field, int allow_minus);
+
+/* return a new list holding the k items with largest values of field,
+ * or smallest if field is preceded by '-', items are ordered from first
+ * to last and all are placed on rank 0, requires a list with detail */
+mfu_flist mfu_flist_topk(mfu_flist flist, const char* field, uint64_t k);
+
+/* compute value of field at each of nq quantiles given in qs,
+ * each in the range [0.0, 1.0], without sorting the list,
+ * fills in vals on all ranks, returns MFU_SUCCESS on success */
+int mfu_flist_quantiles(
+    mfu_flist flist,
+    const char* field,
+    int nq,
+    const double* qs,
+    uint64_t* vals
+);
+
 /****************************************
  * Functions to create / remove data on file system based on input list
  ****************************************/
@@ -379,6 +460,24 @@ void mfu_flist_copy(
     mfu_copy_opts_t* mfu_copy_opts  /* IN - options to be used during copy */
 );
 
+/* re-read the files listed in a manifest written by mfu_flist_copy,
+ * and compare their sizes and checksums to those in the manifest,
+ * files are split into sections according to the chunk options,
+ * returns 0 if all files match, collective */
+int mfu_flist_verify_manifest(
+    const char* name,               /* IN - path of manifest */
+    mfu_copy_opts_t* mfu_copy_opts  /* IN - chunk size and open file options */
+);
+
+/* time reads of a sample of the regular files in flist with a few
+ * block and chunk sizes, and set block_size and chunk_size in
+ * mfu_copy_opts to the best, leaves them alone if there is too
+ * little data to time, collective */
+void mfu_flist_tune(
+    mfu_flist flist,                /* IN - list of source files */
+    mfu_copy_opts_t* mfu_copy_opts  /* IN/OUT - block and chunk sizes */
+);
+
 /* create all directories in flist */
 void mfu_flist_mkdir(mfu_flist flist);
 
@@ -396,6 +495,7 @@ typedef struct mfu_file_chunk_struct {
   uint64_t offset;         /* starting byte offset in file */
   uint64_t length;         /* length of bytes process is responsible for */
   uint64_t file_size;      /* full size of target file */
+  uint64_t chunk_size;     /* size of chunks this file was split into */
   uint64_t rank_of_owner;  /* MPI rank acting as the owner of this file */
   uint64_t index_of_owner; /* index value of file in original flist on its owner rank */
   struct mfu_file_chunk_struct* next; /* pointer to next chunk element */
@@ -406,9 +506,53 @@ typedef struct mfu_file_chunk_struct {
  * is responsbile for */
 mfu_file_chunk* mfu_file_chunk_list_alloc(mfu_flist list, uint64_t chunk_size);
 
+/* options for splitting files into chunks */
+typedef struct {
+    uint64_t chunk_size; /* chunk size, or minimum chunk size if adaptive */
+    int adaptive;        /* pick chunk size per file from file size, total bytes, and rank count */
+    uint64_t align;      /* if nonzero, round adaptive chunk sizes up to a multiple of this, e.g., st_blksize */
+    int locality;        /* shift rank boundaries to file boundaries when the cost to balance is small */
+    int node_aware;      /* divide chunks evenly among nodes first, then among ranks on each node */
+    int node_ranks;      /* if nonzero, max number of ranks per node that are given chunks */
+    uint64_t file_cost;  /* if nonzero, balance estimated cost rather than chunk counts,
+                          * where each file costs file_cost plus its size in bytes */
+} mfu_chunk_opts_t;
+
+/* like mfu_file_chunk_list_alloc, but picks chunk size for each file
+ * according to given options, chosen size is recorded in each element */
+mfu_file_chunk* mfu_file_chunk_list_alloc_opts(mfu_flist list, const mfu_chunk_opts_t* opts);
+
 /* free the linked list allocated with mfu_file_chunk_list_alloc */
 void mfu_file_chunk_list_free(mfu_file_chunk** phead);
 
+/* element in array of file sections returned by mfu_file_chunk_array_alloc,
+ * refers to its file name by index into the names table of the array */
+typedef struct {
+  uint64_t name_id;        /* index of file name in names table */
+  uint64_t offset;         /* starting byte offset in file */
+  uint64_t length;         /* length of bytes process is responsible for */
+  uint64_t file_size;      /* full size of target file */
+  uint64_t chunk_size;     /* size of chunks this file was split into */
+  uint64_t rank_of_owner;  /* MPI rank acting as the owner of this file */
+  uint64_t index_of_owner; /* index value of file in original flist on its owner rank */
+} mfu_file_chunk_desc;
+
+/* array of file sections a process is responsible for */
+typedef struct {
+  uint64_t count;              /* number of file sections */
+  mfu_file_chunk_desc* chunks; /* file sections, in order of global chunk id */
+  uint64_t name_count;         /* number of entries in names table */
+  const char** names;          /* table of full paths to files */
+  char* name_buf;              /* storage for strings in names table */
+} mfu_file_chunk_array;
+
+/* same as mfu_file_chunk_list_alloc_opts, but returns file sections
+ * in a single array that shares file names through a table */
+mfu_file_chunk_array* mfu_file_chunk_array_alloc(mfu_flist list, const mfu_chunk_opts_t* opts);
+
+/* free the array allocated with mfu_file_chunk_array_alloc */
+void mfu_file_chunk_array_free(mfu_file_chunk_array** parray);
+
 #endif /* MFU_FLIST_H */
 
 /* enable C++ codes to include this header directly */
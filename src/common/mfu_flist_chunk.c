@@ -9,82 +9,478 @@
 #include "mfu.h"
 
 /****************************************
- * Functions to divide flist into linked list of file sections
+ * Functions to divide flist into arrays of file sections
  ***************************************/
 
-/* given a file offset, the rank of the last process to hold an
- * extra chunk, and the number of chunks per rank, compute
- * and return the rank of the chunk at the given offset */
-static int map_chunk_to_rank(uint64_t offset, uint64_t cutoff, uint64_t chunks_per_rank)
+/* number of chunks we aim to give each rank when picking
+ * chunk sizes adaptively */
+#define CHUNK_TARGET_PER_RANK (16)
+
+/* largest chunk size we'll pick adaptively, unless the
+ * minimum chunk size is larger */
+#define CHUNK_MAX_SIZE (1024ULL * 1024ULL * 1024ULL)
+
+/* when assigning chunks with locality, a rank may give away or take on
+ * up to 1/CHUNK_LOCALITY_SLACK of its chunks to avoid splitting a file
+ * across ranks */
+#define CHUNK_LOCALITY_SLACK (8)
+
+/* chunk sizes are rounded up to a multiple of this, so every section
+ * starts on a page and on an 8-byte word, mfu_hash_data sums of the
+ * sections of a file only add up to the same value for any split if
+ * every section starts on a word */
+#define CHUNK_MIN_ALIGN (4096)
+
+/* compute chunk size for a file given its size, the chunk size
+ * that would spread all bytes in the job evenly, and the number
+ * of ranks */
+static uint64_t chunk_size_for_file(
+    const mfu_chunk_opts_t* opts,
+    uint64_t file_size,
+    uint64_t job_chunk,
+    int ranks)
 {
-    /* total number of chunks held by ranks below cutoff */
-    uint64_t cutoff_coverage = cutoff * (chunks_per_rank + 1);
-
-    /* given an offset of a chunk, identify which rank will
-     * be responsible */
-    int rank;
-    if (offset < cutoff_coverage) {
-        rank = (int) (offset / (chunks_per_rank + 1));
+    /* minimum chunk size, and fixed size if not adaptive */
+    uint64_t min_chunk = opts->chunk_size;
+    if (min_chunk == 0) {
+        min_chunk = 1024 * 1024;
+    }
+
+    if (!opts->adaptive) {
+        /* keep sections on 8-byte words */
+        return ((min_chunk + 7) / 8) * 8;
+    }
+
+    /* start with size that gives each rank a few chunks of the job */
+    uint64_t chunk = job_chunk;
+
+    /* split mid-size files across all ranks */
+    uint64_t per_rank = file_size / (uint64_t) ranks;
+    if (chunk > per_rank) {
+        chunk = per_rank;
+    }
+
+    /* but don't go below minimum or above maximum */
+    if (chunk > CHUNK_MAX_SIZE) {
+        chunk = CHUNK_MAX_SIZE;
+    }
+    if (chunk < min_chunk) {
+        chunk = min_chunk;
+    }
+
+    /* round up to a multiple of the alignment, sizes like
+     * file_size/ranks could otherwise start sections anywhere */
+    uint64_t align = opts->align;
+    if (align == 0) {
+        align = CHUNK_MIN_ALIGN;
+    }
+    chunk = ((chunk + align - 1) / align) * align;
+
+    return chunk;
+}
+
+/* describes how a file is split into chunks, and the work it
+ * represents, work is counted in units such that rank ranges and
+ * chunk offsets can be computed without visiting every chunk */
+typedef struct {
+    uint64_t chunk_size; /* size of chunks the file is split into */
+    uint64_t chunks;     /* number of chunks */
+    uint64_t fixed;      /* work for a file in addition to its chunks */
+    uint64_t step;       /* work for each full chunk */
+    uint64_t work;       /* total work for the file */
+} chunk_file_t;
+
+/* compute chunks and work for a file, if file_cost is set, a file
+ * counts as file_cost plus its size in bytes, so opening many small
+ * files is balanced against moving the bytes of large files,
+ * otherwise every chunk counts as one unit of work */
+static void chunk_file_layout(
+    const mfu_chunk_opts_t* opts,
+    uint64_t file_size,
+    uint64_t job_chunk,
+    int ranks,
+    chunk_file_t* f)
+{
+    /* pick chunk size for this file */
+    uint64_t chunk_size = chunk_size_for_file(opts, file_size, job_chunk, ranks);
+
+    /* compute number of chunks to copy for this file */
+    uint64_t chunks = file_size / chunk_size;
+    if (chunks * chunk_size < file_size || file_size == 0) {
+        /* this accounts for the last chunk, which may be
+         * partial or it adds a chunk for 0-size files */
+        chunks++;
+    }
+
+    f->chunk_size = chunk_size;
+    f->chunks     = chunks;
+    if (opts->file_cost > 0) {
+        f->fixed = opts->file_cost;
+        f->step  = chunk_size;
+        f->work  = opts->file_cost + file_size;
+    } else {
+        f->fixed = 0;
+        f->step  = 1;
+        f->work  = chunks;
+    }
+
+    return;
+}
+
+/* given the work offset where a file starts, return the work offset
+ * where chunk k of the file starts */
+static uint64_t chunk_file_start(const chunk_file_t* f, uint64_t file_start, uint64_t k)
+{
+    if (k == 0) {
+        return file_start;
+    }
+    return file_start + f->fixed + k * f->step;
+}
+
+/* given the work offset where a file starts, return the index of
+ * the first chunk of the file that starts at or after the given
+ * work offset, or the number of chunks if there is none */
+static uint64_t chunk_file_first_at(const chunk_file_t* f, uint64_t file_start, uint64_t work)
+{
+    if (work <= file_start) {
+        return 0;
+    }
+
+    uint64_t k = 1;
+    uint64_t base = file_start + f->fixed;
+    if (work > base) {
+        k = (work - base + f->step - 1) / f->step;
+        if (k < 1) {
+            k = 1;
+        }
+    }
+    if (k > f->chunks) {
+        k = f->chunks;
+    }
+    return k;
+}
+
+/* given the global offset of a chunk and the offset of the first
+ * chunk held by each rank, compute and return the rank responsible
+ * for the chunk, ranks that hold no chunks are skipped */
+static int map_chunk_to_rank(uint64_t offset, const uint64_t* starts, int ranks)
+{
+    /* binary search for last rank whose first chunk is at or
+     * before the offset, starts[ranks] holds the total count */
+    int low  = 0;
+    int high = ranks - 1;
+    while (low < high) {
+        int mid = low + (high - low + 1) / 2;
+        if (starts[mid] <= offset) {
+            low = mid;
+        } else {
+            high = mid - 1;
+        }
+    }
+    return low;
+}
+
+/* compute amount of work each rank is responsible for given the
+ * total, fill in offset of first unit held by each rank in starts,
+ * which has ranks+1 entries, if node_aware, work is divided evenly
+ * among nodes first and then among ranks on each node, so nodes with
+ * more ranks don't get more work, if node_ranks > 0, only the first
+ * node_ranks ranks on each node are given chunks */
+static void chunk_rank_starts(uint64_t total, const mfu_chunk_opts_t* opts, uint64_t* starts)
+{
+    /* get our rank and number of ranks */
+    int rank, ranks;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+
+    /* count of chunks for each rank, stored in starts[r+1] */
+    int i;
+    if (opts->node_aware || opts->node_ranks > 0) {
+        /* get our rank and number of ranks on our node */
+        MPI_Comm node_comm;
+        MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL, &node_comm);
+        int node_rank, node_size;
+        MPI_Comm_rank(node_comm, &node_rank);
+        MPI_Comm_size(node_comm, &node_size);
+
+        /* limit number of ranks that get chunks on each node */
+        int active = node_size;
+        if (opts->node_ranks > 0 && opts->node_ranks < active) {
+            active = opts->node_ranks;
+        }
+
+        /* count nodes, and number each node by the number of
+         * node leaders with a lower rank than its own leader */
+        int leader = (node_rank == 0);
+        int nodes;
+        MPI_Allreduce(&leader, &nodes, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+
+        int node_index;
+        MPI_Exscan(&leader, &node_index, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+        if (rank == 0) {
+            node_index = 0;
+        }
+        MPI_Bcast(&node_index, 1, MPI_INT, 0, node_comm);
+        MPI_Comm_free(&node_comm);
+
+        /* split chunks among nodes, then among active ranks on node */
+        uint64_t node_chunks = total / (uint64_t) nodes;
+        if ((uint64_t) node_index < total % (uint64_t) nodes) {
+            node_chunks++;
+        }
+        uint64_t count = 0;
+        if (node_rank < active) {
+            count = node_chunks / (uint64_t) active;
+            if ((uint64_t) node_rank < node_chunks % (uint64_t) active) {
+                count++;
+            }
+        }
+
+        /* gather counts from all ranks */
+        MPI_Allgather(&count, 1, MPI_UINT64_T, &starts[1], 1, MPI_UINT64_T, MPI_COMM_WORLD);
     } else {
-        rank = (int) (cutoff + (offset - cutoff_coverage) / chunks_per_rank);
+        /* ranks below cutoff will be responsible for (chunks_per_rank+1)
+         * and ranks at cutoff and above are responsible for chunks_per_rank */
+        uint64_t chunks_per_rank = total / (uint64_t) ranks;
+        uint64_t cutoff = total - chunks_per_rank * (uint64_t) ranks;
+        for (i = 0; i < ranks; i++) {
+            starts[i + 1] = chunks_per_rank;
+            if ((uint64_t) i < cutoff) {
+                starts[i + 1]++;
+            }
+        }
     }
 
-    return rank;
+    /* convert counts to offsets */
+    starts[0] = 0;
+    for (i = 0; i < ranks; i++) {
+        starts[i + 1] += starts[i];
+    }
+
+    return;
+}
+
+/* iterate over files in our list, and split each into runs of
+ * consecutive chunks that map to the same rank, each run becomes
+ * a single file section, if sendptrs is NULL, add up the bytes needed
+ * to pack sections for each destination and count sections before and
+ * after adjusting for locality, otherwise pack each section into the
+ * buffer for its destination and advance the pointer */
+static void chunk_pack_sections(
+    mfu_flist list,
+    const mfu_chunk_opts_t* opts,
+    uint64_t job_chunk,
+    uint64_t offset,
+    const uint64_t* starts,
+    int first_send_rank,
+    uint64_t* bytes,
+    char** sendptrs,
+    uint64_t* sections)
+{
+    /* get our rank and number of ranks */
+    int rank, ranks;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+
+    uint64_t current_offset = offset;
+    uint64_t idx;
+    uint64_t size = mfu_flist_size(list);
+    for (idx = 0; idx < size; idx++) {
+        /* only regular files have data */
+        mfu_filetype type = mfu_flist_file_get_type(list, idx);
+        if (type != MFU_TYPE_FILE) {
+            continue;
+        }
+
+        /* get name and size of file */
+        const char* name = mfu_flist_file_get_name(list, idx);
+        uint64_t file_size = mfu_flist_file_get_size(list, idx);
+
+        /* determine chunks and work for this file */
+        chunk_file_t f;
+        chunk_file_layout(opts, file_size, job_chunk, ranks, &f);
+        uint64_t chunk_size = f.chunk_size;
+        uint64_t chunks     = f.chunks;
+
+        /* compute bytes needed to pack a section of this file,
+         * full name NUL-terminated, offset, length,
+         * file size, chunk size, and owner rank and index */
+        size_t name_size = strlen(name) + 1;
+        size_t pack_size = name_size + 6 * 8;
+
+        /* identify ranks holding the first and last chunks of this file,
+         * a chunk belongs to the rank whose range holds its start */
+        uint64_t file_start = current_offset;
+        uint64_t file_end   = current_offset + f.work;
+        uint64_t last_start = chunk_file_start(&f, file_start, chunks - 1);
+        int lo_rank = map_chunk_to_rank(file_start, starts, ranks);
+        int hi_rank = map_chunk_to_rank(last_start, starts, ranks);
+
+        /* if the file is split across ranks, hand a small piece at either
+         * end of the file to the rank that holds the neighboring piece,
+         * so fewer ranks open the file */
+        int lo_used = lo_rank;
+        int hi_used = hi_rank;
+        if (opts->locality && lo_rank < hi_rank) {
+            uint64_t slack = (starts[ranks] / (uint64_t) ranks) / CHUNK_LOCALITY_SLACK;
+            uint64_t left  = starts[lo_rank + 1] - file_start;
+            uint64_t right = file_end - starts[hi_rank];
+            int next_rank = map_chunk_to_rank(starts[lo_rank + 1], starts, ranks);
+            int prev_rank = map_chunk_to_rank(starts[hi_rank] - 1, starts, ranks);
+            if (next_rank == hi_rank) {
+                /* file is split in two, keep it whole on one rank */
+                if (right <= left && right <= slack) {
+                    hi_used = lo_rank;
+                } else if (left <= slack) {
+                    lo_used = hi_rank;
+                }
+            } else {
+                if (left <= slack) {
+                    lo_used = next_rank;
+                }
+                if (right <= slack) {
+                    hi_used = prev_rank;
+                }
+            }
+        }
+
+        /* emit a run of chunks for each rank that holds part of the file */
+        int dest_rank;
+        for (dest_rank = lo_used; dest_rank <= hi_used; dest_rank++) {
+            /* the run covers the chunks that start in that rank's range,
+             * the first and last runs extend to the start and end of the file */
+            uint64_t chunk_id = 0;
+            if (dest_rank > lo_used) {
+                chunk_id = chunk_file_first_at(&f, file_start, starts[dest_rank]);
+            }
+            uint64_t run_end = chunks;
+            if (dest_rank < hi_used) {
+                run_end = chunk_file_first_at(&f, file_start, starts[dest_rank + 1]);
+            }
+
+            /* skip ranks that hold no chunks of this file */
+            if (chunk_id >= run_end) {
+                continue;
+            }
+
+            int rank_index = dest_rank - first_send_rank;
+
+            /* count sections given to ranks before and after
+             * adjusting for locality */
+            if (sendptrs == NULL) {
+                sections[1]++;
+            }
+
+            /* compute byte range of this run,
+             * the last chunk may be partial */
+            uint64_t sec_offset = chunk_id * chunk_size;
+            uint64_t sec_end    = run_end * chunk_size;
+            if (sec_end > file_size) {
+                sec_end = file_size;
+            }
+
+            if (sendptrs == NULL) {
+                bytes[rank_index] += pack_size;
+            } else {
+                char* sendptr = sendptrs[rank_index];
+                memcpy(sendptr, name, name_size);
+                sendptr += name_size;
+                mfu_pack_uint64(&sendptr, sec_offset);
+                mfu_pack_uint64(&sendptr, sec_end - sec_offset);
+                mfu_pack_uint64(&sendptr, file_size);
+                mfu_pack_uint64(&sendptr, chunk_size);
+                mfu_pack_uint64(&sendptr, (uint64_t) rank);
+                mfu_pack_uint64(&sendptr, idx);
+                sendptrs[rank_index] = sendptr;
+            }
+        }
+
+        /* count ranks holding a piece of the file without locality */
+        if (sendptrs == NULL) {
+            for (dest_rank = lo_rank; dest_rank <= hi_rank; dest_rank++) {
+                uint64_t first = 0;
+                if (dest_rank > lo_rank) {
+                    first = chunk_file_first_at(&f, file_start, starts[dest_rank]);
+                }
+                uint64_t end = chunks;
+                if (dest_rank < hi_rank) {
+                    end = chunk_file_first_at(&f, file_start, starts[dest_rank + 1]);
+                }
+                if (first < end) {
+                    sections[0]++;
+                }
+            }
+        }
+
+        /* go on to the work of our next file */
+        current_offset += f.work;
+    }
+
+    return;
 }
 
 /* This is a long routine, but the idea is simple.  All tasks sum up
- * the number of file chunks they have, and those are then evenly
- * distributed amongst the processes.  */
-mfu_file_chunk* mfu_file_chunk_list_alloc(mfu_flist list, uint64_t chunk_size)
+ * the number of file chunks they have, or the estimated cost of their
+ * files, and those are then evenly distributed amongst the processes.  */
+mfu_file_chunk_array* mfu_file_chunk_array_alloc(mfu_flist list, const mfu_chunk_opts_t* opts)
 {
     /* get our rank and number of ranks */
     int rank, ranks;
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
     MPI_Comm_size(MPI_COMM_WORLD, &ranks);
 
-    /* total up number of file chunks for all files in our list */
-    uint64_t count = 0;
+    /* total up bytes for all files in our list */
     uint64_t idx;
     uint64_t size = mfu_flist_size(list);
+    uint64_t job_chunk = 0;
+    if (opts->adaptive) {
+        uint64_t bytes = 0;
+        for (idx = 0; idx < size; idx++) {
+            mfu_filetype type = mfu_flist_file_get_type(list, idx);
+            if (type == MFU_TYPE_FILE) {
+                bytes += mfu_flist_file_get_size(list, idx);
+            }
+        }
+
+        /* compute chunk size that spreads all bytes evenly */
+        uint64_t total_bytes;
+        MPI_Allreduce(&bytes, &total_bytes, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+        job_chunk = total_bytes / ((uint64_t)ranks * CHUNK_TARGET_PER_RANK);
+    }
+
+    /* total up work for all files in our list, this is the
+     * number of chunks, or estimated cost if file_cost is set */
+    uint64_t count = 0;
     for (idx = 0; idx < size; idx++) {
         /* get type of item */
         mfu_filetype type = mfu_flist_file_get_type(list, idx);
 
-        /* if we have a file, add up its chunks */
+        /* if we have a file, add up its work */
         if (type == MFU_TYPE_FILE) {
             /* get size of file */
             uint64_t file_size = mfu_flist_file_get_size(list, idx);
 
-            /* compute number of chunks to copy for this file */
-            uint64_t chunks = file_size / chunk_size;
-            if (chunks * chunk_size < file_size || file_size == 0) {
-                /* this accounts for the last chunk, which may be
-                 * partial or it adds a chunk for 0-size files */
-                chunks++;
-            }
-
-            /* include these chunks in our total */
-            count += chunks;
+            /* include work for this file in our total */
+            chunk_file_t f;
+            chunk_file_layout(opts, file_size, job_chunk, ranks, &f);
+            count += f.work;
         }
     }
 
-    /* compute total number of chunks across procs */
+    /* compute total work across procs */
     uint64_t total;
     MPI_Allreduce(&count, &total, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
 
-    /* get global offset of our first chunk */
+    /* get global offset of our first unit of work */
     uint64_t offset;
     MPI_Exscan(&count, &offset, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
     if (rank == 0) {
         offset = 0;
     }
 
-    /* compute number of chunks per task, ranks below cutoff will
-     * be responsible for (chunks_per_rank+1) and ranks at cutoff
-     * and above are responsible for chunks_per_rank */
-    uint64_t chunks_per_rank = total / (uint64_t) ranks;
-    uint64_t coverage = chunks_per_rank * (uint64_t) ranks;
-    uint64_t cutoff = total - coverage;
+    /* compute offset of first chunk that each rank is responsible for */
+    uint64_t* starts = (uint64_t*) MFU_MALLOC(((size_t)ranks + 1) * sizeof(uint64_t));
+    chunk_rank_starts(total, opts, starts);
 
     /* TODO: replace this with DSDE */
 
@@ -105,14 +501,15 @@ mfu_file_chunk* mfu_file_chunk_list_alloc(mfu_flist list, uint64_t chunk_size)
     /* if we have some chunks, figure out the number of ranks
      * we'll send to and the range of rank ids, set flags to 1 */
     int send_ranks = 0;
-    int first_send_rank, last_send_rank;
+    int first_send_rank = 0;
+    int last_send_rank;
     if (count > 0) {
         /* compute first rank we'll send data to */
-        first_send_rank = map_chunk_to_rank(offset, cutoff, chunks_per_rank);
+        first_send_rank = map_chunk_to_rank(offset, starts, ranks);
 
         /* compute last rank we'll send to */
         uint64_t last_offset = offset + count - 1;
-        last_send_rank  = map_chunk_to_rank(last_offset, cutoff, chunks_per_rank);
+        last_send_rank  = map_chunk_to_rank(last_offset, starts, ranks);
 
         /* set flag for each process we'll send data to */
         for (i = first_send_rank; i <= last_send_rank; i++) {
@@ -123,109 +520,33 @@ mfu_file_chunk* mfu_file_chunk_list_alloc(mfu_flist list, uint64_t chunk_size)
         send_ranks = last_send_rank - first_send_rank + 1;
     }
 
-    /* allocate a linked list for each process we'll send to */
-    mfu_file_chunk** heads = (mfu_file_chunk**) MFU_MALLOC((size_t)send_ranks * sizeof(mfu_file_chunk*));
-    mfu_file_chunk** tails = (mfu_file_chunk**) MFU_MALLOC((size_t)send_ranks * sizeof(mfu_file_chunk*));
-    uint64_t* counts  = (uint64_t*)   MFU_MALLOC((size_t)send_ranks * sizeof(uint64_t));
-    uint64_t* bytes   = (uint64_t*)   MFU_MALLOC((size_t)send_ranks * sizeof(uint64_t));
-    char** sendbufs   = (char**)      MFU_MALLOC((size_t)send_ranks * sizeof(char*));
+    /* allocate a send buffer for each process we'll send to */
+    uint64_t* bytes  = (uint64_t*) MFU_MALLOC((size_t)send_ranks * sizeof(uint64_t));
+    char** sendbufs  = (char**)    MFU_MALLOC((size_t)send_ranks * sizeof(char*));
+    char** sendptrs  = (char**)    MFU_MALLOC((size_t)send_ranks * sizeof(char*));
 
     /* initialize values */
     for (i = 0; i < send_ranks; i++) {
-        heads[i]    = NULL;
-        tails[i]    = NULL;
-        counts[i]   = 0;
         bytes[i]    = 0;
         sendbufs[i] = NULL;
+        sendptrs[i] = NULL;
     }
 
-    /* now iterate through files and build up list of chunks we'll
-     * send to each task, as an optimization, we encode consecutive
-     * chunks of the same file into a single unit */
-    uint64_t current_offset = offset;
-    for (idx = 0; idx < size; idx++) {
-        /* get type of item */
-        mfu_filetype type = mfu_flist_file_get_type(list, idx);
-
-        /* if we have a file, add up its chunks */
-        if (type == MFU_TYPE_FILE) {
-            /* get size of file */
-            uint64_t file_size = mfu_flist_file_get_size(list, idx);
-
-            /* compute number of chunks to copy for this file */
-            uint64_t chunks = file_size / chunk_size;
-            if (chunks * chunk_size < file_size || file_size == 0) {
-                chunks++;
-            }
-
-            /* iterate over each chunk of this file and determine the
-             * rank we should send it to */
-            int prev_rank = MPI_PROC_NULL;
-            uint64_t chunk_id;
-            for (chunk_id = 0; chunk_id < chunks; chunk_id++) {
-                /* determine which rank we should map this chunk to */
-                int current_rank = map_chunk_to_rank(current_offset, cutoff, chunks_per_rank);
-
-                /* compute index into our send_ranks arrays */
-                int rank_index = current_rank - first_send_rank;
-
-                /* if this chunk goes to a rank we've already created
-                 * an element for, just update that element, otherwise
-                 * create a new element */
-                if (current_rank == prev_rank) {
-                    /* we've already got an element started for this
-                     * file and rank, just update its count field to
-                     * append this element */
-                    mfu_file_chunk* elem = tails[rank_index];
-                    elem->length += chunk_size;
-
-                    /* adjusting length in case chunk is a partial chunk */
-                    uint64_t remainder = file_size - elem->offset;
-                    if (remainder < elem->length) {
-                        elem->length = remainder;
-                    }
-                } else {
-                    /* we're sending to a new rank or have the start
-                     * of a new file, either way allocate a new element */
-                    mfu_file_chunk* elem = (mfu_file_chunk*) MFU_MALLOC(sizeof(mfu_file_chunk));
-                    elem->name             = mfu_flist_file_get_name(list, idx);
-                    elem->offset           = chunk_id * chunk_size;
-                    elem->length           = chunk_size;
-                    elem->file_size        = file_size;
-                    elem->rank_of_owner    = rank;
-                    elem->index_of_owner   = idx;
-                    elem->next             = NULL;
-
-                    /* adjusting length in case chunk is a partial chunk */
-                    uint64_t remainder = file_size - elem->offset;
-                    if (remainder < elem->length) {
-                        elem->length = remainder;
-                    }
-
-                    /* compute bytes needed to pack this item,
-                     * full name NUL-terminated, chunk id,
-                     * number of chunks, and file size */
-                    size_t pack_size = strlen(elem->name) + 1;
-                    pack_size += 5 * 8;
-
-                    /* append element to list */
-                    if (heads[rank_index] == NULL) {
-                        heads[rank_index] = elem;
-                    }
-                    if (tails[rank_index] != NULL) {
-                        tails[rank_index]->next = elem;
-                    }
-                    tails[rank_index] = elem;
-                    counts[rank_index]++;
-                    bytes[rank_index] += pack_size;
-
-                    /* remember which rank we're sending to */
-                    prev_rank = current_rank;
-                }
-
-                /* go on to our next chunk */
-                current_offset++;
-            }
+    /* compute number of bytes we'll send to each task, consecutive
+     * chunks of the same file going to the same task are encoded
+     * as a single section */
+    uint64_t sections[2] = {0, 0};
+    chunk_pack_sections(list, opts, job_chunk, offset, starts,
+        first_send_rank, bytes, NULL, sections);
+
+    /* each section is a file open on some rank, report how many
+     * we saved by keeping files together */
+    if (opts->locality) {
+        uint64_t all_sections[2];
+        MPI_Allreduce(sections, all_sections, 2, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+        if (rank == 0) {
+            MFU_LOG(MFU_LOG_INFO, "File sections: %llu by chunk offset, %llu with locality",
+                (unsigned long long) all_sections[0], (unsigned long long) all_sections[1]);
         }
     }
 
@@ -234,16 +555,9 @@ mfu_file_chunk* mfu_file_chunk_list_alloc(mfu_flist list, uint64_t chunk_size)
     MPI_Alltoall(sendlist, 1, MPI_INT, recvlist, 1, MPI_INT, MPI_COMM_WORLD);
 
     /* determine number of ranks that will send to us */
-    int first_recv_rank = MPI_PROC_NULL;
     int recv_ranks = 0;
     for (i = 0; i < ranks; i++) {
         if (recvlist[i]) {
-            /* record the first rank we'll receive from */
-            if (first_recv_rank == MPI_PROC_NULL) {
-                first_recv_rank = i;
-            }
-
-            /* increase our count of procs to send to us */
             recv_ranks++;
         }
     }
@@ -293,31 +607,13 @@ mfu_file_chunk* mfu_file_chunk_list_alloc(mfu_flist list, uint64_t chunk_size)
     /* wait for sizes to come in */
     MPI_Waitall(msgs, request, status);
 
-    /* allocate memory and encode lists for sending */
+    /* allocate memory and encode sections for sending */
     for (i = 0; i < send_ranks; i++) {
-        /* allocate buffer for this destination */
-        size_t sendbuf_size = (size_t) bytes[i];
-        sendbufs[i] = (char*) MFU_MALLOC(sendbuf_size);
-
-        /* pack data into buffer */
-        char* sendptr = sendbufs[i];
-        mfu_file_chunk* elem = heads[i];
-        while (elem != NULL) {
-            /* pack file name */
-            strcpy(sendptr, elem->name);
-            sendptr += strlen(elem->name) + 1;
-
-            /* pack chunk id, count, and file size */
-            mfu_pack_uint64(&sendptr, elem->offset);
-            mfu_pack_uint64(&sendptr, elem->length);
-            mfu_pack_uint64(&sendptr, elem->file_size);
-            mfu_pack_uint64(&sendptr, elem->rank_of_owner);
-            mfu_pack_uint64(&sendptr, elem->index_of_owner);
-
-            /* go to next element */
-            elem = elem->next;
-        }
+        sendbufs[i] = (char*) MFU_MALLOC((size_t) bytes[i]);
+        sendptrs[i] = sendbufs[i];
     }
+    chunk_pack_sections(list, opts, job_chunk, offset, starts,
+        first_send_rank, bytes, sendptrs, sections);
 
     /* sum up total bytes that we'll receive */
     size_t recvbuf_size = 0;
@@ -348,36 +644,124 @@ mfu_file_chunk* mfu_file_chunk_list_alloc(mfu_flist list, uint64_t chunk_size)
     /* waitall */
     MPI_Waitall(msgs, request, status);
 
-    mfu_file_chunk* head = NULL;
-    mfu_file_chunk* tail = NULL;
-
-    /* iterate over all received data */
+    /* count the sections we received */
+    uint64_t elems = 0;
     const char* packptr = recvbuf;
     char* recvbuf_end = recvbuf + recvbuf_size;
     while (packptr < recvbuf_end) {
-        /* unpack file name */
+        packptr += strlen(packptr) + 1 + 6 * 8;
+        elems++;
+    }
+
+    /* allocate the array, names point into the receive buffer,
+     * which we keep as storage for the names table */
+    mfu_file_chunk_array* array = (mfu_file_chunk_array*) MFU_MALLOC(sizeof(mfu_file_chunk_array));
+    array->count      = elems;
+    array->chunks     = (mfu_file_chunk_desc*) MFU_MALLOC(elems * sizeof(mfu_file_chunk_desc));
+    array->name_count = 0;
+    array->names      = (const char**) MFU_MALLOC(elems * sizeof(char*));
+    array->name_buf   = recvbuf;
+
+    /* iterate over all received data */
+    uint64_t n = 0;
+    packptr = recvbuf;
+    while (packptr < recvbuf_end) {
+        /* unpack file name, and add it to the names table
+         * if it differs from the name of the previous section */
         const char* name = packptr;
         packptr += strlen(name) + 1;
+        if (array->name_count == 0 || strcmp(array->names[array->name_count - 1], name) != 0) {
+            array->names[array->name_count] = name;
+            array->name_count++;
+        }
 
-        /* unpack chunk offset, count, and file size */
-        uint64_t offset, length, file_size, rank_of_owner, index_of_owner;
-        mfu_unpack_uint64(&packptr, &offset);
-        mfu_unpack_uint64(&packptr, &length);
-        mfu_unpack_uint64(&packptr, &file_size);
-        mfu_unpack_uint64(&packptr, &rank_of_owner);
-        mfu_unpack_uint64(&packptr, &index_of_owner);
+        /* unpack chunk offset, count, file size, and owner */
+        mfu_file_chunk_desc* p = &array->chunks[n];
+        p->name_id = array->name_count - 1;
+        mfu_unpack_uint64(&packptr, &p->offset);
+        mfu_unpack_uint64(&packptr, &p->length);
+        mfu_unpack_uint64(&packptr, &p->file_size);
+        mfu_unpack_uint64(&packptr, &p->chunk_size);
+        mfu_unpack_uint64(&packptr, &p->rank_of_owner);
+        mfu_unpack_uint64(&packptr, &p->index_of_owner);
+        n++;
+    }
+
+    /* free our send buffers */
+    for (i = 0; i < send_ranks; i++) {
+        mfu_free(&sendbufs[i]);
+    }
+
+    mfu_free(&recv_counts);
+    mfu_free(&send_counts);
+    mfu_free(&status);
+    mfu_free(&request);
+    mfu_free(&recvranklist);
+    mfu_free(&sendptrs);
+    mfu_free(&sendbufs);
+    mfu_free(&bytes);
+    mfu_free(&recvlist);
+    mfu_free(&sendlist);
+    mfu_free(&starts);
+
+    return array;
+}
+
+/* free the array of file sections */
+void mfu_file_chunk_array_free(mfu_file_chunk_array** parray)
+{
+    /* check whether we were given a pointer */
+    if (parray != NULL) {
+        mfu_file_chunk_array* array = *parray;
+        if (array != NULL) {
+            mfu_free(&array->chunks);
+            mfu_free(&array->names);
+            mfu_free(&array->name_buf);
+            mfu_free(parray);
+        }
+    }
+
+    return;
+}
+
+mfu_file_chunk* mfu_file_chunk_list_alloc(mfu_flist list, uint64_t chunk_size)
+{
+    mfu_chunk_opts_t opts;
+    opts.chunk_size = chunk_size;
+    opts.adaptive   = 0;
+    opts.align      = 0;
+    opts.locality   = 0;
+    opts.node_aware = 0;
+    opts.node_ranks = 0;
+    opts.file_cost  = 0;
+    return mfu_file_chunk_list_alloc_opts(list, &opts);
+}
+
+/* build the linked list form from the array of file sections,
+ * each element gets its own copy of the file name */
+mfu_file_chunk* mfu_file_chunk_list_alloc_opts(mfu_flist list, const mfu_chunk_opts_t* opts)
+{
+    mfu_file_chunk_array* array = mfu_file_chunk_array_alloc(list, opts);
+
+    mfu_file_chunk* head = NULL;
+    mfu_file_chunk* tail = NULL;
+
+    uint64_t n;
+    for (n = 0; n < array->count; n++) {
+        const mfu_file_chunk_desc* c = &array->chunks[n];
 
         /* allocate memory for new struct and set next pointer to null */
-        mfu_file_chunk* p = malloc(sizeof(mfu_file_chunk));
+        mfu_file_chunk* p = (mfu_file_chunk*) MFU_MALLOC(sizeof(mfu_file_chunk));
         p->next = NULL;
 
         /* set the fields of the struct */
-        p->name = strdup(name);
-        p->offset = offset;
-        p->length = length;
-        p->file_size = file_size;
-        p->rank_of_owner = rank_of_owner;
-        p->index_of_owner = index_of_owner;
+        p->name = MFU_STRDUP(array->names[c->name_id]);
+        p->offset = c->offset;
+        p->length = c->length;
+        p->file_size = c->file_size;
+        p->chunk_size = c->chunk_size;
+        p->rank_of_owner = c->rank_of_owner;
+        p->index_of_owner = c->index_of_owner;
 
         /* if the tail is not null then point the tail at the latest struct */
         if (tail != NULL) {
@@ -393,6 +777,8 @@ mfu_file_chunk* mfu_file_chunk_list_alloc(mfu_flist list, uint64_t chunk_size)
         tail = p;
     }
 
+    mfu_file_chunk_array_free(&array);
+
     return head;
 }
 
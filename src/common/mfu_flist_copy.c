@@ -17,6 +17,11 @@
 #include <getopt.h>
 #include <time.h> /* asctime / localtime */
 #include <regex.h>
+#include <pthread.h>
+
+#ifdef HAVE_LIBURING
+#include <liburing.h>
+#endif
 
 /* These headers are needed to query the Lustre MDS for stat
  * information.  This information may be incomplete, but it
@@ -57,6 +62,22 @@
  * Define types
  ***************************************/
 
+/* methods used to copy file data, counted in the copy summary */
+enum {
+    MFU_COPY_ENGINE_RW = 0,  /* read and write through user-space buffers */
+    MFU_COPY_ENGINE_FIEMAP,  /* read and write of extents listed by fiemap */
+    MFU_COPY_ENGINE_SEEK,    /* read and write of data regions found with SEEK_DATA */
+    MFU_COPY_ENGINE_CLONE,   /* FICLONERANGE, destination shares source blocks */
+    MFU_COPY_ENGINE_RANGE,   /* copy_file_range, data stays in the kernel or server */
+    MFU_COPY_ENGINE_URING,   /* io_uring, many reads and writes in flight */
+    MFU_COPY_ENGINE_DIRECT,  /* O_DIRECT on aligned blocks, page cache for the rest */
+    MFU_COPY_ENGINES
+};
+
+static const char* mfu_copy_engine_names[MFU_COPY_ENGINES] = {
+    "read/write", "fiemap", "seek_data", "reflink", "copy_file_range", "io_uring", "O_DIRECT"
+};
+
 typedef struct {
     int64_t  total_dirs;         /* sum of all directories */
     int64_t  total_files;        /* sum of all files */
@@ -67,16 +88,14 @@ typedef struct {
     time_t   time_ended;         /* time when dcp command ended */
     double   wtime_started;      /* time when dcp command started */
     double   wtime_ended;        /* time when dcp command ended */
+    double   wtime_busy;         /* seconds this rank spent copying data */
+    uint64_t total_chunks;       /* number of file sections this rank copied */
+    int64_t  total_src_opens;    /* number of times we opened a source file */
+    int64_t  total_dst_opens;    /* number of times we opened a destination file */
+    int64_t  engine_files[MFU_COPY_ENGINES]; /* number of files whose first section used each engine */
+    int64_t  engine_bytes[MFU_COPY_ENGINES]; /* number of bytes copied with each engine */
 } mfu_copy_stats_t;
 
-/* cache open file descriptor to avoid
- * opening / closing the same file */
-typedef struct {
-    char* name; /* name of open file (NULL if none) */
-    int   read; /* whether file is open for read-only (1) or write (0) */
-    int   fd;   /* file descriptor */
-} mfu_copy_file_cache_t;
-
 /****************************************
  * Define globals
  ***************************************/
@@ -84,52 +103,89 @@ typedef struct {
 /** Where we should keep statistics related to this file copy. */
 static mfu_copy_stats_t mfu_copy_stats;
 
-/** Cache most recent open file descriptor to avoid opening / closing the same file */
-static mfu_copy_file_cache_t mfu_copy_src_cache;
-static mfu_copy_file_cache_t mfu_copy_dst_cache;
+/** Cache open file descriptors to avoid opening / closing the same file
+ * when sections of several files are interleaved */
+static mfu_file_cache_t mfu_copy_src_cache;
+static mfu_file_cache_t mfu_copy_dst_cache;
+
+/* kernel copy methods that failed on the most recent source file,
+ * so later sections of that file skip straight to one that works */
+#define MFU_COPY_NO_CLONE (1)
+#define MFU_COPY_NO_RANGE (2)
+static char* mfu_copy_kernel_file = NULL;
+static int mfu_copy_kernel_flags  = 0;
+
+/* set if copy_file_range is not available on this system */
+static int mfu_copy_kernel_nosys = 0;
+
+/* set if the destination file system can't preallocate space */
+static int mfu_copy_prealloc_unsupported = 0;
+
+/* how to force copied data to stable storage, and a path on the
+ * destination file system to hand to syncfs */
+static mfu_copy_sync_t mfu_copy_durability = MFU_COPY_SYNC_FILE;
+static const char* mfu_copy_sync_path = NULL;
+
+/* checksums of copied files when writing a manifest, NULL otherwise,
+ * and the running checksum of the section being copied */
+static mfu_manifest* mfu_copy_manifest = NULL;
+static uint64_t mfu_copy_sum = 0;
+
+/* add data read from a source file at offset to the checksum
+ * of the current section if we're writing a manifest */
+static void mfu_copy_checksum(uint64_t offset, const void* buf, size_t size)
+{
+    if (mfu_copy_manifest != NULL) {
+        mfu_copy_sum += mfu_hash_data(offset, buf, size);
+    }
+}
 
 static int mfu_copy_open_file(const char* file, int read_flag, 
-        mfu_copy_file_cache_t* cache, mfu_copy_opts_t* mfu_copy_opts)
+        mfu_file_cache_t* cache, mfu_copy_opts_t* mfu_copy_opts)
 {
-    int newfd = -1;
+    /* pick flags for read or write */
+    int flags;
+    if (read_flag) {
+        flags = O_RDONLY;
+    } else {
+        flags = O_WRONLY | O_CREAT;
+    }
+    if (mfu_copy_opts->synchronous) {
+        flags |= O_DIRECT;
+    }
 
     /* see if we have a cached file descriptor */
-    char* name = cache->name;
-    if (name != NULL) {
-        /* we have a cached file descriptor */
-        int fd = cache->fd;
-        if (strcmp(name, file) == 0 && cache->read == read_flag) {
-            /* the file we're trying to open matches name and read/write mode,
-             * so just return the cached descriptor */
-            return fd;
-        } else {
-            /* the file we're trying to open is different,
-             * close the old file and delete the name */
-            mfu_close(name, fd);
-            mfu_free(&cache->name);
-        }
+    int newfd = mfu_file_cache_get(cache, file, flags);
+    if (newfd != -1) {
+        return newfd;
     }
 
     /* open the new file */
     if (read_flag) {
-        int flags = O_RDONLY;
-        if (mfu_copy_opts->synchronous) {
-            flags |= O_DIRECT;
-        }
         newfd = mfu_open(file, flags);
     } else {
-        int flags = O_WRONLY | O_CREAT;
-        if (mfu_copy_opts->synchronous) {
-            flags |= O_DIRECT;
-        }
         newfd = mfu_open(file, flags, DCOPY_DEF_PERMS_FILE);
     }
 
+    /* some file systems refuse O_DIRECT, open without it in that
+     * case and let the copy go through the page cache, we still
+     * cache the descriptor under the flags that were asked for */
+    if (newfd == -1 && errno == EINVAL && (flags & O_DIRECT)) {
+        if (read_flag) {
+            newfd = mfu_open(file, flags & ~O_DIRECT);
+        } else {
+            newfd = mfu_open(file, flags & ~O_DIRECT, DCOPY_DEF_PERMS_FILE);
+        }
+    }
+
     /* cache the file descriptor */
     if (newfd != -1) {
-        cache->name = MFU_STRDUP(file);
-        cache->fd   = newfd;
-        cache->read = read_flag;
+        if (read_flag) {
+            mfu_copy_stats.total_src_opens++;
+        } else {
+            mfu_copy_stats.total_dst_opens++;
+        }
+        mfu_file_cache_add(cache, file, flags, newfd);
 #ifdef LUSTRE_SUPPORT
         /* Zero is an invalid ID for grouplock. */
         if (mfu_copy_opts->grouplock_id != 0) {
@@ -398,27 +454,27 @@ static void mfu_copy_timestamps(
     return;
 }
 
-static int mfu_copy_close_file(mfu_copy_file_cache_t* cache)
+/* return 1 if item is a regular file small enough to be copied
+ * whole by mfu_copy_small_files, 0 otherwise */
+static int mfu_copy_is_small(mfu_flist list, uint64_t idx,
+        const mfu_copy_opts_t* mfu_copy_opts)
 {
-    int rc = 0;
-
-    /* close file if we have one */
-    char* name = cache->name;
-    if (name != NULL) {
-        int fd = cache->fd;
-
-        /* if open for write, fsync */
-        int read_flag = cache->read;
-        if (! read_flag) {
-            rc = mfu_fsync(name, fd);
-        }
+    /* need file sizes to pick small files, and O_DIRECT
+     * copies go through the direct engine of the chunked path */
+    if (mfu_copy_opts->small_file_size == 0 ||
+        mfu_copy_opts->synchronous ||
+        ! mfu_flist_have_detail(list))
+    {
+        return 0;
+    }
 
-        /* close the file and delete the name string */
-        rc = mfu_close(name, fd);
-        mfu_free(&cache->name);
+    mfu_filetype type = mfu_flist_file_get_type(list, idx);
+    if (type != MFU_TYPE_FILE) {
+        return 0;
     }
 
-    return rc;
+    uint64_t size = mfu_flist_file_get_size(list, idx);
+    return (size < mfu_copy_opts->small_file_size);
 }
 
 /* iterate through list of files and set ownership, timestamps,
@@ -458,6 +514,11 @@ static void mfu_copy_set_metadata(int levels, int minlevel, mfu_flist* lists,
 
             /* TODO: skip file if it's not readable */
 
+            /* small files had their metadata set when they were copied */
+            if (mfu_copy_is_small(list, idx, mfu_copy_opts)) {
+                continue;
+            }
+
             /* get destination name of item */
             const char* name = mfu_flist_file_get_name(list, idx);
             char* dest = mfu_param_path_copy_dest(name, numpaths, 
@@ -702,6 +763,98 @@ static int mfu_create_link(mfu_flist list, uint64_t idx,
     return 0;
 }
 
+/* fallocate len bytes at offset in a destination file opened for
+ * preallocation, returns -1 if we should stop preallocating */
+static int mfu_copy_fallocate(const char* dest_path, int fd, int mode,
+        off_t offset, off_t len)
+{
+    if (fallocate(fd, mode, offset, len) < 0) {
+        if (errno == EOPNOTSUPP || errno == ENOSYS) {
+            /* stop trying if the file system doesn't support it */
+            mfu_copy_prealloc_unsupported = 1;
+            MFU_LOG(MFU_LOG_DBG, "Preallocation not supported for `%s'", dest_path);
+        } else {
+            /* not fatal, the copy will allocate blocks as it writes */
+            MFU_LOG(MFU_LOG_WARN, "Failed to preallocate %" PRIu64 " bytes at %" PRIu64 " for `%s' (errno=%d %s)",
+                (uint64_t)len, (uint64_t)offset, dest_path, errno, strerror(errno));
+        }
+        return -1;
+    }
+    return 0;
+}
+
+/* allocate space for the data regions of the source file, which
+ * we find with SEEK_DATA and SEEK_HOLE, keeping the destination
+ * size at 0 so the holes between them are still created */
+static void mfu_copy_preallocate_sparse(const char* src_path,
+        const char* dest_path, int fd, off_t size)
+{
+    int src_fd = mfu_open(src_path, O_RDONLY);
+    if (src_fd < 0) {
+        MFU_LOG(MFU_LOG_ERR, "Failed to open `%s' to find data regions (errno=%d %s)",
+            src_path, errno, strerror(errno));
+        return;
+    }
+
+    off_t pos = 0;
+    while (pos < size) {
+        off_t data = lseek(src_fd, pos, SEEK_DATA);
+        if (data < 0) {
+            /* ENXIO means no data past pos, and if the file system
+             * can't report holes we don't know what to allocate */
+            break;
+        }
+        off_t hole = lseek(src_fd, data, SEEK_HOLE);
+        if (hole < 0) {
+            break;
+        }
+        if (hole > size) {
+            hole = size;
+        }
+        if (hole > data &&
+            mfu_copy_fallocate(dest_path, fd, FALLOC_FL_KEEP_SIZE, data, hole - data) != 0)
+        {
+            break;
+        }
+        pos = hole;
+    }
+
+    mfu_close(src_path, src_fd);
+}
+
+/* allocate space for a new destination file, so its data lands in
+ * contiguous extents and chunks written out of order by different
+ * ranks don't each allocate blocks, with sparse files we allocate
+ * only the data regions of the source so holes are still created */
+static void mfu_copy_preallocate(mfu_flist list, uint64_t idx,
+        const char* dest_path, mfu_copy_opts_t* mfu_copy_opts)
+{
+    /* need the file size, and skip files with nothing to allocate */
+    if (mfu_copy_prealloc_unsupported || ! mfu_flist_have_detail(list)) {
+        return;
+    }
+    uint64_t size = mfu_flist_file_get_size(list, idx);
+    if (size == 0) {
+        return;
+    }
+
+    int fd = mfu_open(dest_path, O_WRONLY);
+    if (fd < 0) {
+        MFU_LOG(MFU_LOG_ERR, "Failed to open `%s' to preallocate (errno=%d %s)",
+            dest_path, errno, strerror(errno));
+        return;
+    }
+
+    if (mfu_copy_opts->sparse) {
+        const char* src_path = mfu_flist_file_get_name(list, idx);
+        mfu_copy_preallocate_sparse(src_path, dest_path, fd, (off_t)size);
+    } else {
+        mfu_copy_fallocate(dest_path, fd, 0, 0, (off_t)size);
+    }
+
+    mfu_close(dest_path, fd);
+}
+
 static int mfu_create_file(mfu_flist list, uint64_t idx,
         int numpaths, mfu_param_path* paths, 
         const mfu_param_path* destpath, mfu_copy_opts_t* mfu_copy_opts)
@@ -778,6 +931,12 @@ static int mfu_create_file(mfu_flist list, uint64_t idx,
         }
     }
 
+    /* allocate space after any truncate above and after setting
+     * striping xattrs, which Lustre needs before allocating */
+    if (mfu_copy_opts->preallocate) {
+        mfu_copy_preallocate(list, idx, dest_path, mfu_copy_opts);
+    }
+
     /* free destination path */
     mfu_free(&dest_path);
 
@@ -823,8 +982,11 @@ static int mfu_create_files(int levels, int minlevel, mfu_flist* lists,
             /* get type of item */
             mfu_filetype type = mfu_flist_file_get_type(list, idx);
 
-            /* process files and links */
-            if (type == MFU_TYPE_FILE) {
+            /* process files and links, small files are
+             * created when they are copied */
+            if (mfu_copy_is_small(list, idx, mfu_copy_opts)) {
+                continue;
+            } else if (type == MFU_TYPE_FILE) {
                 /* TODO: skip file if it's not readable */
                 mfu_create_file(list, idx, numpaths,
                         paths, destpath, mfu_copy_opts);
@@ -866,212 +1028,360 @@ static int mfu_create_files(int levels, int minlevel, mfu_flist* lists,
     return rc;
 }
 
-/* return 1 if entire buffer is 0, return 0 if any byte is not 0,
- * we avoid writing NULL blocks when supporting sparse files */
-static int mfu_is_all_null(const char* buf, uint64_t buf_size)
+/****************************************
+ * Background writer
+ ***************************************/
+
+/* A helper thread writes one block buffer to the destination while
+ * the main thread reads the next block into the other buffer, so a
+ * rank keeps both the source and destination file systems busy.
+ * The helper only calls write, never MPI, but we only start it when
+ * MPI was initialized with at least MPI_THREAD_FUNNELED.  The main
+ * thread waits for each write to finish before reusing its buffer or
+ * touching the destination file descriptor again. */
+typedef struct {
+    pthread_t thread;       /* helper thread */
+    pthread_mutex_t mutex;  /* protects fields below */
+    pthread_cond_t cond;    /* signals a new request or a finished write */
+    int started;            /* whether the thread is running */
+    int busy;               /* set while a write is queued or in progress */
+    int quit;               /* tells the thread to exit */
+    const char* file;       /* name of file to write to */
+    int fd;                 /* descriptor to write to */
+    const void* buf;        /* data to write */
+    size_t size;            /* number of bytes to write */
+    ssize_t rc;             /* result of last write */
+    int err;                /* errno of last write */
+} mfu_copy_writer_t;
+
+static mfu_copy_writer_t mfu_copy_writer;
+
+static void* mfu_copy_writer_main(void* arg)
 {
-    uint64_t i;
-    for (i = 0; i < buf_size; i++) {
-        if (buf[i] != 0) {
-            return 0;
+    mfu_copy_writer_t* w = (mfu_copy_writer_t*) arg;
+
+    pthread_mutex_lock(&w->mutex);
+    while (1) {
+        /* wait for a request */
+        while (! w->busy && ! w->quit) {
+            pthread_cond_wait(&w->cond, &w->mutex);
+        }
+        if (w->quit) {
+            break;
         }
+
+        /* write the buffer with the lock released */
+        pthread_mutex_unlock(&w->mutex);
+        ssize_t rc = mfu_write(w->file, w->fd, w->buf, w->size);
+        int err = errno;
+        pthread_mutex_lock(&w->mutex);
+
+        /* tell the main thread we're done */
+        w->rc   = rc;
+        w->err  = err;
+        w->busy = 0;
+        pthread_cond_broadcast(&w->cond);
     }
-    return 1;
+    pthread_mutex_unlock(&w->mutex);
+
+    return NULL;
 }
 
-/* when using sparse files, we need to write the last byte if the
- * hole is adjacent to EOF, so we need to detect whether we're at
- * the end of the file */
-static int mfu_is_eof(const char* file, int fd)
+/* start the helper thread if it's not running,
+ * returns 0 on success */
+static int mfu_copy_writer_start(mfu_copy_writer_t* w)
 {
-    /* read one byte from fd to determine whether this is EOF.
-     * This is not efficient, but it is the only reliable way */
-    char buf[1];
-    ssize_t num_of_bytes_read = mfu_read(file, fd, buf, 1);
+    if (w->started) {
+        return 0;
+    }
 
-    /* return if we detect EOF */
-    if(! num_of_bytes_read) {
-        return 1;
+    /* only use a second thread if MPI was told to expect one */
+    int level;
+    MPI_Query_thread(&level);
+    if (level < MPI_THREAD_FUNNELED) {
+        return -1;
     }
 
-    /* otherwise, we're not at EOF yet, seek back one byte */
-    if(mfu_lseek(file, fd, -1, SEEK_CUR) == (off_t)-1) {
-        MFU_LOG(MFU_LOG_ERR, "Couldn't seek in path `%s' errno=%d %s",
-                  file, errno, strerror(errno));
+    w->busy = 0;
+    w->quit = 0;
+    pthread_mutex_init(&w->mutex, NULL);
+    pthread_cond_init(&w->cond, NULL);
+    if (pthread_create(&w->thread, NULL, mfu_copy_writer_main, w) != 0) {
+        pthread_cond_destroy(&w->cond);
+        pthread_mutex_destroy(&w->mutex);
         return -1;
     }
+    w->started = 1;
     return 0;
 }
 
-static int mfu_copy_file_normal(
+/* queue a write of size bytes from buf to fd,
+ * the previous write must have been waited on */
+static void mfu_copy_writer_post(mfu_copy_writer_t* w,
+    const char* file, int fd, const void* buf, size_t size)
+{
+    pthread_mutex_lock(&w->mutex);
+    w->file = file;
+    w->fd   = fd;
+    w->buf  = buf;
+    w->size = size;
+    w->busy = 1;
+    pthread_cond_broadcast(&w->cond);
+    pthread_mutex_unlock(&w->mutex);
+}
+
+/* wait for the queued write to finish and return its result,
+ * with errno set as the write left it */
+static ssize_t mfu_copy_writer_wait(mfu_copy_writer_t* w)
+{
+    pthread_mutex_lock(&w->mutex);
+    while (w->busy) {
+        pthread_cond_wait(&w->cond, &w->mutex);
+    }
+    ssize_t rc = w->rc;
+    int err = w->err;
+    pthread_mutex_unlock(&w->mutex);
+    errno = err;
+    return rc;
+}
+
+/* stop the helper thread if it's running */
+static void mfu_copy_writer_stop(mfu_copy_writer_t* w)
+{
+    if (! w->started) {
+        return;
+    }
+
+    pthread_mutex_lock(&w->mutex);
+    w->quit = 1;
+    pthread_cond_broadcast(&w->cond);
+    pthread_mutex_unlock(&w->mutex);
+
+    pthread_join(w->thread, NULL);
+    pthread_cond_destroy(&w->cond);
+    pthread_mutex_destroy(&w->mutex);
+    w->started = 0;
+}
+
+/* copy a section by reading into one buffer while the helper thread
+ * writes the other, assumes file pointers are at offset */
+static int mfu_copy_file_pipelined(
     const char* src,
     const char* dest,
     const int in_fd,
     const int out_fd,
     uint64_t offset,
     uint64_t length,
-    uint64_t file_size,
+    size_t* total,
     mfu_copy_opts_t* mfu_copy_opts)
 {
-    /* hint that we'll read from file sequentially */
-//    posix_fadvise(in_fd, offset, chunk_size, POSIX_FADV_SEQUENTIAL);
-
-    /* seek to offset in source file */
-    if(mfu_lseek(src, in_fd, offset, SEEK_SET) == (off_t)-1) {
-        MFU_LOG(MFU_LOG_ERR, "Couldn't seek in source path `%s' errno=%d %s", \
-            src, errno, strerror(errno));
-        return -1;
-    }
+    mfu_copy_writer_t* w = &mfu_copy_writer;
 
-    /* seek to offset in destination file */
-    if(mfu_lseek(dest, out_fd, offset, SEEK_SET) == (off_t)-1) {
-        MFU_LOG(MFU_LOG_ERR, "Couldn't seek in destination path `%s' errno=%d %s", \
-            dest, errno, strerror(errno));
-        return -1;
-    }
-
-    /* get buffer */
     size_t buf_size = mfu_copy_opts->block_size;
-    void* buf = mfu_copy_opts->block_buf1;
+    char* bufs[2];
+    bufs[0] = mfu_copy_opts->block_buf1;
+    bufs[1] = mfu_copy_opts->block_buf2;
 
-    /* write data */
+    int rc = 0;
+    int cur = 0;
+    int pending = 0;
+    size_t pending_size = 0;
     size_t total_bytes = 0;
-    while(total_bytes <= (size_t)length) {
-        /* determine number of bytes that we
-         * can read = max(buf size, remaining chunk) */
+    while (total_bytes <= (size_t)length) {
+        /* read next block while the last one is written */
         size_t left_to_read = (size_t)length - total_bytes;
-        if(left_to_read > buf_size) {
+        if (left_to_read > buf_size) {
             left_to_read = buf_size;
         }
-
-        /* read data from source file */
+        char* buf = bufs[cur];
         ssize_t num_of_bytes_read = mfu_read(src, in_fd, buf, left_to_read);
 
-        /* check for EOF */
-        if(! num_of_bytes_read) {
+        /* check for read error, letting any queued write finish
+         * before we return, since it still uses the other buffer */
+        if (num_of_bytes_read < 0) {
+            MFU_LOG(MFU_LOG_ERR, "Read error when copying from `%s' to `%s' errno=%d %s",
+                src, dest, errno, strerror(errno));
+            if (pending) {
+                mfu_copy_writer_wait(w);
+                pending = 0;
+            }
+            rc = -1;
             break;
         }
 
+        if (num_of_bytes_read > 0) {
+            mfu_copy_checksum(offset + total_bytes, buf, (size_t) num_of_bytes_read);
+        }
+
         /* compute number of bytes to write */
         size_t bytes_to_write = (size_t) num_of_bytes_read;
-        if(mfu_copy_opts->synchronous) {
-            /* O_DIRECT requires particular write sizes,
-             * ok to write beyond end of file so long as
-             * we truncate in cleanup step */
-            size_t remainder = buf_size - (size_t) num_of_bytes_read;
-            if(remainder > 0) {
-                /* zero out the end of the buffer for security,
-                 * don't want to leave data from another file at end of
-                 * current file if we fail before truncating */
-                char* bufzero = ((char*)buf + num_of_bytes_read);
-                memset(bufzero, 0, remainder);
-            }
 
-            /* assumes buf_size is magic size for O_DIRECT */
-            bytes_to_write = buf_size;
+        /* wait for the previous write before we queue another */
+        if (pending) {
+            ssize_t num_of_bytes_written = mfu_copy_writer_wait(w);
+            pending = 0;
+            if (num_of_bytes_written < 0 || (size_t)num_of_bytes_written != pending_size) {
+                MFU_LOG(MFU_LOG_ERR, "Write error when copying from `%s' to `%s' errno=%d %s",
+                    src, dest, errno, strerror(errno));
+                rc = -1;
+                break;
+            }
         }
 
-        /* Write data to destination file.
-         * Do nothing for a hole in the middle of a file,
-         * because write of next chunk will create one for us.
-         * Write only the last byte to create the hole,
-         * if the hole is next to EOF. */
-        ssize_t num_of_bytes_written = (ssize_t)bytes_to_write;
-        if (mfu_copy_opts->sparse && mfu_is_all_null(buf, bytes_to_write)) {
-            /* TODO: isn't there a better way to know if we're at EOF,
-             * e.g., by using file size? */
-            /* determine whether we're at the end of the file */
-            int end_of_file = mfu_is_eof(src, in_fd);
-            if (end_of_file < 0) {
-                /* hit an error while looking for EOF */
-                return -1;
-            }
+        /* check for EOF */
+        if (! num_of_bytes_read) {
+            break;
+        }
 
-            /* if we're at the end of the file, write out a byte,
-             * otherwise just seek out destination file pointer
-             * ahead without writing anything */
-            if (end_of_file) {
-                /* seek to last byte position in file */
-                if(mfu_lseek(dest, out_fd, (off_t)bytes_to_write - 1, SEEK_CUR) == (off_t)-1) {
-                    MFU_LOG(MFU_LOG_ERR, "Couldn't seek in destination path `%s' errno=%d %s", \
-                        dest, errno, strerror(errno));
-                    return -1;
-                }
+        /* write this block in the background and switch buffers */
+        mfu_copy_writer_post(w, dest, out_fd, buf, bytes_to_write);
+        pending = 1;
+        pending_size = bytes_to_write;
+        cur ^= 1;
 
-                /* write out a single byte */
-                mfu_write(dest, out_fd, buf, 1);
-            } else {
-                /* this section of the destination file is all 0,
-                 * seek past this section */
-                if(mfu_lseek(dest, out_fd, (off_t)bytes_to_write, SEEK_CUR) == (off_t)-1) {
-                    MFU_LOG(MFU_LOG_ERR, "Couldn't seek in destination path `%s' errno=%d %s", \
-                        dest, errno, strerror(errno));
-                    return -1;
-                }
-            }
-        } else {
-            /* write bytes to destination file */
-            num_of_bytes_written = mfu_write(dest, out_fd, buf, bytes_to_write);
-        }
+        total_bytes += (size_t) num_of_bytes_read;
+    }
 
-        /* check for an error */
-        if(num_of_bytes_written < 0) {
+    /* wait for the last write */
+    if (pending) {
+        ssize_t num_of_bytes_written = mfu_copy_writer_wait(w);
+        if (num_of_bytes_written < 0 || (size_t)num_of_bytes_written != pending_size) {
             MFU_LOG(MFU_LOG_ERR, "Write error when copying from `%s' to `%s' errno=%d %s",
                 src, dest, errno, strerror(errno));
-            return -1;
+            rc = -1;
         }
+    }
 
-        /* check that we wrote the same number of bytes that we read */
-        if((size_t)num_of_bytes_written != bytes_to_write) {
-            MFU_LOG(MFU_LOG_ERR, "Write error when copying from `%s' to `%s'",
-                src, dest);
-            return -1;
-        }
+    *total = total_bytes;
+    return rc;
+}
 
-        /* add bytes to our total (use bytes read,
-         * which may be less than number written) */
-        total_bytes += (size_t) num_of_bytes_read;
-    }
+/****************************************
+ * io_uring engine
+ ***************************************/
 
-    /* Increment the global counter. */
-    mfu_copy_stats.total_size += (int64_t) total_bytes;
-    mfu_copy_stats.total_bytes_copied += (int64_t) total_bytes;
+/* Keeps up to queue_depth block reads and writes of a file section
+ * in flight at once, so a single rank can keep a parallel file system
+ * busy.  Each slot owns one block buffer, registered with the kernel
+ * when we're allowed to pin that much memory, and cycles between
+ * reading a block of the source and writing it to the destination. */
 
-#if 0
-    /* force data to file system */
-    if(total_bytes > 0) {
-        mfu_fsync(dest, out_fd);
-    }
+#define MFU_COPY_URING_READ  (0)
+#define MFU_COPY_URING_WRITE (1)
+
+typedef struct {
+    int      op;      /* whether slot is reading or writing */
+    int      index;   /* index of slot, and of its registered buffer */
+    char*    buf;     /* block buffer */
+    uint64_t offset;  /* file offset of block */
+    size_t   len;     /* bytes to read, then bytes read */
+    size_t   wlen;    /* bytes to write */
+    size_t   done;    /* bytes read or written so far */
+} mfu_copy_uring_slot_t;
+
+typedef struct {
+    int started;      /* whether the ring is set up */
+    int failed;       /* set if io_uring is not available, so we don't try again */
+    int fixed;        /* whether buffers are registered */
+    int depth;        /* number of slots */
+    char* bufs;       /* memory for all slot buffers */
+    mfu_copy_uring_slot_t* slots;
+#ifdef HAVE_LIBURING
+    struct io_uring ring;
 #endif
+} mfu_copy_uring_t;
 
-    /* no need to truncate if sparse file is enabled,
-     * since we truncated files when they were first created */
-    if (mfu_copy_opts->sparse) {
+static mfu_copy_uring_t mfu_copy_uring;
+
+#ifdef HAVE_LIBURING
+/* set up ring and buffers on first use, returns 0 on success,
+ * and -1 if io_uring is not available */
+static int mfu_copy_uring_start(mfu_copy_uring_t* u, const mfu_copy_opts_t* mfu_copy_opts)
+{
+    if (u->started) {
         return 0;
     }
+    if (u->failed) {
+        return -1;
+    }
 
-    /* if we wrote the last chunk, truncate the file */
-    off_t last_written = offset + length;
-    off_t file_size_offt = (off_t) file_size;
-    if (last_written >= file_size_offt || file_size == 0) {
-       /*
-        * Use ftruncate() here rather than truncate(), because grouplock
-        * of Lustre would cause block to truncate() since the fd is different
-        * from the out_fd.
-        */
-        if(ftruncate(out_fd, file_size_offt) < 0) {
-            MFU_LOG(MFU_LOG_ERR, "Failed to truncate destination file: %s (errno=%d %s)",
-                dest, errno, strerror(errno));
-            return -1;
-       }
+    /* each slot has at most one request in flight */
+    int depth = mfu_copy_opts->queue_depth;
+    int rc = io_uring_queue_init((unsigned) depth, &u->ring, 0);
+    if (rc < 0) {
+        /* kernel may be too old or io_uring disabled by policy */
+        u->failed = 1;
+        if (mfu_rank == 0) {
+            MFU_LOG(MFU_LOG_WARN, "io_uring not available (errno=%d %s), copying with read and write",
+                -rc, strerror(-rc));
+        }
+        return -1;
     }
 
-    /* we don't bother closing the file because our cache does it for us */
+    /* allocate block buffers, aligned for O_DIRECT */
+    size_t buf_size = mfu_copy_opts->block_size;
+    u->depth = depth;
+    u->bufs  = (char*) MFU_MEMALIGN((size_t)depth * buf_size, 1024 * 1024);
+    u->slots = (mfu_copy_uring_slot_t*) MFU_MALLOC((size_t)depth * sizeof(mfu_copy_uring_slot_t));
+
+    /* register buffers so the kernel maps them once rather than on
+     * every request, this fails if it would exceed RLIMIT_MEMLOCK,
+     * in which case we just pass buffers with each request */
+    struct iovec* iov = (struct iovec*) MFU_MALLOC((size_t)depth * sizeof(struct iovec));
+    int i;
+    for (i = 0; i < depth; i++) {
+        u->slots[i].index = i;
+        u->slots[i].buf   = u->bufs + (size_t)i * buf_size;
+        iov[i].iov_base = u->slots[i].buf;
+        iov[i].iov_len  = buf_size;
+    }
+    u->fixed = (io_uring_register_buffers(&u->ring, iov, (unsigned) depth) == 0);
+    mfu_free(&iov);
 
+    u->started = 1;
     return 0;
 }
 
-static int mfu_copy_file_fiemap(
+/* tear down ring and free buffers */
+static void mfu_copy_uring_stop(mfu_copy_uring_t* u)
+{
+    if (! u->started) {
+        return;
+    }
+    io_uring_queue_exit(&u->ring);
+    mfu_free(&u->bufs);
+    mfu_free(&u->slots);
+    u->started = 0;
+}
+
+/* queue the rest of the slot's read or write on fd */
+static void mfu_copy_uring_prep(mfu_copy_uring_t* u, mfu_copy_uring_slot_t* s, int fd)
+{
+    /* never NULL, since no more than depth requests are queued */
+    struct io_uring_sqe* sqe = io_uring_get_sqe(&u->ring);
+
+    char* buf = s->buf + s->done;
+    uint64_t pos = s->offset + (uint64_t) s->done;
+    if (s->op == MFU_COPY_URING_READ) {
+        unsigned n = (unsigned) (s->len - s->done);
+        if (u->fixed) {
+            io_uring_prep_read_fixed(sqe, fd, buf, n, pos, s->index);
+        } else {
+            io_uring_prep_read(sqe, fd, buf, n, pos);
+        }
+    } else {
+        unsigned n = (unsigned) (s->wlen - s->done);
+        if (u->fixed) {
+            io_uring_prep_write_fixed(sqe, fd, buf, n, pos, s->index);
+        } else {
+            io_uring_prep_write(sqe, fd, buf, n, pos);
+        }
+    }
+    io_uring_sqe_set_data(sqe, s);
+}
+
+/* copy a section keeping reads and writes of many blocks in flight */
+static int mfu_copy_file_uring(
     const char* src,
     const char* dest,
     const int in_fd,
@@ -1079,214 +1389,2557 @@ static int mfu_copy_file_fiemap(
     uint64_t offset,
     uint64_t length,
     uint64_t file_size,
-    bool* normal_copy_required,
     mfu_copy_opts_t* mfu_copy_opts)
 {
-    *normal_copy_required = true;
-    if (mfu_copy_opts->synchronous) {
-        goto fail_normal_copy;
-    }
+    mfu_copy_uring_t* u = &mfu_copy_uring;
+    size_t buf_size = mfu_copy_opts->block_size;
 
-    size_t last_ext_start = offset;
-    size_t last_ext_len = 0;
+    uint64_t end  = offset + length;
+    uint64_t next = offset;
+    uint64_t total_bytes = 0;
+    int inflight = 0;
+    int eof = 0;
+    int rc = 0;
 
-    struct fiemap *fiemap = (struct fiemap*)malloc(sizeof(struct fiemap));
-    if (fiemap == NULL) {
-        MFU_LOG(MFU_LOG_ERR, "Out of memory allocating fiemap\n");
-        goto fail_normal_copy;
+    /* start reading a block into each slot */
+    int i;
+    for (i = 0; i < u->depth && next < end; i++) {
+        mfu_copy_uring_slot_t* s = &u->slots[i];
+        s->op     = MFU_COPY_URING_READ;
+        s->offset = next;
+        s->len    = (size_t) MIN((uint64_t)buf_size, end - next);
+        s->done   = 0;
+        mfu_copy_uring_prep(u, s, in_fd);
+        next += s->len;
+        inflight++;
     }
-    memset(fiemap, 0, sizeof(struct fiemap));
+    io_uring_submit(&u->ring);
 
-    fiemap->fm_start  = offset;
-    fiemap->fm_length = length;
-    fiemap->fm_flags  = FIEMAP_FLAG_SYNC;
-    fiemap->fm_extent_count   = 0;
-    fiemap->fm_mapped_extents = 0;
+    while (inflight > 0) {
+        struct io_uring_cqe* cqe;
+        int ret = io_uring_wait_cqe(&u->ring, &cqe);
+        if (ret < 0) {
+            if (ret == -EINTR) {
+                continue;
+            }
 
-    struct stat sb;
-    if (fstat(in_fd, &sb) < 0) {
-        goto fail_normal_copy;
-    }
+            /* can't tell which requests are still running,
+             * so tear the ring down and stop using it */
+            MFU_LOG(MFU_LOG_ERR, "Failed to wait on io_uring when copying from `%s' to `%s' errno=%d %s",
+                src, dest, -ret, strerror(-ret));
+            mfu_copy_uring_stop(u);
+            u->failed = 1;
+            return -1;
+        }
 
-    if (ioctl(in_fd, FS_IOC_FIEMAP, fiemap) < 0) {
+        mfu_copy_uring_slot_t* s = (mfu_copy_uring_slot_t*) io_uring_cqe_get_data(cqe);
+        int res = cqe->res;
+        io_uring_cqe_seen(&u->ring, cqe);
+        inflight--;
+
+        /* retry interrupted requests */
+        if (res == -EINTR || res == -EAGAIN) {
+            mfu_copy_uring_prep(u, s, (s->op == MFU_COPY_URING_READ) ? in_fd : out_fd);
+            io_uring_submit(&u->ring);
+            inflight++;
+            continue;
+        }
+
+        /* after an error, just wait for requests in flight */
+        if (res < 0) {
+            if (rc == 0) {
+                MFU_LOG(MFU_LOG_ERR, "%s error when copying from `%s' to `%s' errno=%d %s",
+                    (s->op == MFU_COPY_URING_READ) ? "Read" : "Write",
+                    src, dest, -res, strerror(-res));
+            }
+            rc = -1;
+        }
+        if (rc != 0) {
+            continue;
+        }
+
+        if (s->op == MFU_COPY_URING_READ) {
+            if (res == 0) {
+                /* source file is shorter than expected */
+                s->len = s->done;
+                eof = 1;
+            } else {
+                s->done += (size_t) res;
+                if (s->done < s->len) {
+                    /* short read, get the rest of the block */
+                    mfu_copy_uring_prep(u, s, in_fd);
+                    io_uring_submit(&u->ring);
+                    inflight++;
+                    continue;
+                }
+            }
+
+            /* slot is idle if we read nothing */
+            if (s->len == 0) {
+                continue;
+            }
+            total_bytes += (uint64_t) s->len;
+            mfu_copy_checksum(s->offset, s->buf, s->len);
+
+            s->wlen = s->len;
+
+            /* write the block out */
+            s->op   = MFU_COPY_URING_WRITE;
+            s->done = 0;
+            mfu_copy_uring_prep(u, s, out_fd);
+        } else {
+            s->done += (size_t) res;
+            if (s->done < s->wlen) {
+                if (res == 0) {
+                    MFU_LOG(MFU_LOG_ERR, "Write error when copying from `%s' to `%s'",
+                        src, dest);
+                    rc = -1;
+                    continue;
+                }
+
+                /* short write, write the rest of the block */
+                mfu_copy_uring_prep(u, s, out_fd);
+            } else if (! eof && next < end) {
+                /* reuse the slot to read the next block */
+                s->op     = MFU_COPY_URING_READ;
+                s->offset = next;
+                s->len    = (size_t) MIN((uint64_t)buf_size, end - next);
+                s->done   = 0;
+                mfu_copy_uring_prep(u, s, in_fd);
+                next += s->len;
+            } else {
+                /* nothing left for this slot */
+                continue;
+            }
+        }
+        io_uring_submit(&u->ring);
+        inflight++;
+    }
+
+    if (rc != 0) {
+        return -1;
+    }
+
+    mfu_copy_stats.total_size += (int64_t) total_bytes;
+    mfu_copy_stats.total_bytes_copied += (int64_t) total_bytes;
+
+    /* if we wrote the last chunk, truncate the file */
+    off_t last_written = (off_t) end;
+    off_t file_size_offt = (off_t) file_size;
+    if (last_written >= file_size_offt || file_size == 0) {
+        if (ftruncate(out_fd, file_size_offt) < 0) {
+            MFU_LOG(MFU_LOG_ERR, "Failed to truncate destination file: %s (errno=%d %s)",
+                dest, errno, strerror(errno));
+            return -1;
+        }
+    }
+
+    return 0;
+}
+#else
+/* built without liburing, note that once and use read and write */
+static int mfu_copy_uring_start(mfu_copy_uring_t* u, const mfu_copy_opts_t* mfu_copy_opts)
+{
+    if (! u->failed && mfu_rank == 0) {
+        MFU_LOG(MFU_LOG_WARN, "Built without io_uring support, copying with read and write");
+    }
+    u->failed = 1;
+    return -1;
+}
+
+static void mfu_copy_uring_stop(mfu_copy_uring_t* u)
+{
+    return;
+}
+
+static int mfu_copy_file_uring(
+    const char* src,
+    const char* dest,
+    const int in_fd,
+    const int out_fd,
+    uint64_t offset,
+    uint64_t length,
+    uint64_t file_size,
+    mfu_copy_opts_t* mfu_copy_opts)
+{
+    return -1;
+}
+#endif /* HAVE_LIBURING */
+
+static int mfu_copy_file_normal(
+    const char* src,
+    const char* dest,
+    const int in_fd,
+    const int out_fd,
+    uint64_t offset,
+    uint64_t length,
+    uint64_t file_size,
+    mfu_copy_opts_t* mfu_copy_opts)
+{
+    /* hint that we'll read from file sequentially */
+//    posix_fadvise(in_fd, offset, chunk_size, POSIX_FADV_SEQUENTIAL);
+
+    /* seek to offset in source file */
+    if(mfu_lseek(src, in_fd, offset, SEEK_SET) == (off_t)-1) {
+        MFU_LOG(MFU_LOG_ERR, "Couldn't seek in source path `%s' errno=%d %s", \
+            src, errno, strerror(errno));
+        return -1;
+    }
+
+    /* seek to offset in destination file */
+    if(mfu_lseek(dest, out_fd, offset, SEEK_SET) == (off_t)-1) {
+        MFU_LOG(MFU_LOG_ERR, "Couldn't seek in destination path `%s' errno=%d %s", \
+            dest, errno, strerror(errno));
+        return -1;
+    }
+
+    /* get buffer */
+    size_t buf_size = mfu_copy_opts->block_size;
+    void* buf = mfu_copy_opts->block_buf1;
+
+    /* unless we look for holes, which moves the destination file
+     * pointer around, read one buffer while writing the other */
+    size_t total_bytes = 0;
+    int pipelined = 0;
+    if (! mfu_copy_opts->sparse && mfu_copy_opts->block_buf2 != NULL &&
+        mfu_copy_writer_start(&mfu_copy_writer) == 0)
+    {
+        if (mfu_copy_file_pipelined(src, dest, in_fd, out_fd,
+                offset, length, &total_bytes, mfu_copy_opts) != 0)
+        {
+            return -1;
+        }
+        pipelined = 1;
+    }
+
+    /* write data */
+    while(! pipelined && total_bytes <= (size_t)length) {
+        /* determine number of bytes that we
+         * can read = max(buf size, remaining chunk) */
+        size_t left_to_read = (size_t)length - total_bytes;
+        if(left_to_read > buf_size) {
+            left_to_read = buf_size;
+        }
+
+        /* read data from source file */
+        ssize_t num_of_bytes_read = mfu_read(src, in_fd, buf, left_to_read);
+
+        /* check for EOF */
+        if(! num_of_bytes_read) {
+            break;
+        }
+        if (num_of_bytes_read > 0) {
+            mfu_copy_checksum(offset + total_bytes, buf, (size_t) num_of_bytes_read);
+        }
+
+        /* compute number of bytes to write */
+        size_t bytes_to_write = (size_t) num_of_bytes_read;
+
+        /* Write data to destination file.
+         * Do nothing for a hole, just seek the destination file
+         * pointer ahead, the write of the next chunk will create it
+         * in the middle of the file, and we set the file size after
+         * writing the last chunk to create it at the end. */
+        ssize_t num_of_bytes_written = (ssize_t)bytes_to_write;
+        if (mfu_copy_opts->sparse && mfu_is_zero(buf, bytes_to_write)) {
+            /* this section of the destination file is all 0,
+             * seek past this section */
+            if(mfu_lseek(dest, out_fd, (off_t)bytes_to_write, SEEK_CUR) == (off_t)-1) {
+                MFU_LOG(MFU_LOG_ERR, "Couldn't seek in destination path `%s' errno=%d %s", \
+                    dest, errno, strerror(errno));
+                return -1;
+            }
+        } else {
+            /* write bytes to destination file */
+            num_of_bytes_written = mfu_write(dest, out_fd, buf, bytes_to_write);
+        }
+
+        /* check for an error */
+        if(num_of_bytes_written < 0) {
+            MFU_LOG(MFU_LOG_ERR, "Write error when copying from `%s' to `%s' errno=%d %s",
+                src, dest, errno, strerror(errno));
+            return -1;
+        }
+
+        /* check that we wrote the same number of bytes that we read */
+        if((size_t)num_of_bytes_written != bytes_to_write) {
+            MFU_LOG(MFU_LOG_ERR, "Write error when copying from `%s' to `%s'",
+                src, dest);
+            return -1;
+        }
+
+        /* add bytes to our total (use bytes read,
+         * which may be less than number written) */
+        total_bytes += (size_t) num_of_bytes_read;
+    }
+
+    /* Increment the global counter. */
+    mfu_copy_stats.total_size += (int64_t) total_bytes;
+    mfu_copy_stats.total_bytes_copied += (int64_t) total_bytes;
+
+#if 0
+    /* force data to file system */
+    if(total_bytes > 0) {
+        mfu_fsync(dest, out_fd);
+    }
+#endif
+
+    /* if we wrote the last chunk, truncate the file, with sparse
+     * files this also extends the file over any trailing hole,
+     * since we truncated files when they were first created */
+    off_t last_written = offset + length;
+    off_t file_size_offt = (off_t) file_size;
+    if (last_written >= file_size_offt || file_size == 0) {
+       /*
+        * Use ftruncate() here rather than truncate(), because grouplock
+        * of Lustre would cause block to truncate() since the fd is different
+        * from the out_fd.
+        */
+        if(ftruncate(out_fd, file_size_offt) < 0) {
+            MFU_LOG(MFU_LOG_ERR, "Failed to truncate destination file: %s (errno=%d %s)",
+                dest, errno, strerror(errno));
+            return -1;
+       }
+    }
+
+    /* we don't bother closing the file because our cache does it for us */
+
+    return 0;
+}
+
+/* alignment to assume for O_DIRECT if the kernel can't report it,
+ * covers devices with 512 byte and 4KB logical blocks */
+#define MFU_COPY_DIRECT_ALIGN (4096)
+
+/* get the memory and file offset alignment that direct I/O needs
+ * on fd, returns -1 if fd is not open with O_DIRECT or its file
+ * system can't do direct I/O on this file */
+static int mfu_copy_direct_align(int fd, size_t* mem_align, size_t* off_align)
+{
+    /* we open without O_DIRECT if the file system refuses it */
+    int flags = fcntl(fd, F_GETFL);
+    if (flags < 0 || ! (flags & O_DIRECT)) {
+        return -1;
+    }
+
+#ifdef STATX_DIOALIGN
+    struct statx stx;
+    if (statx(fd, "", AT_EMPTY_PATH, STATX_DIOALIGN, &stx) == 0 &&
+        (stx.stx_mask & STATX_DIOALIGN))
+    {
+        /* an offset alignment of 0 means no direct I/O on this file */
+        if (stx.stx_dio_offset_align == 0) {
+            return -1;
+        }
+        *mem_align = (size_t) stx.stx_dio_mem_align;
+        *off_align = (size_t) stx.stx_dio_offset_align;
+        return 0;
+    }
+#endif
+
+    *mem_align = MFU_COPY_DIRECT_ALIGN;
+    *off_align = MFU_COPY_DIRECT_ALIGN;
+    return 0;
+}
+
+/* copy len bytes at pos, with direct I/O if direct is set, otherwise
+ * through the page cache by clearing O_DIRECT while we copy,
+ * adds bytes read to copied */
+static int mfu_copy_direct_range(
+    const char* src,
+    const char* dest,
+    const int in_fd,
+    const int out_fd,
+    uint64_t pos,
+    uint64_t len,
+    int direct,
+    uint64_t* copied,
+    mfu_copy_opts_t* mfu_copy_opts)
+{
+    if (len == 0) {
+        return 0;
+    }
+
+    /* drop O_DIRECT for unaligned pieces, restored below */
+    int in_flags  = fcntl(in_fd,  F_GETFL);
+    int out_flags = fcntl(out_fd, F_GETFL);
+    if (in_flags < 0 || out_flags < 0) {
+        MFU_LOG(MFU_LOG_ERR, "Failed to get file flags copying `%s' to `%s' errno=%d %s",
+            src, dest, errno, strerror(errno));
+        return -1;
+    }
+    if (! direct) {
+        if (fcntl(in_fd,  F_SETFL, in_flags  & ~O_DIRECT) < 0 ||
+            fcntl(out_fd, F_SETFL, out_flags & ~O_DIRECT) < 0)
+        {
+            MFU_LOG(MFU_LOG_ERR, "Failed to clear O_DIRECT copying `%s' to `%s' errno=%d %s",
+                src, dest, errno, strerror(errno));
+            return -1;
+        }
+    }
+
+    int rc = 0;
+    size_t total_bytes = 0;
+    if (mfu_lseek(src, in_fd, (off_t)pos, SEEK_SET) == (off_t)-1) {
+        MFU_LOG(MFU_LOG_ERR, "Couldn't seek in source path `%s' errno=%d %s",
+            src, errno, strerror(errno));
+        rc = -1;
+    } else if (mfu_lseek(dest, out_fd, (off_t)pos, SEEK_SET) == (off_t)-1) {
+        MFU_LOG(MFU_LOG_ERR, "Couldn't seek in destination path `%s' errno=%d %s",
+            dest, errno, strerror(errno));
+        rc = -1;
+    } else if (direct && ! mfu_copy_opts->sparse && mfu_copy_opts->block_buf2 != NULL &&
+        mfu_copy_writer_start(&mfu_copy_writer) == 0)
+    {
+        /* every block is a multiple of the alignment,
+         * so reads and writes can overlap as usual */
+        rc = mfu_copy_file_pipelined(src, dest, in_fd, out_fd,
+                pos, len, &total_bytes, mfu_copy_opts);
+    } else {
+        size_t buf_size = mfu_copy_opts->block_size;
+        char* buf = mfu_copy_opts->block_buf1;
+        while (total_bytes < (size_t)len) {
+            size_t left_to_read = (size_t)len - total_bytes;
+            if (left_to_read > buf_size) {
+                left_to_read = buf_size;
+            }
+
+            ssize_t num_read = mfu_read(src, in_fd, buf, left_to_read);
+            if (num_read < 0) {
+                MFU_LOG(MFU_LOG_ERR, "Failed to read file: %s errno=%d (%s)",
+                    src, errno, strerror(errno));
+                rc = -1;
+                break;
+            }
+            if (num_read == 0) {
+                break;
+            }
+            mfu_copy_checksum(pos + total_bytes, buf, (size_t)num_read);
+
+            /* skip blocks of zeros for sparse files */
+            if (mfu_copy_opts->sparse && mfu_is_zero(buf, (size_t)num_read)) {
+                if (mfu_lseek(dest, out_fd, (off_t)num_read, SEEK_CUR) == (off_t)-1) {
+                    MFU_LOG(MFU_LOG_ERR, "Couldn't seek in destination path `%s' errno=%d %s",
+                        dest, errno, strerror(errno));
+                    rc = -1;
+                    break;
+                }
+            } else {
+                ssize_t num_written = mfu_write(dest, out_fd, buf, (size_t)num_read);
+                if (num_written != num_read) {
+                    MFU_LOG(MFU_LOG_ERR, "Write error when copying from `%s' to `%s' errno=%d %s",
+                        src, dest, errno, strerror(errno));
+                    rc = -1;
+                    break;
+                }
+            }
+
+            total_bytes += (size_t)num_read;
+        }
+    }
+
+    if (! direct) {
+        if (fcntl(in_fd,  F_SETFL, in_flags)  < 0 ||
+            fcntl(out_fd, F_SETFL, out_flags) < 0)
+        {
+            MFU_LOG(MFU_LOG_ERR, "Failed to restore O_DIRECT copying `%s' to `%s' errno=%d %s",
+                src, dest, errno, strerror(errno));
+            rc = -1;
+        }
+    }
+
+    *copied += (uint64_t) total_bytes;
+    return rc;
+}
+
+/* copy a file section opened with O_DIRECT, the file systems tell
+ * us the alignment they need through statx, we copy the aligned
+ * middle of the section with direct I/O and any unaligned head or
+ * tail through the page cache, so we never write past the end of
+ * the file, files that don't allow direct I/O are copied entirely
+ * through the page cache */
+static int mfu_copy_file_direct(
+    const char* src,
+    const char* dest,
+    const int in_fd,
+    const int out_fd,
+    uint64_t offset,
+    uint64_t length,
+    uint64_t file_size,
+    mfu_copy_opts_t* mfu_copy_opts)
+{
+    /* limit section to the size of the file */
+    uint64_t end = offset + length;
+    if (end > file_size) {
+        end = file_size;
+    }
+    if (offset > end) {
+        offset = end;
+    }
+
+    /* find the aligned part of the section, if any, our block
+     * buffers must also meet the alignment for direct I/O */
+    uint64_t direct_start = end;
+    uint64_t direct_end   = end;
+    size_t src_mem, src_off, dst_mem, dst_off;
+    if (mfu_copy_direct_align(in_fd,  &src_mem, &src_off) == 0 &&
+        mfu_copy_direct_align(out_fd, &dst_mem, &dst_off) == 0)
+    {
+        size_t mem_align = MAX(src_mem, dst_mem);
+        size_t off_align = MAX(src_off, dst_off);
+        size_t buf_size  = mfu_copy_opts->block_size;
+        if (mem_align > 0 && off_align > 0 &&
+            (uintptr_t)mfu_copy_opts->block_buf1 % mem_align == 0 &&
+            (uintptr_t)mfu_copy_opts->block_buf2 % mem_align == 0 &&
+            buf_size % off_align == 0)
+        {
+            uint64_t start = (offset + off_align - 1) / off_align * off_align;
+            uint64_t stop  = end / off_align * off_align;
+            if (start < stop) {
+                direct_start = start;
+                direct_end   = stop;
+            }
+        }
+    }
+
+    /* copy head, aligned middle, and tail */
+    uint64_t total_bytes = 0;
+    int rc = mfu_copy_direct_range(src, dest, in_fd, out_fd,
+        offset, direct_start - offset, 0, &total_bytes, mfu_copy_opts);
+    if (rc == 0) {
+        rc = mfu_copy_direct_range(src, dest, in_fd, out_fd,
+            direct_start, direct_end - direct_start, 1, &total_bytes, mfu_copy_opts);
+    }
+    if (rc == 0) {
+        rc = mfu_copy_direct_range(src, dest, in_fd, out_fd,
+            direct_end, end - direct_end, 0, &total_bytes, mfu_copy_opts);
+    }
+
+    /* Increment the global counter. */
+    mfu_copy_stats.total_size += (int64_t) total_bytes;
+    mfu_copy_stats.total_bytes_copied += (int64_t) total_bytes;
+
+    if (rc != 0) {
+        return -1;
+    }
+
+    /* if we wrote the last chunk, set the file size, which only
+     * shrinks an existing destination or extends a sparse one */
+    off_t last_written = (off_t) (offset + length);
+    off_t file_size_offt = (off_t) file_size;
+    if (last_written >= file_size_offt || file_size == 0) {
+       /*
+        * Use ftruncate() here rather than truncate(), because grouplock
+        * of Lustre would cause block to truncate() since the fd is different
+        * from the out_fd.
+        */
+        if (ftruncate(out_fd, file_size_offt) < 0) {
+            MFU_LOG(MFU_LOG_ERR, "Failed to truncate destination file: %s (errno=%d %s)",
+                dest, errno, strerror(errno));
+            return -1;
+       }
+    }
+
+    return 0;
+}
+
+static int mfu_copy_file_fiemap(
+    const char* src,
+    const char* dest,
+    const int in_fd,
+    const int out_fd,
+    uint64_t offset,
+    uint64_t length,
+    uint64_t file_size,
+    bool* normal_copy_required,
+    mfu_copy_opts_t* mfu_copy_opts)
+{
+    *normal_copy_required = true;
+    if (mfu_copy_opts->synchronous) {
+        goto fail_normal_copy;
+    }
+
+    size_t last_ext_start = offset;
+    size_t last_ext_len = 0;
+
+    struct fiemap *fiemap = (struct fiemap*)malloc(sizeof(struct fiemap));
+    if (fiemap == NULL) {
+        MFU_LOG(MFU_LOG_ERR, "Out of memory allocating fiemap\n");
+        goto fail_normal_copy;
+    }
+    memset(fiemap, 0, sizeof(struct fiemap));
+
+    fiemap->fm_start  = offset;
+    fiemap->fm_length = length;
+    fiemap->fm_flags  = FIEMAP_FLAG_SYNC;
+    fiemap->fm_extent_count   = 0;
+    fiemap->fm_mapped_extents = 0;
+
+    struct stat sb;
+    if (fstat(in_fd, &sb) < 0) {
+        goto fail_normal_copy;
+    }
+
+    if (ioctl(in_fd, FS_IOC_FIEMAP, fiemap) < 0) {
+        MFU_LOG(MFU_LOG_ERR, "fiemap ioctl() failed for src %s\n", src);
+        goto fail_normal_copy;
+    }
+
+    size_t extents_size = sizeof(struct fiemap_extent) * (fiemap->fm_mapped_extents);
+
+    if ((fiemap = (struct fiemap*)realloc(fiemap,sizeof(struct fiemap) +
+                                  extents_size)) == NULL)
+    {
+        MFU_LOG(MFU_LOG_ERR, "Out of memory reallocating fiemap\n");
+        goto fail_normal_copy;
+    }
+
+    memset(fiemap->fm_extents, 0, extents_size);
+    fiemap->fm_extent_count   = fiemap->fm_mapped_extents;
+    fiemap->fm_mapped_extents = 0;
+
+    if (ioctl(in_fd, FS_IOC_FIEMAP, fiemap) < 0) {
         MFU_LOG(MFU_LOG_ERR, "fiemap ioctl() failed for src %s\n", src);
         goto fail_normal_copy;
     }
 
-    size_t extents_size = sizeof(struct fiemap_extent) * (fiemap->fm_mapped_extents);
+    uint64_t last_byte = offset + length;
+
+    if (fiemap->fm_mapped_extents > 0) {
+        uint64_t fe_logical = fiemap->fm_extents[0].fe_logical;
+        uint64_t fe_length  = fiemap->fm_extents[0].fe_length;
+        if (fe_logical < offset) {
+            fiemap->fm_extents[0].fe_length -= (offset - fe_logical);
+            fiemap->fm_extents[0].fe_logical = offset;
+        }
+
+        fe_logical = fiemap->fm_extents[fiemap->fm_mapped_extents - 1].fe_logical;
+        fe_length  = fiemap->fm_extents[fiemap->fm_mapped_extents - 1].fe_length;
+        if (fe_logical + fe_length > last_byte) {
+           fiemap->fm_extents[fiemap->fm_mapped_extents - 1].fe_length -=
+           fe_logical + fe_length - last_byte;
+        }
+    }
+
+    *normal_copy_required = false;
+
+    /* seek to offset in source file */
+    if (mfu_lseek(src, in_fd, (off_t)last_ext_start, SEEK_SET) < 0) {
+        MFU_LOG(MFU_LOG_ERR, "Couldn't seek in source path `%s' errno=%d %s", \
+            src, errno, strerror(errno));
+        goto fail;
+    }
+
+    /* seek to offset in destination file */
+    if (mfu_lseek(dest, out_fd, (off_t)last_ext_start, SEEK_SET) < 0) {
+        MFU_LOG(MFU_LOG_ERR, "Couldn't seek in destination path `%s' errno=%d %s", \
+            dest, errno, strerror(errno));
+        goto fail;
+    }
+
+    unsigned int i;
+    for (i = 0; i < fiemap->fm_mapped_extents; i++) {
+        size_t ext_start;
+        size_t ext_len;
+        size_t ext_hole_size;
+
+        size_t buf_size = mfu_copy_opts->block_size;
+        void* buf = mfu_copy_opts->block_buf1;
+
+        ext_start = fiemap->fm_extents[i].fe_logical;
+        ext_len = fiemap->fm_extents[i].fe_length;
+        ext_hole_size = ext_start - (last_ext_start + last_ext_len);
+
+        if (ext_hole_size) {
+            if (mfu_lseek(src, in_fd, (off_t)ext_start, SEEK_SET) < 0) {
+                MFU_LOG(MFU_LOG_ERR, "Couldn't seek in source path `%s' errno=%d %s", \
+                    src, errno, strerror(errno));
+                goto fail;
+            }
+            if (mfu_lseek(dest, out_fd, (off_t)ext_hole_size, SEEK_CUR) < 0) {
+                MFU_LOG(MFU_LOG_ERR, "Couldn't seek in destination path `%s' errno=%d %s", \
+                    dest, errno, strerror(errno));
+                goto fail;
+            }
+        }
+
+        last_ext_start = ext_start;
+        last_ext_len = ext_len;
+
+        size_t ext_pos = ext_start;
+        while (ext_len) {
+            ssize_t num_read = mfu_read(src, in_fd, buf, MIN(ext_len, buf_size));
+
+            if (!num_read)
+                break;
+            if (num_read > 0) {
+                mfu_copy_checksum(ext_pos, buf, (size_t)num_read);
+            }
+
+            ssize_t num_written = mfu_write(dest, out_fd, buf, (size_t)num_read);
+
+            if (num_written < 0) {
+                MFU_LOG(MFU_LOG_ERR, "Write error when copying from `%s' to `%s' errno=%d %s",
+                          src, dest, errno, strerror(errno));
+                goto fail;
+            }
+            if (num_written != num_read) {
+                MFU_LOG(MFU_LOG_ERR, "Write error when copying from `%s' to `%s'",
+                    src, dest);
+                goto fail;
+            }
+
+            ext_len -= (size_t)num_written;
+            ext_pos += (size_t)num_written;
+            mfu_copy_stats.total_bytes_copied += (int64_t) num_written;
+        }
+    }
+
+    off_t last_written = (off_t) last_byte;
+    off_t file_size_offt = (off_t) file_size;
+    if (last_written >= file_size_offt || file_size == 0) {
+       /*
+        * Use ftruncate() here rather than truncate(), because grouplock
+        * of Lustre would cause block to truncate() since the fd is different
+        * from the out_fd.
+        */
+        if (ftruncate(out_fd, file_size_offt) < 0) {
+            MFU_LOG(MFU_LOG_ERR, "Failed to truncate destination file: %s (errno=%d %s)",
+                dest, errno, strerror(errno));
+            goto fail;
+       }
+    }
+
+    if (last_written >= file_size_offt) {
+        mfu_copy_stats.total_size += (int64_t) (file_size_offt - (off_t) offset);
+    } else {
+        mfu_copy_stats.total_size += (int64_t) last_byte;
+    }
+
+    free(fiemap);
+    return 0;
+
+fail:
+    free(fiemap);
+
+fail_normal_copy:
+    return -1;
+}
+
+/* punch a hole in the destination over a range that may already hold
+ * data, e.g., from an earlier copy, write zeros if we can't */
+static int mfu_copy_punch_hole(
+    const char* dest,
+    const int out_fd,
+    off_t pos,
+    off_t len,
+    mfu_copy_opts_t* mfu_copy_opts)
+{
+#ifdef FALLOC_FL_PUNCH_HOLE
+    if (fallocate(out_fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, pos, len) == 0) {
+        return 0;
+    }
+#endif
+
+    /* fall back to writing zeros */
+    size_t buf_size = mfu_copy_opts->block_size;
+    void* buf = mfu_copy_opts->block_buf1;
+    memset(buf, 0, buf_size);
+
+    if (mfu_lseek(dest, out_fd, pos, SEEK_SET) == (off_t)-1) {
+        MFU_LOG(MFU_LOG_ERR, "Couldn't seek in destination path `%s' errno=%d %s",
+            dest, errno, strerror(errno));
+        return -1;
+    }
+
+    while (len > 0) {
+        size_t bytes = (size_t) MIN((off_t)buf_size, len);
+        ssize_t num_written = mfu_write(dest, out_fd, buf, bytes);
+        if (num_written != (ssize_t)bytes) {
+            MFU_LOG(MFU_LOG_ERR, "Write error when zeroing `%s' errno=%d %s",
+                dest, errno, strerror(errno));
+            return -1;
+        }
+        len -= (off_t)num_written;
+    }
+
+    return 0;
+}
+
+/* copy the data regions of a file section found with lseek
+ * SEEK_DATA/SEEK_HOLE, unlike fiemap this doesn't force the source
+ * to flush dirty pages and works on file systems like NFS and tmpfs,
+ * sets normal_copy_required if the source file system can't report
+ * holes, the range is limited by file_size from the file list rather
+ * than probing for EOF */
+static int mfu_copy_file_seek(
+    const char* src,
+    const char* dest,
+    const int in_fd,
+    const int out_fd,
+    uint64_t offset,
+    uint64_t length,
+    uint64_t file_size,
+    bool* normal_copy_required,
+    mfu_copy_opts_t* mfu_copy_opts)
+{
+    *normal_copy_required = true;
+    if (mfu_copy_opts->synchronous) {
+        return -1;
+    }
+
+    /* limit section to the size of the file */
+    off_t pos = (off_t) offset;
+    off_t end = (off_t) (offset + length);
+    off_t file_size_offt = (off_t) file_size;
+    if (end > file_size_offt) {
+        end = file_size_offt;
+    }
+
+    /* find the first data region, a file system that doesn't
+     * support SEEK_DATA fails with EINVAL, in which case we leave
+     * normal_copy_required set so the caller can try another way */
+    off_t data = pos;
+    if (pos < end) {
+        data = lseek(in_fd, pos, SEEK_DATA);
+        if (data == (off_t)-1) {
+            if (errno != ENXIO) {
+                return -1;
+            }
+
+            /* no data from pos to the end of the file */
+            data = end;
+        }
+    }
+
+    *normal_copy_required = false;
+
+    /* get current size of destination, which may hold data
+     * in what are holes in the source if it already existed */
+    struct stat sb;
+    if (fstat(out_fd, &sb) < 0) {
+        MFU_LOG(MFU_LOG_ERR, "Failed to stat destination file: %s (errno=%d %s)",
+            dest, errno, strerror(errno));
+        return -1;
+    }
+    off_t dest_size = sb.st_size;
+
+    size_t buf_size = mfu_copy_opts->block_size;
+    void* buf = mfu_copy_opts->block_buf1;
+
+    while (pos < end) {
+        /* clear out any hole between here and the next data region */
+        if (data > end) {
+            data = end;
+        }
+        if (data > pos && pos < dest_size) {
+            off_t hole_end = MIN(data, dest_size);
+            if (mfu_copy_punch_hole(dest, out_fd, pos, hole_end - pos, mfu_copy_opts) < 0) {
+                return -1;
+            }
+        }
+        pos = data;
+        if (pos >= end) {
+            break;
+        }
+
+        /* find the end of this data region */
+        off_t hole = lseek(in_fd, pos, SEEK_HOLE);
+        if (hole == (off_t)-1) {
+            MFU_LOG(MFU_LOG_ERR, "Couldn't seek in source path `%s' errno=%d %s",
+                src, errno, strerror(errno));
+            return -1;
+        }
+        if (hole > end) {
+            hole = end;
+        }
+
+        /* copy the data region */
+        if (mfu_lseek(src, in_fd, pos, SEEK_SET) == (off_t)-1) {
+            MFU_LOG(MFU_LOG_ERR, "Couldn't seek in source path `%s' errno=%d %s",
+                src, errno, strerror(errno));
+            return -1;
+        }
+        if (mfu_lseek(dest, out_fd, pos, SEEK_SET) == (off_t)-1) {
+            MFU_LOG(MFU_LOG_ERR, "Couldn't seek in destination path `%s' errno=%d %s",
+                dest, errno, strerror(errno));
+            return -1;
+        }
+        while (pos < hole) {
+            size_t bytes = (size_t) MIN((off_t)buf_size, hole - pos);
+            ssize_t num_read = mfu_read(src, in_fd, buf, bytes);
+            if (num_read < 0) {
+                MFU_LOG(MFU_LOG_ERR, "Failed to read file: %s errno=%d (%s)",
+                    src, errno, strerror(errno));
+                return -1;
+            }
+            if (num_read == 0) {
+                /* file shrank since we walked it */
+                hole = pos;
+                end  = pos;
+                break;
+            }
+            mfu_copy_checksum((uint64_t)pos, buf, (size_t)num_read);
+
+            ssize_t num_written = mfu_write(dest, out_fd, buf, (size_t)num_read);
+            if (num_written < 0) {
+                MFU_LOG(MFU_LOG_ERR, "Write error when copying from `%s' to `%s' errno=%d %s",
+                    src, dest, errno, strerror(errno));
+                return -1;
+            }
+            if (num_written != num_read) {
+                MFU_LOG(MFU_LOG_ERR, "Write error when copying from `%s' to `%s'",
+                    src, dest);
+                return -1;
+            }
+
+            pos += (off_t)num_written;
+            mfu_copy_stats.total_bytes_copied += (int64_t) num_written;
+        }
+
+        /* find the next data region */
+        if (pos < end) {
+            data = lseek(in_fd, pos, SEEK_DATA);
+            if (data == (off_t)-1) {
+                if (errno != ENXIO) {
+                    MFU_LOG(MFU_LOG_ERR, "Couldn't seek in source path `%s' errno=%d %s",
+                        src, errno, strerror(errno));
+                    return -1;
+                }
+                data = end;
+            }
+        }
+    }
+
+    /* if we have the last chunk, set the file size, which creates
+     * any hole at the end of the file */
+    off_t last_written = (off_t) (offset + length);
+    if (last_written >= file_size_offt || file_size == 0) {
+       /*
+        * Use ftruncate() here rather than truncate(), because grouplock
+        * of Lustre would cause block to truncate() since the fd is different
+        * from the out_fd.
+        */
+        if (ftruncate(out_fd, file_size_offt) < 0) {
+            MFU_LOG(MFU_LOG_ERR, "Failed to truncate destination file: %s (errno=%d %s)",
+                dest, errno, strerror(errno));
+            return -1;
+       }
+    }
+
+    if (last_written >= file_size_offt) {
+        mfu_copy_stats.total_size += (int64_t) (file_size_offt - (off_t) offset);
+    } else {
+        mfu_copy_stats.total_size += (int64_t) length;
+    }
+
+    return 0;
+}
+
+/* count bytes copied with an engine, and count the file
+ * if this is its first section */
+static void mfu_copy_engine_count(int engine, uint64_t offset, uint64_t bytes)
+{
+    if (offset == 0) {
+        mfu_copy_stats.engine_files[engine]++;
+    }
+    mfu_copy_stats.engine_bytes[engine] += (int64_t) bytes;
+}
+
+/* return 1 if errno from a clone or copy_file_range call means the
+ * method does not work for this pair of files, 0 for a real error */
+static int mfu_copy_kernel_unsupported(int err)
+{
+    return (err == EXDEV || err == EOPNOTSUPP || err == ENOTSUP ||
+            err == ENOSYS || err == ENOTTY || err == EINVAL);
+}
+
+/* look up which kernel copy methods failed on this source file */
+static int mfu_copy_kernel_get_flags(const char* src)
+{
+    if (mfu_copy_kernel_file != NULL && strcmp(mfu_copy_kernel_file, src) == 0) {
+        return mfu_copy_kernel_flags;
+    }
+    mfu_free(&mfu_copy_kernel_file);
+    mfu_copy_kernel_file  = MFU_STRDUP(src);
+    mfu_copy_kernel_flags = 0;
+    return 0;
+}
+
+/* copy a file section with the file system doing the work, first
+ * by sharing source blocks with FICLONERANGE, then with
+ * copy_file_range, which lets file systems like NFS 4.2 copy on the
+ * server, sets copied to the number of bytes copied and engine to
+ * the method that copied them, returns 1 if the caller should copy
+ * the rest of the section with read and write, 0 on success,
+ * and -1 on error */
+static int mfu_copy_file_kernel(
+    const char* src,
+    const char* dest,
+    const int in_fd,
+    const int out_fd,
+    uint64_t offset,
+    uint64_t length,
+    uint64_t file_size,
+    uint64_t* copied,
+    int* engine)
+{
+    *copied = 0;
+    *engine = MFU_COPY_ENGINE_RW;
+
+    /* nothing to gain for an empty section */
+    if (length == 0) {
+        return 1;
+    }
+
+    int flags = mfu_copy_kernel_get_flags(src);
+    if (mfu_copy_kernel_nosys) {
+        flags |= MFU_COPY_NO_RANGE;
+    }
+
+    /* share blocks with the source, clone through the end of the file
+     * for its last section so a partial last block can be shared */
+    if (! (flags & MFU_COPY_NO_CLONE)) {
+        off_t clone_len = (off_t) length;
+        if (offset + length >= file_size) {
+            clone_len = 0;
+        }
+        if (mfu_clone_range(src, in_fd, (off_t)offset, out_fd, (off_t)offset, clone_len) == 0) {
+            *copied = length;
+            *engine = MFU_COPY_ENGINE_CLONE;
+        } else {
+            /* any failure here just means we can't share blocks */
+            mfu_copy_kernel_flags |= MFU_COPY_NO_CLONE;
+        }
+    }
+
+    /* copy within the kernel */
+    uint64_t end = offset + length;
+    if (*copied == 0 && ! (flags & MFU_COPY_NO_RANGE)) {
+        off_t in_off  = (off_t) offset;
+        off_t out_off = (off_t) offset;
+        while (*copied < length) {
+            /* limit each call so it returns to check for errors now and then */
+            size_t left = (size_t) (length - *copied);
+            if (left > (size_t)1 << 30) {
+                left = (size_t)1 << 30;
+            }
+
+            ssize_t n = mfu_copy_file_range(src, in_fd, &in_off, out_fd, &out_off, left);
+            if (n < 0) {
+                if (mfu_copy_kernel_unsupported(errno)) {
+                    /* fall back to read and write for the rest */
+                    if (errno == ENOSYS) {
+                        mfu_copy_kernel_nosys = 1;
+                    }
+                    mfu_copy_kernel_flags |= MFU_COPY_NO_RANGE;
+                    break;
+                }
+                MFU_LOG(MFU_LOG_ERR, "Failed to copy_file_range from `%s' to `%s' errno=%d %s",
+                    src, dest, errno, strerror(errno));
+                return -1;
+            }
+            if (n == 0) {
+                /* source file is shorter than expected */
+                length = *copied;
+                break;
+            }
+            *copied += (uint64_t) n;
+            *engine = MFU_COPY_ENGINE_RANGE;
+        }
+    }
+
+    /* let the caller copy whatever we didn't */
+    if (*copied < length) {
+        return 1;
+    }
+
+    mfu_copy_stats.total_size += (int64_t) *copied;
+    mfu_copy_stats.total_bytes_copied += (int64_t) *copied;
+
+    /* if we wrote the last chunk, truncate the file */
+    off_t last_written = (off_t) end;
+    off_t file_size_offt = (off_t) file_size;
+    if (last_written >= file_size_offt) {
+        if (ftruncate(out_fd, file_size_offt) < 0) {
+            MFU_LOG(MFU_LOG_ERR, "Failed to truncate destination file: %s (errno=%d %s)",
+                dest, errno, strerror(errno));
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static int mfu_copy_file(
+    const char* src,
+    const char* dest,
+    uint64_t offset,
+    uint64_t length,
+    uint64_t file_size,
+    mfu_copy_opts_t* mfu_copy_opts)
+{
+    int ret;
+    bool normal_copy_required;
+
+    /* open the input file */
+    int in_fd = mfu_copy_open_file(src, 1, &mfu_copy_src_cache, mfu_copy_opts);
+    if (in_fd < 0) {
+        MFU_LOG(MFU_LOG_ERR, "Failed to open input file `%s' errno=%d %s",
+            src, errno, strerror(errno));
+        return -1;
+    }
+
+    /* open the output file */
+    int out_fd = mfu_copy_open_file(dest, 0, &mfu_copy_dst_cache, mfu_copy_opts);
+    if (out_fd < 0) {
+        MFU_LOG(MFU_LOG_ERR, "Failed to open output file `%s' errno=%d %s",
+            dest, errno, strerror(errno));
+        return -1;
+    }
+
+    if (mfu_copy_opts->sparse) {
+        ret = mfu_copy_file_seek(src, dest, in_fd, out_fd, offset,
+                               length, file_size,
+                               &normal_copy_required, mfu_copy_opts);
+        if (!ret || !normal_copy_required) {
+            if (!ret) {
+                mfu_copy_engine_count(MFU_COPY_ENGINE_SEEK, offset, length);
+            }
+            return ret;
+        }
+
+        ret = mfu_copy_file_fiemap(src, dest, in_fd, out_fd, offset,
+                               length, file_size, 
+                               &normal_copy_required, mfu_copy_opts);
+        if (!ret || !normal_copy_required) {
+            if (!ret) {
+                mfu_copy_engine_count(MFU_COPY_ENGINE_FIEMAP, offset, length);
+            }
+            return ret;
+        }
+    }
+
+    /* bypass the page cache, the sparse engines above don't do
+     * direct I/O, so we get here for sparse copies too */
+    if (mfu_copy_opts->synchronous) {
+        mfu_copy_engine_count(MFU_COPY_ENGINE_DIRECT, offset, length);
+        return mfu_copy_file_direct(src, dest, in_fd, out_fd,
+                offset, length, file_size, mfu_copy_opts);
+    }
+
+    /* let the file system copy the data if it can, holes may be
+     * filled in and O_DIRECT bypassed, so not for sparse or
+     * synchronous copies */
+    uint64_t copied = 0;
+    if (mfu_copy_opts->kernel_copy && !mfu_copy_opts->sparse &&
+        !mfu_copy_opts->synchronous && mfu_copy_manifest == NULL)
+    {
+        int engine;
+        ret = mfu_copy_file_kernel(src, dest, in_fd, out_fd, offset,
+                length, file_size, &copied, &engine);
+        if (copied > 0) {
+            mfu_copy_engine_count(engine, offset, copied);
+        }
+        if (ret != 1) {
+            return ret;
+        }
+    }
+
+    /* keep many reads and writes in flight with io_uring */
+    if (mfu_copy_opts->queue_depth > 0 && !mfu_copy_opts->sparse &&
+        mfu_copy_uring_start(&mfu_copy_uring, mfu_copy_opts) == 0)
+    {
+        mfu_copy_engine_count(MFU_COPY_ENGINE_URING, offset + copied, length - copied);
+        return mfu_copy_file_uring(src, dest, in_fd, out_fd,
+                offset + copied, length - copied, file_size, mfu_copy_opts);
+    }
+
+    /* copy the rest through our buffers */
+    mfu_copy_engine_count(MFU_COPY_ENGINE_RW, offset + copied, length - copied);
+    return mfu_copy_file_normal(src, dest, in_fd, out_fd, 
+            offset + copied, length - copied, file_size, mfu_copy_opts);
+}
+
+/****************************************
+ * Checkpoint journal
+ ***************************************/
+
+/* When journaling, each rank appends fixed-size records to its own
+ * file, PREFIX.RANK, noting which phases have completed and which
+ * byte ranges of which files have been copied.  Files are named by
+ * their global index in the list being copied, which is sorted by
+ * name so that a file has the same index from one run to the next.
+ * Records are buffered and written out every so often, always after
+ * syncing the destination files they describe. */
+
+/* journal record types */
+#define MFU_COPY_JOURNAL_START (1) /* index = number of ranks, a = items in list, b = small file size */
+#define MFU_COPY_JOURNAL_PHASE (2) /* index = phase that completed */
+#define MFU_COPY_JOURNAL_FILE  (3) /* index into large list, a = file size, b = mtime in ns */
+#define MFU_COPY_JOURNAL_CHUNK (4) /* index into large list, a = offset, b = bytes copied */
+#define MFU_COPY_JOURNAL_SMALL (5) /* index into small list, a = file size, b = mtime in ns */
+
+/* phases noted in the journal, as bits in a mask */
+#define MFU_COPY_PHASE_DIRS  (1) /* directories created */
+#define MFU_COPY_PHASE_FILES (2) /* files and links created */
+#define MFU_COPY_PHASE_DATA  (4) /* all data copied */
+#define MFU_COPY_PHASE_META  (8) /* permissions, ownership, and timestamps set */
+
+/* size of a packed journal record in bytes */
+#define MFU_COPY_JOURNAL_RECSIZE (4 * 8)
+
+/* write out records when this many are buffered or after this many seconds */
+#define MFU_COPY_JOURNAL_RECS     (4096)
+#define MFU_COPY_JOURNAL_INTERVAL (10.0)
+
+typedef struct {
+    uint64_t type;  /* record type */
+    uint64_t index; /* item index or value, depending on type */
+    uint64_t a;     /* first value, depending on type */
+    uint64_t b;     /* second value, depending on type */
+} mfu_copy_journal_rec_t;
+
+typedef struct {
+    char*     name;          /* name of our journal file, NULL when not journaling */
+    int       fd;            /* descriptor of our journal file, -1 if not open */
+    mfu_copy_journal_rec_t* buf; /* records waiting to be written */
+    uint64_t  count;         /* number of records in buf */
+    double    last_flush;    /* time records were last written */
+    int       phases;        /* mask of phases that have completed */
+    uint64_t* large_offsets; /* global index of first large list item on each rank */
+    uint64_t* small_offsets; /* global index of first small list item on each rank */
+    mfu_copy_journal_rec_t* ranges; /* byte ranges of our large files copied by an earlier
+                                     * run, by local index and offset, no two touching */
+    uint64_t  range_count;   /* number of entries in ranges */
+    int       have_ranges;   /* whether any rank has ranges */
+    char*     small_done;    /* flag per small file we hold, set if copied by an earlier run */
+} mfu_copy_journal_t;
+
+static mfu_copy_journal_t mfu_copy_journal;
+
+/* modification time of item in nanoseconds */
+static uint64_t mfu_copy_journal_mtime(mfu_flist list, uint64_t idx)
+{
+    uint64_t secs  = mfu_flist_file_get_mtime(list, idx);
+    uint64_t nsecs = mfu_flist_file_get_mtime_nsec(list, idx);
+    return secs * 1000000000ULL + nsecs;
+}
+
+/* flush everything this node has written to the destination file
+ * system, falls back to sync if syncfs is not available */
+static void mfu_copy_syncfs(void)
+{
+    if (mfu_syncfs(mfu_copy_sync_path) != 0) {
+        if (errno == ENOSYS) {
+            sync();
+        } else {
+            MFU_LOG(MFU_LOG_ERR, "Failed to sync file system of `%s' errno=%d %s",
+                mfu_copy_sync_path, errno, strerror(errno));
+        }
+    }
+}
+
+/* flush the destination file system from one process on each node,
+ * syncfs covers writes from all processes on a node, collective */
+static void mfu_copy_syncfs_all(void)
+{
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+    MPI_Comm node_comm;
+    MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL, &node_comm);
+    int node_rank;
+    MPI_Comm_rank(node_comm, &node_rank);
+    if (node_rank == 0) {
+        mfu_copy_syncfs();
+    }
+    MPI_Comm_free(&node_comm);
+}
+
+/* sync destination files and append buffered records to our journal */
+static void mfu_copy_journal_flush(void)
+{
+    mfu_copy_journal_t* j = &mfu_copy_journal;
+    if (j->fd < 0) {
+        return;
+    }
+
+    if (j->count > 0) {
+        /* records must not reach the journal before the data they
+         * describe, files closed so far were synced on close unless
+         * we only sync the file system as a whole */
+        if (mfu_copy_durability == MFU_COPY_SYNC_FILE) {
+            mfu_file_cache_sync(&mfu_copy_dst_cache);
+        } else {
+            mfu_copy_syncfs();
+        }
+
+        size_t bufsize = (size_t) j->count * MFU_COPY_JOURNAL_RECSIZE;
+        char* packed = (char*) MFU_MALLOC(bufsize);
+        char* ptr = packed;
+        uint64_t i;
+        for (i = 0; i < j->count; i++) {
+            mfu_pack_uint64(&ptr, j->buf[i].type);
+            mfu_pack_uint64(&ptr, j->buf[i].index);
+            mfu_pack_uint64(&ptr, j->buf[i].a);
+            mfu_pack_uint64(&ptr, j->buf[i].b);
+        }
+
+        ssize_t nwrite = mfu_write(j->name, j->fd, packed, bufsize);
+        if (nwrite < 0 || (size_t) nwrite != bufsize || mfu_fsync(j->name, j->fd) != 0) {
+            /* stop journaling rather than leave a partial record
+             * in the middle of the file */
+            MFU_LOG(MFU_LOG_ERR, "Failed to write journal `%s', no longer journaling errno=%d %s",
+                j->name, errno, strerror(errno));
+            mfu_close(j->name, j->fd);
+            j->fd = -1;
+        }
+
+        mfu_free(&packed);
+        j->count = 0;
+    }
+
+    j->last_flush = MPI_Wtime();
+}
+
+/* add a record to our journal, writing out buffered records
+ * if the buffer is full or it's been a while */
+static void mfu_copy_journal_add(uint64_t type, uint64_t index, uint64_t a, uint64_t b)
+{
+    mfu_copy_journal_t* j = &mfu_copy_journal;
+    if (j->fd < 0) {
+        return;
+    }
+
+    /* extend the last record if this range picks up where it ended */
+    int merged = 0;
+    if (type == MFU_COPY_JOURNAL_CHUNK && j->count > 0) {
+        mfu_copy_journal_rec_t* last = &j->buf[j->count - 1];
+        if (last->type == MFU_COPY_JOURNAL_CHUNK &&
+            last->index == index && last->a + last->b == a)
+        {
+            last->b += b;
+            merged = 1;
+        }
+    }
+
+    if (! merged) {
+        mfu_copy_journal_rec_t* rec = &j->buf[j->count];
+        rec->type  = type;
+        rec->index = index;
+        rec->a     = a;
+        rec->b     = b;
+        j->count++;
+    }
+
+    if (j->count == MFU_COPY_JOURNAL_RECS ||
+        MPI_Wtime() - j->last_flush >= MFU_COPY_JOURNAL_INTERVAL)
+    {
+        mfu_copy_journal_flush();
+    }
+}
+
+/* read all whole records from a journal file, returns number of
+ * records read, which is 0 if the file does not exist */
+static uint64_t mfu_copy_journal_read(const char* name, mfu_copy_journal_rec_t** recs)
+{
+    *recs = NULL;
+
+    int fd = mfu_open(name, O_RDONLY);
+    if (fd < 0) {
+        if (errno != ENOENT) {
+            MFU_LOG(MFU_LOG_ERR, "Failed to open journal `%s' errno=%d %s",
+                name, errno, strerror(errno));
+        }
+        return 0;
+    }
+
+    /* a record cut short by a failure at the end of the file is ignored */
+    uint64_t count = 0;
+    struct stat st;
+    if (fstat(fd, &st) == 0) {
+        size_t bufsize = ((size_t) st.st_size / MFU_COPY_JOURNAL_RECSIZE) * MFU_COPY_JOURNAL_RECSIZE;
+        char* packed = (char*) MFU_MALLOC(bufsize);
+        ssize_t nread = mfu_read(name, fd, packed, bufsize);
+        if (nread > 0) {
+            count = (uint64_t) nread / MFU_COPY_JOURNAL_RECSIZE;
+        }
+
+        *recs = (mfu_copy_journal_rec_t*) MFU_MALLOC(count * sizeof(mfu_copy_journal_rec_t));
+        const char* ptr = packed;
+        uint64_t i;
+        for (i = 0; i < count; i++) {
+            mfu_unpack_uint64(&ptr, &(*recs)[i].type);
+            mfu_unpack_uint64(&ptr, &(*recs)[i].index);
+            mfu_unpack_uint64(&ptr, &(*recs)[i].a);
+            mfu_unpack_uint64(&ptr, &(*recs)[i].b);
+        }
+        mfu_free(&packed);
+    } else {
+        MFU_LOG(MFU_LOG_ERR, "Failed to stat journal `%s' errno=%d %s",
+            name, errno, strerror(errno));
+    }
+
+    mfu_close(name, fd);
+    return count;
+}
+
+/* return array of ranks+1 values giving the global index of the
+ * first item of list on each rank, the last value is the total */
+static uint64_t* mfu_copy_list_offsets(mfu_flist list)
+{
+    int ranks;
+    MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+
+    uint64_t size = mfu_flist_size(list);
+    uint64_t* offsets = (uint64_t*) MFU_MALLOC((size_t)(ranks + 1) * sizeof(uint64_t));
+    offsets[0] = 0;
+    MPI_Allgather(&size, 1, MPI_UINT64_T, &offsets[1], 1, MPI_UINT64_T, MPI_COMM_WORLD);
+
+    int i;
+    for (i = 1; i <= ranks; i++) {
+        offsets[i] += offsets[i - 1];
+    }
+
+    return offsets;
+}
+
+/* return rank holding the item with given global index */
+static int mfu_copy_index_owner(const uint64_t* offsets, int ranks, uint64_t index)
+{
+    int low  = 0;
+    int high = ranks - 1;
+    while (low < high) {
+        int mid = (low + high + 1) / 2;
+        if (offsets[mid] <= index) {
+            low = mid;
+        } else {
+            high = mid - 1;
+        }
+    }
+    return low;
+}
+
+/* send each record to the rank holding the item it names in the list
+ * described by offsets, returns number of records we receive */
+static uint64_t mfu_copy_journal_route(const mfu_copy_journal_rec_t* recs, uint64_t count,
+        const uint64_t* offsets, mfu_copy_journal_rec_t** out)
+{
+    int ranks;
+    MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+
+    int* sendcounts = (int*) MFU_MALLOC((size_t)ranks * sizeof(int));
+    int* senddisps  = (int*) MFU_MALLOC((size_t)ranks * sizeof(int));
+    int* recvcounts = (int*) MFU_MALLOC((size_t)ranks * sizeof(int));
+    int* recvdisps  = (int*) MFU_MALLOC((size_t)ranks * sizeof(int));
+
+    /* count values going to each rank, 4 per record */
+    int i;
+    for (i = 0; i < ranks; i++) {
+        sendcounts[i] = 0;
+    }
+    uint64_t n;
+    for (n = 0; n < count; n++) {
+        int dest = mfu_copy_index_owner(offsets, ranks, recs[n].index);
+        sendcounts[dest] += 4;
+    }
+
+    MPI_Alltoall(sendcounts, 1, MPI_INT, recvcounts, 1, MPI_INT, MPI_COMM_WORLD);
+
+    int sendtotal = 0;
+    int recvtotal = 0;
+    for (i = 0; i < ranks; i++) {
+        senddisps[i] = sendtotal;
+        recvdisps[i] = recvtotal;
+        sendtotal += sendcounts[i];
+        recvtotal += recvcounts[i];
+    }
+
+    /* pack records in order of destination rank, reuse
+     * sendcounts to track position as we go */
+    uint64_t* sendbuf = (uint64_t*) MFU_MALLOC((size_t)sendtotal * sizeof(uint64_t));
+    uint64_t* recvbuf = (uint64_t*) MFU_MALLOC((size_t)recvtotal * sizeof(uint64_t));
+    for (i = 0; i < ranks; i++) {
+        sendcounts[i] = 0;
+    }
+    for (n = 0; n < count; n++) {
+        int dest = mfu_copy_index_owner(offsets, ranks, recs[n].index);
+        uint64_t* ptr = &sendbuf[senddisps[dest] + sendcounts[dest]];
+        ptr[0] = recs[n].type;
+        ptr[1] = recs[n].index;
+        ptr[2] = recs[n].a;
+        ptr[3] = recs[n].b;
+        sendcounts[dest] += 4;
+    }
+
+    MPI_Alltoallv(sendbuf, sendcounts, senddisps, MPI_UINT64_T,
+                  recvbuf, recvcounts, recvdisps, MPI_UINT64_T, MPI_COMM_WORLD);
+
+    uint64_t recvrecs = (uint64_t) recvtotal / 4;
+    *out = (mfu_copy_journal_rec_t*) MFU_MALLOC(recvrecs * sizeof(mfu_copy_journal_rec_t));
+    for (n = 0; n < recvrecs; n++) {
+        (*out)[n].type  = recvbuf[n * 4 + 0];
+        (*out)[n].index = recvbuf[n * 4 + 1];
+        (*out)[n].a     = recvbuf[n * 4 + 2];
+        (*out)[n].b     = recvbuf[n * 4 + 3];
+    }
+
+    mfu_free(&recvbuf);
+    mfu_free(&sendbuf);
+    mfu_free(&recvdisps);
+    mfu_free(&recvcounts);
+    mfu_free(&senddisps);
+    mfu_free(&sendcounts);
+
+    return recvrecs;
+}
+
+/* order records by index, then by offset */
+static int mfu_copy_journal_rec_cmp(const void* a, const void* b)
+{
+    const mfu_copy_journal_rec_t* x = (const mfu_copy_journal_rec_t*) a;
+    const mfu_copy_journal_rec_t* y = (const mfu_copy_journal_rec_t*) b;
+    if (x->index != y->index) {
+        return (x->index < y->index) ? -1 : 1;
+    }
+    if (x->a != y->a) {
+        return (x->a < y->a) ? -1 : 1;
+    }
+    return 0;
+}
+
+/* read journals left by an earlier run and keep the byte ranges and
+ * small files it copied for files that have not changed since,
+ * returns the number of ranks in that run, or 0 if there is no
+ * journal that matches this copy */
+static int mfu_copy_journal_load(mfu_flist large_list, mfu_flist small_list,
+        uint64_t list_count, const mfu_copy_opts_t* mfu_copy_opts)
+{
+    mfu_copy_journal_t* j = &mfu_copy_journal;
+
+    int rank, ranks;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+
+    const char* prefix = mfu_copy_opts->journal;
+    size_t namelen = strlen(prefix) + 32;
+    char* name = (char*) MFU_MALLOC(namelen);
+
+    /* rank 0 learns the size of the earlier run and
+     * which phases it finished from the first journal */
+    uint64_t header[2] = {0, 0};
+    if (rank == 0) {
+        snprintf(name, namelen, "%s.%d", prefix, 0);
+        mfu_copy_journal_rec_t* recs;
+        uint64_t count = mfu_copy_journal_read(name, &recs);
+        uint64_t i;
+        for (i = 0; i < count; i++) {
+            if (recs[i].type == MFU_COPY_JOURNAL_START) {
+                if (recs[i].a == list_count &&
+                    recs[i].b == mfu_copy_opts->small_file_size)
+                {
+                    header[0] = recs[i].index;
+                }
+            } else if (recs[i].type == MFU_COPY_JOURNAL_PHASE) {
+                header[1] |= recs[i].index;
+            }
+        }
+        if (count == 0) {
+            MFU_LOG(MFU_LOG_WARN, "No journal found at `%s', copying everything", name);
+        } else if (header[0] == 0) {
+            MFU_LOG(MFU_LOG_WARN, "Journal `%s' is for a different list or batch size, copying everything", name);
+            header[1] = 0;
+        }
+        mfu_free(&recs);
+    }
+    MPI_Bcast(header, 2, MPI_UINT64_T, 0, MPI_COMM_WORLD);
+
+    int old_ranks = (int) header[0];
+    if (old_ranks == 0) {
+        mfu_free(&name);
+        return 0;
+    }
+    j->phases = (int) header[1];
+
+    /* read our share of the old journals */
+    int files = 0;
+    if (rank < old_ranks) {
+        files = (old_ranks - rank + ranks - 1) / ranks;
+    }
+    mfu_copy_journal_rec_t** file_recs = (mfu_copy_journal_rec_t**) MFU_MALLOC((size_t)files * sizeof(mfu_copy_journal_rec_t*));
+    uint64_t* file_counts = (uint64_t*) MFU_MALLOC((size_t)files * sizeof(uint64_t));
+    uint64_t large_count = 0;
+    uint64_t small_count = 0;
+    int f;
+    for (f = 0; f < files; f++) {
+        snprintf(name, namelen, "%s.%d", prefix, rank + f * ranks);
+        file_counts[f] = mfu_copy_journal_read(name, &file_recs[f]);
+        uint64_t i;
+        for (i = 0; i < file_counts[f]; i++) {
+            uint64_t type = file_recs[f][i].type;
+            if (type == MFU_COPY_JOURNAL_FILE || type == MFU_COPY_JOURNAL_CHUNK) {
+                large_count++;
+            } else if (type == MFU_COPY_JOURNAL_SMALL && small_list != NULL) {
+                small_count++;
+            }
+        }
+    }
+
+    /* split records by the list they refer to */
+    mfu_copy_journal_rec_t* large_recs = (mfu_copy_journal_rec_t*) MFU_MALLOC(large_count * sizeof(mfu_copy_journal_rec_t));
+    mfu_copy_journal_rec_t* small_recs = (mfu_copy_journal_rec_t*) MFU_MALLOC(small_count * sizeof(mfu_copy_journal_rec_t));
+    large_count = 0;
+    small_count = 0;
+    for (f = 0; f < files; f++) {
+        uint64_t i;
+        for (i = 0; i < file_counts[f]; i++) {
+            uint64_t type = file_recs[f][i].type;
+            if (type == MFU_COPY_JOURNAL_FILE || type == MFU_COPY_JOURNAL_CHUNK) {
+                large_recs[large_count++] = file_recs[f][i];
+            } else if (type == MFU_COPY_JOURNAL_SMALL && small_list != NULL) {
+                small_recs[small_count++] = file_recs[f][i];
+            }
+        }
+        mfu_free(&file_recs[f]);
+    }
+    mfu_free(&file_counts);
+    mfu_free(&file_recs);
+
+    /* send records to the ranks holding the files they name */
+    mfu_copy_journal_rec_t* recs;
+    uint64_t count = mfu_copy_journal_route(large_recs, large_count, j->large_offsets, &recs);
+    mfu_free(&large_recs);
+
+    /* mark each of our large files whose size and mtime match
+     * what the earlier run saw, 0 if we have no record of it,
+     * 1 if it matches, and 2 if it changed */
+    uint64_t large_size   = mfu_flist_size(large_list);
+    uint64_t large_offset = j->large_offsets[rank];
+    char* file_ok = (char*) MFU_MALLOC((size_t)large_size);
+    if (large_size > 0) {
+        memset(file_ok, 0, (size_t)large_size);
+    }
+    uint64_t n;
+    for (n = 0; n < count; n++) {
+        if (recs[n].type != MFU_COPY_JOURNAL_FILE) {
+            continue;
+        }
+        uint64_t idx = recs[n].index - large_offset;
+        if (recs[n].index < large_offset || idx >= large_size) {
+            continue;
+        }
+        if (mfu_flist_file_get_type(large_list, idx) == MFU_TYPE_FILE &&
+            mfu_flist_file_get_size(large_list, idx) == recs[n].a &&
+            mfu_copy_journal_mtime(large_list, idx) == recs[n].b)
+        {
+            if (file_ok[idx] == 0) {
+                file_ok[idx] = 1;
+            }
+        } else {
+            file_ok[idx] = 2;
+        }
+    }
+
+    /* keep the copied ranges of files that match */
+    j->ranges = (mfu_copy_journal_rec_t*) MFU_MALLOC(count * sizeof(mfu_copy_journal_rec_t));
+    j->range_count = 0;
+    for (n = 0; n < count; n++) {
+        if (recs[n].type != MFU_COPY_JOURNAL_CHUNK || recs[n].index < large_offset) {
+            continue;
+        }
+        uint64_t idx = recs[n].index - large_offset;
+        if (idx < large_size && file_ok[idx] == 1 && recs[n].b > 0) {
+            mfu_copy_journal_rec_t* r = &j->ranges[j->range_count];
+            *r = recs[n];
+            r->index = idx;
+            j->range_count++;
+        }
+    }
+    mfu_free(&file_ok);
+    mfu_free(&recs);
+
+    /* sort ranges and merge any that overlap or touch */
+    qsort(j->ranges, (size_t)j->range_count, sizeof(mfu_copy_journal_rec_t), mfu_copy_journal_rec_cmp);
+    uint64_t merged = 0;
+    for (n = 0; n < j->range_count; n++) {
+        mfu_copy_journal_rec_t* r = &j->ranges[n];
+        if (merged > 0) {
+            mfu_copy_journal_rec_t* last = &j->ranges[merged - 1];
+            if (last->index == r->index && r->a <= last->a + last->b) {
+                uint64_t end = r->a + r->b;
+                if (end > last->a + last->b) {
+                    last->b = end - last->a;
+                }
+                continue;
+            }
+        }
+        j->ranges[merged] = *r;
+        merged++;
+    }
+    j->range_count = merged;
+
+    /* mark small files the earlier run copied that have not changed */
+    uint64_t small_done = 0;
+    if (small_list != NULL) {
+        count = mfu_copy_journal_route(small_recs, small_count, j->small_offsets, &recs);
+        uint64_t small_size   = mfu_flist_size(small_list);
+        uint64_t small_offset = j->small_offsets[rank];
+        for (n = 0; n < count; n++) {
+            uint64_t idx = recs[n].index - small_offset;
+            if (recs[n].index < small_offset || idx >= small_size) {
+                continue;
+            }
+            if (mfu_flist_file_get_size(small_list, idx) == recs[n].a &&
+                mfu_copy_journal_mtime(small_list, idx) == recs[n].b &&
+                ! j->small_done[idx])
+            {
+                j->small_done[idx] = 1;
+                small_done++;
+            }
+        }
+        mfu_free(&recs);
+    }
+    mfu_free(&small_recs);
+
+    /* tell the user how much work is left over from the earlier run */
+    uint64_t values[3], sums[3];
+    values[0] = 0;
+    for (n = 0; n < j->range_count; n++) {
+        values[0] += j->ranges[n].b;
+    }
+    values[1] = small_done;
+    values[2] = j->range_count;
+    MPI_Allreduce(values, sums, 3, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+    j->have_ranges = (sums[2] > 0);
+    if (rank == 0) {
+        double done_tmp;
+        const char* done_units;
+        mfu_format_bytes(sums[0], &done_tmp, &done_units);
+        MFU_LOG(MFU_LOG_INFO, "Resuming from journal of %d processes: %.3lf %s and %llu small files already copied",
+            old_ranks, done_tmp, done_units, (unsigned long long) sums[1]);
+    }
+
+    mfu_free(&name);
+    return old_ranks;
+}
+
+/* start journaling to PREFIX.RANK, when resuming, first read the
+ * journals of the earlier run, list_count is the number of items
+ * in the whole list, collective over all ranks */
+static void mfu_copy_journal_open(mfu_flist large_list, mfu_flist small_list,
+        uint64_t list_count, const mfu_copy_opts_t* mfu_copy_opts)
+{
+    mfu_copy_journal_t* j = &mfu_copy_journal;
+    j->name          = NULL;
+    j->fd            = -1;
+    j->buf           = NULL;
+    j->count         = 0;
+    j->last_flush    = MPI_Wtime();
+    j->phases        = 0;
+    j->large_offsets = NULL;
+    j->small_offsets = NULL;
+    j->ranges        = NULL;
+    j->range_count   = 0;
+    j->have_ranges   = 0;
+    j->small_done    = NULL;
+
+    if (mfu_copy_opts->journal == NULL) {
+        return;
+    }
+
+    int rank, ranks;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+
+    /* build name of our journal file */
+    const char* prefix = mfu_copy_opts->journal;
+    size_t namelen = strlen(prefix) + 32;
+    j->name = (char*) MFU_MALLOC(namelen);
+    snprintf(j->name, namelen, "%s.%d", prefix, rank);
+
+    j->large_offsets = mfu_copy_list_offsets(large_list);
+    if (small_list != NULL) {
+        j->small_offsets = mfu_copy_list_offsets(small_list);
+        uint64_t small_size = mfu_flist_size(small_list);
+        j->small_done = (char*) MFU_MALLOC((size_t)small_size);
+        if (small_size > 0) {
+            memset(j->small_done, 0, (size_t)small_size);
+        }
+    }
+
+    int old_ranks = 0;
+    if (mfu_copy_opts->resume) {
+        old_ranks = mfu_copy_journal_load(large_list, small_list, list_count, mfu_copy_opts);
+    }
+
+    /* write what we know to a new journal, and only replace the
+     * old one once that's done, so a failure here loses nothing */
+    size_t tmplen = strlen(j->name) + 5;
+    char* tmpname = (char*) MFU_MALLOC(tmplen);
+    snprintf(tmpname, tmplen, "%s.tmp", j->name);
+    j->fd = mfu_open(tmpname, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+    if (j->fd < 0) {
+        MFU_LOG(MFU_LOG_ERR, "Failed to open journal `%s' errno=%d %s",
+            tmpname, errno, strerror(errno));
+    }
+    j->buf = (mfu_copy_journal_rec_t*) MFU_MALLOC(MFU_COPY_JOURNAL_RECS * sizeof(mfu_copy_journal_rec_t));
+
+    if (rank == 0) {
+        mfu_copy_journal_add(MFU_COPY_JOURNAL_START, (uint64_t) ranks,
+            list_count, mfu_copy_opts->small_file_size);
+        int phase;
+        for (phase = MFU_COPY_PHASE_DIRS; phase <= MFU_COPY_PHASE_META; phase <<= 1) {
+            if (j->phases & phase) {
+                mfu_copy_journal_add(MFU_COPY_JOURNAL_PHASE, (uint64_t) phase, 0, 0);
+            }
+        }
+    }
+
+    /* note size and mtime of our large files so a later run
+     * can tell whether ranges copied for them are still good */
+    uint64_t idx;
+    uint64_t large_size   = mfu_flist_size(large_list);
+    uint64_t large_offset = j->large_offsets[rank];
+    for (idx = 0; idx < large_size; idx++) {
+        if (mfu_flist_file_get_type(large_list, idx) == MFU_TYPE_FILE) {
+            mfu_copy_journal_add(MFU_COPY_JOURNAL_FILE, large_offset + idx,
+                mfu_flist_file_get_size(large_list, idx),
+                mfu_copy_journal_mtime(large_list, idx));
+        }
+    }
+
+    /* carry over what the earlier run copied */
+    uint64_t n;
+    for (n = 0; n < j->range_count; n++) {
+        const mfu_copy_journal_rec_t* r = &j->ranges[n];
+        mfu_copy_journal_add(MFU_COPY_JOURNAL_CHUNK, large_offset + r->index, r->a, r->b);
+    }
+    if (small_list != NULL) {
+        uint64_t small_size   = mfu_flist_size(small_list);
+        uint64_t small_offset = j->small_offsets[rank];
+        for (idx = 0; idx < small_size; idx++) {
+            if (j->small_done[idx]) {
+                mfu_copy_journal_add(MFU_COPY_JOURNAL_SMALL, small_offset + idx,
+                    mfu_flist_file_get_size(small_list, idx),
+                    mfu_copy_journal_mtime(small_list, idx));
+            }
+        }
+    }
+    mfu_copy_journal_flush();
+
+    if (j->fd >= 0 && rename(tmpname, j->name) != 0) {
+        MFU_LOG(MFU_LOG_ERR, "Failed to rename journal `%s' to `%s' errno=%d %s",
+            tmpname, j->name, errno, strerror(errno));
+    }
+
+    /* remove journals of ranks beyond the size of this job,
+     * whose records we've now written to our own */
+    int r;
+    for (r = rank + ranks; r < old_ranks; r += ranks) {
+        char oldname[PATH_MAX];
+        snprintf(oldname, sizeof(oldname), "%s.%d", prefix, r);
+        mfu_unlink(oldname);
+    }
+
+    mfu_free(&tmpname);
+
+    /* wait until all ranks have noted their files before copying,
+     * so no range is journaled before the file it belongs to */
+    MPI_Barrier(MPI_COMM_WORLD);
+}
+
+/* note in the journal that all ranks have finished phase */
+static void mfu_copy_journal_phase(int phase)
+{
+    mfu_copy_journal_t* j = &mfu_copy_journal;
+    if (j->name == NULL || (j->phases & phase)) {
+        return;
+    }
+
+    /* each rank writes out its records before rank 0 marks the phase done */
+    mfu_copy_journal_flush();
+    MPI_Barrier(MPI_COMM_WORLD);
+
+    j->phases |= phase;
+
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    if (rank == 0) {
+        mfu_copy_journal_add(MFU_COPY_JOURNAL_PHASE, (uint64_t) phase, 0, 0);
+        mfu_copy_journal_flush();
+    }
+}
+
+/* write out remaining records and close the journal */
+static void mfu_copy_journal_close(void)
+{
+    mfu_copy_journal_t* j = &mfu_copy_journal;
+    if (j->name == NULL) {
+        return;
+    }
+
+    mfu_copy_journal_flush();
+    if (j->fd >= 0) {
+        mfu_close(j->name, j->fd);
+        j->fd = -1;
+    }
+
+    mfu_free(&j->small_done);
+    mfu_free(&j->ranges);
+    mfu_free(&j->small_offsets);
+    mfu_free(&j->large_offsets);
+    mfu_free(&j->buf);
+    mfu_free(&j->name);
+}
+
+/* number of bytes starting at offset in our large file idx that
+ * an earlier run copied, at most length */
+static uint64_t mfu_copy_journal_covered(uint64_t idx, uint64_t offset, uint64_t length)
+{
+    mfu_copy_journal_t* j = &mfu_copy_journal;
+
+    /* find last range that starts at or before offset in this file */
+    uint64_t low  = 0;
+    uint64_t high = j->range_count;
+    while (low < high) {
+        uint64_t mid = low + (high - low) / 2;
+        const mfu_copy_journal_rec_t* r = &j->ranges[mid];
+        if (r->index < idx || (r->index == idx && r->a <= offset)) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    if (low == 0) {
+        return 0;
+    }
+
+    const mfu_copy_journal_rec_t* r = &j->ranges[low - 1];
+    if (r->index != idx || r->a + r->b <= offset) {
+        return 0;
+    }
+
+    uint64_t covered = r->a + r->b - offset;
+    if (covered > length) {
+        covered = length;
+    }
+    return covered;
+}
+
+/* return an array giving, for each file section in chunks, the number
+ * of leading bytes an earlier run copied, or NULL if no rank has any
+ * copied ranges, collective over all ranks */
+static uint64_t* mfu_copy_journal_query(const mfu_file_chunk_array* chunks)
+{
+    mfu_copy_journal_t* j = &mfu_copy_journal;
+    if (! j->have_ranges) {
+        return NULL;
+    }
+
+    int ranks;
+    MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+
+    int* sendcounts = (int*) MFU_MALLOC((size_t)ranks * sizeof(int));
+    int* senddisps  = (int*) MFU_MALLOC((size_t)ranks * sizeof(int));
+    int* recvcounts = (int*) MFU_MALLOC((size_t)ranks * sizeof(int));
+    int* recvdisps  = (int*) MFU_MALLOC((size_t)ranks * sizeof(int));
+
+    /* ask the owner of each section's file, sending
+     * local index, offset, and length */
+    int i;
+    for (i = 0; i < ranks; i++) {
+        sendcounts[i] = 0;
+    }
+    uint64_t count = chunks->count;
+    uint64_t n;
+    for (n = 0; n < count; n++) {
+        sendcounts[chunks->chunks[n].rank_of_owner] += 3;
+    }
+
+    MPI_Alltoall(sendcounts, 1, MPI_INT, recvcounts, 1, MPI_INT, MPI_COMM_WORLD);
+
+    int sendtotal = 0;
+    int recvtotal = 0;
+    for (i = 0; i < ranks; i++) {
+        senddisps[i] = sendtotal;
+        recvdisps[i] = recvtotal;
+        sendtotal += sendcounts[i];
+        recvtotal += recvcounts[i];
+    }
+
+    /* remember where each section's question goes so we can find its answer */
+    uint64_t* sendbuf = (uint64_t*) MFU_MALLOC((size_t)sendtotal * sizeof(uint64_t));
+    uint64_t* recvbuf = (uint64_t*) MFU_MALLOC((size_t)recvtotal * sizeof(uint64_t));
+    uint64_t* slot    = (uint64_t*) MFU_MALLOC(count * sizeof(uint64_t));
+    for (i = 0; i < ranks; i++) {
+        sendcounts[i] = 0;
+    }
+    for (n = 0; n < count; n++) {
+        const mfu_file_chunk_desc* p = &chunks->chunks[n];
+        int dest = (int) p->rank_of_owner;
+        int pos = senddisps[dest] + sendcounts[dest];
+        sendbuf[pos + 0] = p->index_of_owner;
+        sendbuf[pos + 1] = p->offset;
+        sendbuf[pos + 2] = p->length;
+        slot[n] = (uint64_t) pos / 3;
+        sendcounts[dest] += 3;
+    }
+
+    MPI_Alltoallv(sendbuf, sendcounts, senddisps, MPI_UINT64_T,
+                  recvbuf, recvcounts, recvdisps, MPI_UINT64_T, MPI_COMM_WORLD);
+
+    /* answer questions in place, one value for every three received */
+    int recvq = recvtotal / 3;
+    int q;
+    for (q = 0; q < recvq; q++) {
+        recvbuf[q] = mfu_copy_journal_covered(recvbuf[q * 3 + 0],
+            recvbuf[q * 3 + 1], recvbuf[q * 3 + 2]);
+    }
+
+    /* send answers back, one value per question */
+    for (i = 0; i < ranks; i++) {
+        sendcounts[i] /= 3;
+        senddisps[i]  /= 3;
+        recvcounts[i] /= 3;
+        recvdisps[i]  /= 3;
+    }
+    MPI_Alltoallv(recvbuf, recvcounts, recvdisps, MPI_UINT64_T,
+                  sendbuf, sendcounts, senddisps, MPI_UINT64_T, MPI_COMM_WORLD);
+
+    uint64_t* covered = (uint64_t*) MFU_MALLOC(count * sizeof(uint64_t));
+    for (n = 0; n < count; n++) {
+        covered[n] = sendbuf[slot[n]];
+    }
+
+    mfu_free(&slot);
+    mfu_free(&recvbuf);
+    mfu_free(&sendbuf);
+    mfu_free(&recvdisps);
+    mfu_free(&recvcounts);
+    mfu_free(&senddisps);
+    mfu_free(&sendcounts);
+
+    return covered;
+}
+
+/* global index in the large list of the file a section belongs to,
+ * 0 when not journaling */
+static uint64_t mfu_copy_journal_index(const mfu_file_chunk_desc* p)
+{
+    mfu_copy_journal_t* j = &mfu_copy_journal;
+    if (j->large_offsets == NULL) {
+        return 0;
+    }
+    return j->large_offsets[p->rank_of_owner] + p->index_of_owner;
+}
+
+/* copy a section of a file to its destination path,
+ * tracks the time spent copying as busy time */
+static int mfu_copy_section(const char* name, uint64_t offset,
+        uint64_t length, uint64_t file_size,
+        int numpaths, const mfu_param_path* paths,
+        const mfu_param_path* destpath, mfu_copy_opts_t* mfu_copy_opts)
+{
+    int rc = 0;
+    double start = MPI_Wtime();
+
+    /* get name of destination file */
+    char* dest_path = mfu_param_path_copy_dest(name, numpaths,
+            paths, destpath, mfu_copy_opts);
+
+    /* No need to copy it */
+    if (dest_path != NULL) {
+        /* copy the section of the file */
+        mfu_copy_sum = 0;
+        rc = mfu_copy_file(name, dest_path, offset, length, file_size,
+                mfu_copy_opts);
+        if (mfu_copy_manifest != NULL) {
+            mfu_manifest_add(mfu_copy_manifest, dest_path, file_size, mfu_copy_sum);
+        }
+
+        /* free the dest name */
+        mfu_free(&dest_path);
+    }
+
+    mfu_copy_stats.total_chunks++;
+    mfu_copy_stats.wtime_busy += MPI_Wtime() - start;
+
+    return rc;
+}
+
+/* copy a piece of a file section and note it in the journal
+ * once it's copied, index is the global index of the file */
+static void mfu_copy_piece(const char* name, uint64_t index,
+        uint64_t offset, uint64_t length, uint64_t file_size,
+        int numpaths, const mfu_param_path* paths,
+        const mfu_param_path* destpath, mfu_copy_opts_t* mfu_copy_opts)
+{
+    int rc = mfu_copy_section(name, offset, length, file_size,
+        numpaths, paths, destpath, mfu_copy_opts);
+    if (rc == 0 && length > 0) {
+        mfu_copy_journal_add(MFU_COPY_JOURNAL_CHUNK, index, offset, length);
+    }
+}
+
+/* copy a file section skipping its first skip bytes, which an
+ * earlier run copied, when journaling, the section is copied in
+ * pieces of the file's chunk size, so a failure part way through
+ * a long section loses at most the piece in progress */
+static void mfu_copy_section_resumable(const mfu_file_chunk_array* chunks,
+        uint64_t n, uint64_t skip,
+        int numpaths, const mfu_param_path* paths,
+        const mfu_param_path* destpath, mfu_copy_opts_t* mfu_copy_opts)
+{
+    const mfu_file_chunk_desc* p = &chunks->chunks[n];
+    const char* name = chunks->names[p->name_id];
+
+    if (mfu_copy_journal.name == NULL) {
+        mfu_copy_section(name, p->offset, p->length, p->file_size,
+            numpaths, paths, destpath, mfu_copy_opts);
+        return;
+    }
+
+    /* nothing to do if an earlier run copied the whole section */
+    uint64_t end = p->offset + p->length;
+    uint64_t offset = p->offset + skip;
+    if (skip > 0 && offset >= end) {
+        return;
+    }
+
+    uint64_t index = mfu_copy_journal_index(p);
+    do {
+        uint64_t length = end - offset;
+        if (length > p->chunk_size) {
+            length = p->chunk_size;
+        }
+        mfu_copy_piece(name, index, offset, length, p->file_size,
+            numpaths, paths, destpath, mfu_copy_opts);
+        offset += length;
+    } while (offset < end);
+}
+
+/* copy a small file whole in a single open-read-write-close sequence,
+ * the destination is created here rather than in mfu_create_files,
+ * and metadata is applied while the destination is still open */
+static int mfu_copy_small_file(mfu_flist list, uint64_t idx,
+        int numpaths, const mfu_param_path* paths,
+        const mfu_param_path* destpath, mfu_copy_opts_t* mfu_copy_opts)
+{
+    int rc = 0;
+
+    /* get source name */
+    const char* src_path = mfu_flist_file_get_name(list, idx);
+
+    /* get destination name */
+    char* dest_path = mfu_param_path_copy_dest(src_path, numpaths,
+            paths, destpath, mfu_copy_opts);
+
+    /* No need to copy it */
+    if (dest_path == NULL) {
+        return 0;
+    }
+
+    /* open source file */
+    int in_fd = mfu_open(src_path, O_RDONLY);
+    if (in_fd < 0) {
+        MFU_LOG(MFU_LOG_ERR, "Failed to open `%s' errno=%d %s",
+            src_path, errno, strerror(errno));
+        mfu_free(&dest_path);
+        return -1;
+    }
+
+    /* create destination file, truncating anything already there */
+    int out_fd = mfu_open(dest_path, O_WRONLY | O_CREAT | O_TRUNC, DCOPY_DEF_PERMS_FILE);
+    if (out_fd < 0) {
+        MFU_LOG(MFU_LOG_ERR, "Failed to open `%s' errno=%d %s",
+            dest_path, errno, strerror(errno));
+        mfu_close(src_path, in_fd);
+        mfu_free(&dest_path);
+        return -1;
+    }
+
+    mfu_copy_stats.total_src_opens++;
+    mfu_copy_stats.total_dst_opens++;
+
+    /* copy extended attributes before writing data */
+    if (mfu_copy_opts->preserve) {
+        mfu_copy_xattrs(list, idx, dest_path);
+    }
+
+    /* copy data until we hit the end of the source file */
+    size_t buf_size = mfu_copy_opts->block_size;
+    char* buf = mfu_copy_opts->block_buf1;
+    uint64_t total_bytes = 0;
+    mfu_copy_sum = 0;
+    while (1) {
+        ssize_t num_read = mfu_read(src_path, in_fd, buf, buf_size);
+        if (num_read < 0) {
+            MFU_LOG(MFU_LOG_ERR, "Failed to read `%s' errno=%d %s",
+                src_path, errno, strerror(errno));
+            rc = -1;
+            break;
+        }
+
+        /* check for EOF */
+        if (num_read == 0) {
+            break;
+        }
+        mfu_copy_checksum(total_bytes, buf, (size_t) num_read);
+
+        if (mfu_copy_opts->sparse && mfu_is_zero(buf, (size_t) num_read)) {
+            /* skip over holes, we set the final size below */
+            if (mfu_lseek(dest_path, out_fd, (off_t) num_read, SEEK_CUR) == (off_t)-1) {
+                MFU_LOG(MFU_LOG_ERR, "Couldn't seek in destination path `%s' errno=%d %s",
+                    dest_path, errno, strerror(errno));
+                rc = -1;
+                break;
+            }
+        } else {
+            ssize_t num_written = mfu_write(dest_path, out_fd, buf, (size_t) num_read);
+            if (num_written != num_read) {
+                MFU_LOG(MFU_LOG_ERR, "Write error when copying from `%s' to `%s' errno=%d %s",
+                    src_path, dest_path, errno, strerror(errno));
+                rc = -1;
+                break;
+            }
+        }
+
+        total_bytes += (uint64_t) num_read;
+    }
+
+    /* extend file over any trailing hole */
+    if (rc == 0 && mfu_copy_opts->sparse) {
+        if (ftruncate(out_fd, (off_t) total_bytes) < 0) {
+            MFU_LOG(MFU_LOG_ERR, "Failed to truncate destination file: %s (errno=%d %s)",
+                dest_path, errno, strerror(errno));
+            rc = -1;
+        }
+    }
+
+    mfu_copy_stats.total_size += (int64_t) total_bytes;
+    mfu_copy_stats.total_bytes_copied += (int64_t) total_bytes;
+    mfu_copy_engine_count(MFU_COPY_ENGINE_RW, 0, total_bytes);
+    if (mfu_copy_manifest != NULL) {
+        mfu_manifest_add(mfu_copy_manifest, dest_path, total_bytes, mfu_copy_sum);
+    }
+
+    /* force data to the file system before we set timestamps, so
+     * writing it back later can't change them, with fs durability
+     * the whole file system is synced at the end unless we are
+     * about to set timestamps */
+    if (mfu_copy_durability == MFU_COPY_SYNC_FILE ||
+        (mfu_copy_durability == MFU_COPY_SYNC_FS && mfu_copy_opts->preserve))
+    {
+        mfu_fdatasync(dest_path, out_fd);
+    }
+
+    /* set ownership, then permissions, then timestamps, on the open file */
+    mode_t mode = (mode_t) mfu_flist_file_get_mode(list, idx);
+    if (mfu_copy_opts->preserve) {
+        uid_t uid = (uid_t) mfu_flist_file_get_uid(list, idx);
+        gid_t gid = (gid_t) mfu_flist_file_get_gid(list, idx);
+        if (fchown(out_fd, uid, gid) != 0) {
+            /* as in mfu_copy_ownership, EPERM is expected when not the owner */
+            if (errno != EPERM) {
+                MFU_LOG(MFU_LOG_ERR, "Failed to change ownership on %s fchown() errno=%d %s",
+                    dest_path, errno, strerror(errno));
+            }
+        }
+    }
+
+    if (fchmod(out_fd, mode) != 0) {
+        MFU_LOG(MFU_LOG_ERR, "Failed to change permissions on %s fchmod() errno=%d %s",
+            dest_path, errno, strerror(errno));
+    }
+
+    if (mfu_copy_opts->preserve) {
+        struct timespec times[2];
+        times[0].tv_sec  = (time_t) mfu_flist_file_get_atime(list, idx);
+        times[0].tv_nsec = (long)   mfu_flist_file_get_atime_nsec(list, idx);
+        times[1].tv_sec  = (time_t) mfu_flist_file_get_mtime(list, idx);
+        times[1].tv_nsec = (long)   mfu_flist_file_get_mtime_nsec(list, idx);
+        if (futimens(out_fd, times) != 0) {
+            MFU_LOG(MFU_LOG_ERR, "Failed to change timestamps on %s futimens() errno=%d %s",
+                dest_path, errno, strerror(errno));
+        }
+    }
+
+    mfu_close(dest_path, out_fd);
+    mfu_close(src_path, in_fd);
+
+    mfu_free(&dest_path);
+
+    /* increment our file count by one */
+    mfu_copy_stats.total_files++;
+
+    return rc;
+}
+
+/* split list into regular files small enough to be copied whole
+ * and everything else, the small files are spread evenly so that
+ * each rank gets a similar sized batch */
+static void mfu_copy_split_small(mfu_flist flist, const mfu_copy_opts_t* mfu_copy_opts,
+        mfu_flist* out_small, mfu_flist* out_large)
+{
+    mfu_flist small = mfu_flist_subset(flist);
+    mfu_flist large = mfu_flist_subset(flist);
+
+    uint64_t idx;
+    uint64_t size = mfu_flist_size(flist);
+    for (idx = 0; idx < size; idx++) {
+        if (mfu_copy_is_small(flist, idx, mfu_copy_opts)) {
+            mfu_flist_file_copy(flist, idx, small);
+        } else {
+            mfu_flist_file_copy(flist, idx, large);
+        }
+    }
+
+    mfu_flist_summarize(small);
+    mfu_flist_summarize(large);
 
-    if ((fiemap = (struct fiemap*)realloc(fiemap,sizeof(struct fiemap) +
-                                  extents_size)) == NULL)
-    {
-        MFU_LOG(MFU_LOG_ERR, "Out of memory reallocating fiemap\n");
-        goto fail_normal_copy;
-    }
+    *out_small = mfu_flist_spread(small);
+    *out_large = large;
 
-    memset(fiemap->fm_extents, 0, extents_size);
-    fiemap->fm_extent_count   = fiemap->fm_mapped_extents;
-    fiemap->fm_mapped_extents = 0;
+    mfu_flist_free(&small);
+}
 
-    if (ioctl(in_fd, FS_IOC_FIEMAP, fiemap) < 0) {
-        MFU_LOG(MFU_LOG_ERR, "fiemap ioctl() failed for src %s\n", src);
-        goto fail_normal_copy;
+/* copy our batch of small files, each in a single pass */
+static void mfu_copy_small_files(mfu_flist list,
+        int numpaths, const mfu_param_path* paths,
+        const mfu_param_path* destpath, mfu_copy_opts_t* mfu_copy_opts)
+{
+    /* get current rank */
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+    /* nothing to do if no rank has small files */
+    uint64_t total = mfu_flist_global_size(list);
+    if (total == 0) {
+        return;
     }
 
-    uint64_t last_byte = offset + length;
+    /* indicate which phase we're in to user */
+    if (rank == 0) {
+        MFU_LOG(MFU_LOG_INFO, "Copying %" PRIu64 " small files.", total);
+    }
 
-    if (fiemap->fm_mapped_extents > 0) {
-        uint64_t fe_logical = fiemap->fm_extents[0].fe_logical;
-        uint64_t fe_length  = fiemap->fm_extents[0].fe_length;
-        if (fe_logical < offset) {
-            fiemap->fm_extents[0].fe_length -= (offset - fe_logical);
-            fiemap->fm_extents[0].fe_logical = offset;
-        }
+    double start = MPI_Wtime();
 
-        fe_logical = fiemap->fm_extents[fiemap->fm_mapped_extents - 1].fe_logical;
-        fe_length  = fiemap->fm_extents[fiemap->fm_mapped_extents - 1].fe_length;
-        if (fe_logical + fe_length > last_byte) {
-           fiemap->fm_extents[fiemap->fm_mapped_extents - 1].fe_length -=
-           fe_logical + fe_length - last_byte;
+    /* when journaling, small files are named by their global index */
+    const char* done = mfu_copy_journal.small_done;
+    uint64_t offset = 0;
+    if (mfu_copy_journal.small_offsets != NULL) {
+        offset = mfu_copy_journal.small_offsets[rank];
+    }
+
+    /* total up files and bytes we have left to copy */
+    uint64_t idx;
+    uint64_t size = mfu_flist_size(list);
+    uint64_t total_items = 0;
+    uint64_t total_bytes = 0;
+    for (idx = 0; idx < size; idx++) {
+        if (done == NULL || ! done[idx]) {
+            total_items++;
+            total_bytes += mfu_flist_file_get_size(list, idx);
         }
     }
 
-    *normal_copy_required = false;
+    uint64_t items = 0;
+    uint64_t bytes = 0;
+    mfu_progress* prg = mfu_progress_start(mfu_progress_timeout, "Copied",
+        total_items, total_bytes, MPI_COMM_WORLD);
 
-    /* seek to offset in source file */
-    if (mfu_lseek(src, in_fd, (off_t)last_ext_start, SEEK_SET) < 0) {
-        MFU_LOG(MFU_LOG_ERR, "Couldn't seek in source path `%s' errno=%d %s", \
-            src, errno, strerror(errno));
-        goto fail;
-    }
+    for (idx = 0; idx < size; idx++) {
+        /* skip files an earlier run copied */
+        if (done != NULL && done[idx]) {
+            continue;
+        }
 
-    /* seek to offset in destination file */
-    if (mfu_lseek(dest, out_fd, (off_t)last_ext_start, SEEK_SET) < 0) {
-        MFU_LOG(MFU_LOG_ERR, "Couldn't seek in destination path `%s' errno=%d %s", \
-            dest, errno, strerror(errno));
-        goto fail;
+        int rc = mfu_copy_small_file(list, idx, numpaths, paths, destpath, mfu_copy_opts);
+        if (rc == 0) {
+            mfu_copy_journal_add(MFU_COPY_JOURNAL_SMALL, offset + idx,
+                mfu_flist_file_get_size(list, idx),
+                mfu_copy_journal_mtime(list, idx));
+        }
+
+        /* report progress */
+        items++;
+        bytes += mfu_flist_file_get_size(list, idx);
+        mfu_progress_update(prg, items, bytes);
     }
 
-    unsigned int i;
-    for (i = 0; i < fiemap->fm_mapped_extents; i++) {
-        size_t ext_start;
-        size_t ext_len;
-        size_t ext_hole_size;
+    /* count time waiting for other ranks as idle */
+    double end = MPI_Wtime();
+    mfu_progress_complete(&prg, items, bytes);
 
-        size_t buf_size = mfu_copy_opts->block_size;
-        void* buf = mfu_copy_opts->block_buf1;
+    /* count this as busy time, but not as chunks */
+    mfu_copy_stats.wtime_busy += end - start;
+}
 
-        ext_start = fiemap->fm_extents[i].fe_logical;
-        ext_len = fiemap->fm_extents[i].fe_length;
-        ext_hole_size = ext_start - (last_ext_start + last_ext_len);
+/* globals needed for libcircle callback routines */
+static mfu_file_chunk_array* copy_circle_chunks;  /* file sections assigned to this rank */
+static int copy_circle_numpaths;                   /* number of source paths */
+static const mfu_param_path* copy_circle_paths;    /* source paths */
+static const mfu_param_path* copy_circle_destpath; /* destination path */
+static mfu_copy_opts_t* copy_circle_opts;          /* copy options */
+static const uint64_t* copy_circle_covered;        /* leading bytes of each section copied by an earlier run */
+static uint64_t copy_circle_items;                 /* number of pieces this rank has copied */
+static uint64_t copy_circle_bytes;                 /* number of bytes this rank has copied */
+static uint64_t copy_circle_total_bytes;           /* number of bytes all ranks have to copy */
+static double copy_circle_start;                   /* time at which we started copying */
+
+/* estimated cost of a file section and its index, used to order sections */
+typedef struct {
+    uint64_t cost;
+    uint64_t index;
+} copy_circle_order_t;
 
-        if (ext_hole_size) {
-            if (mfu_lseek(src, in_fd, (off_t)ext_start, SEEK_SET) < 0) {
-                MFU_LOG(MFU_LOG_ERR, "Couldn't seek in source path `%s' errno=%d %s", \
-                    src, errno, strerror(errno));
-                goto fail;
-            }
-            if (mfu_lseek(dest, out_fd, (off_t)ext_hole_size, SEEK_CUR) < 0) {
-                MFU_LOG(MFU_LOG_ERR, "Couldn't seek in destination path `%s' errno=%d %s", \
-                    dest, errno, strerror(errno));
-                goto fail;
-            }
-        }
+/* order sections by increasing cost, and by decreasing index for equal cost */
+static int copy_circle_order_cmp(const void* a, const void* b)
+{
+    const copy_circle_order_t* x = (const copy_circle_order_t*) a;
+    const copy_circle_order_t* y = (const copy_circle_order_t*) b;
+    if (x->cost != y->cost) {
+        return (x->cost < y->cost) ? -1 : 1;
+    }
+    if (x->index != y->index) {
+        return (x->index > y->index) ? -1 : 1;
+    }
+    return 0;
+}
 
-        last_ext_start = ext_start;
-        last_ext_len = ext_len;
+/* enqueue our file sections, split into pieces of the chunk size
+ * chosen for each file so that other ranks can steal work from the
+ * middle of large files, the libcircle queue hands back the most
+ * recently enqueued item first, so we enqueue the cheapest sections
+ * first, which has ranks work largest first, and we enqueue pieces
+ * in reverse order to read and write each file front to back */
+static void copy_circle_create(CIRCLE_handle* handle)
+{
+    char item[CIRCLE_MAX_STRING_LEN];
+
+    /* estimate cost of each section, its bytes plus the cost
+     * of opening its file */
+    uint64_t count = copy_circle_chunks->count;
+    copy_circle_order_t* order = (copy_circle_order_t*) MFU_MALLOC(count * sizeof(copy_circle_order_t));
+    uint64_t n;
+    for (n = 0; n < count; n++) {
+        const mfu_file_chunk_desc* p = &copy_circle_chunks->chunks[n];
+        order[n].cost  = p->length + copy_circle_opts->file_cost;
+        order[n].index = n;
+    }
+    qsort(order, (size_t) count, sizeof(copy_circle_order_t), copy_circle_order_cmp);
 
-        while (ext_len) {
-            ssize_t num_read = mfu_read(src, in_fd, buf, MIN(ext_len, buf_size));
+    for (n = 0; n < count; n++) {
+        const mfu_file_chunk_desc* p = &copy_circle_chunks->chunks[order[n].index];
+        const char* name = copy_circle_chunks->names[p->name_id];
 
-            if (!num_read)
-                break;
+        /* number of pieces in this section, a 0-byte section is one piece */
+        uint64_t pieces = (p->length + p->chunk_size - 1) / p->chunk_size;
+        if (pieces == 0) {
+            pieces = 1;
+        }
 
-            ssize_t num_written = mfu_write(dest, out_fd, buf, (size_t)num_read);
+        /* skip bytes an earlier run copied */
+        uint64_t start = p->offset;
+        if (copy_circle_covered != NULL) {
+            start += copy_circle_covered[order[n].index];
+        }
 
-            if (num_written < 0) {
-                MFU_LOG(MFU_LOG_ERR, "Write error when copying from `%s' to `%s' errno=%d %s",
-                          src, dest, errno, strerror(errno));
-                goto fail;
+        uint64_t index = mfu_copy_journal_index(p);
+        while (pieces > 0) {
+            pieces--;
+            uint64_t offset = p->offset + pieces * p->chunk_size;
+            uint64_t length = p->offset + p->length - offset;
+            if (length > p->chunk_size) {
+                length = p->chunk_size;
             }
-            if (num_written != num_read) {
-                MFU_LOG(MFU_LOG_ERR, "Write error when copying from `%s' to `%s'",
-                    src, dest);
-                goto fail;
+            if (offset < start) {
+                /* this and all earlier pieces were copied */
+                if (offset + length <= start) {
+                    break;
+                }
+                length -= start - offset;
+                offset = start;
             }
 
-            ext_len -= (size_t)num_written;
-            mfu_copy_stats.total_bytes_copied += (int64_t) num_written;
+            /* encode file index, offset, length, file size, and file name */
+            int len = snprintf(item, sizeof(item), "%llu:%llu:%llu:%llu:%s",
+                (unsigned long long) index,
+                (unsigned long long) offset,
+                (unsigned long long) length,
+                (unsigned long long) p->file_size,
+                name
+            );
+            if (len >= 0 && (size_t)len < sizeof(item)) {
+                handle->enqueue(item);
+            } else {
+                /* name is too long to pass through libcircle,
+                 * so just copy the section ourselves */
+                mfu_copy_piece(name, index, offset, length, p->file_size,
+                    copy_circle_numpaths, copy_circle_paths,
+                    copy_circle_destpath, copy_circle_opts);
+                copy_circle_items++;
+                copy_circle_bytes += length;
+            }
         }
     }
 
-    off_t last_written = (off_t) last_byte;
-    off_t file_size_offt = (off_t) file_size;
-    if (last_written >= file_size_offt || file_size == 0) {
-       /*
-        * Use ftruncate() here rather than truncate(), because grouplock
-        * of Lustre would cause block to truncate() since the fd is different
-        * from the out_fd.
-        */
-        if (ftruncate(out_fd, file_size_offt) < 0) {
-            MFU_LOG(MFU_LOG_ERR, "Failed to truncate destination file: %s (errno=%d %s)",
-                dest, errno, strerror(errno));
-            goto fail;
-       }
-    }
-
-    if (last_written >= file_size_offt) {
-        mfu_copy_stats.total_size += (int64_t) (file_size_offt - (off_t) offset);
-    } else {
-        mfu_copy_stats.total_size += (int64_t) last_byte;
-    }
-
-    free(fiemap);
-    return 0;
-
-fail:
-    free(fiemap);
+    mfu_free(&order);
 
-fail_normal_copy:
-    return -1;
+    return;
 }
 
-static int mfu_copy_file(
-    const char* src,
-    const char* dest,
-    uint64_t offset,
-    uint64_t length,
-    uint64_t file_size,
-    mfu_copy_opts_t* mfu_copy_opts)
+/* dequeue and copy a file section */
+static void copy_circle_process(CIRCLE_handle* handle)
 {
-    int ret;
-    bool normal_copy_required;
+    char item[CIRCLE_MAX_STRING_LEN];
+    handle->dequeue(item);
+
+    /* decode file index, offset, length, and file size, name is what's left */
+    char* ptr = item;
+    uint64_t index     = (uint64_t) strtoull(ptr, &ptr, 10);
+    uint64_t offset    = (uint64_t) strtoull(ptr + 1, &ptr, 10);
+    uint64_t length    = (uint64_t) strtoull(ptr + 1, &ptr, 10);
+    uint64_t file_size = (uint64_t) strtoull(ptr + 1, &ptr, 10);
+    const char* name = ptr + 1;
+
+    mfu_copy_piece(name, index, offset, length, file_size,
+        copy_circle_numpaths, copy_circle_paths,
+        copy_circle_destpath, copy_circle_opts);
+    copy_circle_items++;
+    copy_circle_bytes += length;
 
-    /* open the input file */
-    int in_fd = mfu_copy_open_file(src, 1, &mfu_copy_src_cache, mfu_copy_opts);
-    if (in_fd < 0) {
-        MFU_LOG(MFU_LOG_ERR, "Failed to open input file `%s' errno=%d %s",
-            src, errno, strerror(errno));
-        return -1;
-    }
+    return;
+}
 
-    /* open the output file */
-    int out_fd = mfu_copy_open_file(dest, 0, &mfu_copy_dst_cache, mfu_copy_opts);
-    if (out_fd < 0) {
-        MFU_LOG(MFU_LOG_ERR, "Failed to open output file `%s' errno=%d %s",
-            dest, errno, strerror(errno));
-        return -1;
-    }
+/* libcircle reductions report progress of the dynamic copy, they
+ * run on libcircle's own timer and include idle ranks, which would
+ * not get a chance to join reductions of their own */
+static void copy_circle_reduce_init(void)
+{
+    uint64_t vals[2];
+    vals[0] = copy_circle_items;
+    vals[1] = copy_circle_bytes;
+    CIRCLE_reduce(vals, sizeof(vals));
+}
 
-    if (mfu_copy_opts->sparse) {
-        ret = mfu_copy_file_fiemap(src, dest, in_fd, out_fd, offset,
-                               length, file_size, 
-                               &normal_copy_required, mfu_copy_opts);
-        if (!ret || !normal_copy_required) {
-            return ret;
-        }
-    }
+static void copy_circle_reduce_op(const void* buf1, size_t size1, const void* buf2, size_t size2)
+{
+    const uint64_t* a = (const uint64_t*) buf1;
+    const uint64_t* b = (const uint64_t*) buf2;
+    uint64_t vals[2];
+    vals[0] = a[0] + b[0];
+    vals[1] = a[1] + b[1];
+    CIRCLE_reduce(vals, sizeof(vals));
+}
 
-    return mfu_copy_file_normal(src, dest, in_fd, out_fd, 
-            offset, length, file_size, mfu_copy_opts);
+static void copy_circle_reduce_fini(const void* buf, size_t size)
+{
+    const uint64_t* a = (const uint64_t*) buf;
+    double secs = MPI_Wtime() - copy_circle_start;
+    mfu_progress_print("Copied", secs, a[0], 0, a[1], copy_circle_total_bytes);
 }
 
 /* After receiving all incoming chunks, process open and write their chunks 
@@ -1305,34 +3958,170 @@ static void mfu_copy_files(mfu_flist list, uint64_t chunk_size,
         MFU_LOG(MFU_LOG_INFO, "Copying data.");
     }
     
-    /* split file list into a linked list of file sections,
+    /* pick chunk size for each file, when adaptive, align chunks
+     * to the preferred I/O size of the destination file system,
+     * and keep files whole on a rank where we can so each file
+     * is opened by as few ranks as possible */
+    mfu_chunk_opts_t chunk_opts;
+    chunk_opts.chunk_size = chunk_size;
+    chunk_opts.adaptive   = mfu_copy_opts->adaptive_chunks;
+    chunk_opts.align      = 0;
+    chunk_opts.locality   = mfu_copy_opts->locality;
+    chunk_opts.node_aware = mfu_copy_opts->node_aware;
+    chunk_opts.node_ranks = mfu_copy_opts->node_ranks;
+    chunk_opts.file_cost  = mfu_copy_opts->file_cost;
+    if (destpath->target_stat_valid) {
+        chunk_opts.align = (uint64_t) destpath->target_stat.st_blksize;
+    } else if (destpath->path_stat_valid) {
+        chunk_opts.align = (uint64_t) destpath->path_stat.st_blksize;
+    }
+
+    /* split file list into an array of file sections,
      * this evenly spreads the file sections across processes */
-    mfu_file_chunk* p = mfu_file_chunk_list_alloc(list, chunk_size);
-    
-    /* loop over and copy data for each file section we're responsible for */
-    while (p != NULL) {
-        /* get name of destination file */
-        char* dest_path = mfu_param_path_copy_dest(p->name, numpaths,
-                paths, destpath, mfu_copy_opts);
+    mfu_file_chunk_array* chunks = mfu_file_chunk_array_alloc(list, &chunk_opts);
+
+    /* when resuming, find how much of each section was already copied */
+    uint64_t* covered = mfu_copy_journal_query(chunks);
+
+    /* total up bytes we have left to copy for progress messages */
+    uint64_t n;
+    uint64_t total_bytes = 0;
+    for (n = 0; n < chunks->count; n++) {
+        uint64_t skip = (covered != NULL) ? covered[n] : 0;
+        uint64_t length = chunks->chunks[n].length;
+        total_bytes += (skip < length) ? length - skip : 0;
+    }
 
-        /* No need to copy it */
-        if (dest_path == NULL) {
-            continue;
+    if (mfu_copy_opts->dynamic) {
+        /* use the static assignment as the initial queue on each rank,
+         * and let libcircle move work from busy ranks to idle ranks */
+        copy_circle_chunks     = chunks;
+        copy_circle_numpaths   = numpaths;
+        copy_circle_paths      = paths;
+        copy_circle_destpath   = destpath;
+        copy_circle_opts       = mfu_copy_opts;
+        copy_circle_covered    = covered;
+        copy_circle_items      = 0;
+        copy_circle_bytes      = 0;
+        copy_circle_start      = MPI_Wtime();
+        MPI_Allreduce(&total_bytes, &copy_circle_total_bytes, 1,
+            MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+
+        /* initialize libcircle */
+        CIRCLE_init(0, NULL, CIRCLE_SPLIT_EQUAL | CIRCLE_CREATE_GLOBAL);
+
+        /* set libcircle verbosity level */
+        enum CIRCLE_loglevel loglevel = CIRCLE_LOG_WARN;
+        CIRCLE_enable_logging(loglevel);
+
+        /* register callbacks */
+        CIRCLE_cb_create(&copy_circle_create);
+        CIRCLE_cb_process(&copy_circle_process);
+
+        /* report progress through libcircle reductions */
+        if (mfu_progress_timeout > 0) {
+            CIRCLE_cb_reduce_init(&copy_circle_reduce_init);
+            CIRCLE_cb_reduce_op(&copy_circle_reduce_op);
+            CIRCLE_cb_reduce_fini(&copy_circle_reduce_fini);
+            CIRCLE_set_reduce_period(mfu_progress_timeout);
         }
 
-        /* call copy_file for each element of the copy_elem linked list of structs */
-        mfu_copy_file(p->name, dest_path, (uint64_t)p->offset, 
-                (uint64_t)p->length, (uint64_t)p->file_size, mfu_copy_opts);
-
-        /* free the dest name */
-        mfu_free(&dest_path);
+        /* run the libcircle job */
+        CIRCLE_begin();
+        CIRCLE_finalize();
+    } else {
+        uint64_t bytes = 0;
+        mfu_progress* prg = mfu_progress_start(mfu_progress_timeout, "Copied",
+            chunks->count, total_bytes, MPI_COMM_WORLD);
+
+        /* loop over and copy data for each file section we're responsible for */
+        for (n = 0; n < chunks->count; n++) {
+            /* call copy_file for each file section */
+            uint64_t skip = (covered != NULL) ? covered[n] : 0;
+            mfu_copy_section_resumable(chunks, n, skip,
+                    numpaths, paths, destpath, mfu_copy_opts);
+
+            /* report progress */
+            uint64_t length = chunks->chunks[n].length;
+            bytes += (skip < length) ? length - skip : 0;
+            mfu_progress_update(prg, n + 1, bytes);
+        }
 
-        /* update pointer to next element */
-        p = p->next;
+        /* wait for other ranks to finish copying */
+        mfu_progress_complete(&prg, chunks->count, bytes);
     }
     
-    /* free the linked list */
-    mfu_file_chunk_list_free(&p);
+    /* free the array of file sections */
+    mfu_free(&covered);
+    mfu_file_chunk_array_free(&chunks);
+}
+
+/* report how long each rank spent copying data versus waiting
+ * for other ranks to finish, given time for the copy phase */
+static void mfu_copy_print_balance(double copy_time)
+{
+    /* get our rank and number of ranks */
+    int rank, ranks;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+
+    /* compute our busy and idle times */
+    double busy = mfu_copy_stats.wtime_busy;
+    double idle = copy_time - busy;
+    if (idle < 0.0) {
+        idle = 0.0;
+    }
+
+    /* gather busy and idle times and chunk counts to rank 0 */
+    double times[3];
+    times[0] = busy;
+    times[1] = idle;
+    times[2] = (double) mfu_copy_stats.total_chunks;
+
+    double* all_times = NULL;
+    if (rank == 0) {
+        all_times = (double*) MFU_MALLOC((size_t)ranks * 3 * sizeof(double));
+    }
+    MPI_Gather(times, 3, MPI_DOUBLE, all_times, 3, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+
+    if (rank == 0) {
+        double busy_min = all_times[0];
+        double busy_max = all_times[0];
+        double busy_sum = 0.0;
+        double idle_max = 0.0;
+        double idle_sum = 0.0;
+        int i;
+        for (i = 0; i < ranks; i++) {
+            double rank_busy = all_times[i * 3 + 0];
+            double rank_idle = all_times[i * 3 + 1];
+            if (rank_busy < busy_min) {
+                busy_min = rank_busy;
+            }
+            if (rank_busy > busy_max) {
+                busy_max = rank_busy;
+            }
+            if (rank_idle > idle_max) {
+                idle_max = rank_idle;
+            }
+            busy_sum += rank_busy;
+            idle_sum += rank_idle;
+
+            MFU_LOG(MFU_LOG_VERBOSE, "Rank %d: busy %.3lf secs, idle %.3lf secs, %.0lf sections",
+                i, rank_busy, rank_idle, all_times[i * 3 + 2]);
+        }
+
+        double util = 0.0;
+        if (busy_sum + idle_sum > 0.0) {
+            util = busy_sum * 100.0 / (busy_sum + idle_sum);
+        }
+
+        MFU_LOG(MFU_LOG_INFO, "Copy busy secs: min %.3lf, max %.3lf, avg %.3lf",
+            busy_min, busy_max, busy_sum / (double)ranks);
+        MFU_LOG(MFU_LOG_INFO, "Copy idle secs: max %.3lf, avg %.3lf (%.1lf%% busy)",
+            idle_max, idle_sum / (double)ranks, util);
+    }
+
+    mfu_free(&all_times);
 }
 
 void mfu_flist_copy(mfu_flist src_cp_list, int numpaths,
@@ -1351,8 +4140,10 @@ void mfu_flist_copy(mfu_flist src_cp_list, int numpaths,
     /* TODO: consider file system striping params here */
     /* hard code some configurables for now */
 
-    /* Set default block size */
-    mfu_copy_opts->block_size = FD_BLOCK_SIZE;
+    /* Use block size set by the caller, or the default */
+    if (mfu_copy_opts->block_size == 0) {
+        mfu_copy_opts->block_size = FD_BLOCK_SIZE;
+    }
 
     /* allocate buffer to read/write files, aligned on 1MB boundaraies */
     size_t alignment = 1024*1024;
@@ -1369,58 +4160,162 @@ void mfu_flist_copy(mfu_flist src_cp_list, int numpaths,
     mfu_copy_stats.total_links = 0;
     mfu_copy_stats.total_size  = 0;
     mfu_copy_stats.total_bytes_copied = 0;
+    mfu_copy_stats.wtime_busy = 0.0;
+    mfu_copy_stats.total_chunks = 0;
+    mfu_copy_stats.total_src_opens = 0;
+    mfu_copy_stats.total_dst_opens = 0;
+    int e;
+    for (e = 0; e < MFU_COPY_ENGINES; e++) {
+        mfu_copy_stats.engine_files[e] = 0;
+        mfu_copy_stats.engine_bytes[e] = 0;
+    }
+
+    /* checksum data as we copy it if asked for a manifest, we don't
+     * read what an earlier run copied, so not when resuming */
+    if (mfu_copy_opts->manifest != NULL) {
+        if (mfu_copy_opts->resume) {
+            if (rank == 0) {
+                MFU_LOG(MFU_LOG_WARN, "Not writing manifest `%s' when resuming a copy",
+                    mfu_copy_opts->manifest);
+            }
+        } else {
+            mfu_copy_manifest = mfu_manifest_new();
+        }
+    }
 
-    /* Initialize file cache */
-    mfu_copy_src_cache.name = NULL;
-    mfu_copy_dst_cache.name = NULL;
+    /* Initialize file caches, with file durability destination
+     * files are fdatasync'd as they are closed */
+    mfu_copy_durability = mfu_copy_opts->durability;
+    mfu_copy_sync_path  = destpath->path;
+    int sync_on_close = (mfu_copy_durability == MFU_COPY_SYNC_FILE);
+    mfu_file_cache_init(&mfu_copy_src_cache, mfu_copy_opts->open_files, 0);
+    mfu_file_cache_init(&mfu_copy_dst_cache, mfu_copy_opts->open_files, sync_on_close);
+
+    /* when journaling, sort a copy of the list by name so that
+     * each item has the same index from one run to the next */
+    mfu_flist list = src_cp_list;
+    if (mfu_copy_opts->journal != NULL) {
+        list = mfu_flist_subset(src_cp_list);
+        uint64_t idx;
+        uint64_t size = mfu_flist_size(src_cp_list);
+        for (idx = 0; idx < size; idx++) {
+            mfu_flist_file_copy(src_cp_list, idx, list);
+        }
+        mfu_flist_summarize(list);
+        mfu_flist_sort("name", &list);
+    }
 
     /* split items in file list into sublists depending on their
      * directory depth */
     int levels, minlevel;
     mfu_flist* lists;
-    mfu_flist_array_by_depth(src_cp_list, &levels, &minlevel, &lists);
+    mfu_flist_array_by_depth(list, &levels, &minlevel, &lists);
 
     /* TODO: filter out files that are bigger than 0 bytes if we can't read them */
 
+    /* split off small files, which skip the create and chunk phases */
+    mfu_flist small_list = NULL;
+    mfu_flist large_list = list;
+    if (mfu_copy_opts->small_file_size > 0) {
+        mfu_copy_split_small(list, mfu_copy_opts, &small_list, &large_list);
+    }
+
+    /* start journal, and pick up where an earlier run left off */
+    mfu_copy_journal_open(large_list, small_list,
+            mfu_flist_global_size(list), mfu_copy_opts);
+    int phases = mfu_copy_journal.phases;
+
     /* create directories, from top down */
-    mfu_create_directories(levels, minlevel, lists, numpaths,
-            paths, destpath, mfu_copy_opts);
+    if (! (phases & MFU_COPY_PHASE_DIRS)) {
+        mfu_create_directories(levels, minlevel, lists, numpaths,
+                paths, destpath, mfu_copy_opts);
+    }
+    mfu_copy_journal_phase(MFU_COPY_PHASE_DIRS);
 
     /* create files and links */
-    mfu_create_files(levels, minlevel, lists, numpaths,
-            paths, destpath, mfu_copy_opts);
+    if (! (phases & MFU_COPY_PHASE_FILES)) {
+        mfu_create_files(levels, minlevel, lists, numpaths,
+                paths, destpath, mfu_copy_opts);
+    }
+    mfu_copy_journal_phase(MFU_COPY_PHASE_FILES);
 
     /* copy data */
-    mfu_copy_files(src_cp_list, mfu_copy_opts->chunk_size, 
-            numpaths, paths, destpath, mfu_copy_opts);
+    if (! (phases & MFU_COPY_PHASE_DATA)) {
+        double copy_start = MPI_Wtime();
+        if (small_list != NULL) {
+            mfu_copy_small_files(small_list, numpaths, paths, destpath, mfu_copy_opts);
+        }
+        mfu_copy_files(large_list, mfu_copy_opts->chunk_size, 
+                numpaths, paths, destpath, mfu_copy_opts);
 
-    /* close files */
-    mfu_copy_close_file(&mfu_copy_src_cache);
-    mfu_copy_close_file(&mfu_copy_dst_cache);
+        /* wait for all ranks to finish copying so that idle time
+         * includes time spent waiting on slower ranks */
+        MPI_Barrier(MPI_COMM_WORLD);
+        mfu_copy_print_balance(MPI_Wtime() - copy_start);
+    }
+
+    /* report how often sections found their files already open */
+    mfu_file_cache_print(&mfu_copy_src_cache, "Source");
+    mfu_file_cache_print(&mfu_copy_dst_cache, "Destination");
+
+    /* close files, and stop the helper thread that wrote them */
+    mfu_file_cache_free(&mfu_copy_src_cache);
+    mfu_file_cache_free(&mfu_copy_dst_cache);
+    mfu_copy_writer_stop(&mfu_copy_writer);
+    mfu_copy_uring_stop(&mfu_copy_uring);
+    mfu_copy_journal_phase(MFU_COPY_PHASE_DATA);
+
+    /* write checksums of the files we copied */
+    if (mfu_copy_manifest != NULL) {
+        mfu_manifest_write(mfu_copy_manifest, mfu_copy_opts->manifest);
+        mfu_manifest_free(&mfu_copy_manifest);
+    }
 
     /* force the copy to backend, to avoid the following metadata
-     * setting mismatch, which may happen on lustre */
-    sync();
+     * setting mismatch, which may happen on lustre, with file
+     * durability each file was synced as it was closed above */
+    if (mfu_copy_durability == MFU_COPY_SYNC_FS) {
+        mfu_copy_syncfs_all();
+    }
 
     /* wait for all sync to finish before starting to set metadata */
     MPI_Barrier(MPI_COMM_WORLD);
 
     /* set permissions, ownership, and timestamps if needed */
-    mfu_copy_set_metadata(levels, minlevel, lists, numpaths,
-            paths, destpath, mfu_copy_opts);
+    if (! (phases & MFU_COPY_PHASE_META)) {
+        mfu_copy_set_metadata(levels, minlevel, lists, numpaths,
+                paths, destpath, mfu_copy_opts);
+    }
+    mfu_copy_journal_phase(MFU_COPY_PHASE_META);
+    mfu_copy_journal_close();
 
     /* free our lists of levels */
     mfu_flist_array_free(levels, &lists);
 
+    /* free lists of small and large files */
+    if (small_list != NULL) {
+        mfu_flist_free(&small_list);
+        mfu_flist_free(&large_list);
+    }
+
+    /* free sorted list */
+    if (list != src_cp_list) {
+        mfu_flist_free(&list);
+    }
+
     /* free buffers */
     mfu_free(&mfu_copy_opts->block_buf1);
     mfu_free(&mfu_copy_opts->block_buf2);
+    mfu_free(&mfu_copy_kernel_file);
 
     /* force updates to disk */
-    if (rank == 0) {
-        MFU_LOG(MFU_LOG_INFO, "Syncing updates to disk.");
+    if (mfu_copy_durability == MFU_COPY_SYNC_FS) {
+        if (rank == 0) {
+            MFU_LOG(MFU_LOG_INFO, "Syncing updates to disk.");
+        }
+        mfu_copy_syncfs_all();
+        MPI_Barrier(MPI_COMM_WORLD);
     }
-    sync();
 
     /* Determine the actual and relative end time for the epilogue. */
     mfu_copy_stats.wtime_ended = MPI_Wtime();
@@ -1430,17 +4325,24 @@ void mfu_flist_copy(mfu_flist src_cp_list, int numpaths,
     double rel_time = mfu_copy_stats.wtime_ended - \
                       mfu_copy_stats.wtime_started;
 
-    /* prep our values into buffer */
-    int64_t values[5];
+    /* prep our values into buffer, followed by file and byte
+     * counts for each copy engine */
+    int64_t values[7 + 2 * MFU_COPY_ENGINES];
     values[0] = mfu_copy_stats.total_dirs;
     values[1] = mfu_copy_stats.total_files;
     values[2] = mfu_copy_stats.total_links;
     values[3] = mfu_copy_stats.total_size;
     values[4] = mfu_copy_stats.total_bytes_copied;
+    values[5] = mfu_copy_stats.total_src_opens;
+    values[6] = mfu_copy_stats.total_dst_opens;
+    for (e = 0; e < MFU_COPY_ENGINES; e++) {
+        values[7 + 2 * e]     = mfu_copy_stats.engine_files[e];
+        values[7 + 2 * e + 1] = mfu_copy_stats.engine_bytes[e];
+    }
 
     /* sum values across processes */
-    int64_t sums[5];
-    MPI_Allreduce(values, sums, 5, MPI_INT64_T, MPI_SUM, MPI_COMM_WORLD);
+    int64_t sums[7 + 2 * MFU_COPY_ENGINES];
+    MPI_Allreduce(values, sums, 7 + 2 * MFU_COPY_ENGINES, MPI_INT64_T, MPI_SUM, MPI_COMM_WORLD);
 
     /* extract results from allreduce */
     int64_t agg_dirs   = sums[0];
@@ -1448,6 +4350,8 @@ void mfu_flist_copy(mfu_flist src_cp_list, int numpaths,
     int64_t agg_links  = sums[2];
     int64_t agg_size   = sums[3];
     int64_t agg_copied = sums[4];
+    int64_t agg_src_opens = sums[5];
+    int64_t agg_dst_opens = sums[6];
 
     /* compute rate of copy */
     double agg_rate = (double)agg_copied / rel_time;
@@ -1489,6 +4393,28 @@ void mfu_flist_copy(mfu_flist src_cp_list, int numpaths,
         MFU_LOG(MFU_LOG_INFO, "Data: %.3lf %s (%" PRId64 " bytes)",
             agg_size_tmp, agg_size_units, agg_size);
 
+        /* number of opens per file is 1 when no file is split across ranks */
+        double opens_per_file = 0.0;
+        if (agg_files > 0) {
+            opens_per_file = (double)agg_dst_opens / (double)agg_files;
+        }
+        MFU_LOG(MFU_LOG_INFO, "Opens: %" PRId64 " source, %" PRId64 " destination (%.2lf per file)",
+            agg_src_opens, agg_dst_opens, opens_per_file);
+
+        /* list how many files and bytes each engine copied */
+        for (e = 0; e < MFU_COPY_ENGINES; e++) {
+            int64_t engine_files = sums[7 + 2 * e];
+            int64_t engine_bytes = sums[7 + 2 * e + 1];
+            if (engine_files > 0 || engine_bytes > 0) {
+                double engine_bytes_tmp;
+                const char* engine_bytes_units;
+                mfu_format_bytes((uint64_t)engine_bytes, &engine_bytes_tmp, &engine_bytes_units);
+                MFU_LOG(MFU_LOG_INFO, "  Engine %s: %" PRId64 " files, %.3lf %s",
+                    mfu_copy_engine_names[e], engine_files,
+                    engine_bytes_tmp, engine_bytes_units);
+            }
+        }
+
         MFU_LOG(MFU_LOG_INFO, "Rate: %.3lf %s " \
             "(%.3" PRId64 " bytes in %.3lf seconds)", \
             agg_rate_tmp, agg_rate_units, agg_copied, rel_time);
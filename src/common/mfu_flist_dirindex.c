@@ -0,0 +1,832 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <limits.h>
+#include <inttypes.h>
+
+#include <libgen.h> /* dirname */
+
+#include "dtcmp.h"
+#include "mfu.h"
+#include "mfu_flist_internal.h"
+
+/****************************************
+ * Functions to compute and write per-directory aggregates
+ ***************************************/
+
+/* The directory index records one entry for each directory in a
+ * list, holding the number of items and bytes directly within the
+ * directory (exclusive) and beneath the directory at any depth
+ * (inclusive), along with the largest mtime seen in each case.
+ *
+ * The file is written in MPI external32 representation, so all
+ * integers are big-endian uint64_t values.  It starts with a 24-byte
+ * header of 3 values:
+ *   version, number of directory records, chars in name field
+ * followed by fixed-size records of chars + 56 bytes:
+ *   name (chars bytes, NUL-padded), depth,
+ *   inclusive items, inclusive bytes, inclusive max mtime,
+ *   exclusive items, exclusive bytes, exclusive max mtime
+ *
+ * chars is a multiple of 8 that fits the longest name along with
+ * its terminating NUL.  An empty list produces a header with zero
+ * records and zero chars, so readers can tell a list with no
+ * directories from a missing file.
+ *
+ * Records are sorted by inclusive bytes in descending order, so the
+ * largest directories can be read from the front of the file. */
+
+#define DIRINDEX_VERSION (1)
+
+/* number of uint64_t fields in each record after the name */
+#define DIRINDEX_FIELDS (7)
+
+/* aggregate values for a single directory */
+typedef struct {
+    char* name;          /* full path of directory */
+    uint64_t depth;      /* depth of directory */
+    uint64_t excl_items; /* number of items directly in directory */
+    uint64_t excl_bytes; /* bytes in regular files directly in directory */
+    uint64_t excl_mtime; /* max mtime of directory and its entries */
+    uint64_t incl_items; /* number of items beneath directory */
+    uint64_t incl_bytes; /* bytes in regular files beneath directory */
+    uint64_t incl_mtime; /* max mtime of anything beneath directory */
+} dirindex_elem_t;
+
+/* we hash directory names to map all contributions for a given
+ * directory to the same process */
+static int dirindex_map(const char* name, int ranks)
+{
+    size_t len = strlen(name);
+    uint32_t hash = mfu_hash_jenkins(name, len);
+    int rank = (int)(hash % (uint32_t)ranks);
+    return rank;
+}
+
+/* contributions are exchanged as a name padded to chars bytes,
+ * followed by a flag that is set if the record comes from the
+ * directory item itself, and then an item count, byte count,
+ * and mtime */
+static size_t dirindex_rec_size(size_t chars)
+{
+    return chars + 4 * 8;
+}
+
+static void dirindex_rec_pack(
+    char* buf,
+    size_t chars,
+    const char* name,
+    uint64_t flag,
+    uint64_t items,
+    uint64_t bytes,
+    uint64_t mtime)
+{
+    char* ptr = buf;
+    strncpy(ptr, name, chars);
+    ptr += chars;
+    mfu_pack_uint64(&ptr, flag);
+    mfu_pack_uint64(&ptr, items);
+    mfu_pack_uint64(&ptr, bytes);
+    mfu_pack_uint64(&ptr, mtime);
+    return;
+}
+
+static void dirindex_rec_unpack(
+    const char* buf,
+    size_t chars,
+    uint64_t* flag,
+    uint64_t* items,
+    uint64_t* bytes,
+    uint64_t* mtime)
+{
+    const char* ptr = buf + chars;
+    mfu_unpack_uint64(&ptr, flag);
+    mfu_unpack_uint64(&ptr, items);
+    mfu_unpack_uint64(&ptr, bytes);
+    mfu_unpack_uint64(&ptr, mtime);
+    return;
+}
+
+/* routine for sorting packed records by name */
+static int dirindex_rec_cmp(const void* a, const void* b)
+{
+    return strcmp((const char*)a, (const char*)b);
+}
+
+/* routine for looking up a directory by name in sorted array */
+static int dirindex_elem_cmp(const void* a, const void* b)
+{
+    const char* name = (const char*) a;
+    const dirindex_elem_t* elem = (const dirindex_elem_t*) b;
+    return strcmp(name, elem->name);
+}
+
+/* given a send buffer of records grouped by destination rank and
+ * the number of records for each rank, exchange records among
+ * ranks and return newly allocated receive buffer and count */
+static void dirindex_exchange(
+    char* sendbuf,
+    const int* sendcounts,
+    size_t recsize,
+    char** outbuf,
+    uint64_t* outcount)
+{
+    /* get number of ranks */
+    int ranks;
+    MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+
+    /* allocate arrays for alltoall */
+    size_t bufsize = (size_t)ranks * sizeof(int);
+    int* senddisps = (int*) MFU_MALLOC(bufsize);
+    int* recvcounts = (int*) MFU_MALLOC(bufsize);
+    int* recvdisps = (int*) MFU_MALLOC(bufsize);
+
+    /* compute displacements in records, records are padded to
+     * the longest name, so we count records rather than bytes
+     * to keep large lists within the range of an int */
+    uint64_t sendtotal = 0;
+    int i;
+    for (i = 0; i < ranks; i++) {
+        senddisps[i] = (int) sendtotal;
+        sendtotal += (uint64_t) sendcounts[i];
+    }
+
+    /* alltoall to get our incoming counts */
+    MPI_Alltoall(sendcounts, 1, MPI_INT, recvcounts, 1, MPI_INT, MPI_COMM_WORLD);
+
+    /* compute number of records we receive and displacements */
+    uint64_t recvtotal = 0;
+    for (i = 0; i < ranks; i++) {
+        recvdisps[i] = (int) recvtotal;
+        recvtotal += (uint64_t) recvcounts[i];
+    }
+    if (sendtotal > INT_MAX || recvtotal > INT_MAX) {
+        MFU_ABORT(-1, "Too many directory records to exchange: sending %" PRIu64 ", receiving %" PRIu64,
+            sendtotal, recvtotal);
+    }
+
+    /* allocate recvbuf */
+    char* recvbuf = (char*) MFU_MALLOC(recvtotal * recsize);
+
+    /* alltoallv to send data, one element per record */
+    MPI_Datatype dt_rec;
+    MPI_Type_contiguous((int)recsize, MPI_BYTE, &dt_rec);
+    MPI_Type_commit(&dt_rec);
+    MPI_Alltoallv(
+        sendbuf, sendcounts, senddisps, dt_rec,
+        recvbuf, recvcounts, recvdisps, dt_rec, MPI_COMM_WORLD
+    );
+    MPI_Type_free(&dt_rec);
+
+    /* free memory */
+    mfu_free(&recvdisps);
+    mfu_free(&recvcounts);
+    mfu_free(&senddisps);
+
+    /* return buffer and record count to caller */
+    *outbuf   = recvbuf;
+    *outcount = recvtotal;
+    return;
+}
+
+/* send exclusive contributions of each item to the process
+ * responsible for its parent directory, and merge contributions
+ * into a sorted array of directories, returns number of
+ * directories in array */
+static uint64_t dirindex_collect(
+    mfu_flist flist,
+    size_t chars,
+    dirindex_elem_t** outelems)
+{
+    /* get number of ranks */
+    int ranks;
+    MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+
+    /* size and mtime are only available with detail */
+    int detail = mfu_flist_have_detail(flist);
+
+    /* allocate space to count records for each rank */
+    int* counts  = (int*) MFU_MALLOC((size_t)ranks * sizeof(int));
+    int* offsets = (int*) MFU_MALLOC((size_t)ranks * sizeof(int));
+    int i;
+    for (i = 0; i < ranks; i++) {
+        counts[i]  = 0;
+        offsets[i] = 0;
+    }
+
+    /* each item sends one record to its parent directory, and each
+     * directory sends one more record to itself so that directories
+     * with no children still show up in the index */
+    uint64_t idx;
+    uint64_t size = mfu_flist_size(flist);
+    char* parent = (char*) MFU_MALLOC(chars);
+    for (idx = 0; idx < size; idx++) {
+        const char* name = mfu_flist_file_get_name(flist, idx);
+        if (strcmp(name, "/") != 0) {
+            strcpy(parent, name);
+            dirname(parent);
+            counts[dirindex_map(parent, ranks)]++;
+        }
+
+        mfu_filetype type = mfu_flist_file_get_type(flist, idx);
+        if (type == MFU_TYPE_DIR) {
+            counts[dirindex_map(name, ranks)]++;
+        }
+    }
+
+    /* compute displacement of each rank in send buffer */
+    uint64_t sendcount = 0;
+    for (i = 0; i < ranks; i++) {
+        offsets[i] = (int) sendcount;
+        sendcount += (uint64_t) counts[i];
+    }
+
+    /* allocate send buffer */
+    size_t recsize = dirindex_rec_size(chars);
+    char* sendbuf = (char*) MFU_MALLOC(sendcount * recsize);
+
+    /* pack records into send buffer */
+    for (idx = 0; idx < size; idx++) {
+        const char* name = mfu_flist_file_get_name(flist, idx);
+        mfu_filetype type = mfu_flist_file_get_type(flist, idx);
+
+        /* only count bytes for regular files */
+        uint64_t bytes = 0;
+        uint64_t mtime = 0;
+        if (detail) {
+            if (type == MFU_TYPE_FILE) {
+                bytes = mfu_flist_file_get_size(flist, idx);
+            }
+            mtime = mfu_flist_file_get_mtime(flist, idx);
+        }
+
+        /* add contribution to parent directory */
+        if (strcmp(name, "/") != 0) {
+            strcpy(parent, name);
+            dirname(parent);
+            int dest = dirindex_map(parent, ranks);
+            char* ptr = sendbuf + (size_t)offsets[dest] * recsize;
+            dirindex_rec_pack(ptr, chars, parent, 0, 1, bytes, mtime);
+            offsets[dest]++;
+        }
+
+        /* register directory itself, include its own mtime */
+        if (type == MFU_TYPE_DIR) {
+            int dest = dirindex_map(name, ranks);
+            char* ptr = sendbuf + (size_t)offsets[dest] * recsize;
+            dirindex_rec_pack(ptr, chars, name, 1, 0, 0, mtime);
+            offsets[dest]++;
+        }
+    }
+    mfu_free(&parent);
+
+    /* exchange records */
+    char* recvbuf;
+    uint64_t recvcount;
+    dirindex_exchange(sendbuf, counts, recsize, &recvbuf, &recvcount);
+
+    /* sort records by name to group records for same directory */
+    qsort(recvbuf, (size_t)recvcount, recsize, dirindex_rec_cmp);
+
+    /* allocate enough space to hold an entry for every record */
+    dirindex_elem_t* elems = (dirindex_elem_t*) MFU_MALLOC(recvcount * sizeof(dirindex_elem_t));
+
+    /* merge records for each directory, we drop records for parent
+     * directories that are not themselves in the list */
+    uint64_t count = 0;
+    uint64_t rec = 0;
+    while (rec < recvcount) {
+        const char* name = recvbuf + rec * recsize;
+
+        uint64_t exists = 0;
+        uint64_t items  = 0;
+        uint64_t bytes  = 0;
+        uint64_t mtime  = 0;
+        while (rec < recvcount) {
+            const char* ptr = recvbuf + rec * recsize;
+            if (strcmp(name, ptr) != 0) {
+                break;
+            }
+
+            uint64_t r_flag, r_items, r_bytes, r_mtime;
+            dirindex_rec_unpack(ptr, chars, &r_flag, &r_items, &r_bytes, &r_mtime);
+            exists += r_flag;
+            items  += r_items;
+            bytes  += r_bytes;
+            if (r_mtime > mtime) {
+                mtime = r_mtime;
+            }
+            rec++;
+        }
+
+        if (exists) {
+            dirindex_elem_t* elem = &elems[count];
+            elem->name       = MFU_STRDUP(name);
+            elem->depth      = (uint64_t) mfu_flist_compute_depth(name);
+            elem->excl_items = items;
+            elem->excl_bytes = bytes;
+            elem->excl_mtime = mtime;
+            elem->incl_items = items;
+            elem->incl_bytes = bytes;
+            elem->incl_mtime = mtime;
+            count++;
+        }
+    }
+
+    /* free memory */
+    mfu_free(&recvbuf);
+    mfu_free(&sendbuf);
+    mfu_free(&offsets);
+    mfu_free(&counts);
+
+    *outelems = elems;
+    return count;
+}
+
+/* working from the deepest level up, send inclusive totals of
+ * each directory to the process responsible for its parent,
+ * once we finish a level, all directories in the level above
+ * hold their final inclusive totals */
+static void dirindex_reduce(
+    dirindex_elem_t* elems,
+    uint64_t count,
+    size_t chars)
+{
+    /* get number of ranks */
+    int ranks;
+    MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+
+    /* compute local min/max depth */
+    uint64_t min_depth = UINT64_MAX;
+    uint64_t max_depth = 0;
+    uint64_t i;
+    for (i = 0; i < count; i++) {
+        uint64_t depth = elems[i].depth;
+        if (depth < min_depth) {
+            min_depth = depth;
+        }
+        if (depth > max_depth) {
+            max_depth = depth;
+        }
+    }
+
+    /* get global min/max depth */
+    uint64_t global_min, global_max;
+    MPI_Allreduce(&min_depth, &global_min, 1, MPI_UINT64_T, MPI_MIN, MPI_COMM_WORLD);
+    MPI_Allreduce(&max_depth, &global_max, 1, MPI_UINT64_T, MPI_MAX, MPI_COMM_WORLD);
+
+    /* allocate space to count records for each rank */
+    int* counts  = (int*) MFU_MALLOC((size_t)ranks * sizeof(int));
+    int* offsets = (int*) MFU_MALLOC((size_t)ranks * sizeof(int));
+
+    size_t recsize = dirindex_rec_size(chars);
+    char* parent = (char*) MFU_MALLOC(chars);
+
+    /* the top level has no parents in the index, so stop just below it,
+     * if no rank has a directory, min is larger than max and we skip this */
+    uint64_t depth;
+    for (depth = global_max; depth > global_min; depth--) {
+        /* count records we'll send to each rank for this level */
+        int r;
+        for (r = 0; r < ranks; r++) {
+            counts[r]  = 0;
+            offsets[r] = 0;
+        }
+        uint64_t sendcount = 0;
+        for (i = 0; i < count; i++) {
+            if (elems[i].depth == depth) {
+                strcpy(parent, elems[i].name);
+                dirname(parent);
+                counts[dirindex_map(parent, ranks)]++;
+                sendcount++;
+            }
+        }
+
+        /* compute displacement of each rank in send buffer */
+        uint64_t disp = 0;
+        for (r = 0; r < ranks; r++) {
+            offsets[r] = (int) disp;
+            disp += (uint64_t) counts[r];
+        }
+
+        /* pack inclusive totals for each directory at this level */
+        char* sendbuf = (char*) MFU_MALLOC(sendcount * recsize);
+        for (i = 0; i < count; i++) {
+            dirindex_elem_t* elem = &elems[i];
+            if (elem->depth == depth) {
+                strcpy(parent, elem->name);
+                dirname(parent);
+                int dest = dirindex_map(parent, ranks);
+                char* ptr = sendbuf + (size_t)offsets[dest] * recsize;
+                dirindex_rec_pack(ptr, chars, parent, 0,
+                    elem->incl_items, elem->incl_bytes, elem->incl_mtime
+                );
+                offsets[dest]++;
+            }
+        }
+
+        /* exchange records */
+        char* recvbuf;
+        uint64_t recvcount;
+        dirindex_exchange(sendbuf, counts, recsize, &recvbuf, &recvcount);
+
+        /* add child totals into parent directory if we have it */
+        uint64_t rec;
+        for (rec = 0; rec < recvcount; rec++) {
+            const char* ptr = recvbuf + rec * recsize;
+            dirindex_elem_t* elem = (dirindex_elem_t*) bsearch(
+                ptr, elems, (size_t)count, sizeof(dirindex_elem_t), dirindex_elem_cmp
+            );
+            if (elem != NULL) {
+                uint64_t r_flag, r_items, r_bytes, r_mtime;
+                dirindex_rec_unpack(ptr, chars, &r_flag, &r_items, &r_bytes, &r_mtime);
+                elem->incl_items += r_items;
+                elem->incl_bytes += r_bytes;
+                if (r_mtime > elem->incl_mtime) {
+                    elem->incl_mtime = r_mtime;
+                }
+            }
+        }
+
+        mfu_free(&recvbuf);
+        mfu_free(&sendbuf);
+    }
+
+    /* free memory */
+    mfu_free(&parent);
+    mfu_free(&offsets);
+    mfu_free(&counts);
+
+    return;
+}
+
+/* build type for a directory record in the index file,
+ * a name of chars bytes followed by DIRINDEX_FIELDS uint64_t values */
+static void dirindex_type(int chars, MPI_Datatype* dt_rec)
+{
+    /* build type for file path */
+    MPI_Datatype dt_filepath;
+    MPI_Type_contiguous(chars, MPI_CHAR, &dt_filepath);
+
+    /* build type for directory record */
+    int j;
+    MPI_Datatype types[DIRINDEX_FIELDS + 1];
+    types[0] = dt_filepath;
+    for (j = 1; j <= DIRINDEX_FIELDS; j++) {
+        types[j] = MPI_UINT64_T;
+    }
+    DTCMP_Type_create_series(DIRINDEX_FIELDS + 1, types, dt_rec);
+
+    /* the record type keeps its own reference to the path type */
+    MPI_Type_free(&dt_filepath);
+    return;
+}
+
+/* write the 24-byte index header with the given record count
+ * and name width, records follow it in the layout described at
+ * the top of this file */
+static void dirindex_write_header(
+    MPI_File fh,
+    uint64_t all_count,
+    int chars)
+{
+    /* get our rank */
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+    /* prepare header */
+    uint64_t header[3];
+    header[0] = DIRINDEX_VERSION; /* file version */
+    header[1] = all_count;        /* number of directory records */
+    header[2] = (uint64_t)chars;  /* number of chars in name */
+
+    /* write the header */
+    MPI_Status status;
+    char datarep[] = "external32";
+    MPI_File_set_view(fh, 0, MPI_UINT64_T, MPI_UINT64_T, datarep, MPI_INFO_NULL);
+    if (rank == 0) {
+        MPI_File_write_at(fh, 0, header, 3, MPI_UINT64_T, &status);
+    }
+    return;
+}
+
+/* sort directories by inclusive bytes and write them to file
+ * as a header followed by one fixed-size record per directory */
+static void dirindex_write(
+    const char* name,
+    dirindex_elem_t* elems,
+    uint64_t count,
+    int chars)
+{
+    /* get our rank */
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+    /* build type for directory record */
+    MPI_Datatype dt_rec;
+    dirindex_type(chars, &dt_rec);
+
+    /* build keysat type (inclusive bytes + record) */
+    MPI_Datatype dt_keysat;
+    MPI_Datatype keysat_types[2];
+    keysat_types[0] = MPI_UINT64_T;
+    keysat_types[1] = dt_rec;
+    DTCMP_Type_create_series(2, keysat_types, &dt_keysat);
+
+    /* get extent of record */
+    MPI_Aint lb, extent;
+    MPI_Type_get_extent(dt_rec, &lb, &extent);
+    size_t keysat_size = 8 + (size_t)extent;
+
+    /* pack records into sort buffer */
+    char* sortbuf = (char*) MFU_MALLOC(count * keysat_size);
+    char* ptr = sortbuf;
+    uint64_t i;
+    for (i = 0; i < count; i++) {
+        dirindex_elem_t* elem = &elems[i];
+        mfu_pack_uint64(&ptr, elem->incl_bytes);
+        memset(ptr, 0, (size_t)chars);
+        strcpy(ptr, elem->name);
+        ptr += chars;
+        mfu_pack_uint64(&ptr, elem->depth);
+        mfu_pack_uint64(&ptr, elem->incl_items);
+        mfu_pack_uint64(&ptr, elem->incl_bytes);
+        mfu_pack_uint64(&ptr, elem->incl_mtime);
+        mfu_pack_uint64(&ptr, elem->excl_items);
+        mfu_pack_uint64(&ptr, elem->excl_bytes);
+        mfu_pack_uint64(&ptr, elem->excl_mtime);
+    }
+
+    /* sort records by inclusive bytes, largest first */
+    void* outsortbuf;
+    int outsortcount;
+    DTCMP_Handle handle;
+    int sort_rc = DTCMP_Sortz(
+                      sortbuf, (int)count, &outsortbuf, &outsortcount,
+                      MPI_UINT64_T, dt_keysat, DTCMP_OP_UINT64T_DESCEND, DTCMP_FLAG_NONE,
+                      MPI_COMM_WORLD, &handle
+                  );
+    if (sort_rc != DTCMP_SUCCESS) {
+        MFU_ABORT(1, "Failed to sort directory index");
+    }
+
+    /* strip keys, leaving records in place */
+    uint64_t outcount = (uint64_t) outsortcount;
+    char* buf = (char*) MFU_MALLOC(outcount * (size_t)extent);
+    for (i = 0; i < outcount; i++) {
+        memcpy(buf + i * (size_t)extent, (char*)outsortbuf + i * keysat_size + 8, (size_t)extent);
+    }
+    DTCMP_Free(&handle);
+
+    /* compute total records and our offset */
+    uint64_t all_count;
+    MPI_Allreduce(&outcount, &all_count, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+
+    uint64_t offset;
+    MPI_Exscan(&outcount, &offset, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+    if (rank == 0) {
+        offset = 0;
+    }
+
+    /* open file */
+    MPI_Status status;
+    MPI_File fh;
+    char datarep[] = "external32";
+    int amode = MPI_MODE_WRONLY | MPI_MODE_CREATE;
+    MPI_File_open(MPI_COMM_WORLD, (char*)name, amode, MPI_INFO_NULL, &fh);
+
+    /* truncate file to 0 bytes */
+    MPI_File_set_size(fh, 0);
+
+    /* write the header */
+    dirindex_write_header(fh, all_count, chars);
+    MPI_Offset disp = 3 * 8;
+
+    /* collective write of directory records */
+    MPI_File_set_view(fh, disp, dt_rec, dt_rec, datarep, MPI_INFO_NULL);
+    MPI_File_write_at_all(fh, (MPI_Offset)offset, buf, (int)outcount, dt_rec, &status);
+
+    /* close file */
+    MPI_File_close(&fh);
+
+    /* free memory */
+    mfu_free(&buf);
+    mfu_free(&sortbuf);
+
+    /* free the datatypes */
+    MPI_Type_free(&dt_keysat);
+    MPI_Type_free(&dt_rec);
+
+    return;
+}
+
+void mfu_flist_write_dirindex(
+    const char* name,
+    mfu_flist flist)
+{
+    /* start timer */
+    double start_write = MPI_Wtime();
+
+    /* report the filename we're writing to */
+    if (mfu_debug_level >= MFU_LOG_VERBOSE && mfu_rank == 0) {
+        printf("Writing directory index to: %s\n", name);
+        fflush(stdout);
+    }
+
+    /* an empty list gets a header with no records */
+    uint64_t all_files = mfu_flist_global_size(flist);
+    if (all_files == 0) {
+        MPI_File fh;
+        int amode = MPI_MODE_WRONLY | MPI_MODE_CREATE;
+        MPI_File_open(MPI_COMM_WORLD, (char*)name, amode, MPI_INFO_NULL, &fh);
+        MPI_File_set_size(fh, 0);
+        dirindex_write_header(fh, 0, 0);
+        MPI_File_close(&fh);
+        return;
+    }
+
+    /* find smallest length that fits max and consists of integer
+     * number of 8 byte segments */
+    int max = (int) mfu_flist_file_max_name(flist);
+    int chars = max / 8;
+    if (chars * 8 < max) {
+        chars++;
+    }
+    chars *= 8;
+
+    /* gather exclusive totals for each directory */
+    dirindex_elem_t* elems;
+    uint64_t count = dirindex_collect(flist, (size_t)chars, &elems);
+
+    /* accumulate inclusive totals from the bottom up */
+    dirindex_reduce(elems, count, (size_t)chars);
+
+    /* write directories to file */
+    dirindex_write(name, elems, count, chars);
+
+    /* get total number of directories */
+    uint64_t all_count;
+    MPI_Allreduce(&count, &all_count, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+
+    /* free directory entries */
+    uint64_t i;
+    for (i = 0; i < count; i++) {
+        mfu_free(&elems[i].name);
+    }
+    mfu_free(&elems);
+
+    /* end timer */
+    double end_write = MPI_Wtime();
+
+    /* report write count, time, and rate */
+    if (mfu_debug_level >= MFU_LOG_VERBOSE && mfu_rank == 0) {
+        double secs = end_write - start_write;
+        double rate = 0.0;
+        if (secs > 0.0) {
+            rate = ((double)all_count) / secs;
+        }
+        printf("Wrote %lu directories in %f seconds (%f dirs/sec)\n",
+               all_count, secs, rate
+              );
+    }
+    return;
+}
+
+int mfu_flist_read_dirindex(
+    const char* name,
+    uint64_t n,
+    uint64_t* outcount,
+    mfu_dirindex_elem_t** outelems)
+{
+    /* get our rank */
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+    /* nothing read yet */
+    *outcount = 0;
+    *outelems = NULL;
+
+    /* open file */
+    MPI_File fh;
+    char datarep[] = "external32";
+    int amode = MPI_MODE_RDONLY;
+    int rc = MPI_File_open(MPI_COMM_WORLD, (char*)name, amode, MPI_INFO_NULL, &fh);
+    if (rc != MPI_SUCCESS) {
+        if (rank == 0) {
+            MFU_LOG(MFU_LOG_ERR, "Failed to open directory index `%s'", name);
+        }
+        return MFU_FAILURE;
+    }
+
+    /* rank 0 reads the header and checks that the file is large
+     * enough to hold the records it names, then broadcasts the
+     * header along with a flag saying whether it is valid */
+    MPI_Status status;
+    uint64_t header[4] = {0, 0, 0, 0};
+    MPI_File_set_view(fh, 0, MPI_UINT64_T, MPI_UINT64_T, datarep, MPI_INFO_NULL);
+    if (rank == 0) {
+        MPI_Offset filesize;
+        MPI_File_get_size(fh, &filesize);
+        if (filesize >= 3 * 8) {
+            MPI_File_read_at(fh, 0, header, 3, MPI_UINT64_T, &status);
+            uint64_t chars = header[2];
+            uint64_t space = (uint64_t)filesize - 3 * 8;
+            if (header[0] == DIRINDEX_VERSION &&
+                chars % 8 == 0 && chars <= INT_MAX &&
+                (header[1] == 0 || (chars > 0 && header[1] <= space / (chars + DIRINDEX_FIELDS * 8))))
+            {
+                header[3] = 1;
+            }
+        }
+    }
+    MPI_Bcast(header, 4, MPI_UINT64_T, 0, MPI_COMM_WORLD);
+
+    if (header[3] == 0) {
+        if (rank == 0) {
+            MFU_LOG(MFU_LOG_ERR, "Invalid directory index `%s'", name);
+        }
+        MPI_File_close(&fh);
+        return MFU_FAILURE;
+    }
+
+    /* records are sorted largest first, so the top n are at the front */
+    uint64_t count = header[1];
+    if (n > 0 && n < count) {
+        count = n;
+    }
+    if (count > INT_MAX) {
+        if (rank == 0) {
+            MFU_LOG(MFU_LOG_ERR, "Too many directory records to read from `%s': %" PRIu64,
+                name, count);
+        }
+        MPI_File_close(&fh);
+        return MFU_FAILURE;
+    }
+
+    /* an index of a list with no directories has no records */
+    if (count == 0) {
+        MPI_File_close(&fh);
+        return MFU_SUCCESS;
+    }
+
+    /* build type for directory record */
+    int chars = (int) header[2];
+    MPI_Datatype dt_rec;
+    dirindex_type(chars, &dt_rec);
+
+    MPI_Aint lb, extent;
+    MPI_Type_get_extent(dt_rec, &lb, &extent);
+
+    /* rank 0 reads records and broadcasts them to all ranks */
+    char* buf = (char*) MFU_MALLOC(count * (size_t)extent);
+    MPI_File_set_view(fh, 3 * 8, dt_rec, dt_rec, datarep, MPI_INFO_NULL);
+    if (rank == 0) {
+        MPI_File_read_at(fh, 0, buf, (int)count, dt_rec, &status);
+    }
+    MPI_Bcast(buf, (int)count, dt_rec, 0, MPI_COMM_WORLD);
+
+    /* close file */
+    MPI_File_close(&fh);
+
+    /* unpack records, names are NUL-padded to chars bytes */
+    mfu_dirindex_elem_t* elems = (mfu_dirindex_elem_t*) MFU_MALLOC(count * sizeof(mfu_dirindex_elem_t));
+    const char* ptr = buf;
+    uint64_t i;
+    for (i = 0; i < count; i++) {
+        mfu_dirindex_elem_t* elem = &elems[i];
+        elem->name = (char*) MFU_MALLOC((size_t)chars + 1);
+        memcpy(elem->name, ptr, (size_t)chars);
+        elem->name[chars] = '\0';
+        ptr += chars;
+        mfu_unpack_uint64(&ptr, &elem->depth);
+        mfu_unpack_uint64(&ptr, &elem->incl_items);
+        mfu_unpack_uint64(&ptr, &elem->incl_bytes);
+        mfu_unpack_uint64(&ptr, &elem->incl_mtime);
+        mfu_unpack_uint64(&ptr, &elem->excl_items);
+        mfu_unpack_uint64(&ptr, &elem->excl_bytes);
+        mfu_unpack_uint64(&ptr, &elem->excl_mtime);
+    }
+
+    /* free memory */
+    mfu_free(&buf);
+    MPI_Type_free(&dt_rec);
+
+    *outcount = count;
+    *outelems = elems;
+    return MFU_SUCCESS;
+}
+
+void mfu_flist_free_dirindex(
+    uint64_t count,
+    mfu_dirindex_elem_t** pelems)
+{
+    mfu_dirindex_elem_t* elems = *pelems;
+    uint64_t i;
+    for (i = 0; i < count; i++) {
+        mfu_free(&elems[i].name);
+    }
+    mfu_free(pelems);
+    return;
+}
@@ -120,6 +120,40 @@ mfu_filetype mfu_flist_mode_to_filetype(mode_t mode);
  * and absolute */
 int mfu_flist_compute_depth(const char* path);
 
+/* sort variable-length records across all ranks by the NUL-terminated
+ * string at the start of each record, records in inbuf are encoded
+ * as a uint32_t length followed by that many bytes, returns a newly
+ * allocated buffer holding the records assigned to this rank in
+ * sorted order using the same encoding, sets outcount to the number
+ * of records and outbytes to the size of the buffer, reverses the
+ * order if descend is set */
+char* mfu_flist_sort_strings(
+    const char* inbuf,
+    uint64_t count,
+    int descend,
+    uint64_t* outcount,
+    size_t* outbytes
+);
+
+/* per-file checksums summed from the pieces each rank hashed
+ * with mfu_hash_data, see mfu_flist_manifest.c */
+typedef struct mfu_manifest_struct mfu_manifest;
+
+/* allocate an empty set of checksums */
+mfu_manifest* mfu_manifest_new(void);
+
+/* add the checksum of a piece of file name to its running sum,
+ * size is the size of the file, the largest value added is kept */
+void mfu_manifest_add(mfu_manifest* m, const char* name, uint64_t size, uint64_t sum);
+
+/* add up the checksums of each file across ranks and write a
+ * line for each file to the named manifest, returns 0 on success,
+ * collective */
+int mfu_manifest_write(mfu_manifest* m, const char* name);
+
+/* free checksums allocated with mfu_manifest_new */
+void mfu_manifest_free(mfu_manifest** pm);
+
 #endif /* MFU_FLIST_INTERNAL_H */
 
 /* enable C++ codes to include this header directly */
@@ -709,6 +709,223 @@ static void read_cache_v3(
     return;
 }
 
+/* reads a manifest written by write_cache_shards and the records
+ * from its shard files, records are evenly divided among ranks
+ * regardless of the number of shards, each rank opens just the
+ * shards that overlap its portion of the list */
+static void read_cache_shards(
+    const char* name,
+    MPI_Offset* outdisp,
+    MPI_File fh,
+    char* datarep,
+    uint64_t* outstart,
+    uint64_t* outend,
+    flist_t* flist)
+{
+    MPI_Status status;
+
+    MPI_Offset disp = *outdisp;
+
+    /* pointer to users, groups, and file buffer data structure */
+    buf_t* users  = &flist->users;
+    buf_t* groups = &flist->groups;
+
+    /* get our rank */
+    int rank, ranks;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+
+    /* rank 0 reads and broadcasts header */
+    uint64_t header[10];
+    MPI_File_set_view(fh, disp, MPI_UINT64_T, MPI_UINT64_T, datarep, MPI_INFO_NULL);
+    if (rank == 0) {
+        MPI_File_read_at(fh, 0, header, 10, MPI_UINT64_T, &status);
+    }
+    MPI_Bcast(header, 10, MPI_UINT64_T, 0, MPI_COMM_WORLD);
+    disp += 10 * 8; /* 10 consecutive uint64_t types in external32 */
+
+    uint64_t all_count;
+    *outstart        = header[0];
+    *outend          = header[1];
+    users->count     = header[2];
+    users->chars     = header[3];
+    groups->count    = header[4];
+    groups->chars    = header[5];
+    all_count        = header[6];
+    uint64_t chars   = header[7];
+    flist->detail    = (int) header[8];
+    int shards       = (int) header[9];
+
+    /* compute count for each process */
+    uint64_t count = all_count / (uint64_t)ranks;
+    uint64_t remainder = all_count - count * (uint64_t)ranks;
+    if ((uint64_t)rank < remainder) {
+        count++;
+    }
+
+    /* get our offset */
+    uint64_t offset;
+    MPI_Exscan(&count, &offset, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+    if (rank == 0) {
+        offset = 0;
+    }
+
+    /* read users, if any */
+    if (flist->detail && users->count > 0 && users->chars > 0) {
+        /* create type */
+        mfu_flist_usrgrp_create_stridtype((int)users->chars,  &(users->dt));
+
+        /* get extent */
+        MPI_Aint lb_user, extent_user;
+        MPI_Type_get_extent(users->dt, &lb_user, &extent_user);
+
+        /* allocate memory to hold data */
+        size_t bufsize_user = users->count * (size_t)extent_user;
+        users->buf = (void*) MFU_MALLOC(bufsize_user);
+        users->bufsize = bufsize_user;
+
+        /* read data */
+        MPI_File_set_view(fh, disp, users->dt, users->dt, datarep, MPI_INFO_NULL);
+        if (rank == 0) {
+            MPI_File_read_at(fh, 0, users->buf, (int)users->count, users->dt, &status);
+        }
+        MPI_Bcast(users->buf, (int)users->count, users->dt, 0, MPI_COMM_WORLD);
+        disp += (MPI_Offset) bufsize_user;
+    }
+
+    /* read groups, if any */
+    if (flist->detail && groups->count > 0 && groups->chars > 0) {
+        /* create type */
+        mfu_flist_usrgrp_create_stridtype((int)groups->chars, &(groups->dt));
+
+        /* get extent */
+        MPI_Aint lb_group, extent_group;
+        MPI_Type_get_extent(groups->dt, &lb_group, &extent_group);
+
+        /* allocate memory to hold data */
+        size_t bufsize_group = groups->count * (size_t)extent_group;
+        groups->buf = (void*) MFU_MALLOC(bufsize_group);
+        groups->bufsize = bufsize_group;
+
+        /* read data */
+        MPI_File_set_view(fh, disp, groups->dt, groups->dt, datarep, MPI_INFO_NULL);
+        if (rank == 0) {
+            MPI_File_read_at(fh, 0, groups->buf, (int)groups->count, groups->dt, &status);
+        }
+        MPI_Bcast(groups->buf, (int)groups->count, groups->dt, 0, MPI_COMM_WORLD);
+        disp += (MPI_Offset) bufsize_group;
+    }
+
+    /* read number of records in each shard */
+    uint64_t* shard_counts = (uint64_t*) MFU_MALLOC((size_t)shards * sizeof(uint64_t));
+    MPI_File_set_view(fh, disp, MPI_UINT64_T, MPI_UINT64_T, datarep, MPI_INFO_NULL);
+    if (rank == 0) {
+        MPI_File_read_at(fh, 0, shard_counts, shards, MPI_UINT64_T, &status);
+    }
+    MPI_Bcast(shard_counts, shards, MPI_UINT64_T, 0, MPI_COMM_WORLD);
+    disp += (MPI_Offset)shards * 8;
+
+    /* read files, if any */
+    if (count > 0 && chars > 0) {
+        /* create types */
+        MPI_Datatype dt;
+        create_stattype(flist->detail, (int)chars, &dt);
+
+        /* get extents */
+        MPI_Aint lb_file, extent_file;
+        MPI_Type_get_extent(dt, &lb_file, &extent_file);
+
+        /* allocate a buffer, ensure it's large enough to hold at least one
+         * complete record */
+        size_t bufsize = 1024 * 1024;
+        if (bufsize < (size_t) extent_file) {
+            bufsize = (size_t) extent_file;
+        }
+        void* buf = MFU_MALLOC(bufsize);
+
+        /* compute number of items we can fit in each read iteration */
+        uint64_t bufcount = (uint64_t)bufsize / (uint64_t)extent_file;
+
+        /* allocate space to build shard file names */
+        size_t shard_name_len = strlen(name) + 32;
+        char* shard_name = (char*) MFU_MALLOC(shard_name_len);
+
+        /* read the portion of each shard that overlaps our range */
+        uint64_t first = offset;
+        uint64_t last  = offset + count;
+        uint64_t shard_start = 0;
+        int shard;
+        for (shard = 0; shard < shards && shard_start < last; shard++) {
+            uint64_t shard_end = shard_start + shard_counts[shard];
+
+            /* compute range of records we need from this shard */
+            uint64_t start = (first > shard_start) ? first : shard_start;
+            uint64_t end   = (last  < shard_end)   ? last  : shard_end;
+            if (start < end) {
+                /* open shard file, each rank reads independently */
+                MPI_File shard_fh;
+                snprintf(shard_name, shard_name_len, "%s.%d", name, shard);
+                int rc = MPI_File_open(MPI_COMM_SELF, shard_name, MPI_MODE_RDONLY, MPI_INFO_NULL, &shard_fh);
+                if (rc != MPI_SUCCESS) {
+                    MFU_ABORT(1, "Failed to open shard file %s", shard_name);
+                }
+
+                /* shard files have no header, just a sequence of records */
+                MPI_File_set_view(shard_fh, 0, dt, dt, datarep, MPI_INFO_NULL);
+
+                /* iterate with multiple reads until all records are read */
+                MPI_Offset read_offset = (MPI_Offset)(start - shard_start);
+                uint64_t remaining = end - start;
+                while (remaining > 0) {
+                    /* determine number to read */
+                    int read_count = (int) bufcount;
+                    if (remaining < bufcount) {
+                        read_count = (int) remaining;
+                    }
+
+                    MPI_File_read_at(shard_fh, read_offset, buf, read_count, dt, &status);
+
+                    /* update our offset with the number of items we just read */
+                    read_offset += (MPI_Offset)read_count;
+                    remaining -= (uint64_t) read_count;
+
+                    /* unpack data from buffer into list */
+                    char* ptr = (char*) buf;
+                    uint64_t packcount = 0;
+                    while (packcount < (uint64_t) read_count) {
+                        /* unpack item from buffer and advance pointer */
+                        list_insert_ptr(flist, ptr, flist->detail, chars);
+                        ptr += extent_file;
+                        packcount++;
+                    }
+                }
+
+                MPI_File_close(&shard_fh);
+            }
+
+            shard_start = shard_end;
+        }
+
+        /* free memory */
+        mfu_free(&shard_name);
+        mfu_free(&buf);
+
+        /* free off our datatype */
+        MPI_Type_free(&dt);
+    }
+
+    mfu_free(&shard_counts);
+
+    /* create maps of users and groups */
+    if (flist->detail) {
+        mfu_flist_usrgrp_create_map(&flist->users, flist->user_id2name);
+        mfu_flist_usrgrp_create_map(&flist->groups, flist->group_id2name);
+    }
+
+    *outdisp = disp;
+    return;
+}
+
 void mfu_flist_read_cache(
     const char* name,
     mfu_flist bflist)
@@ -763,6 +980,9 @@ void mfu_flist_read_cache(
     if (version == 3) {
         read_cache_v3(name, &disp, fh, datarep, &outstart, &outend, flist);
     }
+    else if (version == 4) {
+        read_cache_shards(name, &disp, fh, datarep, &outstart, &outend, flist);
+    }
     else {
         /* TODO: unknown file format */
         read_cache_variable(name, fh, datarep, flist);
@@ -802,11 +1022,45 @@ void mfu_flist_read_cache(
  * 2: version, start, end, files, file chars, list (file, type)
  * 3: version, start, end, files, users, user chars, groups, group chars,
  *    files, file chars, list (user, userid), list (group, groupid),
- *    list (stat) */
+ *    list (stat)
+ * 4: version, start, end, users, user chars, groups, group chars,
+ *    files, file chars, detail, shards, list (user, userid),
+ *    list (group, groupid), list (shard file count),
+ *    with records stored in separate <name>.<shard> files */
+
+/* set mpi io hints for a cache file written by the given number of
+ * processes, by default we stripe across as many OSTs as writers */
+static void cache_set_hints(MPI_Info info, int writers, const mfu_cache_opts_t* opts)
+{
+    char str_buf[32];
+
+    /* no. of I/O devices for lustre striping */
+    int stripes = writers;
+    if (opts != NULL && opts->stripe_count > 0) {
+        stripes = opts->stripe_count;
+    }
+    sprintf(str_buf, "%d", stripes);
+    MPI_Info_set(info, "striping_factor", str_buf);
+
+    /* size of each stripe in bytes */
+    if (opts != NULL && opts->stripe_size > 0) {
+        sprintf(str_buf, "%llu", (unsigned long long) opts->stripe_size);
+        MPI_Info_set(info, "striping_unit", str_buf);
+    }
+
+    /* size of buffer used by aggregators in collective writes */
+    if (opts != NULL && opts->cb_buffer_size > 0) {
+        sprintf(str_buf, "%llu", (unsigned long long) opts->cb_buffer_size);
+        MPI_Info_set(info, "cb_buffer_size", str_buf);
+    }
+
+    return;
+}
 
 /* write each record in ASCII format, terminated with newlines */
 static void write_cache_readdir_variable(
     const char* name,
+    const mfu_cache_opts_t* opts,
     flist_t* flist)
 {
     /* get our rank in job & number of ranks */
@@ -844,12 +1098,8 @@ static void write_cache_readdir_variable(
     //int amode = MPI_MODE_WRONLY | MPI_MODE_CREATE | MPI_MODE_SEQUENTIAL;
     int amode = MPI_MODE_WRONLY | MPI_MODE_CREATE;
 
-    /* change number of ranks to string to pass to MPI_Info */
-    char str_buf[12];
-    sprintf(str_buf, "%d", ranks);
-
-    /* no. of I/O devices for lustre striping is number of ranks */
-    MPI_Info_set(info, "striping_factor", str_buf);
+    /* stripe across number of ranks unless user set hints */
+    cache_set_hints(info, ranks, opts);
 
     MPI_File_open(MPI_COMM_WORLD, (char*)name, amode, info, &fh);
 
@@ -1086,6 +1336,7 @@ static void write_cache_stat(
     const char* name,
     uint64_t walk_start,
     uint64_t walk_end,
+    const mfu_cache_opts_t* opts,
     flist_t* flist)
 {
     buf_t* users  = &flist->users;
@@ -1129,12 +1380,8 @@ static void write_cache_stat(
     //int amode = MPI_MODE_WRONLY | MPI_MODE_CREATE | MPI_MODE_SEQUENTIAL;
     int amode = MPI_MODE_WRONLY | MPI_MODE_CREATE;
 
-    /* change number of ranks to string to pass to MPI_Info */
-    char str_buf[12];
-    sprintf(str_buf, "%d", ranks);
-
-    /* no. of I/O devices for lustre striping is number of ranks */
-    MPI_Info_set(info, "striping_factor", str_buf);
+    /* stripe across number of ranks unless user set hints */
+    cache_set_hints(info, ranks, opts);
 
     MPI_File_open(MPI_COMM_WORLD, (char*)name, amode, info, &fh);
 
@@ -1259,9 +1506,243 @@ static void write_cache_stat(
     return;
 }
 
-void mfu_flist_write_cache(
+/* write list as a set of shard files and a manifest, ranks are
+ * divided into contiguous groups, one per shard, and each group
+ * writes its records to its shard file in rank order, so the
+ * concatenation of shards preserves the order of the list */
+static void write_cache_shards(
     const char* name,
-    mfu_flist bflist)
+    uint64_t walk_start,
+    uint64_t walk_end,
+    const mfu_cache_opts_t* opts,
+    flist_t* flist)
+{
+    buf_t* users  = &flist->users;
+    buf_t* groups = &flist->groups;
+
+    /* get our rank in job & number of ranks */
+    int rank, ranks;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+
+    /* determine the shard we write to,
+     * if there are more shards than ranks, some shards are empty */
+    int shards = opts->shards;
+    int shard = (int)(((uint64_t)rank * (uint64_t)shards) / (uint64_t)ranks);
+
+    /* create a communicator for the ranks writing our shard */
+    MPI_Comm comm;
+    MPI_Comm_split(MPI_COMM_WORLD, shard, rank, &comm);
+
+    int shard_rank, shard_ranks;
+    MPI_Comm_rank(comm, &shard_rank);
+    MPI_Comm_size(comm, &shard_ranks);
+
+    /* get number of items in our list and total file count */
+    uint64_t count     = flist->list_count;
+    uint64_t all_count = flist->total_files;
+
+    /* compute our offset within the shard */
+    uint64_t offset;
+    MPI_Exscan(&count, &offset, 1, MPI_UINT64_T, MPI_SUM, comm);
+    if (shard_rank == 0) {
+        offset = 0;
+    }
+
+    /* compute number of records in each shard */
+    uint64_t* shard_counts = (uint64_t*) MFU_MALLOC((size_t)shards * sizeof(uint64_t));
+    uint64_t* all_shard_counts = (uint64_t*) MFU_MALLOC((size_t)shards * sizeof(uint64_t));
+    int i;
+    for (i = 0; i < shards; i++) {
+        shard_counts[i] = 0;
+    }
+    shard_counts[shard] = count;
+    MPI_Allreduce(shard_counts, all_shard_counts, shards, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+
+    /* find smallest length that fits max and consists of integer
+     * number of 8 byte segments */
+    int max = (int) flist->max_file_name;
+    int chars = max / 8;
+    if (chars * 8 < max) {
+        chars++;
+    }
+    chars *= 8;
+
+    /* build datatype to hold file info */
+    MPI_Datatype dt;
+    create_stattype(flist->detail, chars, &dt);
+
+    /* get extent of stat type */
+    MPI_Aint lb, extent;
+    MPI_Type_get_extent(dt, &lb, &extent);
+
+    /* build name of our shard file */
+    size_t shard_name_len = strlen(name) + 32;
+    char* shard_name = (char*) MFU_MALLOC(shard_name_len);
+    snprintf(shard_name, shard_name_len, "%s.%d", name, shard);
+
+    /* stripe shard across ranks in our group unless user set hints */
+    MPI_Info info;
+    MPI_Info_create(&info);
+    cache_set_hints(info, shard_ranks, opts);
+
+    /* open shard file */
+    MPI_Status status;
+    MPI_File fh;
+    char datarep[] = "external32";
+    int amode = MPI_MODE_WRONLY | MPI_MODE_CREATE;
+    MPI_File_open(comm, shard_name, amode, info, &fh);
+
+    /* truncate file to 0 bytes */
+    MPI_File_set_size(fh, 0);
+
+    /* in order to avoid blowing out memory, we'll pack into a smaller
+     * buffer and iteratively make many collective writes */
+
+    /* allocate a buffer, ensure it's large enough to hold at least one
+     * complete record */
+    size_t bufsize = 1024 * 1024;
+    if (bufsize < (size_t) extent) {
+        bufsize = (size_t) extent;
+    }
+    void* buf = MFU_MALLOC(bufsize);
+
+    /* compute number of items we can fit in each write iteration */
+    uint64_t bufcount = (uint64_t)bufsize / (uint64_t)extent;
+
+    /* determine number of iterations we need to write all items */
+    uint64_t iters = count / bufcount;
+    if (iters * bufcount < count) {
+        iters++;
+    }
+
+    /* compute max iterations across procs in our shard */
+    uint64_t all_iters;
+    MPI_Allreduce(&iters, &all_iters, 1, MPI_UINT64_T, MPI_MAX, comm);
+
+    /* shard files have no header, just a sequence of records */
+    MPI_File_set_view(fh, 0, dt, dt, datarep, MPI_INFO_NULL);
+
+    /* compute byte offset to write our element */
+    MPI_Offset write_offset = (MPI_Offset)offset;
+
+    /* iterate with multiple writes until all records are written */
+    const elem_t* current = flist->list_head;
+    while (all_iters > 0) {
+        /* copy stat data into write buffer */
+        char* ptr = (char*) buf;
+        uint64_t packcount = 0;
+        while (current != NULL && packcount < bufcount) {
+            /* pack item into buffer and advance pointer */
+            size_t pack_bytes = list_elem_pack(ptr, flist->detail, (uint64_t)chars, current);
+            ptr += pack_bytes;
+            packcount++;
+            current = current->next;
+        }
+
+        /* collective write of file info */
+        int write_count = (int) packcount;
+        MPI_File_write_at_all(fh, write_offset, buf, write_count, dt, &status);
+
+        /* update our offset with the number of bytes we just wrote */
+        write_offset += (MPI_Offset)packcount;
+
+        /* one less iteration */
+        all_iters--;
+    }
+
+    /* free write buffer */
+    mfu_free(&buf);
+
+    /* close shard file */
+    MPI_File_close(&fh);
+
+    /* now write the manifest */
+    MPI_File_open(MPI_COMM_WORLD, (char*)name, amode, MPI_INFO_NULL, &fh);
+
+    /* truncate file to 0 bytes */
+    MPI_File_set_size(fh, 0);
+
+    /* prepare header */
+    uint64_t header[11];
+    header[0]  = 4;                       /* file version */
+    header[1]  = walk_start;              /* time_t when file walk started */
+    header[2]  = walk_end;                /* time_t when file walk stopped */
+    header[3]  = users->count;            /* number of user records */
+    header[4]  = users->chars;            /* number of chars in user name */
+    header[5]  = groups->count;           /* number of group records */
+    header[6]  = groups->chars;           /* number of chars in group name */
+    header[7]  = all_count;               /* total number of stat entries */
+    header[8]  = (uint64_t)chars;         /* number of chars in file name */
+    header[9]  = (uint64_t)flist->detail; /* whether records hold stat data */
+    header[10] = (uint64_t)shards;        /* number of shard files */
+
+    /* write the header */
+    MPI_Offset disp = 0;
+    MPI_File_set_view(fh, disp, MPI_UINT64_T, MPI_UINT64_T, datarep, MPI_INFO_NULL);
+    if (rank == 0) {
+        MPI_File_write_at(fh, 0, header, 11, MPI_UINT64_T, &status);
+    }
+    disp += 11 * 8;
+
+    if (flist->detail && users->dt != MPI_DATATYPE_NULL) {
+        /* get extent user */
+        MPI_Aint lb_user, extent_user;
+        MPI_Type_get_extent(users->dt, &lb_user, &extent_user);
+
+        /* write out users */
+        MPI_File_set_view(fh, disp, users->dt, users->dt, datarep, MPI_INFO_NULL);
+        if (rank == 0) {
+            int write_count = (int) users->count;
+            MPI_File_write_at(fh, 0, users->buf, write_count, users->dt, &status);
+        }
+        disp += (MPI_Offset)users->count * extent_user;
+    }
+
+    if (flist->detail && groups->dt != MPI_DATATYPE_NULL) {
+        /* get extent group */
+        MPI_Aint lb_group, extent_group;
+        MPI_Type_get_extent(groups->dt, &lb_group, &extent_group);
+
+        /* write out groups */
+        MPI_File_set_view(fh, disp, groups->dt, groups->dt, datarep, MPI_INFO_NULL);
+        if (rank == 0) {
+            int write_count = (int) groups->count;
+            MPI_File_write_at(fh, 0, groups->buf, write_count, groups->dt, &status);
+        }
+        disp += (MPI_Offset)groups->count * extent_group;
+    }
+
+    /* write out number of records in each shard */
+    MPI_File_set_view(fh, disp, MPI_UINT64_T, MPI_UINT64_T, datarep, MPI_INFO_NULL);
+    if (rank == 0) {
+        MPI_File_write_at(fh, 0, all_shard_counts, shards, MPI_UINT64_T, &status);
+    }
+
+    /* close manifest */
+    MPI_File_close(&fh);
+
+    /* free memory */
+    mfu_free(&shard_name);
+    mfu_free(&all_shard_counts);
+    mfu_free(&shard_counts);
+
+    /* free the datatype */
+    MPI_Type_free(&dt);
+
+    /* free mpi info */
+    MPI_Info_free(&info);
+
+    /* free our shard communicator */
+    MPI_Comm_free(&comm);
+
+    return;
+}
+
+void mfu_flist_write_cache_opts(
+    const char* name,
+    mfu_flist bflist,
+    const mfu_cache_opts_t* opts)
 {
     /* convert handle to flist_t */
     flist_t* flist = (flist_t*) bflist;
@@ -1279,12 +1760,15 @@ void mfu_flist_write_cache(
     }
 
     if (all_count > 0) {
-        if (flist->detail) {
-            write_cache_stat(name, 0, 0, flist);
+        if (opts != NULL && opts->shards > 0) {
+            write_cache_shards(name, 0, 0, opts, flist);
+        }
+        else if (flist->detail) {
+            write_cache_stat(name, 0, 0, opts, flist);
         }
         else {
             //write_cache_readdir(name, 0, 0, flist);
-            write_cache_readdir_variable(name, flist);
+            write_cache_readdir_variable(name, opts, flist);
         }
     }
 
@@ -1305,6 +1789,14 @@ void mfu_flist_write_cache(
     return;
 }
 
+void mfu_flist_write_cache(
+    const char* name,
+    mfu_flist bflist)
+{
+    mfu_flist_write_cache_opts(name, bflist, NULL);
+    return;
+}
+
 /* TODO: move this somewhere or modify existing print_file */
 /* print information about a file given the index and rank (used in print_files) */
 static size_t print_file_text(mfu_flist flist, uint64_t idx, char* buffer, size_t bufsize)
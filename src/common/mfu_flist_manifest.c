@@ -0,0 +1,596 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <limits.h>
+
+#include "mfu.h"
+#include "mfu_flist_internal.h"
+
+/****************************************
+ * Functions to record and verify per-file checksums
+ ***************************************/
+
+/* A manifest lists a checksum and size for each regular file that
+ * was copied, one file per line:
+ *
+ *   <checksum as 16 hex digits> <size in bytes> <path>
+ *
+ * The checksum of a file is the sum of mfu_hash_data over its pieces,
+ * so the ranks that copy pieces of a file each add up what they
+ * hashed, and we send those partial sums to a rank picked by hashing
+ * the file name, which adds them up and writes the line for the file.
+ * Lines are grouped by that rank, so they are not sorted by name. */
+
+/* most bytes we write to the manifest in one call */
+#define MANIFEST_WRITE_BYTES (1024 * 1024 * 1024)
+
+/* partial sum for one file from the pieces a rank hashed */
+typedef struct {
+    char* name;    /* full path of file */
+    uint64_t size; /* file size, largest value reported */
+    uint64_t sum;  /* sum of checksums of pieces */
+} manifest_elem_t;
+
+struct mfu_manifest_struct {
+    uint64_t count;         /* number of entries in use */
+    uint64_t capacity;      /* number of entries allocated */
+    manifest_elem_t* elems; /* array of entries */
+};
+
+mfu_manifest* mfu_manifest_new(void)
+{
+    mfu_manifest* m = (mfu_manifest*) MFU_MALLOC(sizeof(mfu_manifest));
+    m->count    = 0;
+    m->capacity = 0;
+    m->elems    = NULL;
+    return m;
+}
+
+void mfu_manifest_free(mfu_manifest** pm)
+{
+    mfu_manifest* m = *pm;
+    if (m == NULL) {
+        return;
+    }
+
+    uint64_t i;
+    for (i = 0; i < m->count; i++) {
+        mfu_free(&m->elems[i].name);
+    }
+    mfu_free(&m->elems);
+    mfu_free(pm);
+}
+
+void mfu_manifest_add(mfu_manifest* m, const char* name, uint64_t size, uint64_t sum)
+{
+    /* a rank usually hashes consecutive pieces of the same file,
+     * so merge with the last entry if we can */
+    if (m->count > 0) {
+        manifest_elem_t* last = &m->elems[m->count - 1];
+        if (strcmp(last->name, name) == 0) {
+            last->sum += sum;
+            if (size > last->size) {
+                last->size = size;
+            }
+            return;
+        }
+    }
+
+    /* grow array if needed */
+    if (m->count == m->capacity) {
+        uint64_t capacity = (m->capacity > 0) ? 2 * m->capacity : 64;
+        manifest_elem_t* elems = (manifest_elem_t*) MFU_MALLOC(capacity * sizeof(manifest_elem_t));
+        if (m->count > 0) {
+            memcpy(elems, m->elems, m->count * sizeof(manifest_elem_t));
+        }
+        mfu_free(&m->elems);
+        m->elems    = elems;
+        m->capacity = capacity;
+    }
+
+    manifest_elem_t* elem = &m->elems[m->count];
+    elem->name = MFU_STRDUP(name);
+    elem->size = size;
+    elem->sum  = sum;
+    m->count++;
+}
+
+/* we hash file names to map all partial sums for a given
+ * file to the same process */
+static int manifest_map(const char* name, int ranks)
+{
+    size_t len = strlen(name);
+    uint32_t hash = mfu_hash_jenkins(name, len);
+    int rank = (int)(hash % (uint32_t)ranks);
+    return rank;
+}
+
+/* partial sums are exchanged as a name padded to chars bytes,
+ * followed by the size and sum */
+static size_t manifest_rec_size(size_t chars)
+{
+    return chars + 2 * 8;
+}
+
+/* routine for sorting packed records by name */
+static int manifest_rec_cmp(const void* a, const void* b)
+{
+    return strcmp((const char*)a, (const char*)b);
+}
+
+/* routine for sorting entries by name */
+static int manifest_elem_cmp(const void* a, const void* b)
+{
+    const manifest_elem_t* elem_a = (const manifest_elem_t*) a;
+    const manifest_elem_t* elem_b = (const manifest_elem_t*) b;
+    return strcmp(elem_a->name, elem_b->name);
+}
+
+/* routine for looking up a file by name in sorted array */
+static int manifest_name_cmp(const void* a, const void* b)
+{
+    const char* name = (const char*) a;
+    const manifest_elem_t* elem = (const manifest_elem_t*) b;
+    return strcmp(name, elem->name);
+}
+
+/* send partial sums to the process responsible for each file, and
+ * replace the entries in m with the merged sums for the files this
+ * process is responsible for, sorted by name, collective */
+static void manifest_combine(mfu_manifest* m)
+{
+    /* get number of ranks */
+    int ranks;
+    MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+
+    /* find longest name across all ranks, including terminating NUL */
+    uint64_t i;
+    uint64_t max_chars = 1;
+    for (i = 0; i < m->count; i++) {
+        uint64_t chars = (uint64_t) strlen(m->elems[i].name) + 1;
+        if (chars > max_chars) {
+            max_chars = chars;
+        }
+    }
+    uint64_t all_max_chars;
+    MPI_Allreduce(&max_chars, &all_max_chars, 1, MPI_UINT64_T, MPI_MAX, MPI_COMM_WORLD);
+    size_t chars = (size_t) all_max_chars;
+    size_t recsize = manifest_rec_size(chars);
+
+    /* count records for each rank, we exchange whole records
+     * with a datatype below, so counts are in records, not bytes */
+    size_t bufsize = (size_t)ranks * sizeof(int);
+    int* sendcounts = (int*) MFU_MALLOC(bufsize);
+    int* senddisps  = (int*) MFU_MALLOC(bufsize);
+    int* recvcounts = (int*) MFU_MALLOC(bufsize);
+    int* recvdisps  = (int*) MFU_MALLOC(bufsize);
+    int* offsets    = (int*) MFU_MALLOC(bufsize);
+    int r;
+    for (r = 0; r < ranks; r++) {
+        sendcounts[r] = 0;
+    }
+    for (i = 0; i < m->count; i++) {
+        sendcounts[manifest_map(m->elems[i].name, ranks)]++;
+    }
+
+    /* compute displacement of each rank in send buffer */
+    uint64_t sendcount = 0;
+    for (r = 0; r < ranks; r++) {
+        senddisps[r] = (int) sendcount;
+        offsets[r]   = (int) sendcount;
+        sendcount += (uint64_t) sendcounts[r];
+    }
+
+    /* pack records into send buffer */
+    char* sendbuf = (char*) MFU_MALLOC((size_t)sendcount * recsize);
+    for (i = 0; i < m->count; i++) {
+        const manifest_elem_t* elem = &m->elems[i];
+        int dest = manifest_map(elem->name, ranks);
+        char* ptr = sendbuf + (size_t)offsets[dest] * recsize;
+        memset(ptr, 0, chars);
+        strcpy(ptr, elem->name);
+        ptr += chars;
+        mfu_pack_uint64(&ptr, elem->size);
+        mfu_pack_uint64(&ptr, elem->sum);
+        offsets[dest]++;
+    }
+
+    /* alltoall to get our incoming counts */
+    MPI_Alltoall(sendcounts, 1, MPI_INT, recvcounts, 1, MPI_INT, MPI_COMM_WORLD);
+
+    /* compute size of recvbuf and displacements */
+    uint64_t recvcount = 0;
+    for (r = 0; r < ranks; r++) {
+        recvdisps[r] = (int) recvcount;
+        recvcount += (uint64_t) recvcounts[r];
+    }
+
+    /* displacements are int, so give up if we have too many records */
+    if (sendcount > INT_MAX || recvcount > INT_MAX) {
+        MFU_ABORT(-1, "Too many manifest records to exchange: sending %" PRIu64 " receiving %" PRIu64,
+            sendcount, recvcount);
+    }
+
+    /* alltoallv to send data */
+    MPI_Datatype dt_rec;
+    MPI_Type_contiguous((int)recsize, MPI_BYTE, &dt_rec);
+    MPI_Type_commit(&dt_rec);
+    char* recvbuf = (char*) MFU_MALLOC((size_t)recvcount * recsize);
+    MPI_Alltoallv(
+        sendbuf, sendcounts, senddisps, dt_rec,
+        recvbuf, recvcounts, recvdisps, dt_rec, MPI_COMM_WORLD
+    );
+    MPI_Type_free(&dt_rec);
+
+    /* sort records by name to group records for same file */
+    qsort(recvbuf, (size_t)recvcount, recsize, manifest_rec_cmp);
+
+    /* replace our entries with merged records */
+    for (i = 0; i < m->count; i++) {
+        mfu_free(&m->elems[i].name);
+    }
+    m->count = 0;
+    uint64_t rec;
+    for (rec = 0; rec < recvcount; rec++) {
+        const char* ptr = recvbuf + rec * recsize;
+        const char* packed = ptr + chars;
+        uint64_t size, sum;
+        mfu_unpack_uint64(&packed, &size);
+        mfu_unpack_uint64(&packed, &sum);
+        mfu_manifest_add(m, ptr, size, sum);
+    }
+
+    /* free memory */
+    mfu_free(&recvbuf);
+    mfu_free(&sendbuf);
+    mfu_free(&offsets);
+    mfu_free(&recvdisps);
+    mfu_free(&recvcounts);
+    mfu_free(&senddisps);
+    mfu_free(&sendcounts);
+}
+
+int mfu_manifest_write(mfu_manifest* m, const char* name)
+{
+    /* get our rank */
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+    /* add up partial sums for each file */
+    manifest_combine(m);
+
+    /* compute bytes needed to print our lines */
+    uint64_t i;
+    uint64_t bytes = 0;
+    for (i = 0; i < m->count; i++) {
+        const manifest_elem_t* elem = &m->elems[i];
+        int len = snprintf(NULL, 0, "%016" PRIx64 " %" PRIu64 " %s\n",
+            elem->sum, elem->size, elem->name);
+        bytes += (uint64_t) len;
+    }
+
+    /* print lines into buffer, with room for snprintf's NUL */
+    char* buf = (char*) MFU_MALLOC((size_t)bytes + 1);
+    char* ptr = buf;
+    for (i = 0; i < m->count; i++) {
+        const manifest_elem_t* elem = &m->elems[i];
+        int len = snprintf(ptr, (size_t)(bytes + 1 - (uint64_t)(ptr - buf)),
+            "%016" PRIx64 " %" PRIu64 " %s\n",
+            elem->sum, elem->size, elem->name);
+        ptr += len;
+    }
+
+    /* compute our offset and total number of files */
+    uint64_t offset;
+    MPI_Exscan(&bytes, &offset, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+    if (rank == 0) {
+        offset = 0;
+    }
+    uint64_t all_count;
+    MPI_Allreduce(&m->count, &all_count, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+
+    /* open file */
+    MPI_Status status;
+    MPI_File fh;
+    int amode = MPI_MODE_WRONLY | MPI_MODE_CREATE;
+    int mpirc = MPI_File_open(MPI_COMM_WORLD, (char*)name, amode, MPI_INFO_NULL, &fh);
+    if (mpirc != MPI_SUCCESS) {
+        if (rank == 0) {
+            MFU_LOG(MFU_LOG_ERR, "Failed to open manifest `%s'", name);
+        }
+        mfu_free(&buf);
+        return -1;
+    }
+
+    /* truncate file to 0 bytes */
+    MPI_File_set_size(fh, 0);
+
+    /* write our lines in pieces, so each count fits in an int */
+    MPI_Offset write_offset = (MPI_Offset)offset;
+    ptr = buf;
+    uint64_t remaining = bytes;
+    while (remaining > 0) {
+        uint64_t write_bytes = remaining;
+        if (write_bytes > MANIFEST_WRITE_BYTES) {
+            write_bytes = MANIFEST_WRITE_BYTES;
+        }
+        MPI_File_write_at(fh, write_offset, ptr, (int)write_bytes, MPI_CHAR, &status);
+        write_offset += (MPI_Offset) write_bytes;
+        ptr += write_bytes;
+        remaining -= write_bytes;
+    }
+
+    /* close file */
+    MPI_File_close(&fh);
+
+    if (rank == 0) {
+        MFU_LOG(MFU_LOG_INFO, "Wrote checksums of %" PRIu64 " files to `%s'",
+            all_count, name);
+    }
+
+    mfu_free(&buf);
+    return 0;
+}
+
+/* parse a manifest line into its checksum, size, and path,
+ * strips the newline, returns 0 on success */
+static int manifest_parse(char* line, uint64_t* sum, uint64_t* size, char** path)
+{
+    size_t len = strlen(line);
+    if (len > 0 && line[len - 1] == '\n') {
+        line[len - 1] = '\0';
+    }
+
+    unsigned long long val_sum, val_size;
+    int pos = 0;
+    if (sscanf(line, "%llx %llu %n", &val_sum, &val_size, &pos) != 2 ||
+        pos == 0 || line[pos] == '\0')
+    {
+        return -1;
+    }
+
+    *sum  = (uint64_t) val_sum;
+    *size = (uint64_t) val_size;
+    *path = line + pos;
+    return 0;
+}
+
+/* compute checksum of a file section, adds sum of the section and
+ * the size of the file, if offset is 0, to actual, returns 0 on
+ * success */
+static int manifest_hash_section(
+    mfu_manifest* actual,
+    mfu_file_cache_t* cache,
+    const char* name,
+    uint64_t offset,
+    uint64_t length,
+    char* buf,
+    size_t buf_size,
+    mfu_progress* prg,
+    uint64_t* bytes)
+{
+    int fd = mfu_file_cache_open(cache, name, O_RDONLY, 0);
+    if (fd < 0) {
+        MFU_LOG(MFU_LOG_ERR, "Failed to open `%s' errno=%d %s",
+            name, errno, strerror(errno));
+        return -1;
+    }
+
+    /* the section at the start of the file reports its size */
+    uint64_t size = 0;
+    if (offset == 0) {
+        struct stat st;
+        if (fstat(fd, &st) < 0) {
+            MFU_LOG(MFU_LOG_ERR, "Failed to stat `%s' errno=%d %s",
+                name, errno, strerror(errno));
+            return -1;
+        }
+        size = (uint64_t) st.st_size;
+    }
+
+    if (mfu_lseek(name, fd, (off_t)offset, SEEK_SET) == (off_t)-1) {
+        MFU_LOG(MFU_LOG_ERR, "Couldn't seek in path `%s' errno=%d %s",
+            name, errno, strerror(errno));
+        return -1;
+    }
+
+    uint64_t sum = 0;
+    uint64_t total = 0;
+    while (total < length) {
+        size_t left = buf_size;
+        if (length - total < (uint64_t)left) {
+            left = (size_t)(length - total);
+        }
+
+        ssize_t num_read = mfu_read(name, fd, buf, left);
+        if (num_read < 0) {
+            MFU_LOG(MFU_LOG_ERR, "Failed to read `%s' errno=%d %s",
+                name, errno, strerror(errno));
+            return -1;
+        }
+        if (num_read == 0) {
+            /* file is shorter than the manifest says,
+             * which the size check will catch */
+            break;
+        }
+
+        sum += mfu_hash_data(offset + total, buf, (size_t)num_read);
+        total += (uint64_t)num_read;
+
+        *bytes += (uint64_t)num_read;
+        mfu_progress_update(prg, 0, *bytes);
+    }
+
+    mfu_manifest_add(actual, name, size, sum);
+    return 0;
+}
+
+int mfu_flist_verify_manifest(const char* name, mfu_copy_opts_t* mfu_copy_opts)
+{
+    /* get our rank and number of ranks */
+    int rank, ranks;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+
+    double start = MPI_Wtime();
+
+    if (rank == 0) {
+        MFU_LOG(MFU_LOG_INFO, "Verifying files listed in `%s'", name);
+    }
+
+    /* every rank reads the manifest, builds a list of every
+     * ranks-th file to split into sections, and keeps the expected
+     * values for the files whose sums it will receive */
+    mfu_flist list = mfu_flist_new();
+    mfu_flist_set_detail(list, 1);
+    mfu_manifest* expected = mfu_manifest_new();
+    int read_error = 0;
+    FILE* fp = fopen(name, "r");
+    if (fp != NULL) {
+        char* line = NULL;
+        size_t linesize = 0;
+        uint64_t lineno = 0;
+        while (getline(&line, &linesize, fp) != -1) {
+            uint64_t sum, size;
+            char* path;
+            if (manifest_parse(line, &sum, &size, &path) != 0) {
+                if (rank == 0) {
+                    MFU_LOG(MFU_LOG_ERR, "Invalid line %" PRIu64 " in manifest `%s'",
+                        lineno + 1, name);
+                }
+                read_error = 1;
+                lineno++;
+                continue;
+            }
+
+            if (lineno % (uint64_t)ranks == (uint64_t)rank) {
+                uint64_t idx = mfu_flist_file_create(list);
+                mfu_flist_file_set_name(list, idx, path);
+                mfu_flist_file_set_type(list, idx, MFU_TYPE_FILE);
+                mfu_flist_file_set_detail(list, idx, 1);
+                mfu_flist_file_set_size(list, idx, size);
+            }
+            if (manifest_map(path, ranks) == rank) {
+                mfu_manifest_add(expected, path, size, sum);
+            }
+            lineno++;
+        }
+        free(line);
+        fclose(fp);
+    } else {
+        MFU_LOG(MFU_LOG_ERR, "Failed to open manifest `%s' errno=%d %s",
+            name, errno, strerror(errno));
+        read_error = 1;
+    }
+    mfu_flist_summarize(list);
+
+    /* give up if any rank failed to read the manifest */
+    int any_read_error;
+    MPI_Allreduce(&read_error, &any_read_error, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+    if (any_read_error) {
+        mfu_manifest_free(&expected);
+        mfu_flist_free(&list);
+        return -1;
+    }
+
+    /* split files into sections spread across ranks like a copy */
+    mfu_chunk_opts_t chunk_opts;
+    chunk_opts.chunk_size = mfu_copy_opts->chunk_size;
+    chunk_opts.adaptive   = mfu_copy_opts->adaptive_chunks;
+    chunk_opts.align      = 0;
+    chunk_opts.locality   = mfu_copy_opts->locality;
+    chunk_opts.node_aware = mfu_copy_opts->node_aware;
+    chunk_opts.node_ranks = mfu_copy_opts->node_ranks;
+    chunk_opts.file_cost  = mfu_copy_opts->file_cost;
+    mfu_file_chunk_array* chunks = mfu_file_chunk_array_alloc(list, &chunk_opts);
+
+    /* total up bytes we will read for progress messages */
+    uint64_t n;
+    uint64_t total_bytes = 0;
+    for (n = 0; n < chunks->count; n++) {
+        total_bytes += chunks->chunks[n].length;
+    }
+    mfu_progress* prg = mfu_progress_start(mfu_progress_timeout, "Verified",
+        0, total_bytes, MPI_COMM_WORLD);
+
+    /* hash our sections */
+    size_t buf_size = FD_BLOCK_SIZE;
+    char* buf = (char*) MFU_MEMALIGN(buf_size, 1024 * 1024);
+    mfu_file_cache_t cache;
+    mfu_file_cache_init(&cache, mfu_copy_opts->open_files, 0);
+    mfu_manifest* actual = mfu_manifest_new();
+    uint64_t errors = 0;
+    uint64_t bytes = 0;
+    for (n = 0; n < chunks->count; n++) {
+        const mfu_file_chunk_desc* p = &chunks->chunks[n];
+        const char* path = chunks->names[p->name_id];
+        if (manifest_hash_section(actual, &cache, path, p->offset, p->length,
+                buf, buf_size, prg, &bytes) != 0)
+        {
+            errors++;
+        }
+    }
+    mfu_progress_complete(&prg, 0, bytes);
+    mfu_file_cache_free(&cache);
+    mfu_free(&buf);
+    mfu_file_chunk_array_free(&chunks);
+    mfu_flist_free(&list);
+
+    /* add up sums for each file, and compare with what we expect */
+    manifest_combine(actual);
+    qsort(expected->elems, (size_t)expected->count, sizeof(manifest_elem_t), manifest_elem_cmp);
+    uint64_t mismatches = 0;
+    uint64_t i;
+    for (i = 0; i < expected->count; i++) {
+        const manifest_elem_t* want = &expected->elems[i];
+        const manifest_elem_t* got = (const manifest_elem_t*) bsearch(
+            want->name, actual->elems, (size_t)actual->count,
+            sizeof(manifest_elem_t), manifest_name_cmp);
+        if (got == NULL) {
+            /* failed to open file, already reported */
+            mismatches++;
+        } else if (got->size != want->size) {
+            MFU_LOG(MFU_LOG_ERR, "Size mismatch: `%s' is %" PRIu64 " bytes, expected %" PRIu64,
+                want->name, got->size, want->size);
+            mismatches++;
+        } else if (got->sum != want->sum) {
+            MFU_LOG(MFU_LOG_ERR, "Checksum mismatch: `%s'", want->name);
+            mismatches++;
+        }
+    }
+
+    /* sum counts across ranks */
+    uint64_t values[4], sums[4];
+    values[0] = expected->count;
+    values[1] = mismatches;
+    values[2] = errors;
+    values[3] = bytes;
+    MPI_Allreduce(values, sums, 4, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+
+    double secs = MPI_Wtime() - start;
+    if (rank == 0) {
+        double rate = 0.0;
+        if (secs > 0.0) {
+            rate = (double)sums[3] / secs;
+        }
+        double size_tmp, rate_tmp;
+        const char* size_units;
+        const char* rate_units;
+        mfu_format_bytes(sums[3], &size_tmp, &size_units);
+        mfu_format_bw(rate, &rate_tmp, &rate_units);
+        MFU_LOG(MFU_LOG_INFO, "Verified %" PRIu64 " files, %.3lf %s in %.3lf seconds (%.3lf %s)",
+            sums[0], size_tmp, size_units, secs, rate_tmp, rate_units);
+        if (sums[1] > 0 || sums[2] > 0) {
+            MFU_LOG(MFU_LOG_ERR, "%" PRIu64 " files do not match the manifest", sums[1]);
+        }
+    }
+
+    mfu_manifest_free(&actual);
+    mfu_manifest_free(&expected);
+
+    return (sums[1] > 0 || sums[2] > 0) ? 1 : 0;
+}
@@ -26,6 +26,10 @@
  * Global functions used by remove routines
  ****************************/
 
+/* progress of current remove operation */
+static mfu_progress* remove_prg;  /* progress messages, NULL if disabled */
+static uint64_t remove_items;     /* number of items local process has removed */
+
 /* removes name by calling rmdir, unlink, or remove depending
  * on item type */
 static void remove_type(char type, const char* name)
@@ -62,6 +66,10 @@ static void remove_type(char type, const char* name)
                  );
     }
 
+    /* report progress */
+    remove_items++;
+    mfu_progress_update(remove_prg, remove_items, 0);
+
     return;
 }
 
@@ -358,34 +366,30 @@ static void remove_sort(mfu_flist list, uint64_t* rmcount)
         return;
     }
 
-    /* get maximum file name and number of items */
-    int chars = (int) mfu_flist_file_max_name(list);
+    /* get number of items */
     uint64_t my_count = mfu_flist_size(list);
 
-    /* create key datatype (filename) and comparison op */
-    MPI_Datatype dt_key;
-    DTCMP_Op op_str;
-    DTCMP_Str_create_ascend(chars, &dt_key, &op_str);
-
-    /* create keysat datatype (filename + type) */
-    MPI_Datatype types[2], dt_keysat;
-    types[0] = dt_key;
-    types[1] = MPI_CHAR;
-    DTCMP_Type_create_series(2, types, &dt_keysat);
+    /* compute size of records, each holds the filename and type,
+     * so records are only as long as the names they hold */
+    size_t sendbufsize = 0;
+    uint64_t idx;
+    for (idx = 0; idx < my_count; idx++) {
+        const char* name = mfu_flist_file_get_name(list, idx);
+        sendbufsize += 4 + strlen(name) + 2;
+    }
 
     /* allocate send buffer */
-    int sendcount = (int) my_count;
-    size_t sendbufsize = (size_t)(sendcount * (chars + 1));
     char* sendbuf = (char*) MFU_MALLOC(sendbufsize);
 
     /* copy data into buffer */
     char* ptr = sendbuf;
-    uint64_t idx;
     for (idx = 0; idx < my_count; idx++) {
-        /* encode the filename first */
+        /* encode the record length and filename first */
         const char* name = mfu_flist_file_get_name(list, idx);
+        size_t len = strlen(name) + 1;
+        mfu_pack_uint32(&ptr, (uint32_t)(len + 1));
         strcpy(ptr, name);
-        ptr += chars;
+        ptr += len;
 
         /* last character encodes item type */
         mfu_filetype type = mfu_flist_file_get_type(list, idx);
@@ -402,25 +406,25 @@ static void remove_sort(mfu_flist list, uint64_t* rmcount)
     }
 
     /* sort items */
-    void* recvbuf;
-    int recvcount;
-    DTCMP_Handle handle;
-    DTCMP_Sortz(
-        sendbuf, sendcount, &recvbuf, &recvcount,
-        dt_key, dt_keysat, op_str, DTCMP_FLAG_NONE, MPI_COMM_WORLD, &handle
-    );
+    uint64_t recvcount;
+    size_t recvbytes;
+    char* recvbuf = mfu_flist_sort_strings(sendbuf, my_count, 0, &recvcount, &recvbytes);
 
     /* delete data */
-    int delcount = 0;
-    ptr = (char*)recvbuf;
+    uint64_t delcount = 0;
+    const char* cptr = recvbuf;
     while (delcount < recvcount) {
+        /* skip record length */
+        uint32_t len;
+        mfu_unpack_uint32(&cptr, &len);
+
         /* get item name */
-        char* name = ptr;
-        ptr += chars;
+        const char* name = cptr;
+        cptr += strlen(name) + 1;
 
         /* get item type */
-        char type = ptr[0];
-        ptr++;
+        char type = cptr[0];
+        cptr++;
 
         /* delete item */
         remove_type(type, name);
@@ -428,21 +432,14 @@ static void remove_sort(mfu_flist list, uint64_t* rmcount)
     }
 
     /* record number of items we deleted */
-    *rmcount = (uint64_t) delcount;
+    *rmcount = delcount;
 
     /* free output data */
-    DTCMP_Free(&handle);
+    mfu_free(&recvbuf);
 
     /* free our send buffer */
     mfu_free(&sendbuf);
 
-    /* free key comparison operation */
-    DTCMP_Op_free(&op_str);
-
-    /* free datatypes */
-    MPI_Type_free(&dt_keysat);
-    MPI_Type_free(&dt_key);
-
     return;
 }
 
@@ -690,6 +687,11 @@ void mfu_flist_unlink(mfu_flist flist, bool traceless)
     }
 #endif
 
+    /* print progress while we remove items */
+    remove_items = 0;
+    remove_prg = mfu_progress_start(mfu_progress_timeout, "Removed",
+        size, 0, MPI_COMM_WORLD);
+
     /* now remove files starting from deepest level */
     for (level = levels - 1; level >= 0; level--) {
         double start = MPI_Wtime();
@@ -730,6 +732,9 @@ void mfu_flist_unlink(mfu_flist flist, bool traceless)
         }
     }
 
+    /* wait for all procs to finish removing */
+    mfu_progress_complete(&remove_prg, remove_items, 0);
+
     /* if traceless, restore the stat of each item's pdir */
     if (traceless) {
         mfu_flist newlist = mfu_flist_spread(pstatlist);
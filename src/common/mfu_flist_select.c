@@ -0,0 +1,437 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <limits.h>
+#include <inttypes.h>
+
+#include "mfu.h"
+
+/****************************************
+ * Functions to select items by rank order without a full sort
+ ***************************************/
+
+typedef enum {
+    SELECT_NULL = 0,
+    SELECT_SIZE,
+    SELECT_ATIME,
+    SELECT_MTIME,
+    SELECT_CTIME,
+    SELECT_UID,
+    SELECT_GID,
+} select_field;
+
+/* convert field name to field type, returns SELECT_NULL if invalid */
+static select_field select_parse(const char* name)
+{
+    if (strcmp(name, "size") == 0) {
+        return SELECT_SIZE;
+    } else if (strcmp(name, "atime") == 0) {
+        return SELECT_ATIME;
+    } else if (strcmp(name, "mtime") == 0) {
+        return SELECT_MTIME;
+    } else if (strcmp(name, "ctime") == 0) {
+        return SELECT_CTIME;
+    } else if (strcmp(name, "uid") == 0) {
+        return SELECT_UID;
+    } else if (strcmp(name, "gid") == 0) {
+        return SELECT_GID;
+    }
+    return SELECT_NULL;
+}
+
+/* return value of field for given item */
+static uint64_t select_value(mfu_flist flist, uint64_t idx, select_field field)
+{
+    switch (field) {
+        case SELECT_SIZE:
+            return mfu_flist_file_get_size(flist, idx);
+        case SELECT_ATIME:
+            return mfu_flist_file_get_atime(flist, idx);
+        case SELECT_MTIME:
+            return mfu_flist_file_get_mtime(flist, idx);
+        case SELECT_CTIME:
+            return mfu_flist_file_get_ctime(flist, idx);
+        case SELECT_UID:
+            return mfu_flist_file_get_uid(flist, idx);
+        case SELECT_GID:
+            return mfu_flist_file_get_gid(flist, idx);
+        case SELECT_NULL:
+        default:
+            return 0;
+    }
+}
+
+/* returns 1 if field names a valid select field, with an optional
+ * leading '-' if allow_minus is set, and 0 otherwise */
+int mfu_flist_select_field_valid(const char* field, int allow_minus)
+{
+    if (field == NULL) {
+        return 0;
+    }
+    if (allow_minus && field[0] == '-') {
+        field++;
+    }
+    return (select_parse(field) != SELECT_NULL);
+}
+
+/* candidates for top-k are stored as an 8-byte score followed by
+ * the packed list element, we always keep the k largest scores */
+
+/* sort candidate records by score, largest first */
+static int select_cmp_score(const void* a, const void* b)
+{
+    uint64_t score_a, score_b;
+    memcpy(&score_a, a, 8);
+    memcpy(&score_b, b, 8);
+    if (score_a > score_b) {
+        return -1;
+    } else if (score_a < score_b) {
+        return 1;
+    }
+    return 0;
+}
+
+/* move element at position i down a min-heap of scores */
+static void select_heap_down(uint64_t* scores, uint64_t* idxs, uint64_t count, uint64_t i)
+{
+    while (1) {
+        uint64_t left  = 2 * i + 1;
+        uint64_t right = left + 1;
+        uint64_t min = i;
+        if (left < count && scores[left] < scores[min]) {
+            min = left;
+        }
+        if (right < count && scores[right] < scores[min]) {
+            min = right;
+        }
+        if (min == i) {
+            break;
+        }
+        uint64_t tmp_score = scores[i];
+        uint64_t tmp_idx   = idxs[i];
+        scores[i] = scores[min];
+        idxs[i]   = idxs[min];
+        scores[min] = tmp_score;
+        idxs[min]   = tmp_idx;
+        i = min;
+    }
+    return;
+}
+
+/* return a new list holding the k items with the largest values of
+ * the given field, or smallest if field is preceded by '-', items are
+ * ordered from first to last and all are placed on rank 0 */
+mfu_flist mfu_flist_topk(mfu_flist flist, const char* field, uint64_t k)
+{
+    /* get our rank and the size of comm_world */
+    int rank, ranks;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+
+    /* create list to hold result */
+    mfu_flist topk = mfu_flist_subset(flist);
+
+    /* determine whether we want largest or smallest values */
+    int smallest = 0;
+    if (field != NULL && field[0] == '-') {
+        smallest = 1;
+        field++;
+    }
+
+    /* check that we have a valid field */
+    select_field type = SELECT_NULL;
+    if (field != NULL) {
+        type = select_parse(field);
+    }
+    if (type == SELECT_NULL || !mfu_flist_have_detail(flist) || k == 0) {
+        if (rank == 0 && k > 0) {
+            MFU_LOG(MFU_LOG_ERR, "Invalid field for top-k query: %s", field);
+        }
+        mfu_flist_summarize(topk);
+        return topk;
+    }
+
+    /* we can't return more items than the list holds, so don't
+     * allocate room for more than that however large k is */
+    uint64_t size = mfu_flist_size(flist);
+    uint64_t all_size;
+    MPI_Allreduce(&size, &all_size, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+    if (k > all_size) {
+        k = all_size;
+    }
+
+    /* we send candidates with int record counts */
+    if (k > INT_MAX) {
+        MFU_ABORT(-1, "Too many items for top-k query: %" PRIu64, k);
+    }
+
+    /* select up to k local items with largest scores using a min-heap,
+     * to select smallest values we invert the value to get a score */
+    uint64_t max = (k < size) ? k : size;
+    uint64_t* scores = (uint64_t*) MFU_MALLOC(max * sizeof(uint64_t));
+    uint64_t* idxs   = (uint64_t*) MFU_MALLOC(max * sizeof(uint64_t));
+    uint64_t count = 0;
+    uint64_t idx;
+    for (idx = 0; idx < size; idx++) {
+        uint64_t score = select_value(flist, idx, type);
+        if (smallest) {
+            score = ~score;
+        }
+
+        if (count < max) {
+            /* heap not full yet, add item and build heap once full */
+            scores[count] = score;
+            idxs[count]   = idx;
+            count++;
+            if (count == max) {
+                uint64_t i = max / 2;
+                while (i > 0) {
+                    i--;
+                    select_heap_down(scores, idxs, count, i);
+                }
+            }
+        } else if (score > scores[0]) {
+            /* replace smallest score in heap */
+            scores[0] = score;
+            idxs[0]   = idx;
+            select_heap_down(scores, idxs, count, 0);
+        }
+    }
+
+    /* pack our candidates into a buffer, each record is a score
+     * followed by the packed item */
+    size_t pack_size = mfu_flist_file_pack_size(flist);
+    size_t rec_size = 8 + pack_size;
+    char* buf = (char*) MFU_MALLOC(count * rec_size);
+    uint64_t i;
+    for (i = 0; i < count; i++) {
+        char* ptr = buf + i * rec_size;
+        memcpy(ptr, &scores[i], 8);
+        mfu_flist_file_pack(ptr + 8, flist, idxs[i]);
+    }
+    mfu_free(&idxs);
+    mfu_free(&scores);
+
+    /* send whole records, so counts are in records rather than bytes */
+    MPI_Datatype dt_rec;
+    MPI_Type_contiguous((int)rec_size, MPI_BYTE, &dt_rec);
+    MPI_Type_commit(&dt_rec);
+
+    /* merge candidates up a binomial tree to rank 0, at each step we
+     * keep just the k best of our candidates and our child's */
+    int step = 1;
+    while (step < ranks) {
+        if (rank % (2 * step) != 0) {
+            /* send our candidates to our parent and stop */
+            int parent = rank - step;
+            MPI_Send(&count, 1, MPI_UINT64_T, parent, 0, MPI_COMM_WORLD);
+            MPI_Send(buf, (int)count, dt_rec, parent, 0, MPI_COMM_WORLD);
+            count = 0;
+            break;
+        }
+
+        int child = rank + step;
+        if (child < ranks) {
+            /* receive candidates from child and append to our own */
+            uint64_t child_count;
+            MPI_Recv(&child_count, 1, MPI_UINT64_T, child, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+            char* newbuf = (char*) MFU_MALLOC((count + child_count) * rec_size);
+            if (count > 0) {
+                memcpy(newbuf, buf, count * rec_size);
+            }
+            mfu_free(&buf);
+            buf = newbuf;
+            char* ptr = buf + count * rec_size;
+            MPI_Recv(ptr, (int)child_count, dt_rec, child, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+            count += child_count;
+
+            /* keep the k best */
+            qsort(buf, (size_t)count, rec_size, select_cmp_score);
+            if (count > k) {
+                count = k;
+            }
+        }
+
+        step *= 2;
+    }
+
+    MPI_Type_free(&dt_rec);
+
+    /* rank 0 now has the final candidates, sort them and insert into list */
+    if (rank == 0) {
+        qsort(buf, (size_t)count, rec_size, select_cmp_score);
+        for (i = 0; i < count; i++) {
+            char* ptr = buf + i * rec_size;
+            mfu_flist_file_unpack(ptr + 8, topk);
+        }
+    }
+    mfu_free(&buf);
+
+    /* compute global summary */
+    mfu_flist_summarize(topk);
+
+    return topk;
+}
+
+/* sort values in ascending order */
+static int select_cmp_uint64(const void* a, const void* b)
+{
+    uint64_t val_a = *(const uint64_t*) a;
+    uint64_t val_b = *(const uint64_t*) b;
+    if (val_a < val_b) {
+        return -1;
+    } else if (val_a > val_b) {
+        return 1;
+    }
+    return 0;
+}
+
+/* return number of values in sorted array that are <= val */
+static uint64_t select_count_le(const uint64_t* vals, uint64_t count, uint64_t val)
+{
+    uint64_t low  = 0;
+    uint64_t high = count;
+    while (low < high) {
+        uint64_t mid = low + (high - low) / 2;
+        if (vals[mid] <= val) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+/* compute value of field at each of nq quantiles given in qs, where
+ * each quantile is in the range [0.0, 1.0], values are returned in
+ * vals on all ranks, for each quantile q we return the smallest value
+ * v such that at least ceil(q * N) items have values <= v */
+int mfu_flist_quantiles(mfu_flist flist, const char* field, int nq, const double* qs, uint64_t* vals)
+{
+    int i;
+
+    /* get our rank */
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+    /* check that we have a valid field */
+    select_field type = SELECT_NULL;
+    if (field != NULL) {
+        type = select_parse(field);
+    }
+    if (type == SELECT_NULL || !mfu_flist_have_detail(flist)) {
+        if (rank == 0) {
+            MFU_LOG(MFU_LOG_ERR, "Invalid field for quantile query: %s", field);
+        }
+        return MFU_FAILURE;
+    }
+
+    /* sort our values locally, so we can count values below a
+     * given value with a binary search */
+    uint64_t size = mfu_flist_size(flist);
+    uint64_t* values = (uint64_t*) MFU_MALLOC(size * sizeof(uint64_t));
+    uint64_t idx;
+    for (idx = 0; idx < size; idx++) {
+        values[idx] = select_value(flist, idx, type);
+    }
+    qsort(values, (size_t)size, sizeof(uint64_t), select_cmp_uint64);
+
+    /* get total number of values and global min and max */
+    uint64_t total;
+    MPI_Allreduce(&size, &total, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+
+    uint64_t min = (size > 0) ? values[0] : UINT64_MAX;
+    uint64_t max = (size > 0) ? values[size - 1] : 0;
+    uint64_t global_min, global_max;
+    MPI_Allreduce(&min, &global_min, 1, MPI_UINT64_T, MPI_MIN, MPI_COMM_WORLD);
+    MPI_Allreduce(&max, &global_max, 1, MPI_UINT64_T, MPI_MAX, MPI_COMM_WORLD);
+
+    /* nothing to do for an empty list */
+    if (total == 0) {
+        for (i = 0; i < nq; i++) {
+            vals[i] = 0;
+        }
+        mfu_free(&values);
+        return MFU_SUCCESS;
+    }
+
+    /* compute target rank of each quantile and initialize search range */
+    uint64_t* targets = (uint64_t*) MFU_MALLOC((size_t)nq * sizeof(uint64_t));
+    uint64_t* lows    = (uint64_t*) MFU_MALLOC((size_t)nq * sizeof(uint64_t));
+    uint64_t* highs   = (uint64_t*) MFU_MALLOC((size_t)nq * sizeof(uint64_t));
+    uint64_t* counts  = (uint64_t*) MFU_MALLOC((size_t)nq * sizeof(uint64_t));
+    uint64_t* all_counts = (uint64_t*) MFU_MALLOC((size_t)nq * sizeof(uint64_t));
+    for (i = 0; i < nq; i++) {
+        double q = qs[i];
+        if (q < 0.0) {
+            q = 0.0;
+        }
+        if (q > 1.0) {
+            q = 1.0;
+        }
+        uint64_t target = (uint64_t)(q * (double)total);
+        if ((double)target < q * (double)total) {
+            target++;
+        }
+        if (target < 1) {
+            target = 1;
+        }
+        if (target > total) {
+            target = total;
+        }
+        targets[i] = target;
+        lows[i]    = global_min;
+        highs[i]   = global_max;
+    }
+
+    /* bisect on value for all quantiles at once, every rank
+     * computes the same ranges so all agree on when to stop,
+     * this takes at most 64 rounds of small allreduce calls */
+    int done = 0;
+    while (!done) {
+        /* count our values at or below midpoint of each range */
+        done = 1;
+        for (i = 0; i < nq; i++) {
+            uint64_t mid = lows[i] + (highs[i] - lows[i]) / 2;
+            counts[i] = select_count_le(values, size, mid);
+            if (lows[i] < highs[i]) {
+                done = 0;
+            }
+        }
+        if (done) {
+            break;
+        }
+
+        /* sum counts across ranks */
+        MPI_Allreduce(counts, all_counts, nq, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+
+        /* narrow range for each quantile */
+        for (i = 0; i < nq; i++) {
+            if (lows[i] < highs[i]) {
+                uint64_t mid = lows[i] + (highs[i] - lows[i]) / 2;
+                if (all_counts[i] >= targets[i]) {
+                    highs[i] = mid;
+                } else {
+                    lows[i] = mid + 1;
+                }
+            }
+        }
+    }
+
+    /* return values to caller */
+    for (i = 0; i < nq; i++) {
+        vals[i] = lows[i];
+    }
+
+    /* free memory */
+    mfu_free(&all_counts);
+    mfu_free(&counts);
+    mfu_free(&highs);
+    mfu_free(&lows);
+    mfu_free(&targets);
+    mfu_free(&values);
+
+    return MFU_SUCCESS;
+}
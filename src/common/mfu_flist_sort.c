@@ -19,6 +19,7 @@
 #include "libcircle.h"
 #include "dtcmp.h"
 #include "mfu.h"
+#include "mfu_flist_internal.h"
 
 typedef enum {
     NULLFIELD = 0,
@@ -33,201 +34,415 @@ typedef enum {
     FILESIZE,
 } sort_field;
 
-/* routine for sorting strings in ascending order */
-static int my_strcmp(const void* a, const void* b)
+/****************************************
+ * Sort variable-length string records
+ ***************************************/
+
+/* Records are ordered by the NUL-terminated string at the start of
+ * each record.  Rather than padding every key to the longest name in
+ * the list, each record is indexed by an 8-byte prefix of its string,
+ * and full strings are only compared when prefixes match.  Records
+ * are exchanged with a sample sort, so memory and bandwidth follow
+ * the actual string lengths. */
+
+#define SORT_STR_SAMPLES (128) /* max number of samples taken per rank */
+#define SORT_STR_UNIT     (64)  /* records for each rank are sent in units of this many bytes */
+
+/* index entry for a record */
+typedef struct {
+    uint64_t prefix; /* first 8 bytes of string in big-endian order */
+    const char* str; /* pointer to string, record length precedes it */
+    size_t size;     /* total bytes in record including length field */
+} sort_str_t;
+
+/* qsort does not take a context parameter, so we record the sort
+ * direction here before calling it */
+static int sort_str_descend = 0;
+
+/* encode first 8 bytes of string into an integer so that comparing
+ * integers orders strings the same as strcmp */
+static uint64_t sort_str_prefix(const char* str)
 {
-    return strcmp((const char*)a, (const char*)b);
+    uint64_t val = 0;
+    int done = 0;
+    int i;
+    for (i = 0; i < 8; i++) {
+        unsigned char c = 0;
+        if (!done) {
+            c = (unsigned char) str[i];
+            if (c == 0) {
+                done = 1;
+            }
+        }
+        val = (val << 8) | (uint64_t) c;
+    }
+    return val;
 }
 
-static int my_strcmp_rev(const void* a, const void* b)
+static int sort_str_cmp(const void* a, const void* b)
 {
-    return strcmp((const char*)b, (const char*)a);
+    const sort_str_t* item_a = (const sort_str_t*) a;
+    const sort_str_t* item_b = (const sort_str_t*) b;
+
+    int rc;
+    if (item_a->prefix < item_b->prefix) {
+        rc = -1;
+    } else if (item_a->prefix > item_b->prefix) {
+        rc = 1;
+    } else {
+        rc = strcmp(item_a->str, item_b->str);
+    }
+
+    return sort_str_descend ? -rc : rc;
 }
 
-static int sort_files_readdir(const char* sortfields, mfu_flist* pflist)
+/* build and sort index for count records in buf */
+static sort_str_t* sort_str_index(const char* buf, uint64_t count, int descend)
 {
-    /* get list from caller */
-    mfu_flist flist = *pflist;
+    sort_str_t* items = (sort_str_t*) MFU_MALLOC(count * sizeof(sort_str_t));
+
+    const char* ptr = buf;
+    uint64_t idx;
+    for (idx = 0; idx < count; idx++) {
+        uint32_t len;
+        mfu_unpack_uint32(&ptr, &len);
+        items[idx].prefix = sort_str_prefix(ptr);
+        items[idx].str    = ptr;
+        items[idx].size   = 4 + (size_t) len;
+        ptr += len;
+    }
 
-    /* create a new list as subset of original list */
-    mfu_flist flist2 = mfu_flist_subset(flist);
+    sort_str_descend = descend;
+    qsort(items, (size_t)count, sizeof(sort_str_t), sort_str_cmp);
 
-    uint64_t incount = mfu_flist_size(flist);
-    uint64_t chars   = mfu_flist_file_max_name(flist);
+    return items;
+}
 
-    /* create datatype for packed file list element */
-    MPI_Datatype dt_sat;
-    size_t bytes = mfu_flist_file_pack_size(flist);
-    MPI_Type_contiguous((int)bytes, MPI_BYTE, &dt_sat);
+/* given our sorted index, gather samples from all ranks and choose
+ * ranks-1 splitters, returns buffer holding splitter strings which
+ * the splitter entries point into */
+static char* sort_str_splitters(const sort_str_t* items, uint64_t count, int descend, sort_str_t* splitters, int* nsplitters)
+{
+    int i;
 
-    /* get our rank and the size of comm_world */
-    int rank, ranks;
-    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    /* get the size of comm_world */
+    int ranks;
+    MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+
+    /* determine number of samples we'll contribute */
+    uint64_t samples = (uint64_t)(ranks - 1);
+    if (samples > SORT_STR_SAMPLES) {
+        samples = SORT_STR_SAMPLES;
+    }
+    if (samples > count) {
+        samples = count;
+    }
+
+    /* pack evenly spaced strings from our sorted items */
+    size_t sample_bytes = 0;
+    uint64_t s;
+    for (s = 0; s < samples; s++) {
+        const char* str = items[(s * count) / samples].str;
+        sample_bytes += strlen(str) + 1;
+    }
+
+    char* sendbuf = (char*) MFU_MALLOC(sample_bytes);
+    char* ptr = sendbuf;
+    for (s = 0; s < samples; s++) {
+        const char* str = items[(s * count) / samples].str;
+        strcpy(ptr, str);
+        ptr += strlen(str) + 1;
+    }
+
+    /* gather samples from all ranks */
+    int sendsize = (int) sample_bytes;
+    int* recvsizes = (int*) MFU_MALLOC((size_t)ranks * sizeof(int));
+    int* recvdisps = (int*) MFU_MALLOC((size_t)ranks * sizeof(int));
+    MPI_Allgather(&sendsize, 1, MPI_INT, recvsizes, 1, MPI_INT, MPI_COMM_WORLD);
+
+    size_t recvbytes = 0;
+    for (i = 0; i < ranks; i++) {
+        recvdisps[i] = (int) recvbytes;
+        recvbytes += (size_t) recvsizes[i];
+    }
+
+    char* samplebuf = (char*) MFU_MALLOC(recvbytes);
+    MPI_Allgatherv(
+        sendbuf, sendsize, MPI_BYTE,
+        samplebuf, recvsizes, recvdisps, MPI_BYTE, MPI_COMM_WORLD
+    );
+
+    /* index and sort the samples, every rank does this on the same data */
+    size_t total = 0;
+    ptr = samplebuf;
+    while (ptr < samplebuf + recvbytes) {
+        total++;
+        ptr += strlen(ptr) + 1;
+    }
+
+    sort_str_t* sample_items = (sort_str_t*) MFU_MALLOC(total * sizeof(sort_str_t));
+    total = 0;
+    ptr = samplebuf;
+    while (ptr < samplebuf + recvbytes) {
+        sample_items[total].prefix = sort_str_prefix(ptr);
+        sample_items[total].str    = ptr;
+        sample_items[total].size   = 0;
+        total++;
+        ptr += strlen(ptr) + 1;
+    }
+
+    sort_str_descend = descend;
+    qsort(sample_items, total, sizeof(sort_str_t), sort_str_cmp);
+
+    /* pick evenly spaced splitters, if there are no samples
+     * then all ranks are empty and we'll have nothing to send */
+    *nsplitters = 0;
+    if (total > 0) {
+        for (i = 1; i < ranks; i++) {
+            size_t pos = ((size_t)i * total) / (size_t)ranks;
+            splitters[i - 1] = sample_items[pos];
+        }
+        *nsplitters = ranks - 1;
+    }
+
+    /* free memory */
+    mfu_free(&sample_items);
+    mfu_free(&recvdisps);
+    mfu_free(&recvsizes);
+    mfu_free(&sendbuf);
+
+    return samplebuf;
+}
+
+/* sort variable-length records across all ranks by the NUL-terminated
+ * string at the start of each record, records in inbuf are encoded
+ * as a uint32_t length followed by that many bytes, returns a newly
+ * allocated buffer holding the records assigned to this rank in
+ * sorted order using the same encoding */
+char* mfu_flist_sort_strings(
+    const char* inbuf,
+    uint64_t count,
+    int descend,
+    uint64_t* outcount,
+    size_t* outbytes)
+{
+    int i;
+
+    /* get the size of comm_world */
+    int ranks;
     MPI_Comm_size(MPI_COMM_WORLD, &ranks);
 
-    /* build type for file path */
-    MPI_Datatype dt_filepath;
-    MPI_Type_contiguous((int)chars, MPI_CHAR, &dt_filepath);
-    MPI_Type_commit(&dt_filepath);
+    /* sort our records locally */
+    sort_str_t* items = sort_str_index(inbuf, count, descend);
+
+    /* choose splitters */
+    int nsplitters;
+    sort_str_t* splitters = (sort_str_t*) MFU_MALLOC((size_t)ranks * sizeof(sort_str_t));
+    char* samplebuf = sort_str_splitters(items, count, descend, splitters, &nsplitters);
+
+    /* copy records to send buffer in sorted order, and compute number
+     * of bytes to send to each rank, items up to and including
+     * splitter i go to rank i, records vary in length so we can't
+     * count them with a datatype, instead we pad the records for
+     * each rank to a multiple of SORT_STR_UNIT bytes and count units,
+     * which keeps counts within an int for much larger lists */
+    size_t bytes = 0;
+    uint64_t idx;
+    for (idx = 0; idx < count; idx++) {
+        bytes += items[idx].size;
+    }
+    bytes += (size_t)ranks * SORT_STR_UNIT;
+    char* sendbuf = (char*) MFU_MALLOC(bytes);
+
+    uint64_t* sendsizes = (uint64_t*) MFU_MALLOC((size_t)ranks * sizeof(uint64_t));
+    uint64_t* recvsizes = (uint64_t*) MFU_MALLOC((size_t)ranks * sizeof(uint64_t));
+    int* sendunits = (int*) MFU_MALLOC((size_t)ranks * sizeof(int));
+    int* senddisps = (int*) MFU_MALLOC((size_t)ranks * sizeof(int));
+    int* recvunits = (int*) MFU_MALLOC((size_t)ranks * sizeof(int));
+    int* recvdisps = (int*) MFU_MALLOC((size_t)ranks * sizeof(int));
+
+    sort_str_descend = descend;
+    uint64_t sendtotal = 0;
+    idx = 0;
+    for (i = 0; i < ranks; i++) {
+        char* start = sendbuf + sendtotal * SORT_STR_UNIT;
+        char* ptr = start;
+        while (idx < count &&
+               (i >= nsplitters || sort_str_cmp(&items[idx], &splitters[i]) <= 0))
+        {
+            /* record length field immediately precedes the string */
+            memcpy(ptr, items[idx].str - 4, items[idx].size);
+            ptr += items[idx].size;
+            idx++;
+        }
+
+        sendsizes[i] = (uint64_t)(ptr - start);
+        uint64_t units = (sendsizes[i] + SORT_STR_UNIT - 1) / SORT_STR_UNIT;
+        sendunits[i] = (int) units;
+        senddisps[i] = (int) sendtotal;
+        sendtotal += units;
+    }
+
+    /* exchange byte counts, so we can drop the padding on receipt */
+    MPI_Alltoall(sendsizes, 1, MPI_UINT64_T, recvsizes, 1, MPI_UINT64_T, MPI_COMM_WORLD);
 
-    /* build comparison op for filenames */
-    DTCMP_Op op_filepath;
-    if (DTCMP_Op_create(dt_filepath, my_strcmp, &op_filepath) != DTCMP_SUCCESS) {
-        MFU_ABORT(1, "Failed to create sorting operation for filepath");
+    uint64_t recvtotal = 0;
+    for (i = 0; i < ranks; i++) {
+        uint64_t units = (recvsizes[i] + SORT_STR_UNIT - 1) / SORT_STR_UNIT;
+        recvunits[i] = (int) units;
+        recvdisps[i] = (int) recvtotal;
+        recvtotal += units;
+    }
+    if (sendtotal > INT_MAX || recvtotal > INT_MAX) {
+        MFU_ABORT(-1, "Too many bytes to sort: sending %llu, receiving %llu",
+            (unsigned long long) (sendtotal * SORT_STR_UNIT),
+            (unsigned long long) (recvtotal * SORT_STR_UNIT));
     }
 
-    /* build comparison op for filenames */
-    DTCMP_Op op_filepath_rev;
-    if (DTCMP_Op_create(dt_filepath, my_strcmp_rev, &op_filepath_rev) != DTCMP_SUCCESS) {
-        MFU_ABORT(1, "Failed to create reverse sorting operation for filepath");
+    /* exchange records */
+    char* recvbuf = (char*) MFU_MALLOC(recvtotal * SORT_STR_UNIT);
+    MPI_Datatype dt_unit;
+    MPI_Type_contiguous(SORT_STR_UNIT, MPI_BYTE, &dt_unit);
+    MPI_Type_commit(&dt_unit);
+    MPI_Alltoallv(
+        sendbuf, sendunits, senddisps, dt_unit,
+        recvbuf, recvunits, recvdisps, dt_unit, MPI_COMM_WORLD
+    );
+    MPI_Type_free(&dt_unit);
+
+    /* squeeze out padding, sections only move toward the front */
+    size_t recvbytes = 0;
+    for (i = 0; i < ranks; i++) {
+        memmove(recvbuf + recvbytes, recvbuf + (size_t)recvdisps[i] * SORT_STR_UNIT, (size_t)recvsizes[i]);
+        recvbytes += (size_t)recvsizes[i];
     }
 
-    /* TODO: process sort fields */
-    const int MAXFIELDS = 1;
-    MPI_Datatype types[MAXFIELDS];
-    DTCMP_Op ops[MAXFIELDS];
-    sort_field fields[MAXFIELDS];
-    size_t lengths[MAXFIELDS];
-    int nfields = 0;
-    for (nfields = 0; nfields < MAXFIELDS; nfields++) {
-        types[nfields]   = MPI_DATATYPE_NULL;
-        ops[nfields]     = DTCMP_OP_NULL;
+    /* count the records we received */
+    uint64_t recvcount = 0;
+    const char* cptr = recvbuf;
+    while (cptr < recvbuf + recvbytes) {
+        uint32_t len;
+        mfu_unpack_uint32(&cptr, &len);
+        cptr += len;
+        recvcount++;
     }
-    nfields = 0;
+
+    /* sort received records and copy them to output buffer in order */
+    sort_str_t* recv_items = sort_str_index(recvbuf, recvcount, descend);
+    char* outbuf = (char*) MFU_MALLOC(recvbytes);
+    char* ptr = outbuf;
+    for (idx = 0; idx < recvcount; idx++) {
+        memcpy(ptr, recv_items[idx].str - 4, recv_items[idx].size);
+        ptr += recv_items[idx].size;
+    }
+
+    /* free memory */
+    mfu_free(&recv_items);
+    mfu_free(&recvbuf);
+    mfu_free(&recvdisps);
+    mfu_free(&recvunits);
+    mfu_free(&senddisps);
+    mfu_free(&sendunits);
+    mfu_free(&recvsizes);
+    mfu_free(&sendsizes);
+    mfu_free(&sendbuf);
+    mfu_free(&samplebuf);
+    mfu_free(&splitters);
+    mfu_free(&items);
+
+    *outcount = recvcount;
+    *outbytes = recvbytes;
+    return outbuf;
+}
+
+static int sort_files_readdir(const char* sortfields, mfu_flist* pflist)
+{
+    /* get list from caller */
+    mfu_flist flist = *pflist;
+
+    /* get our rank */
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+    /* process sort fields, we only have names without stat data,
+     * so any fields after the first are redundant */
+    int rc = MFU_SUCCESS;
+    int have_name = 0;
+    int descend = 0;
     char* sortfields_copy = MFU_STRDUP(sortfields);
     char* token = strtok(sortfields_copy, ",");
     while (token != NULL) {
-        int valid = 1;
-        if (strcmp(token, "name") == 0) {
-            types[nfields]   = dt_filepath;
-            ops[nfields]     = op_filepath;
-            fields[nfields]  = FILENAME;
-            lengths[nfields] = chars;
-        }
-        else if (strcmp(token, "-name") == 0) {
-            types[nfields]   = dt_filepath;
-            ops[nfields]     = op_filepath_rev;
-            fields[nfields]  = FILENAME;
-            lengths[nfields] = chars;
+        if (strcmp(token, "name") == 0 || strcmp(token, "-name") == 0) {
+            if (!have_name) {
+                have_name = 1;
+                descend = (token[0] == '-');
+            }
         }
         else {
             /* invalid token */
-            valid = 0;
+            rc = MFU_FAILURE;
             if (rank == 0) {
                 MFU_LOG(MFU_LOG_ERR, "Invalid sort field: %s\n", token);
             }
         }
-        if (valid) {
-            nfields++;
-        }
-        if (nfields > MAXFIELDS) {
-            /* TODO: print warning if we have too many fields */
-            break;
-        }
         token = strtok(NULL, ",");
     }
     mfu_free(&sortfields_copy);
 
-    /* build key type */
-    MPI_Datatype dt_key;
-    if (DTCMP_Type_create_series(nfields, types, &dt_key) != DTCMP_SUCCESS) {
-        MFU_ABORT(1, "Failed to create type for key");
+    if (rc != MFU_SUCCESS) {
+        return rc;
     }
 
-    /* create sort op */
-    DTCMP_Op op_key;
-    if (DTCMP_Op_create_series(nfields, ops, &op_key) != DTCMP_SUCCESS) {
-        MFU_ABORT(1, "Failed to create sorting operation for key");
+    /* compute size of records, each holds the file name and type */
+    uint64_t incount = mfu_flist_size(flist);
+    size_t bytes = 0;
+    uint64_t idx;
+    for (idx = 0; idx < incount; idx++) {
+        const char* name = mfu_flist_file_get_name(flist, idx);
+        bytes += 4 + strlen(name) + 1 + 4;
     }
 
-    /* build keysat type */
-    MPI_Datatype dt_keysat, keysat_types[2];
-    keysat_types[0] = dt_key;
-    keysat_types[1] = dt_sat;
-    if (DTCMP_Type_create_series(2, keysat_types, &dt_keysat) != DTCMP_SUCCESS) {
-        MFU_ABORT(1, "Failed to create type for keysat");
+    /* encode records */
+    char* sortbuf = (char*) MFU_MALLOC(bytes);
+    char* ptr = sortbuf;
+    for (idx = 0; idx < incount; idx++) {
+        const char* name = mfu_flist_file_get_name(flist, idx);
+        size_t len = strlen(name) + 1;
+        mfu_pack_uint32(&ptr, (uint32_t)(len + 4));
+        strcpy(ptr, name);
+        ptr += len;
+        mfu_pack_uint32(&ptr, (uint32_t) mfu_flist_file_get_type(flist, idx));
     }
 
-    /* get extent of key type */
-    MPI_Aint key_lb, key_extent;
-    MPI_Type_get_extent(dt_key, &key_lb, &key_extent);
-
-    /* get extent of keysat type */
-    MPI_Aint keysat_lb, keysat_extent;
-    MPI_Type_get_extent(dt_keysat, &keysat_lb, &keysat_extent);
-
-    /* get extent of sat type */
-    MPI_Aint sat_lb, sat_extent;
-    MPI_Type_get_extent(dt_sat, &sat_lb, &sat_extent);
-
-    /* compute size of sort element and allocate buffer */
-    size_t sortbufsize = (size_t)keysat_extent * incount;
-    void* sortbuf = MFU_MALLOC(sortbufsize);
-
-    /* copy data into sort elements */
-    uint64_t idx = 0;
-    char* sortptr = (char*) sortbuf;
-    while (idx < incount) {
-        /* copy in access time */
-        int i;
-        for (i = 0; i < nfields; i++) {
-            if (fields[i] == FILENAME) {
-                const char* name = mfu_flist_file_get_name(flist, idx);
-                strcpy(sortptr, name);
-            }
-            sortptr += lengths[i];
-        }
-
-        /* pack file element */
-        sortptr += mfu_flist_file_pack(sortptr, flist, idx);
+    /* sort data */
+    uint64_t outcount;
+    size_t outbytes;
+    char* outbuf = mfu_flist_sort_strings(sortbuf, incount, descend, &outcount, &outbytes);
 
-        idx++;
-    }
+    /* create a new list as subset of original list */
+    mfu_flist flist2 = mfu_flist_subset(flist);
 
-    /* sort data */
-    void* outsortbuf;
-    int outsortcount;
-    DTCMP_Handle handle;
-    int sort_rc = DTCMP_Sortz(
-                      sortbuf, (int)incount, &outsortbuf, &outsortcount,
-                      dt_key, dt_keysat, op_key, DTCMP_FLAG_NONE,
-                      MPI_COMM_WORLD, &handle
-                  );
-    if (sort_rc != DTCMP_SUCCESS) {
-        MFU_ABORT(1, "Failed to sort data");
-    }
-
-    /* step through sorted data filenames */
-    idx = 0;
-    sortptr = (char*) outsortbuf;
-    while (idx < (uint64_t)outsortcount) {
-        sortptr += key_extent;
-        sortptr += mfu_flist_file_unpack(sortptr, flist2);
-        idx++;
+    /* step through sorted records and insert into new list */
+    const char* cptr = outbuf;
+    for (idx = 0; idx < outcount; idx++) {
+        uint32_t len, type;
+        mfu_unpack_uint32(&cptr, &len);
+        const char* name = cptr;
+        cptr += strlen(name) + 1;
+        mfu_unpack_uint32(&cptr, &type);
+
+        uint64_t newidx = mfu_flist_file_create(flist2);
+        mfu_flist_file_set_name(flist2, newidx, name);
+        mfu_flist_file_set_type(flist2, newidx, (mfu_filetype) type);
     }
 
     /* build summary of new list */
     mfu_flist_summarize(flist2);
 
     /* free memory */
-    DTCMP_Free(&handle);
-
-    /* free ops */
-    DTCMP_Op_free(&op_key);
-    DTCMP_Op_free(&op_filepath_rev);
-    DTCMP_Op_free(&op_filepath);
-
-    /* free types */
-    MPI_Type_free(&dt_keysat);
-    MPI_Type_free(&dt_key);
-    MPI_Type_free(&dt_filepath);
-
-    /* free input buffer holding sort elements */
+    mfu_free(&outbuf);
     mfu_free(&sortbuf);
 
-    /* free the satellite type */
-    MPI_Type_free(&dt_sat);
-
     /* return new list and free old one */
     *pflist = flist2;
     mfu_flist_free(&flist);
@@ -235,342 +450,626 @@ static int sort_files_readdir(const char* sortfields, mfu_flist* pflist)
     return MFU_SUCCESS;
 }
 
-static int sort_files_stat(const char* sortfields, mfu_flist* pflist)
+/****************************************
+ * Sort using composite byte keys
+ ***************************************/
+
+/* Each item is encoded into a single fixed-width byte key such that
+ * memcmp on two keys orders items by the requested fields.  Integers
+ * are stored big-endian, strings are NUL-padded, and the bits of
+ * fields sorted in descending order are inverted.  File names are
+ * encoded by a fixed-length prefix, and if the user did not ask to
+ * sort by name, a name prefix is appended as a final tiebreaker so
+ * that all items are ordered.  Items whose name prefixes match are
+ * resolved by comparing their full names.
+ *
+ * The list is sorted with a parallel sample sort: each rank radix
+ * sorts its items locally, splitters are chosen from a sample of
+ * items from each rank, items are exchanged with alltoallv, and each
+ * rank radix sorts the items it receives. */
+
+#define SORT_NAME_PREFIX (64) /* max bytes of file name stored in key */
+#define SORT_SAMPLES (128)    /* max number of samples taken per rank */
+#define SORT_RADIX_MIN (32)   /* use insertion sort for fewer items */
+#define SORT_MAX_FIELDS (7)   /* max number of fields user may specify */
+
+/* describes layout of sort key */
+typedef struct {
+    int nfields;                            /* number of fields in key */
+    sort_field fields[SORT_MAX_FIELDS + 1]; /* field type, plus room for name tiebreaker */
+    int descend[SORT_MAX_FIELDS + 1];       /* whether field is sorted in descending order */
+    size_t widths[SORT_MAX_FIELDS + 1];     /* number of bytes for field in key */
+    size_t keylen;                          /* total number of bytes in key */
+    size_t name_offset;                     /* offset of file name prefix in key */
+    size_t name_width;                      /* number of bytes of file name prefix */
+    int name_descend;                       /* whether names sort in descending order */
+    size_t rec_size;                        /* bytes in key plus packed list element */
+} sort_key_t;
+
+/* qsort does not take a context parameter, so we record the key
+ * description here before calling it */
+static const sort_key_t* sort_key_current = NULL;
+
+/* the packed list element that follows each key starts with a 4-byte
+ * detail flag and a 4-byte name length followed by the file name,
+ * sample records are built to match this layout */
+static const char* sort_key_name(const char* rec, const sort_key_t* key)
 {
-    /* get list from caller */
-    mfu_flist flist = *pflist;
-
-    /* create a new list as subset of original list */
-    mfu_flist flist2 = mfu_flist_subset(flist);
-
-    uint64_t incount     = mfu_flist_size(flist);
-    uint64_t chars       = mfu_flist_file_max_name(flist);
-    uint64_t chars_user  = mfu_flist_user_max_name(flist);
-    uint64_t chars_group = mfu_flist_group_max_name(flist);
-
-    /* create datatype for packed file list element */
-    MPI_Datatype dt_sat;
-    size_t bytes = mfu_flist_file_pack_size(flist);
-    MPI_Type_contiguous((int)bytes, MPI_BYTE, &dt_sat);
-
-    /* get our rank and the size of comm_world */
-    int rank, ranks;
-    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
-    MPI_Comm_size(MPI_COMM_WORLD, &ranks);
-
-    /* build type for file path */
-    MPI_Datatype dt_filepath, dt_user, dt_group;
-    MPI_Type_contiguous((int)chars,       MPI_CHAR, &dt_filepath);
-    MPI_Type_contiguous((int)chars_user,  MPI_CHAR, &dt_user);
-    MPI_Type_contiguous((int)chars_group, MPI_CHAR, &dt_group);
-    MPI_Type_commit(&dt_filepath);
-    MPI_Type_commit(&dt_user);
-    MPI_Type_commit(&dt_group);
+    return rec + key->keylen + 8;
+}
 
-    /* build comparison op for filenames */
-    DTCMP_Op op_filepath, op_user, op_group;
-    if (DTCMP_Op_create(dt_filepath, my_strcmp, &op_filepath) != DTCMP_SUCCESS) {
-        MFU_ABORT(1, "Failed to create sorting operation for filepath");
+/* encode integer in big-endian order, inverting bits if descending */
+static void sort_key_encode_uint64(char* ptr, uint64_t val, int descend)
+{
+    int i;
+    for (i = 7; i >= 0; i--) {
+        unsigned char c = (unsigned char)(val & 0xFF);
+        if (descend) {
+            c = (unsigned char) ~c;
+        }
+        ptr[i] = (char) c;
+        val >>= 8;
     }
-    if (DTCMP_Op_create(dt_user, my_strcmp, &op_user) != DTCMP_SUCCESS) {
-        MFU_ABORT(1, "Failed to create sorting operation for username");
+    return;
+}
+
+/* encode string padded with NUL to width bytes (truncating if needed),
+ * inverting bits if descending */
+static void sort_key_encode_str(char* ptr, const char* str, size_t width, int descend)
+{
+    if (str == NULL) {
+        str = "";
     }
-    if (DTCMP_Op_create(dt_group, my_strcmp, &op_group) != DTCMP_SUCCESS) {
-        MFU_ABORT(1, "Failed to create sorting operation for groupname");
+    strncpy(ptr, str, width);
+    if (descend) {
+        size_t i;
+        for (i = 0; i < width; i++) {
+            ptr[i] = (char) ~((unsigned char) ptr[i]);
+        }
     }
+    return;
+}
 
-    /* build comparison op for filenames */
-    DTCMP_Op op_filepath_rev, op_user_rev, op_group_rev;
-    if (DTCMP_Op_create(dt_filepath, my_strcmp_rev, &op_filepath_rev) != DTCMP_SUCCESS) {
-        MFU_ABORT(1, "Failed to create reverse sorting operation for groupname");
-    }
-    if (DTCMP_Op_create(dt_user, my_strcmp_rev, &op_user_rev) != DTCMP_SUCCESS) {
-        MFU_ABORT(1, "Failed to create reverse sorting operation for groupname");
+/* compare two records, comparing full file names whenever the
+ * encoded name prefixes match */
+static int sort_key_cmp(const char* a, const char* b, const sort_key_t* key)
+{
+    /* compare all fields up to and including the name prefix */
+    size_t head = key->name_offset + key->name_width;
+    int rc = memcmp(a, b, head);
+    if (rc != 0) {
+        return rc;
     }
-    if (DTCMP_Op_create(dt_group, my_strcmp_rev, &op_group_rev) != DTCMP_SUCCESS) {
-        MFU_ABORT(1, "Failed to create reverse sorting operation for groupname");
+
+    /* prefixes match, compare full names */
+    rc = strcmp(sort_key_name(a, key), sort_key_name(b, key));
+    if (rc != 0) {
+        return key->name_descend ? -rc : rc;
     }
 
-    /* TODO: process sort fields */
-    const int MAXFIELDS = 7;
-    MPI_Datatype types[MAXFIELDS];
-    DTCMP_Op ops[MAXFIELDS];
-    sort_field fields[MAXFIELDS];
-    size_t lengths[MAXFIELDS];
-    int nfields = 0;
-    for (nfields = 0; nfields < MAXFIELDS; nfields++) {
-        types[nfields]   = MPI_DATATYPE_NULL;
-        ops[nfields]     = DTCMP_OP_NULL;
+    /* compare any fields after the name */
+    return memcmp(a + head, b + head, key->keylen - head);
+}
+
+/* qsort wrapper to compare records given pointers to them */
+static int sort_key_qsort_cmp(const void* a, const void* b)
+{
+    const char* rec_a = *(char* const*) a;
+    const char* rec_b = *(char* const*) b;
+    return sort_key_cmp(rec_a, rec_b, sort_key_current);
+}
+
+/* parse sort fields and compute key layout,
+ * returns MFU_SUCCESS if all fields are valid */
+static int sort_key_parse(const char* sortfields, mfu_flist flist, sort_key_t* key)
+{
+    int rc = MFU_SUCCESS;
+
+    /* get our rank */
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+    /* limit name prefix to longest name in list */
+    size_t name_width = (size_t) mfu_flist_file_max_name(flist);
+    if (name_width > SORT_NAME_PREFIX) {
+        name_width = SORT_NAME_PREFIX;
     }
-    nfields = 0;
+
+    /* user and group names are short, so we store them in full */
+    size_t chars_user  = (size_t) mfu_flist_user_max_name(flist);
+    size_t chars_group = (size_t) mfu_flist_group_max_name(flist);
+
+    int have_name = 0;
+    key->nfields      = 0;
+    key->keylen       = 0;
+    key->name_offset  = 0;
+    key->name_width   = name_width;
+    key->name_descend = 0;
+
     char* sortfields_copy = MFU_STRDUP(sortfields);
     char* token = strtok(sortfields_copy, ",");
     while (token != NULL) {
-        int valid = 1;
-        if (strcmp(token, "name") == 0) {
-            types[nfields]   = dt_filepath;
-            ops[nfields]     = op_filepath;
-            fields[nfields]  = FILENAME;
-            lengths[nfields] = chars;
-        }
-        else if (strcmp(token, "-name") == 0) {
-            types[nfields]   = dt_filepath;
-            ops[nfields]     = op_filepath_rev;
-            fields[nfields]  = FILENAME;
-            lengths[nfields] = chars;
-        }
-        else if (strcmp(token, "user") == 0) {
-            types[nfields]   = dt_user;
-            ops[nfields]     = op_user;
-            fields[nfields]  = USERNAME;
-            lengths[nfields] = chars_user;
-        }
-        else if (strcmp(token, "-user") == 0) {
-            types[nfields]   = dt_user;
-            ops[nfields]     = op_user_rev;
-            fields[nfields]  = USERNAME;
-            lengths[nfields] = chars_user;
-        }
-        else if (strcmp(token, "group") == 0) {
-            types[nfields]   = dt_group;
-            ops[nfields]     = op_group;
-            fields[nfields]  = GROUPNAME;
-            lengths[nfields] = chars_group;
+        /* leading '-' means descending order */
+        int descend = 0;
+        const char* field = token;
+        if (field[0] == '-') {
+            descend = 1;
+            field++;
         }
-        else if (strcmp(token, "-group") == 0) {
-            types[nfields]   = dt_group;
-            ops[nfields]     = op_group_rev;
-            fields[nfields]  = GROUPNAME;
-            lengths[nfields] = chars_group;
-        }
-        else if (strcmp(token, "uid") == 0) {
-            types[nfields]   = MPI_UINT32_T;
-            ops[nfields]     = DTCMP_OP_UINT32T_ASCEND;
-            fields[nfields]  = USERID;
-            lengths[nfields] = 4;
-        }
-        else if (strcmp(token, "-uid") == 0) {
-            types[nfields]   = MPI_UINT32_T;
-            ops[nfields]     = DTCMP_OP_UINT32T_DESCEND;
-            fields[nfields]  = USERID;
-            lengths[nfields] = 4;
-        }
-        else if (strcmp(token, "gid") == 0) {
-            types[nfields]   = MPI_UINT32_T;
-            ops[nfields]     = DTCMP_OP_UINT32T_ASCEND;
-            fields[nfields]  = GROUPID;
-            lengths[nfields] = 4;
-        }
-        else if (strcmp(token, "-gid") == 0) {
-            types[nfields]   = MPI_UINT32_T;
-            ops[nfields]     = DTCMP_OP_UINT32T_DESCEND;
-            fields[nfields]  = GROUPID;
-            lengths[nfields] = 4;
+
+        sort_field type = NULLFIELD;
+        size_t width = 8;
+        if (strcmp(field, "name") == 0) {
+            type  = FILENAME;
+            width = name_width;
         }
-        else if (strcmp(token, "atime") == 0) {
-            types[nfields]   = MPI_UINT32_T;
-            ops[nfields]     = DTCMP_OP_UINT32T_ASCEND;
-            fields[nfields]  = ATIME;
-            lengths[nfields] = 4;
+        else if (strcmp(field, "user") == 0) {
+            type  = USERNAME;
+            width = chars_user;
         }
-        else if (strcmp(token, "-atime") == 0) {
-            types[nfields]   = MPI_UINT32_T;
-            ops[nfields]     = DTCMP_OP_UINT32T_DESCEND;
-            fields[nfields]  = ATIME;
-            lengths[nfields] = 4;
+        else if (strcmp(field, "group") == 0) {
+            type  = GROUPNAME;
+            width = chars_group;
         }
-        else if (strcmp(token, "mtime") == 0) {
-            types[nfields]   = MPI_UINT32_T;
-            ops[nfields]     = DTCMP_OP_UINT32T_ASCEND;
-            fields[nfields]  = MTIME;
-            lengths[nfields] = 4;
+        else if (strcmp(field, "uid") == 0) {
+            type = USERID;
         }
-        else if (strcmp(token, "-mtime") == 0) {
-            types[nfields]   = MPI_UINT32_T;
-            ops[nfields]     = DTCMP_OP_UINT32T_DESCEND;
-            fields[nfields]  = MTIME;
-            lengths[nfields] = 4;
+        else if (strcmp(field, "gid") == 0) {
+            type = GROUPID;
         }
-        else if (strcmp(token, "ctime") == 0) {
-            types[nfields]   = MPI_UINT32_T;
-            ops[nfields]     = DTCMP_OP_UINT32T_ASCEND;
-            fields[nfields]  = CTIME;
-            lengths[nfields] = 4;
+        else if (strcmp(field, "atime") == 0) {
+            type = ATIME;
         }
-        else if (strcmp(token, "-ctime") == 0) {
-            types[nfields]   = MPI_UINT32_T;
-            ops[nfields]     = DTCMP_OP_UINT32T_DESCEND;
-            fields[nfields]  = CTIME;
-            lengths[nfields] = 4;
+        else if (strcmp(field, "mtime") == 0) {
+            type = MTIME;
         }
-        else if (strcmp(token, "size") == 0) {
-            types[nfields]   = MPI_UINT64_T;
-            ops[nfields]     = DTCMP_OP_UINT64T_ASCEND;
-            fields[nfields]  = FILESIZE;
-            lengths[nfields] = 8;
+        else if (strcmp(field, "ctime") == 0) {
+            type = CTIME;
         }
-        else if (strcmp(token, "-size") == 0) {
-            types[nfields]   = MPI_UINT64_T;
-            ops[nfields]     = DTCMP_OP_UINT64T_DESCEND;
-            fields[nfields]  = FILESIZE;
-            lengths[nfields] = 8;
+        else if (strcmp(field, "size") == 0) {
+            type = FILESIZE;
         }
         else {
             /* invalid token */
-            valid = 0;
+            rc = MFU_FAILURE;
             if (rank == 0) {
                 MFU_LOG(MFU_LOG_ERR, "Invalid sort field: %s\n", token);
             }
         }
-        if (valid) {
-            nfields++;
+
+        /* only have stat fields if we have detail */
+        if (type != NULLFIELD && type != FILENAME && !mfu_flist_have_detail(flist)) {
+            rc = MFU_FAILURE;
+            if (rank == 0) {
+                MFU_LOG(MFU_LOG_ERR, "Sort field requires stat data: %s\n", token);
+            }
+            type = NULLFIELD;
         }
-        if (nfields > MAXFIELDS) {
-            /* TODO: print warning if we have too many fields */
-            break;
+
+        /* any fields after the first name field are redundant */
+        if (type != NULLFIELD && !have_name) {
+            if (key->nfields == SORT_MAX_FIELDS) {
+                if (rank == 0) {
+                    MFU_LOG(MFU_LOG_WARN, "Sorting by first %d fields, ignoring the rest of `%s'",
+                        SORT_MAX_FIELDS, sortfields);
+                }
+                break;
+            }
+
+            if (type == FILENAME) {
+                have_name = 1;
+                key->name_offset  = key->keylen;
+                key->name_descend = descend;
+            }
+
+            int i = key->nfields;
+            key->fields[i]  = type;
+            key->descend[i] = descend;
+            key->widths[i]  = width;
+            key->keylen    += width;
+            key->nfields++;
         }
+
         token = strtok(NULL, ",");
     }
     mfu_free(&sortfields_copy);
 
-    /* build key type */
-    MPI_Datatype dt_key;
-    if (DTCMP_Type_create_series(nfields, types, &dt_key) != DTCMP_SUCCESS) {
-        MFU_ABORT(1, "Failed to create key type");
+    /* append name prefix as a tiebreaker if not given */
+    if (!have_name) {
+        int i = key->nfields;
+        key->name_offset = key->keylen;
+        key->fields[i]   = FILENAME;
+        key->descend[i]  = 0;
+        key->widths[i]   = name_width;
+        key->keylen     += name_width;
+        key->nfields++;
     }
 
-    /* create op to sort by access time, then filename */
-    DTCMP_Op op_key;
-    if (DTCMP_Op_create_series(nfields, ops, &op_key) != DTCMP_SUCCESS) {
-        MFU_ABORT(1, "Failed to create sorting operation for key");
-    }
+    key->rec_size = key->keylen + mfu_flist_file_pack_size(flist);
 
-    /* build keysat type */
-    MPI_Datatype dt_keysat, keysat_types[2];
-    keysat_types[0] = dt_key;
-    keysat_types[1] = dt_sat;
-    if (DTCMP_Type_create_series(2, keysat_types, &dt_keysat) != DTCMP_SUCCESS) {
-        MFU_ABORT(1, "Failed to create keysat type");
+    return rc;
+}
+
+/* encode key for given item followed by packed item */
+static void sort_key_pack(char* rec, const sort_key_t* key, mfu_flist flist, uint64_t idx)
+{
+    char* ptr = rec;
+    int i;
+    for (i = 0; i < key->nfields; i++) {
+        int descend  = key->descend[i];
+        size_t width = key->widths[i];
+        switch (key->fields[i]) {
+            case FILENAME:
+                sort_key_encode_str(ptr, mfu_flist_file_get_name(flist, idx), width, descend);
+                break;
+            case USERNAME:
+                sort_key_encode_str(ptr, mfu_flist_file_get_username(flist, idx), width, descend);
+                break;
+            case GROUPNAME:
+                sort_key_encode_str(ptr, mfu_flist_file_get_groupname(flist, idx), width, descend);
+                break;
+            case USERID:
+                sort_key_encode_uint64(ptr, mfu_flist_file_get_uid(flist, idx), descend);
+                break;
+            case GROUPID:
+                sort_key_encode_uint64(ptr, mfu_flist_file_get_gid(flist, idx), descend);
+                break;
+            case ATIME:
+                sort_key_encode_uint64(ptr, mfu_flist_file_get_atime(flist, idx), descend);
+                break;
+            case MTIME:
+                sort_key_encode_uint64(ptr, mfu_flist_file_get_mtime(flist, idx), descend);
+                break;
+            case CTIME:
+                sort_key_encode_uint64(ptr, mfu_flist_file_get_ctime(flist, idx), descend);
+                break;
+            case FILESIZE:
+                sort_key_encode_uint64(ptr, mfu_flist_file_get_size(flist, idx), descend);
+                break;
+            case NULLFIELD:
+            default:
+                break;
+        }
+        ptr += width;
     }
 
-    /* get extent of key type */
-    MPI_Aint key_lb, key_extent;
-    MPI_Type_get_extent(dt_key, &key_lb, &key_extent);
+    /* pack file element */
+    mfu_flist_file_pack(ptr, flist, idx);
+
+    return;
+}
 
-    /* get extent of keysat type */
-    MPI_Aint keysat_lb, keysat_extent;
-    MPI_Type_get_extent(dt_keysat, &keysat_lb, &keysat_extent);
+/* most significant digit radix sort on key bytes starting from byte,
+ * uses tmp as scratch space */
+static void sort_key_radix(char** recs, char** tmp, size_t n, size_t byte, size_t keylen)
+{
+    size_t i;
+
+    /* fall back to insertion sort on small sets */
+    if (n < SORT_RADIX_MIN) {
+        for (i = 1; i < n; i++) {
+            char* rec = recs[i];
+            size_t j = i;
+            while (j > 0 && memcmp(recs[j - 1] + byte, rec + byte, keylen - byte) > 0) {
+                recs[j] = recs[j - 1];
+                j--;
+            }
+            recs[j] = rec;
+        }
+        return;
+    }
 
-    /* get extent of sat type */
-    MPI_Aint stat_lb, stat_extent;
-    MPI_Type_get_extent(dt_sat, &stat_lb, &stat_extent);
+    /* count number of items for each value of this byte */
+    size_t counts[256];
+    size_t starts[256];
+    for (i = 0; i < 256; i++) {
+        counts[i] = 0;
+    }
+    for (i = 0; i < n; i++) {
+        unsigned char c = (unsigned char) recs[i][byte];
+        counts[c]++;
+    }
 
-    /* compute size of sort element and allocate buffer */
-    size_t sortbufsize = (size_t)keysat_extent * incount;
-    void* sortbuf = MFU_MALLOC(sortbufsize);
+    /* compute starting position of each bucket */
+    size_t pos = 0;
+    for (i = 0; i < 256; i++) {
+        starts[i] = pos;
+        pos += counts[i];
+    }
 
-    /* copy data into sort elements */
-    uint64_t idx = 0;
-    char* sortptr = (char*) sortbuf;
-    while (idx < incount) {
-        /* copy in access time */
-        int i;
-        for (i = 0; i < nfields; i++) {
-            if (fields[i] == FILENAME) {
-                const char* name = mfu_flist_file_get_name(flist, idx);
-                strcpy(sortptr, name);
-            }
-            else if (fields[i] == USERNAME) {
-                const char* name = mfu_flist_file_get_username(flist, idx);
-                strcpy(sortptr, name);
-            }
-            else if (fields[i] == GROUPNAME) {
-                const char* name = mfu_flist_file_get_groupname(flist, idx);
-                strcpy(sortptr, name);
-            }
-            else if (fields[i] == USERID) {
-                uint32_t val32 = (uint32_t) mfu_flist_file_get_uid(flist, idx);
-                memcpy(sortptr, &val32, 4);
-            }
-            else if (fields[i] == GROUPID) {
-                uint32_t val32 = (uint32_t) mfu_flist_file_get_gid(flist, idx);
-                memcpy(sortptr, &val32, 4);
-            }
-            else if (fields[i] == ATIME) {
-                uint32_t val32 = (uint32_t) mfu_flist_file_get_atime(flist, idx);
-                memcpy(sortptr, &val32, 4);
-            }
-            else if (fields[i] == MTIME) {
-                uint32_t val32 = (uint32_t) mfu_flist_file_get_mtime(flist, idx);
-                memcpy(sortptr, &val32, 4);
-            }
-            else if (fields[i] == CTIME) {
-                uint32_t val32 = (uint32_t) mfu_flist_file_get_ctime(flist, idx);
-                memcpy(sortptr, &val32, 4);
+    /* distribute items into buckets */
+    for (i = 0; i < n; i++) {
+        unsigned char c = (unsigned char) recs[i][byte];
+        tmp[starts[c]] = recs[i];
+        starts[c]++;
+    }
+    memcpy(recs, tmp, n * sizeof(char*));
+
+    /* sort each bucket on the next byte */
+    if (byte + 1 < keylen) {
+        pos = 0;
+        for (i = 0; i < 256; i++) {
+            if (counts[i] > 1) {
+                sort_key_radix(recs + pos, tmp + pos, counts[i], byte + 1, keylen);
             }
-            else if (fields[i] == FILESIZE) {
-                uint64_t val64 = mfu_flist_file_get_size(flist, idx);
-                memcpy(sortptr, &val64, 8);
+            pos += counts[i];
+        }
+    }
+
+    return;
+}
+
+/* sort array of pointers to records */
+static void sort_key_local(char** recs, size_t n, const sort_key_t* key)
+{
+    if (n < 2) {
+        return;
+    }
+
+    /* radix sort on key bytes */
+    char** tmp = (char**) MFU_MALLOC(n * sizeof(char*));
+    sort_key_radix(recs, tmp, n, 0, key->keylen);
+    mfu_free(&tmp);
+
+    /* the radix sort is exact unless items share a name prefix that
+     * was truncated, find runs of items that match up to the end of
+     * the name prefix and sort those on full names */
+    size_t head = key->name_offset + key->name_width;
+    size_t start = 0;
+    while (start < n) {
+        size_t end = start + 1;
+        while (end < n && memcmp(recs[start], recs[end], head) == 0) {
+            end++;
+        }
+
+        if (end - start > 1) {
+            const char* name = sort_key_name(recs[start], key);
+            if (strlen(name) >= key->name_width) {
+                sort_key_current = key;
+                qsort(recs + start, end - start, sizeof(char*), sort_key_qsort_cmp);
             }
+        }
+
+        start = end;
+    }
+
+    return;
+}
 
-            sortptr += lengths[i];
+/* given a sorted array of records, select up to SORT_SAMPLES evenly
+ * spaced records, gather samples from all ranks, and choose ranks-1
+ * splitters, returns buffer holding splitter records and fills in
+ * array of pointers to each splitter */
+static char* sort_key_splitters(char** recs, size_t n, const sort_key_t* key, char** splitters)
+{
+    int i;
+
+    /* get our rank and the size of comm_world */
+    int rank, ranks;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+
+    /* determine number of samples we'll contribute */
+    size_t samples = (size_t)(ranks - 1);
+    if (samples > SORT_SAMPLES) {
+        samples = SORT_SAMPLES;
+    }
+    if (samples > n) {
+        samples = n;
+    }
+
+    /* samples hold the key followed by a header and the file name,
+     * so that we don't have to send the full packed element */
+    size_t sample_bytes = 0;
+    size_t s;
+    for (s = 0; s < samples; s++) {
+        const char* rec = recs[(s * n) / samples];
+        sample_bytes += key->keylen + 8 + strlen(sort_key_name(rec, key)) + 1;
+    }
+
+    char* sendbuf = (char*) MFU_MALLOC(sample_bytes);
+    char* ptr = sendbuf;
+    for (s = 0; s < samples; s++) {
+        const char* rec = recs[(s * n) / samples];
+        const char* name = sort_key_name(rec, key);
+        size_t len = strlen(name) + 1;
+        memcpy(ptr, rec, key->keylen);
+        ptr += key->keylen;
+        mfu_pack_uint32(&ptr, 0);
+        mfu_pack_uint32(&ptr, (uint32_t) len);
+        strcpy(ptr, name);
+        ptr += len;
+    }
+
+    /* gather samples from all ranks */
+    int sendsize = (int) sample_bytes;
+    int* recvsizes = (int*) MFU_MALLOC((size_t)ranks * sizeof(int));
+    int* recvdisps = (int*) MFU_MALLOC((size_t)ranks * sizeof(int));
+    MPI_Allgather(&sendsize, 1, MPI_INT, recvsizes, 1, MPI_INT, MPI_COMM_WORLD);
+
+    size_t recvbytes = 0;
+    for (i = 0; i < ranks; i++) {
+        recvdisps[i] = (int) recvbytes;
+        recvbytes += (size_t) recvsizes[i];
+    }
+
+    char* samplebuf = (char*) MFU_MALLOC(recvbytes);
+    MPI_Allgatherv(
+        sendbuf, sendsize, MPI_BYTE,
+        samplebuf, recvsizes, recvdisps, MPI_BYTE, MPI_COMM_WORLD
+    );
+
+    /* count samples and record pointer to each one */
+    size_t total = 0;
+    ptr = samplebuf;
+    while (ptr < samplebuf + recvbytes) {
+        total++;
+        ptr += key->keylen + 8 + strlen(sort_key_name(ptr, key)) + 1;
+    }
+
+    char** sample_recs = (char**) MFU_MALLOC(total * sizeof(char*));
+    total = 0;
+    ptr = samplebuf;
+    while (ptr < samplebuf + recvbytes) {
+        sample_recs[total] = ptr;
+        total++;
+        ptr += key->keylen + 8 + strlen(sort_key_name(ptr, key)) + 1;
+    }
+
+    /* sort the samples, every rank does this on the same data */
+    sort_key_current = key;
+    qsort(sample_recs, total, sizeof(char*), sort_key_qsort_cmp);
+
+    /* pick evenly spaced splitters, if there are no samples
+     * then all ranks are empty and we'll have nothing to send */
+    for (i = 1; i < ranks; i++) {
+        splitters[i - 1] = NULL;
+        if (total > 0) {
+            size_t pos = ((size_t)i * total) / (size_t)ranks;
+            splitters[i - 1] = sample_recs[pos];
         }
+    }
 
-        /* pack file element */
-        sortptr += mfu_flist_file_pack(sortptr, flist, idx);
+    /* free memory */
+    mfu_free(&sample_recs);
+    mfu_free(&recvdisps);
+    mfu_free(&recvsizes);
+    mfu_free(&sendbuf);
 
-        idx++;
+    return samplebuf;
+}
+
+static int sort_files_key(const char* sortfields, mfu_flist* pflist)
+{
+    /* get list from caller */
+    mfu_flist flist = *pflist;
+
+    /* get our rank and the size of comm_world */
+    int rank, ranks;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+
+    /* compute key layout from sort fields */
+    sort_key_t key;
+    int rc = sort_key_parse(sortfields, flist, &key);
+    int all_rc;
+    MPI_Allreduce(&rc, &all_rc, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+    if (all_rc != MFU_SUCCESS) {
+        return MFU_FAILURE;
     }
 
-    /* sort data */
-    void* outsortbuf;
-    int outsortcount;
-    DTCMP_Handle handle;
-    int sort_rc = DTCMP_Sortz(
-                      sortbuf, (int)incount, &outsortbuf, &outsortcount,
-                      dt_key, dt_keysat, op_key, DTCMP_FLAG_NONE,
-                      MPI_COMM_WORLD, &handle
-                  );
-    if (sort_rc != DTCMP_SUCCESS) {
-        MFU_ABORT(1, "Failed to sort data");
-    }
-
-    /* step through sorted data filenames */
-    idx = 0;
-    sortptr = (char*) outsortbuf;
-    while (idx < (uint64_t)outsortcount) {
-        sortptr += key_extent;
-        sortptr += mfu_flist_file_unpack(sortptr, flist2);
-        idx++;
+    /* create a new list as subset of original list */
+    mfu_flist flist2 = mfu_flist_subset(flist);
+
+    /* encode key and packed item for each element */
+    uint64_t incount = mfu_flist_size(flist);
+    size_t rec_size = key.rec_size;
+    char* sortbuf = (char*) MFU_MALLOC(incount * rec_size);
+    char** recs = (char**) MFU_MALLOC(incount * sizeof(char*));
+    uint64_t idx;
+    for (idx = 0; idx < incount; idx++) {
+        char* rec = sortbuf + idx * rec_size;
+        sort_key_pack(rec, &key, flist, idx);
+        recs[idx] = rec;
+    }
+
+    /* sort our items locally */
+    sort_key_local(recs, (size_t)incount, &key);
+
+    /* choose splitters */
+    char** splitters = (char**) MFU_MALLOC((size_t)ranks * sizeof(char*));
+    char* samplebuf = sort_key_splitters(recs, (size_t)incount, &key, splitters);
+
+    /* compute number of items to send to each rank, items up to and
+     * including splitter i go to rank i, we binary search for the
+     * first item that is larger than each splitter */
+    int* sendcounts = (int*) MFU_MALLOC((size_t)ranks * sizeof(int));
+    int* senddisps  = (int*) MFU_MALLOC((size_t)ranks * sizeof(int));
+    int* recvcounts = (int*) MFU_MALLOC((size_t)ranks * sizeof(int));
+    int* recvdisps  = (int*) MFU_MALLOC((size_t)ranks * sizeof(int));
+    size_t prev = 0;
+    int i;
+    for (i = 0; i < ranks; i++) {
+        size_t end = (size_t) incount;
+        if (i < ranks - 1 && splitters[i] != NULL) {
+            size_t low  = prev;
+            size_t high = (size_t) incount;
+            while (low < high) {
+                size_t mid = low + (high - low) / 2;
+                if (sort_key_cmp(recs[mid], splitters[i], &key) <= 0) {
+                    low = mid + 1;
+                } else {
+                    high = mid;
+                }
+            }
+            end = low;
+        }
+
+        /* records are padded to the longest name, so we count
+         * records rather than bytes to stay within an int */
+        sendcounts[i] = (int)(end - prev);
+        senddisps[i]  = (int)prev;
+        prev = end;
+    }
+
+    /* copy records to send buffer in sorted order */
+    char* sendbuf = (char*) MFU_MALLOC(incount * rec_size);
+    for (idx = 0; idx < incount; idx++) {
+        memcpy(sendbuf + idx * rec_size, recs[idx], rec_size);
+    }
+    mfu_free(&recs);
+    mfu_free(&sortbuf);
+
+    /* alltoall to get our incoming counts */
+    MPI_Alltoall(sendcounts, 1, MPI_INT, recvcounts, 1, MPI_INT, MPI_COMM_WORLD);
+
+    size_t recvcount = 0;
+    for (i = 0; i < ranks; i++) {
+        recvdisps[i] = (int) recvcount;
+        recvcount += (size_t) recvcounts[i];
+    }
+    if (incount > INT_MAX || recvcount > INT_MAX) {
+        MFU_ABORT(-1, "Too many records to sort: sending %llu, receiving %llu",
+            (unsigned long long) incount, (unsigned long long) recvcount);
+    }
+
+    /* exchange records, one datatype element per record */
+    char* recvbuf = (char*) MFU_MALLOC(recvcount * rec_size);
+    MPI_Datatype dt_rec;
+    MPI_Type_contiguous((int)rec_size, MPI_BYTE, &dt_rec);
+    MPI_Type_commit(&dt_rec);
+    MPI_Alltoallv(
+        sendbuf, sendcounts, senddisps, dt_rec,
+        recvbuf, recvcounts, recvdisps, dt_rec, MPI_COMM_WORLD
+    );
+    MPI_Type_free(&dt_rec);
+
+    /* sort the records we received */
+    recs = (char**) MFU_MALLOC(recvcount * sizeof(char*));
+    size_t r;
+    for (r = 0; r < recvcount; r++) {
+        recs[r] = recvbuf + r * rec_size;
+    }
+    sort_key_local(recs, recvcount, &key);
+
+    /* unpack items into new list in sorted order */
+    for (r = 0; r < recvcount; r++) {
+        mfu_flist_file_unpack(recs[r] + key.keylen, flist2);
     }
 
     /* build summary of new list */
     mfu_flist_summarize(flist2);
 
     /* free memory */
-    DTCMP_Free(&handle);
-
-    /* free ops */
-    DTCMP_Op_free(&op_key);
-    DTCMP_Op_free(&op_group_rev);
-    DTCMP_Op_free(&op_user_rev);
-    DTCMP_Op_free(&op_filepath_rev);
-    DTCMP_Op_free(&op_group);
-    DTCMP_Op_free(&op_user);
-    DTCMP_Op_free(&op_filepath);
-
-    /* free types */
-    MPI_Type_free(&dt_keysat);
-    MPI_Type_free(&dt_key);
-    MPI_Type_free(&dt_group);
-    MPI_Type_free(&dt_user);
-    MPI_Type_free(&dt_filepath);
-
-    /* free input buffer holding sort elements */
-    mfu_free(&sortbuf);
-
-    /* free the satellite type */
-    MPI_Type_free(&dt_sat);
+    mfu_free(&recs);
+    mfu_free(&recvbuf);
+    mfu_free(&sendbuf);
+    mfu_free(&recvdisps);
+    mfu_free(&recvcounts);
+    mfu_free(&senddisps);
+    mfu_free(&sendcounts);
+    mfu_free(&samplebuf);
+    mfu_free(&splitters);
 
     /* return new list and free old one */
     *pflist = flist2;
@@ -599,7 +1098,7 @@ int mfu_flist_sort(const char* sortfields, mfu_flist* pflist)
     /* sort list */
     int rc;
     if (mfu_flist_have_detail(flist)) {
-        rc = sort_files_stat(sortfields, pflist);
+        rc = sort_files_key(sortfields, pflist);
     }
     else {
         rc = sort_files_readdir(sortfields, pflist);
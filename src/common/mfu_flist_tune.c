@@ -0,0 +1,268 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+
+#include "mfu.h"
+
+/****************************************
+ * Functions to pick block and chunk sizes by timing reads
+ ***************************************/
+
+/* The best block and chunk sizes differ a lot between file systems,
+ * so before a copy or compare we read a sample of the source files
+ * with a few sizes and keep the fastest.  Each process reads from
+ * regular files in its part of the list.  Every trial reads data that
+ * no earlier trial read, so later trials aren't helped by the page
+ * cache, and we drop pages we read once we are done with them.
+ *
+ * We first time block sizes, reading sections as large as the largest
+ * chunk size.  Then, with the best block size, we time chunk sizes,
+ * where each section of a chunk goes to the next file in turn, like
+ * sections handed out in a copy.  Smaller chunks balance work better,
+ * so we take the smallest chunk size within 10% of the fastest. */
+
+/* block and chunk sizes to try */
+static const size_t tune_block_sizes[] = {
+    256 * 1024, 1024 * 1024, 4 * 1024 * 1024, 16 * 1024 * 1024
+};
+static const uint64_t tune_chunk_sizes[] = {
+    1024 * 1024, 4 * 1024 * 1024, 16 * 1024 * 1024, 64 * 1024 * 1024
+};
+#define TUNE_BLOCKS (sizeof(tune_block_sizes) / sizeof(tune_block_sizes[0]))
+#define TUNE_CHUNKS (sizeof(tune_chunk_sizes) / sizeof(tune_chunk_sizes[0]))
+#define TUNE_TRIALS (TUNE_BLOCKS + TUNE_CHUNKS)
+
+/* most bytes each process reads in one trial */
+#define TUNE_TRIAL_BYTES (64 * 1024 * 1024)
+
+/* skip tuning if processes together can't read this much per trial */
+#define TUNE_MIN_BYTES (64 * 1024 * 1024)
+
+/* a regular file to read from, and how far we have read into it */
+typedef struct {
+    const char* name;
+    uint64_t size;
+    uint64_t pos;
+} tune_file_t;
+
+/* read up to budget bytes from files in sections of section_size
+ * bytes, each section from the next file in turn that has data left,
+ * using reads of block_size bytes, returns number of bytes read */
+static uint64_t tune_read(
+    tune_file_t* files,
+    uint64_t nfiles,
+    uint64_t* next,
+    uint64_t section_size,
+    size_t block_size,
+    uint64_t budget,
+    char* buf)
+{
+    uint64_t total = 0;
+    uint64_t empty = 0;
+    while (total < budget && nfiles > 0 && empty < nfiles) {
+        tune_file_t* f = &files[*next];
+        *next = (*next + 1) % nfiles;
+
+        /* skip files we have read to the end */
+        if (f->pos >= f->size) {
+            empty++;
+            continue;
+        }
+        empty = 0;
+
+        uint64_t length = f->size - f->pos;
+        if (length > section_size) {
+            length = section_size;
+        }
+        if (length > budget - total) {
+            length = budget - total;
+        }
+
+        int fd = mfu_open(f->name, O_RDONLY);
+        if (fd < 0) {
+            /* don't try this file again */
+            f->pos = f->size;
+            continue;
+        }
+
+        uint64_t done = 0;
+        if (mfu_lseek(f->name, fd, (off_t)f->pos, SEEK_SET) == (off_t)-1) {
+            length = 0;
+            f->size = f->pos;
+        }
+        while (done < length) {
+            size_t left = block_size;
+            if (length - done < (uint64_t)left) {
+                left = (size_t)(length - done);
+            }
+            ssize_t nread = mfu_read(f->name, fd, buf, left);
+            if (nread <= 0) {
+                /* file changed or can't be read, stop using it */
+                f->size = f->pos + done;
+                break;
+            }
+            done += (uint64_t)nread;
+        }
+
+        /* leave the page cache as we found it */
+        posix_fadvise(fd, (off_t)f->pos, (off_t)done, POSIX_FADV_DONTNEED);
+        mfu_close(f->name, fd);
+
+        f->pos += done;
+        total  += done;
+    }
+    return total;
+}
+
+/* time a trial across all processes, returns aggregate bytes/sec */
+static double tune_trial(
+    tune_file_t* files,
+    uint64_t nfiles,
+    uint64_t* next,
+    uint64_t section_size,
+    size_t block_size,
+    uint64_t budget,
+    char* buf)
+{
+    MPI_Barrier(MPI_COMM_WORLD);
+    double start = MPI_Wtime();
+    uint64_t bytes = tune_read(files, nfiles, next, section_size, block_size, budget, buf);
+    double secs = MPI_Wtime() - start;
+
+    /* the trial takes as long as the slowest process */
+    double max_secs;
+    uint64_t all_bytes;
+    MPI_Allreduce(&secs, &max_secs, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+    MPI_Allreduce(&bytes, &all_bytes, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+
+    double rate = 0.0;
+    if (max_secs > 0.0) {
+        rate = (double)all_bytes / max_secs;
+    }
+    return rate;
+}
+
+void mfu_flist_tune(mfu_flist list, mfu_copy_opts_t* mfu_copy_opts)
+{
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+    double start = MPI_Wtime();
+
+    /* collect regular files from our part of the list */
+    uint64_t size = mfu_flist_size(list);
+    tune_file_t* files = (tune_file_t*) MFU_MALLOC(size * sizeof(tune_file_t));
+    uint64_t nfiles = 0;
+    uint64_t local_bytes = 0;
+    uint64_t idx;
+    for (idx = 0; idx < size; idx++) {
+        mfu_filetype type = mfu_flist_file_get_type(list, idx);
+        uint64_t filesize = mfu_flist_file_get_size(list, idx);
+        if (type == MFU_TYPE_FILE && filesize > 0) {
+            files[nfiles].name = mfu_flist_file_get_name(list, idx);
+            files[nfiles].size = filesize;
+            files[nfiles].pos  = 0;
+            local_bytes += filesize;
+            nfiles++;
+        }
+    }
+
+    /* give every trial on this process the same number of bytes,
+     * so no trial runs short of fresh data */
+    uint64_t budget = local_bytes / TUNE_TRIALS;
+    if (budget > TUNE_TRIAL_BYTES) {
+        budget = TUNE_TRIAL_BYTES;
+    }
+
+    uint64_t all_budget;
+    MPI_Allreduce(&budget, &all_budget, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+    if (all_budget < TUNE_MIN_BYTES) {
+        if (rank == 0) {
+            MFU_LOG(MFU_LOG_INFO, "Too little data to tune, using block size %" PRIu64 " and chunk size %" PRIu64,
+                (uint64_t)mfu_copy_opts->block_size, (uint64_t)mfu_copy_opts->chunk_size);
+        }
+        mfu_free(&files);
+        return;
+    }
+
+    if (rank == 0) {
+        MFU_LOG(MFU_LOG_INFO, "Tuning block and chunk sizes");
+    }
+
+    size_t max_block = tune_block_sizes[TUNE_BLOCKS - 1];
+    char* buf = (char*) MFU_MEMALIGN(max_block, 1024 * 1024);
+    uint64_t next = 0;
+    size_t i;
+
+    /* time block sizes with sections as large as the largest chunk */
+    size_t best_block = mfu_copy_opts->block_size;
+    double best_block_rate = 0.0;
+    for (i = 0; i < TUNE_BLOCKS; i++) {
+        size_t block = tune_block_sizes[i];
+        double rate = tune_trial(files, nfiles, &next,
+            tune_chunk_sizes[TUNE_CHUNKS - 1], block, budget, buf);
+        if (rank == 0) {
+            double rate_tmp;
+            const char* rate_units;
+            mfu_format_bw(rate, &rate_tmp, &rate_units);
+            MFU_LOG(MFU_LOG_VERBOSE, "Block size %" PRIu64 ": %.3lf %s",
+                (uint64_t)block, rate_tmp, rate_units);
+        }
+        if (rate > best_block_rate) {
+            best_block_rate = rate;
+            best_block = block;
+        }
+    }
+
+    /* time chunk sizes no smaller than the block size we picked */
+    double chunk_rates[TUNE_CHUNKS];
+    double best_chunk_rate = 0.0;
+    for (i = 0; i < TUNE_CHUNKS; i++) {
+        uint64_t chunk = tune_chunk_sizes[i];
+        chunk_rates[i] = 0.0;
+        if (chunk < (uint64_t)best_block) {
+            continue;
+        }
+        chunk_rates[i] = tune_trial(files, nfiles, &next,
+            chunk, best_block, budget, buf);
+        if (rank == 0) {
+            double rate_tmp;
+            const char* rate_units;
+            mfu_format_bw(chunk_rates[i], &rate_tmp, &rate_units);
+            MFU_LOG(MFU_LOG_VERBOSE, "Chunk size %" PRIu64 ": %.3lf %s",
+                chunk, rate_tmp, rate_units);
+        }
+        if (chunk_rates[i] > best_chunk_rate) {
+            best_chunk_rate = chunk_rates[i];
+        }
+    }
+
+    /* smaller chunks balance work better, so take the
+     * smallest one that is nearly as fast as the fastest */
+    uint64_t best_chunk = (uint64_t) mfu_copy_opts->chunk_size;
+    for (i = 0; i < TUNE_CHUNKS; i++) {
+        if (chunk_rates[i] > 0.0 && chunk_rates[i] >= 0.9 * best_chunk_rate) {
+            best_chunk = tune_chunk_sizes[i];
+            break;
+        }
+    }
+
+    /* rates are the same on all ranks, so all pick the same sizes */
+    mfu_copy_opts->block_size = best_block;
+    mfu_copy_opts->chunk_size = (size_t)best_chunk;
+
+    double secs = MPI_Wtime() - start;
+    if (rank == 0) {
+        MFU_LOG(MFU_LOG_INFO, "Picked block size %" PRIu64 " and chunk size %" PRIu64 " in %.3lf secs",
+            (uint64_t)best_block, best_chunk, secs);
+    }
+
+    mfu_free(&buf);
+    mfu_free(&files);
+}
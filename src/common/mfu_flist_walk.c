@@ -55,6 +55,7 @@ static int SET_DIR_PERMS;
  ***************************************/
 
 static uint64_t reduce_items;
+static double reduce_start;
 
 static void reduce_init(void)
 {
@@ -71,26 +72,13 @@ static void reduce_exec(const void* buf1, size_t size1, const void* buf2, size_t
 
 static void reduce_fini(const void* buf, size_t size)
 {
-    /* get current time */
-    time_t walk_start_t = time(NULL);
-    if (walk_start_t == (time_t) - 1) {
-        /* TODO: ERROR! */
-    }
-
-    /* format timestamp string */
-    char walk_s[30];
-    size_t rc = strftime(walk_s, sizeof(walk_s) - 1, "%FT%T", localtime(&walk_start_t));
-    if (rc == 0) {
-        walk_s[0] = '\0';
-    }
-
     /* get result of reduction */
     const uint64_t* a = (const uint64_t*) buf;
-    unsigned long long val = (unsigned long long) a[0];
 
-    /* print status to stdout */
-    printf("%s: Items walked %llu ...\n", walk_s, val);
-    fflush(stdout);
+    /* print status to stdout, we don't know how many items
+     * there are in total until the walk is done */
+    double secs = MPI_Wtime() - reduce_start;
+    mfu_progress_print("Walked", secs, a[0], 0, 0, 0);
 }
 
 #ifdef LUSTRE_SUPPORT
@@ -791,11 +779,17 @@ void mfu_flist_walk_paths(uint64_t num_paths, const char** paths, int use_stat,
         //        CIRCLE_cb_process(&walk_getdents_process);
     }
 
-    /* prepare callbacks and initialize variables for reductions */
+    /* prepare callbacks and initialize variables for reductions,
+     * libcircle runs these on its own timer, which lets idle ranks
+     * contribute their counts while they wait for work */
     reduce_items = 0;
-    CIRCLE_cb_reduce_init(&reduce_init);
-    CIRCLE_cb_reduce_op(&reduce_exec);
-    CIRCLE_cb_reduce_fini(&reduce_fini);
+    reduce_start = MPI_Wtime();
+    if (mfu_progress_timeout > 0) {
+        CIRCLE_cb_reduce_init(&reduce_init);
+        CIRCLE_cb_reduce_op(&reduce_exec);
+        CIRCLE_cb_reduce_fini(&reduce_fini);
+        CIRCLE_set_reduce_period(mfu_progress_timeout);
+    }
 
     /* run the libcircle job */
     CIRCLE_begin();
@@ -1,3 +1,4 @@
+#define _GNU_SOURCE
 #include "mfu.h"
 
 #include <stdio.h>
@@ -8,8 +9,14 @@
 #include <stdarg.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
 #include <fcntl.h>
 
+#ifdef __linux__
+#include <linux/fs.h>
+#endif
+
 #define MFU_IO_TRIES  (5)
 #define MFU_IO_USLEEP (100)
 
@@ -401,6 +408,386 @@ retry:
     return rc;
 }
 
+/* force flush of written data, but not timestamps */
+int mfu_fdatasync(const char* file, int fd)
+{
+    int rc;
+    int tries = MFU_IO_TRIES;
+retry:
+    rc = fdatasync(fd);
+    if (rc < 0) {
+        if (errno == EINTR || errno == EIO) {
+            tries--;
+            if (tries > 0) {
+                /* sleep a bit before consecutive tries */
+                usleep(MFU_IO_USLEEP);
+                goto retry;
+            }
+        }
+    }
+    return rc;
+}
+
+/* force flush of everything written to the file system holding path */
+int mfu_syncfs(const char* path)
+{
+#ifdef SYS_syncfs
+    int fd = mfu_open(path, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+
+    int rc;
+    int tries = MFU_IO_TRIES;
+retry:
+    rc = (int) syscall(SYS_syncfs, fd);
+    if (rc < 0) {
+        if (errno == EINTR || errno == EIO) {
+            tries--;
+            if (tries > 0) {
+                /* sleep a bit before consecutive tries */
+                usleep(MFU_IO_USLEEP);
+                goto retry;
+            }
+        }
+    }
+
+    /* keep errno from syncfs */
+    int err = errno;
+    mfu_close(path, fd);
+    errno = err;
+    return rc;
+#else
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+/* clone a range of one file into another, sharing data blocks */
+int mfu_clone_range(const char* file, int src_fd, off_t src_off,
+    int dst_fd, off_t dst_off, off_t len)
+{
+#ifdef FICLONERANGE
+    struct file_clone_range range;
+    range.src_fd      = (int64_t) src_fd;
+    range.src_offset  = (uint64_t) src_off;
+    range.src_length  = (uint64_t) len;
+    range.dest_offset = (uint64_t) dst_off;
+
+    int rc;
+    int tries = MFU_IO_TRIES;
+retry:
+    rc = ioctl(dst_fd, FICLONERANGE, &range);
+    if (rc < 0) {
+        if (errno == EINTR || errno == EIO) {
+            tries--;
+            if (tries > 0) {
+                /* sleep a bit before consecutive tries */
+                usleep(MFU_IO_USLEEP);
+                goto retry;
+            }
+        }
+    }
+    return rc;
+#else
+    errno = EOPNOTSUPP;
+    return -1;
+#endif
+}
+
+/* copy a range of one file into another within the kernel */
+ssize_t mfu_copy_file_range(const char* file, int src_fd, off_t* src_off,
+    int dst_fd, off_t* dst_off, size_t len)
+{
+#ifdef SYS_copy_file_range
+    loff_t in_off  = (loff_t) *src_off;
+    loff_t out_off = (loff_t) *dst_off;
+
+    ssize_t rc;
+    int tries = MFU_IO_TRIES;
+retry:
+    rc = (ssize_t) syscall(SYS_copy_file_range, src_fd, &in_off, dst_fd, &out_off, len, 0);
+    if (rc < 0) {
+        if (errno == EINTR || errno == EIO) {
+            tries--;
+            if (tries > 0) {
+                /* sleep a bit before consecutive tries */
+                usleep(MFU_IO_USLEEP);
+                goto retry;
+            }
+        }
+        return rc;
+    }
+
+    *src_off = (off_t) in_off;
+    *dst_off = (off_t) out_off;
+    return rc;
+#else
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+/*****************************
+ * Open file cache
+ ****************************/
+
+struct mfu_file_cache_elem_struct {
+    char*    name;  /* name of open file */
+    int      flags; /* flags file was opened with */
+    int      fd;    /* file descriptor */
+    uint64_t hash;  /* hash of name and flags */
+    int      hnext; /* index of next element in same hash bin, -1 if last */
+    int      prev;  /* index of next more recently used element, -1 if head */
+    int      next;  /* index of next less recently used element, -1 if tail */
+};
+
+/* FNV-1a hash of file name, folded with open flags */
+static uint64_t mfu_file_cache_hash(const char* file, int flags)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    const unsigned char* p = (const unsigned char*) file;
+    while (*p != '\0') {
+        hash ^= (uint64_t) *p;
+        hash *= 1099511628211ULL;
+        p++;
+    }
+    hash ^= (uint64_t) (unsigned int) flags;
+    hash *= 1099511628211ULL;
+    return hash;
+}
+
+/* remove element from LRU list */
+static void mfu_file_cache_lru_remove(mfu_file_cache_t* cache, int i)
+{
+    mfu_file_cache_elem_t* e = &cache->elems[i];
+    if (e->prev != -1) {
+        cache->elems[e->prev].next = e->next;
+    } else {
+        cache->head = e->next;
+    }
+    if (e->next != -1) {
+        cache->elems[e->next].prev = e->prev;
+    } else {
+        cache->tail = e->prev;
+    }
+    e->prev = -1;
+    e->next = -1;
+}
+
+/* insert element at head of LRU list */
+static void mfu_file_cache_lru_push(mfu_file_cache_t* cache, int i)
+{
+    mfu_file_cache_elem_t* e = &cache->elems[i];
+    e->prev = -1;
+    e->next = cache->head;
+    if (cache->head != -1) {
+        cache->elems[cache->head].prev = i;
+    } else {
+        cache->tail = i;
+    }
+    cache->head = i;
+}
+
+/* remove element from its hash bin */
+static void mfu_file_cache_bin_remove(mfu_file_cache_t* cache, int i)
+{
+    int* link = &cache->bin[cache->elems[i].hash % (uint64_t) cache->bins];
+    while (*link != -1) {
+        if (*link == i) {
+            *link = cache->elems[i].hnext;
+            break;
+        }
+        link = &cache->elems[*link].hnext;
+    }
+    cache->elems[i].hnext = -1;
+}
+
+/* fdatasync (if needed) and close file held by element */
+static int mfu_file_cache_close_elem(mfu_file_cache_t* cache, int i)
+{
+    int rc = 0;
+    mfu_file_cache_elem_t* e = &cache->elems[i];
+
+    /* flush data if file was open for write */
+    if (cache->sync && (e->flags & O_ACCMODE) != O_RDONLY) {
+        if (mfu_fdatasync(e->name, e->fd) != 0) {
+            rc = -1;
+        }
+    }
+
+    if (mfu_close(e->name, e->fd) != 0) {
+        rc = -1;
+    }
+    mfu_free(&e->name);
+    e->fd = -1;
+
+    return rc;
+}
+
+/* initialize cache to hold up to size open files */
+void mfu_file_cache_init(mfu_file_cache_t* cache, int size, int sync)
+{
+    /* always keep at least one file open */
+    if (size < 1) {
+        size = 1;
+    }
+
+    cache->size  = size;
+    cache->count = 0;
+    cache->sync  = sync;
+    cache->bins  = size * 2;
+    cache->bin   = (int*) MFU_MALLOC((size_t)cache->bins * sizeof(int));
+    cache->elems = (mfu_file_cache_elem_t*) MFU_MALLOC((size_t)size * sizeof(mfu_file_cache_elem_t));
+    cache->head  = -1;
+    cache->tail  = -1;
+    cache->hits   = 0;
+    cache->misses = 0;
+
+    int i;
+    for (i = 0; i < cache->bins; i++) {
+        cache->bin[i] = -1;
+    }
+}
+
+/* return cached descriptor for file opened with flags, or -1 if none */
+int mfu_file_cache_get(mfu_file_cache_t* cache, const char* file, int flags)
+{
+    uint64_t hash = mfu_file_cache_hash(file, flags);
+    int i = cache->bin[hash % (uint64_t) cache->bins];
+    while (i != -1) {
+        mfu_file_cache_elem_t* e = &cache->elems[i];
+        if (e->hash == hash && e->flags == flags && strcmp(e->name, file) == 0) {
+            /* found it, move it to the front of the LRU list */
+            if (cache->head != i) {
+                mfu_file_cache_lru_remove(cache, i);
+                mfu_file_cache_lru_push(cache, i);
+            }
+            cache->hits++;
+            return e->fd;
+        }
+        i = e->hnext;
+    }
+
+    cache->misses++;
+    return -1;
+}
+
+/* add descriptor for file opened with flags, evicting the
+ * least recently used file if the cache is full */
+void mfu_file_cache_add(mfu_file_cache_t* cache, const char* file, int flags, int fd)
+{
+    /* pick an element to hold the new file */
+    int i;
+    if (cache->count < cache->size) {
+        i = cache->count;
+        cache->count++;
+    } else {
+        i = cache->tail;
+        mfu_file_cache_bin_remove(cache, i);
+        mfu_file_cache_lru_remove(cache, i);
+        mfu_file_cache_close_elem(cache, i);
+    }
+
+    mfu_file_cache_elem_t* e = &cache->elems[i];
+    e->name  = MFU_STRDUP(file);
+    e->flags = flags;
+    e->fd    = fd;
+    e->hash  = mfu_file_cache_hash(file, flags);
+
+    /* insert into hash bin and at head of LRU list */
+    int b = (int) (e->hash % (uint64_t) cache->bins);
+    e->hnext = cache->bin[b];
+    cache->bin[b] = i;
+    mfu_file_cache_lru_push(cache, i);
+}
+
+/* return cached descriptor or open file and add it to the cache */
+int mfu_file_cache_open(mfu_file_cache_t* cache, const char* file, int flags, mode_t mode)
+{
+    int fd = mfu_file_cache_get(cache, file, flags);
+    if (fd != -1) {
+        return fd;
+    }
+
+    fd = mfu_open(file, flags, mode);
+    if (fd != -1) {
+        mfu_file_cache_add(cache, file, flags, fd);
+    }
+    return fd;
+}
+
+/* fdatasync all files in the cache that are open for write */
+int mfu_file_cache_sync(mfu_file_cache_t* cache)
+{
+    int rc = 0;
+
+    int i;
+    for (i = 0; i < cache->count; i++) {
+        mfu_file_cache_elem_t* e = &cache->elems[i];
+        if ((e->flags & O_ACCMODE) != O_RDONLY) {
+            if (mfu_fdatasync(e->name, e->fd) != 0) {
+                rc = -1;
+            }
+        }
+    }
+
+    return rc;
+}
+
+/* close all files in the cache */
+int mfu_file_cache_close_all(mfu_file_cache_t* cache)
+{
+    int rc = 0;
+
+    int i;
+    for (i = 0; i < cache->count; i++) {
+        if (mfu_file_cache_close_elem(cache, i) != 0) {
+            rc = -1;
+        }
+    }
+    for (i = 0; i < cache->bins; i++) {
+        cache->bin[i] = -1;
+    }
+    cache->count = 0;
+    cache->head  = -1;
+    cache->tail  = -1;
+
+    return rc;
+}
+
+/* close all files and free memory associated with the cache */
+int mfu_file_cache_free(mfu_file_cache_t* cache)
+{
+    int rc = mfu_file_cache_close_all(cache);
+    mfu_free(&cache->bin);
+    mfu_free(&cache->elems);
+    cache->size = 0;
+    cache->bins = 0;
+    return rc;
+}
+
+/* sum hits and misses across ranks and print hit rate from rank 0 */
+void mfu_file_cache_print(const mfu_file_cache_t* cache, const char* label)
+{
+    uint64_t values[2], sums[2];
+    values[0] = cache->hits;
+    values[1] = cache->misses;
+    MPI_Allreduce(values, sums, 2, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    if (rank == 0) {
+        uint64_t lookups = sums[0] + sums[1];
+        double rate = 0.0;
+        if (lookups > 0) {
+            rate = (double)sums[0] * 100.0 / (double)lookups;
+        }
+        MFU_LOG(MFU_LOG_VERBOSE, "%s file cache: %llu hits, %llu misses (%.1lf%% hit rate)",
+            label, (unsigned long long)sums[0], (unsigned long long)sums[1], rate);
+    }
+}
+
 /*****************************
  * Directories
  ****************************/
@@ -29,6 +29,7 @@ extern "C" {
 
 #include <stdlib.h>
 #include <stdarg.h>
+#include <stdint.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
@@ -102,6 +103,84 @@ int mfu_unlink(const char* file);
 /* force flush of written data */
 int mfu_fsync(const char* file, int fd);
 
+/* force flush of written data and of the metadata needed to read it
+ * back, like the file size, but not of timestamps */
+int mfu_fdatasync(const char* file, int fd);
+
+/* force flush of all written data and metadata on the file system
+ * that holds path, unlike sync this leaves other file systems alone,
+ * returns -1 with errno set to ENOSYS if syncfs is not available */
+int mfu_syncfs(const char* path);
+
+/* clone len bytes at src_off in src_fd to dst_off in dst_fd, so that
+ * both files share the same data blocks, a len of 0 clones through
+ * the end of the source file, returns -1 with errno set to EOPNOTSUPP
+ * or ENOTTY if the file system can't share blocks between the files */
+int mfu_clone_range(const char* file, int src_fd, off_t src_off,
+    int dst_fd, off_t dst_off, off_t len);
+
+/* copy up to len bytes from src_fd at *src_off to dst_fd at *dst_off
+ * without passing data through user space, advances both offsets by
+ * the number of bytes copied and returns it, 0 at end of file,
+ * retries on EINTR or EIO, returns -1 with errno set to ENOSYS
+ * if the system call is not available */
+ssize_t mfu_copy_file_range(const char* file, int src_fd, off_t* src_off,
+    int dst_fd, off_t* dst_off, size_t len);
+
+/*****************************
+ * Open file cache
+ ****************************/
+
+/* LRU cache of open file descriptors keyed by path and open flags,
+ * lets a process that works on sections of many files switch
+ * between them without closing and reopening each file */
+typedef struct mfu_file_cache_elem_struct mfu_file_cache_elem_t;
+
+typedef struct {
+    int size;                     /* max number of files kept open */
+    int count;                    /* number of elements in use */
+    int sync;                     /* whether to fdatasync files opened for write before closing */
+    int bins;                     /* number of hash bins */
+    int* bin;                     /* index of first element in each hash bin, -1 if empty */
+    mfu_file_cache_elem_t* elems; /* array of size elements */
+    int head;                     /* index of most recently used element, -1 if empty */
+    int tail;                     /* index of least recently used element, -1 if empty */
+    uint64_t hits;                /* number of lookups that found an open file */
+    uint64_t misses;              /* number of lookups that did not */
+} mfu_file_cache_t;
+
+/* initialize cache to hold up to size open files, if sync is set,
+ * files opened for write are fdatasync'd before they are closed */
+void mfu_file_cache_init(mfu_file_cache_t* cache, int size, int sync);
+
+/* return cached descriptor for file opened with flags, or -1 if none,
+ * marks the file as most recently used */
+int mfu_file_cache_get(mfu_file_cache_t* cache, const char* file, int flags);
+
+/* add descriptor fd for file opened with flags, closes the least
+ * recently used file if the cache is full */
+void mfu_file_cache_add(mfu_file_cache_t* cache, const char* file, int flags, int fd);
+
+/* return cached descriptor for file opened with flags,
+ * or open it with mfu_open and add it to the cache,
+ * returns -1 with errno set if the open fails */
+int mfu_file_cache_open(mfu_file_cache_t* cache, const char* file, int flags, mode_t mode);
+
+/* fdatasync all files in the cache that are open for write,
+ * returns 0 on success, -1 if any fsync failed */
+int mfu_file_cache_sync(mfu_file_cache_t* cache);
+
+/* close all files in the cache, returns 0 on success, -1 if any
+ * fdatasync or close failed */
+int mfu_file_cache_close_all(mfu_file_cache_t* cache);
+
+/* close all files and free memory associated with the cache */
+int mfu_file_cache_free(mfu_file_cache_t* cache);
+
+/* sum hits and misses across all ranks and print hit rate from
+ * rank 0 at verbose level, collective over MPI_COMM_WORLD */
+void mfu_file_cache_print(const mfu_file_cache_t* cache, const char* label);
+
 /*****************************
  * Directories
  ****************************/
@@ -79,6 +79,13 @@ void mfu_param_path_check_copy(
     int* flag_copy_into_dir         /* OUT - flag indicating whether source items should be copied into destination directory (1) or not (0) */
 );
 
+/* how mfu_flist_copy forces copied data to stable storage */
+typedef enum {
+    MFU_COPY_SYNC_FILE = 0, /* fdatasync each destination file when it is closed */
+    MFU_COPY_SYNC_FS   = 1, /* syncfs the destination file system after data and after metadata */
+    MFU_COPY_SYNC_NONE = 2, /* leave write back to the operating system */
+} mfu_copy_sync_t;
+
 /* options passed to mfu_flist_copy that affect how a copy is executed */
 typedef struct {
     int    copy_into_dir; /* flag indicating whether copying into existing dir */
@@ -93,6 +100,22 @@ typedef struct {
     char*  block_buf1;    /* buffer to read / write data */
     char*  block_buf2;    /* another buffer to read / write data */
     int    grouplock_id;  /* Lustre grouplock ID */
+    int    dynamic;       /* whether to balance copy work dynamically with work stealing */
+    int    adaptive_chunks; /* whether to pick chunk size per file, chunk_size is then the minimum */
+    uint64_t small_file_size; /* copy regular files smaller than this whole in one pass, 0 to disable */
+    int    node_ranks;    /* max number of ranks per node to give copy work to, 0 for all */
+    uint64_t file_cost;   /* estimated cost to open a file in bytes of data, 0 to balance chunk counts */
+    int    locality;      /* whether to keep files whole on a rank when that costs little balance */
+    int    node_aware;    /* whether to divide copy work evenly among nodes before ranks */
+    int    open_files;    /* max number of source and of destination files each rank keeps open */
+    char*  journal;       /* path prefix of per-rank checkpoint journals, NULL to disable */
+    int    resume;        /* whether to skip work recorded in an existing journal */
+    int    kernel_copy;   /* whether to try reflink and copy_file_range before read and write */
+    int    queue_depth;   /* number of blocks each rank keeps in flight with io_uring, 0 to disable */
+    int    preallocate;   /* whether to fallocate destination files to their full size when created */
+    char*  manifest;      /* path of file to write checksums of copied files to, NULL to disable */
+    mfu_copy_sync_t durability; /* how to force copied data to stable storage */
+    int    autotune;      /* whether to pick block and chunk sizes by timing reads of source files */
 } mfu_copy_opts_t;
 
 /* Given a source item name, determine which source path this item
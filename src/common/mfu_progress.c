@@ -0,0 +1,221 @@
+#include "mfu.h"
+#include "mpi.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* users may override this to change the default */
+int mfu_progress_timeout = 10;
+
+struct mfu_progress_struct {
+    MPI_Comm comm;          /* dup of comm given to start, so our reductions don't mix with others */
+    MPI_Request req;        /* request for outstanding reduction */
+    int active;             /* whether a reduction is outstanding */
+    int ranks;              /* number of ranks in comm */
+    int rank;               /* our rank in comm */
+    int secs;               /* seconds between reductions */
+    char* label;            /* verb to print before counts */
+    double time_start;      /* time at which we started */
+    double time_last;       /* time at which we last started a reduction */
+    uint64_t total_items;   /* global number of items expected, 0 if not known */
+    uint64_t total_bytes;   /* global number of bytes expected, 0 if not known */
+    uint64_t values[3];     /* our current items, bytes, and done flag */
+    uint64_t sendbuf[3];    /* copy of values for outstanding reduction */
+    uint64_t recvbuf[3];    /* result of last reduction */
+};
+
+void mfu_progress_print(const char* label, double secs,
+    uint64_t items, uint64_t total_items,
+    uint64_t bytes, uint64_t total_bytes)
+{
+    char msg[512];
+    size_t len = sizeof(msg);
+    int n = 0;
+
+    /* item counts, with percentage if we know the total */
+    if (total_items > 0) {
+        double pct = (double)items * 100.0 / (double)total_items;
+        n += snprintf(msg + n, len - (size_t)n, "%s %llu of %llu items (%.0lf%%)",
+            label, (unsigned long long)items, (unsigned long long)total_items, pct);
+    } else {
+        n += snprintf(msg + n, len - (size_t)n, "%s %llu items",
+            label, (unsigned long long)items);
+    }
+
+    /* byte counts if the operation moves data */
+    int have_bytes = (bytes > 0 || total_bytes > 0);
+    if (have_bytes) {
+        double val;
+        const char* units;
+        mfu_format_bytes(bytes, &val, &units);
+        n += snprintf(msg + n, len - (size_t)n, ", %.3lf %s", val, units);
+
+        if (total_bytes > 0) {
+            double total_val;
+            const char* total_units;
+            mfu_format_bytes(total_bytes, &total_val, &total_units);
+            double pct = (double)bytes * 100.0 / (double)total_bytes;
+            n += snprintf(msg + n, len - (size_t)n, " of %.3lf %s (%.0lf%%)",
+                total_val, total_units, pct);
+        }
+    }
+
+    /* rate in bytes if we have them, items otherwise */
+    double rate = 0.0;
+    if (secs > 0.0) {
+        rate = (double)(have_bytes ? bytes : items) / secs;
+    }
+    if (have_bytes) {
+        double rate_val;
+        const char* rate_units;
+        mfu_format_bytes((uint64_t)rate, &rate_val, &rate_units);
+        n += snprintf(msg + n, len - (size_t)n, " in %.3lf secs (%.3lf %s/sec)",
+            secs, rate_val, rate_units);
+    } else {
+        n += snprintf(msg + n, len - (size_t)n, " in %.3lf secs (%.3lf items/sec)",
+            secs, rate);
+    }
+
+    /* estimate time remaining from whichever total we know */
+    double remaining = -1.0;
+    if (total_bytes > 0 && bytes > 0 && rate > 0.0 && have_bytes) {
+        uint64_t left = (bytes < total_bytes) ? total_bytes - bytes : 0;
+        remaining = (double)left / rate;
+    } else if (total_items > 0 && items > 0 && rate > 0.0 && !have_bytes) {
+        uint64_t left = (items < total_items) ? total_items - items : 0;
+        remaining = (double)left / rate;
+    }
+    if (remaining >= 0.0) {
+        n += snprintf(msg + n, len - (size_t)n, ", %.0lf secs left", remaining);
+    }
+
+    /* get current time */
+    char now_s[30];
+    time_t now = time(NULL);
+    size_t rc = strftime(now_s, sizeof(now_s) - 1, "%FT%T", localtime(&now));
+    if (rc == 0) {
+        now_s[0] = '\0';
+    }
+
+    /* print status to stdout */
+    printf("%s: %s ...\n", now_s, msg);
+    fflush(stdout);
+}
+
+/* start a reduction of our current values */
+static void mfu_progress_reduce(mfu_progress* prg)
+{
+    memcpy(prg->sendbuf, prg->values, sizeof(prg->values));
+    MPI_Iallreduce(prg->sendbuf, prg->recvbuf, 3, MPI_UINT64_T, MPI_SUM,
+        prg->comm, &prg->req);
+    prg->active = 1;
+    prg->time_last = MPI_Wtime();
+}
+
+/* print result of the reduction that just completed from rank 0 */
+static void mfu_progress_report(const mfu_progress* prg)
+{
+    if (prg->rank == 0) {
+        double secs = MPI_Wtime() - prg->time_start;
+        mfu_progress_print(prg->label, secs,
+            prg->recvbuf[0], prg->total_items,
+            prg->recvbuf[1], prg->total_bytes);
+    }
+}
+
+mfu_progress* mfu_progress_start(int secs, const char* label,
+    uint64_t total_items, uint64_t total_bytes, MPI_Comm comm)
+{
+    /* nothing to track if progress messages are disabled */
+    if (secs <= 0) {
+        return NULL;
+    }
+
+    mfu_progress* prg = (mfu_progress*) MFU_MALLOC(sizeof(mfu_progress));
+
+    /* use our own communicator so outstanding reductions
+     * can't be matched with collectives issued by the caller */
+    MPI_Comm_dup(comm, &prg->comm);
+    MPI_Comm_size(prg->comm, &prg->ranks);
+    MPI_Comm_rank(prg->comm, &prg->rank);
+
+    /* sum totals across ranks */
+    uint64_t totals[2], all_totals[2];
+    totals[0] = total_items;
+    totals[1] = total_bytes;
+    MPI_Allreduce(totals, all_totals, 2, MPI_UINT64_T, MPI_SUM, prg->comm);
+
+    prg->req         = MPI_REQUEST_NULL;
+    prg->active      = 0;
+    prg->secs        = secs;
+    prg->label       = MFU_STRDUP(label);
+    prg->time_start  = MPI_Wtime();
+    prg->time_last   = prg->time_start;
+    prg->total_items = all_totals[0];
+    prg->total_bytes = all_totals[1];
+    memset(prg->values,  0, sizeof(prg->values));
+    memset(prg->sendbuf, 0, sizeof(prg->sendbuf));
+    memset(prg->recvbuf, 0, sizeof(prg->recvbuf));
+
+    return prg;
+}
+
+void mfu_progress_update(mfu_progress* prg, uint64_t items, uint64_t bytes)
+{
+    if (prg == NULL) {
+        return;
+    }
+
+    prg->values[0] = items;
+    prg->values[1] = bytes;
+
+    /* check whether the outstanding reduction has completed,
+     * all ranks have joined it once it has */
+    if (prg->active) {
+        int flag;
+        MPI_Test(&prg->req, &flag, MPI_STATUS_IGNORE);
+        if (! flag) {
+            return;
+        }
+        prg->active = 0;
+        mfu_progress_report(prg);
+    }
+
+    /* start a new reduction if our timer has expired */
+    if (MPI_Wtime() - prg->time_last >= (double)prg->secs) {
+        mfu_progress_reduce(prg);
+    }
+}
+
+void mfu_progress_complete(mfu_progress** pprg, uint64_t items, uint64_t bytes)
+{
+    mfu_progress* prg = *pprg;
+    if (prg == NULL) {
+        return;
+    }
+
+    prg->values[0] = items;
+    prg->values[1] = bytes;
+    prg->values[2] = 1;
+
+    /* keep joining reductions started by ranks that are still
+     * working until every rank reports that it is done */
+    while (1) {
+        if (! prg->active) {
+            mfu_progress_reduce(prg);
+        }
+        MPI_Wait(&prg->req, MPI_STATUS_IGNORE);
+        prg->active = 0;
+
+        if (prg->recvbuf[2] == (uint64_t)prg->ranks) {
+            break;
+        }
+        mfu_progress_report(prg);
+    }
+
+    MPI_Comm_free(&prg->comm);
+    mfu_free(&prg->label);
+    mfu_free(pprg);
+}
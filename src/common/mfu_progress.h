@@ -0,0 +1,70 @@
+/* defines routines to periodically report progress of long-running
+ * operations like walk, copy, compare, and remove */
+
+/* enable C++ codes to include this header directly */
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef MFU_PROGRESS_H
+#define MFU_PROGRESS_H
+
+#include <stdint.h>
+#include "mpi.h"
+
+/* Each process keeps running counts of the items and bytes it has
+ * processed and passes them to mfu_progress_update as it goes.
+ * Every so many seconds, processes sum their counts with a
+ * nonblocking allreduce, and rank 0 prints the totals along with
+ * the rate and an estimate of the time remaining.  A process never
+ * waits on another in mfu_progress_update, it only tests whether
+ * the outstanding reduction has completed.  Processes that finish
+ * early call mfu_progress_complete, which keeps joining reductions
+ * until all processes have finished.
+ *
+ *   mfu_progress* prg = mfu_progress_start(mfu_progress_timeout,
+ *       "Copied", local_items, local_bytes, MPI_COMM_WORLD);
+ *   for (...) {
+ *       ... process an item ...
+ *       items++;
+ *       bytes += size;
+ *       mfu_progress_update(prg, items, bytes);
+ *   }
+ *   mfu_progress_complete(&prg, items, bytes); */
+
+/* number of seconds between progress messages, 0 disables them,
+ * users may override this to change the default */
+extern int mfu_progress_timeout;
+
+typedef struct mfu_progress_struct mfu_progress;
+
+/* start tracking progress, prints a message every secs seconds
+ * labeled with the given verb, e.g., "Copied", total_items and
+ * total_bytes are the number of items and bytes this process
+ * expects to handle, either can be 0 if not known, returns NULL
+ * if secs is 0, collective over comm */
+mfu_progress* mfu_progress_start(int secs, const char* label,
+    uint64_t total_items, uint64_t total_bytes, MPI_Comm comm);
+
+/* update progress with the number of items and bytes this process
+ * has handled so far, never blocks, does nothing if prg is NULL */
+void mfu_progress_update(mfu_progress* prg, uint64_t items, uint64_t bytes);
+
+/* mark this process as finished with its final counts, waits for
+ * all processes in comm to finish and frees prg, collective over
+ * the comm given to mfu_progress_start */
+void mfu_progress_complete(mfu_progress** pprg, uint64_t items, uint64_t bytes);
+
+/* print a progress message from the calling process given counts
+ * and totals summed across processes and the seconds elapsed since
+ * the operation started, a total of 0 means it is not known */
+void mfu_progress_print(const char* label, double secs,
+    uint64_t items, uint64_t total_items,
+    uint64_t bytes, uint64_t total_bytes);
+
+#endif /* MFU_PROGRESS_H */
+
+/* enable C++ codes to include this header directly */
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
@@ -9,6 +9,10 @@
 #include <errno.h>
 #include <limits.h>
 
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#endif
+
 #ifndef ULLONG_MAX 
 #define ULLONG_MAX (__LONG_LONG_MAX__ * 2UL + 1UL)
 #endif
@@ -547,3 +551,154 @@ uint32_t mfu_hash_jenkins(const char* key, size_t len)
     hash += (hash << 15);
     return hash;
 }
+
+/* check bytes one at a time, used for short buffers and the
+ * unaligned head and tail of longer ones */
+static int mfu_is_zero_bytes(const unsigned char* buf, size_t size)
+{
+    size_t i;
+    for (i = 0; i < size; i++) {
+        if (buf[i] != 0) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* check 64 bytes at a time with word loads, ORing the words
+ * together so the compiler can keep them in registers */
+static int mfu_is_zero_words(const unsigned char* buf, size_t size)
+{
+    /* get to an 8-byte boundary */
+    size_t head = (size_t)(-(uintptr_t)buf & (sizeof(uint64_t) - 1));
+    if (head > size) {
+        head = size;
+    }
+    if (! mfu_is_zero_bytes(buf, head)) {
+        return 0;
+    }
+    buf  += head;
+    size -= head;
+
+    const uint64_t* words = (const uint64_t*) buf;
+    size_t count = size / sizeof(uint64_t);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        uint64_t bits = words[i + 0] | words[i + 1] | words[i + 2] | words[i + 3] |
+                        words[i + 4] | words[i + 5] | words[i + 6] | words[i + 7];
+        if (bits != 0) {
+            return 0;
+        }
+    }
+    for (; i < count; i++) {
+        if (words[i] != 0) {
+            return 0;
+        }
+    }
+
+    size_t done = count * sizeof(uint64_t);
+    return mfu_is_zero_bytes(buf + done, size - done);
+}
+
+#if defined(__x86_64__) && defined(__GNUC__)
+/* check 128 bytes at a time with AVX2, only called if the
+ * processor supports it, so we compile it for AVX2 regardless
+ * of the flags used for the rest of the library */
+__attribute__((target("avx2")))
+static int mfu_is_zero_avx2(const unsigned char* buf, size_t size)
+{
+    /* get to a 32-byte boundary */
+    size_t head = (size_t)(-(uintptr_t)buf & 31);
+    if (head > size) {
+        head = size;
+    }
+    if (! mfu_is_zero_bytes(buf, head)) {
+        return 0;
+    }
+    buf  += head;
+    size -= head;
+
+    size_t i = 0;
+    for (; i + 128 <= size; i += 128) {
+        __m256i v0 = _mm256_load_si256((const __m256i*)(buf + i +  0));
+        __m256i v1 = _mm256_load_si256((const __m256i*)(buf + i + 32));
+        __m256i v2 = _mm256_load_si256((const __m256i*)(buf + i + 64));
+        __m256i v3 = _mm256_load_si256((const __m256i*)(buf + i + 96));
+        __m256i v  = _mm256_or_si256(_mm256_or_si256(v0, v1), _mm256_or_si256(v2, v3));
+        if (! _mm256_testz_si256(v, v)) {
+            return 0;
+        }
+    }
+
+    return mfu_is_zero_words(buf + i, size - i);
+}
+#endif
+
+/* implementation picked on first call based on the processor */
+static int (*mfu_is_zero_fn)(const unsigned char* buf, size_t size) = NULL;
+
+int mfu_is_zero(const void* buf, size_t size)
+{
+    if (mfu_is_zero_fn == NULL) {
+        mfu_is_zero_fn = mfu_is_zero_words;
+#if defined(__x86_64__) && defined(__GNUC__)
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            mfu_is_zero_fn = mfu_is_zero_avx2;
+        }
+#endif
+    }
+    return mfu_is_zero_fn((const unsigned char*) buf, size);
+}
+
+/* murmur3 64-bit finalizer, mixes all bits of x, and maps 0 to 0 */
+static inline uint64_t mfu_hash_mix(uint64_t x)
+{
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+/* each little-endian word of the file is mixed and multiplied by
+ * an odd weight that depends on its position, so moving data within
+ * a file changes the sum, the weights are 2*i+1 times a constant
+ * for the i-th word of the file */
+#define MFU_HASH_WEIGHT (0x9e3779b97f4a7c15ULL)
+
+/* read 8 bytes as a little-endian word, written out so compilers
+ * turn it into a single load on little-endian machines */
+static inline uint64_t mfu_hash_load(const unsigned char* p)
+{
+    return  (uint64_t) p[0]        | ((uint64_t) p[1] << 8)  |
+           ((uint64_t) p[2] << 16) | ((uint64_t) p[3] << 24) |
+           ((uint64_t) p[4] << 32) | ((uint64_t) p[5] << 40) |
+           ((uint64_t) p[6] << 48) | ((uint64_t) p[7] << 56);
+}
+
+uint64_t mfu_hash_data(uint64_t offset, const void* buf, size_t size)
+{
+    const unsigned char* ptr = (const unsigned char*) buf;
+    uint64_t weight = (2 * (offset / 8) + 1) * MFU_HASH_WEIGHT;
+    uint64_t step   = 2 * MFU_HASH_WEIGHT;
+    uint64_t sum = 0;
+
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word = mfu_hash_load(ptr + i);
+        sum += mfu_hash_mix(word) * weight;
+        weight += step;
+    }
+
+    /* pad a partial word at the end of the file with zeros */
+    if (i < size) {
+        unsigned char last[8] = {0};
+        memcpy(last, ptr + i, size - i);
+        uint64_t word = mfu_hash_load(last);
+        sum += mfu_hash_mix(word) * weight;
+    }
+
+    return sum;
+}
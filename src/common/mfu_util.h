@@ -178,6 +178,17 @@ void mfu_unpack_uint64(const char** pptr, uint64_t* value);
 /* Bob Jenkins one-at-a-time hash: http://en.wikipedia.org/wiki/Jenkins_hash_function */
 uint32_t mfu_hash_jenkins(const char* key, size_t len);
 
+/* return 1 if all size bytes in buf are 0, 0 otherwise, stops at the
+ * first nonzero word, uses AVX2 if the processor supports it */
+int mfu_is_zero(const void* buf, size_t size);
+
+/* checksum size bytes of file data that start at the given byte
+ * offset in the file, which must be a multiple of 8, the checksum of
+ * a file is the sum of the checksums of its pieces, so pieces hashed
+ * by different processes can be added in any order, and since zeros
+ * add nothing, holes in sparse files need not be read */
+uint64_t mfu_hash_data(uint64_t offset, const void* buf, size_t size);
+
 #endif /* MFU_UTIL_H */
 
 /* enable C++ codes to include this header directly */
@@ -54,26 +54,6 @@ static int gcs_shm_file_key = MPI_KEYVAL_INVALID;
 
 static strmap* gcs_shm_ptr_tree = NULL;
 
-/* split input communicator into subcommunicators using string as a color,
- * str cannot be NULL */
-static void comm_split_str(MPI_Comm comm, const char* str, MPI_Comm* newcomm)
-{
-    /* use DTCMP to rank strings */
-    uint64_t groups;
-    uint64_t group_id;
-    uint64_t group_ranks;
-    uint64_t group_rank;
-    DTCMP_Rank_strings(1, &str, &groups, &group_id, &group_ranks, &group_rank, DTCMP_FLAG_NONE, comm);
-
-    /* use our group id as our color value*/
-    int color = (int) group_id;
-
-    /* split the communicator */
-    MPI_Comm_split(comm, color, 0, newcomm);
-
-    return;
-}
-
 /* determine whether any value is true */
 static int gcs_anytrue(int value, MPI_Comm comm)
 {
@@ -490,6 +470,7 @@ static void print_usage(void)
     printf("\n");
     printf("Options:\n");
     printf("  -s, --size <SIZE>  - block size to divide files (default 1MB)\n");
+    printf("  -n, --per-node <N> - limit number of processes per node that read the file\n");
     printf("  -h, --help         - print usage\n");
     printf("\n");
     fflush(stdout);
@@ -523,10 +504,14 @@ int main (int argc, char *argv[])
     /* TODO: set this to size of lustre stripe of the file/system */
     uint64_t stripe_size = 1024 * 1024;
 
+    /* max number of readers on each node, 0 for all */
+    int per_node = 0;
+
     /* process any options */
     int option_index = 0;
     static struct option long_options[] = {
         {"size",         1, 0, 's'},
+        {"per-node",     1, 0, 'n'},
         {"help",         0, 0, 'h'},
         {0, 0, 0, 0}
     };
@@ -535,7 +520,7 @@ int main (int argc, char *argv[])
     int usage = 0;
     while (1) {
         int c = getopt_long(
-                    argc, argv, "s:h",
+                    argc, argv, "s:n:h",
                     long_options, &option_index
                 );
 
@@ -555,6 +540,17 @@ int main (int argc, char *argv[])
                 }
                 stripe_size = (uint64_t) byte_val;
                 break;
+            case 'n':
+                /* parse max readers per node from command line */
+                per_node = atoi(optarg);
+                if (per_node < 1) {
+                    if (rank == 0) {
+                        printf("ERROR: Number of processes per node must be at least 1: %s\n", optarg);
+                        fflush(stdout);
+                    }
+                    usage = 1;
+                }
+                break;
             case 'h':
                 usage = 1;
                 break;
@@ -587,59 +583,22 @@ int main (int argc, char *argv[])
     char* in_file_path  = mfu_path_strdup_abs_reduce_str(argv[optind]);
     char* out_file_path = mfu_path_strdup_abs_reduce_str(argv[optind + 1]);
 
-    /* put procs on same node into a subcommunicator */
-    /* split on hostname */
+    /* put procs on same node into a subcommunicator,
+     * these are the procs that can share memory segments */
     MPI_Comm node_comm;
-    comm_split_str(MPI_COMM_WORLD, hostname, &node_comm);
+    MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL, &node_comm);
 
     /* get our rank and number of ranks in our node comm */
     int node_rank, node_size;
     MPI_Comm_rank(node_comm, &node_rank);
     MPI_Comm_size(node_comm, &node_size);
 
-    /* we'll split into levels, but we want each level to be ordered
-     * the same by node, so we use our node leader's rank as a key */
-    int key = rank;
-    MPI_Bcast(&key, 1, MPI_INT, 0, node_comm);
-
-    /* split across nodes into levels */
-    MPI_Comm level_comm;
-    MPI_Comm_split(MPI_COMM_WORLD, node_rank, key, &level_comm);
-
-    /* get our rank and number of ranks in the level communicator */
-    int level_rank, level_size;
-    MPI_Comm_rank(level_comm, &level_rank);
-    MPI_Comm_size(level_comm, &level_size);
-
-    /* ensure that all nodes have same number of procs,
-     * makes math easier when dividing up work */
-
-    /* get number of procs on our node and max number of procs on any node */
-    int max_node_size;
-    MPI_Allreduce(&node_size, &max_node_size, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
-
-    /* determine whether all nodes have the same number of procs */
-    int same_count = 1;
-    if (node_size != max_node_size) {
-        same_count = 0;
-    }
-    int all_same_count;
-    MPI_Allreduce(&same_count, &all_same_count, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
-
-    /* bail out if we have different nodes have different numbers of procs */
-    if (! all_same_count) {
-        if (rank == 0) {
-            printf("ERROR: Must run with same number of tasks on all nodes\n");
-            fflush(stdout);
-        }
-        MPI_Finalize();
-        mfu_free(&out_file_path);
-        mfu_free(&in_file_path);
-        return 0;
-    }
+    /* get the fewest procs on any node */
+    int min_node_size;
+    MPI_Allreduce(&node_size, &min_node_size, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
 
     /* ensure that each node has at least two procs */
-    if (node_size < 2) {
+    if (min_node_size < 2) {
         if (rank == 0) {
             printf("ERROR: Must run with at least two tasks per node\n");
             fflush(stdout);
@@ -650,6 +609,44 @@ int main (int argc, char *argv[])
         return 0;
     }
 
+    /* segments are divided evenly among nodes first and then among the
+     * readers on each node, so every node must have the same number of
+     * readers, use as many as the smallest node has, up to per_node,
+     * and leave any other procs idle so nodes running more procs are
+     * not given more data to read */
+    int node_readers = min_node_size - 1;
+    if (per_node > 0 && per_node < node_readers) {
+        node_readers = per_node;
+    }
+    int active = (node_rank <= node_readers);
+
+    /* we'll split into levels, but we want each level to be ordered
+     * the same by node, so we use our node leader's rank as a key */
+    int key = rank;
+    MPI_Bcast(&key, 1, MPI_INT, 0, node_comm);
+
+    /* split across nodes into levels, idle procs are left out */
+    int color = active ? node_rank : MPI_UNDEFINED;
+    MPI_Comm level_comm;
+    MPI_Comm_split(MPI_COMM_WORLD, color, key, &level_comm);
+
+    /* get our rank and number of ranks in the level communicator,
+     * each level has one proc from every node */
+    int level_rank = 0;
+    int level_size = 0;
+    if (active) {
+        MPI_Comm_rank(level_comm, &level_rank);
+        MPI_Comm_size(level_comm, &level_size);
+    }
+
+    /* let the user know if some procs will sit idle */
+    int max_node_size;
+    MPI_Allreduce(&node_size, &max_node_size, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+    if (rank == 0 && node_readers + 1 < max_node_size) {
+        printf("Using %d readers per node, other tasks are idle\n", node_readers);
+        fflush(stdout);
+    }
+
     /* check that we can read the input from at least rank 0
      * to catch simple typos */
     int readable = 1;
@@ -709,7 +706,7 @@ int main (int argc, char *argv[])
 
     /* we'll create multiple shared memory segments,
      * two for each reader process */
-    int bufcounts = (node_size - 1) * 2;
+    int bufcounts = node_readers * 2;
     void** shmbuf_base = (void**) malloc(bufcounts * sizeof(void*));
     void** shmbuf      = (void**) malloc(bufcounts * sizeof(void*));
 
@@ -764,13 +761,16 @@ int main (int argc, char *argv[])
 
     /* identify number of reader tasks and assign a rank to each one */
 
-    /* tasks with node_rank == 0 are excluded from this set */
-    int reader_size = ranks - level_size;
+    /* every node has node_readers readers, the node leaders know the
+     * number of nodes from their level, so count those */
+    int num_nodes = (node_rank == 0) ? level_size : 0;
+    MPI_Bcast(&num_nodes, 1, MPI_INT, 0, node_comm);
+    int reader_size = num_nodes * node_readers;
 
     /* assign ranks so that readers on the same node are in
      * consecutive order (remember to exclude node_rank == 0 from
      * each node) */
-    int reader_rank = level_rank * (node_size - 1) + (node_rank - 1);
+    int reader_rank = level_rank * node_readers + (node_rank - 1);
 
     /* rank 0 on each node will write file, others will read from input */
     if (node_rank == 0) {
@@ -843,7 +843,7 @@ int main (int argc, char *argv[])
                 write_error = 1;
             }
         }
-    } else {
+    } else if (active) {
         /* open input file for reading if we're a reader */
         in_file = mfu_open(in_file_path, O_RDONLY);
         if (in_file < 0) {
@@ -861,7 +861,7 @@ int main (int argc, char *argv[])
 
     double time_start = MPI_Wtime();
 
-    /* compute rank on left side */
+    /* compute rank on left side, idle procs don't use these */
     int left = level_rank - 1;
     if (left < 0) {
       left = level_size - 1;
@@ -874,7 +874,7 @@ int main (int argc, char *argv[])
     }
 
 /* readers */
-if (node_rank != 0) {
+if (node_rank != 0 && active) {
     /* read back parts of output file and broadcast */
     MPI_Request request[3];
     MPI_Status  status[3];
@@ -925,7 +925,7 @@ if (node_rank != 0) {
                 if (lev_incoming >= level_size) {
                     lev_incoming -= level_size;
                 }
-                int read_rank_incoming = lev_incoming * (node_size - 1) + (node_rank - 1);
+                int read_rank_incoming = lev_incoming * node_readers + (node_rank - 1);
 
                 /* get offset and size of incoming data */
                 off_t pos2;
@@ -995,13 +995,13 @@ if (node_rank == 0) {
                 int lev;
                 for (lev = 0; lev < level_size; lev++) {
                 int node;
-                for (node = 1; node < node_size; node++) {
+                for (node = 1; node <= node_readers; node++) {
                     /* determine source of data we'll receive in this step */
                     int lev_incoming = level_rank + lev;
                     if (lev_incoming >= level_size) {
                         lev_incoming -= level_size;
                     }
-                    int read_rank_incoming = lev_incoming * (node_size - 1) + (node - 1);
+                    int read_rank_incoming = lev_incoming * node_readers + (node - 1);
 
                     /* get offset and size of bytes for this reader */
                     off_t pos;
@@ -1023,9 +1023,18 @@ if (node_rank == 0) {
                         /* assume that we'll be writing data */
                         int write_data = 1;
 
+                        /* a chunk of zeros can compare against the existing data
+                         * with a single pass over the read buffer */
+                        int zero_chunk = mfu_is_zero(copybuf, size);
+
                         /* if the file already exists, read in this segment and compare
                          * it to what we should be writing */
-                        if (file_exists) {
+                        if (! file_exists && zero_chunk) {
+                            /* we created the file empty and truncate it to its
+                             * full size at the end, so skip writing zeros and
+                             * leave a hole */
+                            write_data = 0;
+                        } else if (file_exists) {
                             /* file exists, now assume it's the same content so that
                              * we don't need to write this data */
                             write_data = 0;
@@ -1044,7 +1053,10 @@ if (node_rank == 0) {
                             ssize_t return_size = mfu_read(out_file_path, out_file, readbuf, size);
                             if (return_size == (ssize_t)size) {
                                 /* we read the correct number of bytes, now compare them */
-                                if (memcmp(readbuf, copybuf, size) != 0) {
+                                int same = zero_chunk ?
+                                    mfu_is_zero(readbuf, size) :
+                                    (memcmp(readbuf, copybuf, size) == 0);
+                                if (! same) {
                                     /* found a difference so overwrite existing data */
                                     write_data = 1;
                                 }
@@ -1176,7 +1188,7 @@ if (node_rank == 0) {
                 perror(error_msg);
             }
         }
-    } else {
+    } else if (active) {
         /* readers close input file */
         if (mfu_close(in_file_path, in_file) != 0) {
             snprintf(error_msg, 8192, "%s: Failed to close file %s", hostname, in_file_path);
@@ -1215,7 +1227,9 @@ if (node_rank == 0) {
     mfu_free(&in_file_path);
 
     /* free our node and level communicators */
-    MPI_Comm_free(&level_comm);
+    if (level_comm != MPI_COMM_NULL) {
+        MPI_Comm_free(&level_comm);
+    }
     MPI_Comm_free(&node_comm);
 
     mfu_finalize();
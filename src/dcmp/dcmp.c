@@ -30,6 +30,11 @@ static void print_usage(void)
     printf("  -o, --output <EXPR:FILE>  - write list of entries matching EXPR to FILE\n");
     printf("  -t, --text                - change output option to write in text format\n");
     printf("  -b, --base                - enable base checks and normal output with --output\n");
+    printf("      --adaptive            - pick chunk size for each file from file and job size\n");
+    printf("      --autotune            - pick block and chunk sizes by timing reads of source files\n");
+    printf("      --locality            - keep files whole on a process when that costs little balance\n");
+    printf("      --node-aware          - divide work evenly among nodes, then among processes on each\n");
+    printf("      --progress <N>        - print progress every N seconds, 0 to disable (default 10)\n");
     printf("  -v, --verbose             - verbose output\n");
     //printf("  -d, --debug               - run in debug mode\n");
     printf("  -h, --help                - print usage\n");
@@ -475,27 +480,27 @@ static int dcmp_compare_data(
     off_t offset,
     size_t length,
     size_t buff_size,
+    mfu_file_cache_t* src_cache,
+    mfu_file_cache_t* dst_cache,
     mfu_copy_opts_t* mfu_copy_opts)
 {
-    /* open source file */
-    int src_fd = mfu_open(src_name, O_RDONLY);
+    /* open source file, or reuse descriptor from an earlier section */
+    int src_fd = mfu_file_cache_open(src_cache, src_name, O_RDONLY, 0);
     if (src_fd < 0) {
        /* log error if there is an open failure on the 
         * src side */
         MFU_LOG(MFU_LOG_ERR, "Failed to open %s, error msg: %s", 
           src_name, strerror(errno));
-        mfu_close(src_name, src_fd);
        return -1;
     }
 
     /* open destination file */
-    int dst_fd = mfu_open(dst_name, O_RDONLY);
+    int dst_fd = mfu_file_cache_open(dst_cache, dst_name, O_RDONLY, 0);
     if (dst_fd < 0) {
        /* log error if there is an open failure on the 
         * dst side */
         MFU_LOG(MFU_LOG_ERR, "Failed to open %s, error msg: %s", 
           dst_name, strerror(errno));
-        mfu_close(src_name, src_fd);
         return -1;
     }
 
@@ -512,8 +517,6 @@ static int dcmp_compare_data(
         * src side */
         MFU_LOG(MFU_LOG_ERR, "Failed to lseek %s, offset: %x, error msg: %s",
           src_name, (unsigned long)offset, strerror(errno));
-        mfu_close(dst_name, dst_fd);
-        mfu_close(src_name, src_fd);
         return -1;
     }
     
@@ -523,8 +526,6 @@ static int dcmp_compare_data(
         * dst side */
         MFU_LOG(MFU_LOG_ERR, "Failed to lseek %s, offset: %x, error msg: %s",  
           dst_name, (unsigned long)offset, strerror(errno));
-        mfu_close(dst_name, dst_fd);
-        mfu_close(src_name, src_fd);
         return -1;
     }
 
@@ -609,9 +610,7 @@ static int dcmp_compare_data(
     mfu_free(&dest_buf);
     mfu_free(&src_buf);
 
-    /* close files */
-    mfu_close(dst_name, dst_fd);
-    mfu_close(src_name, src_fd);
+    /* files are left open in the caches for the next section */
 
     return rc;
 }
@@ -793,28 +792,30 @@ static void dcmp_strmap_compare_data(
     size_t strlen_prefix,
     mfu_copy_opts_t* mfu_copy_opts)
 {
-    /* get the largest filename */
-    uint64_t max_name = mfu_flist_file_max_name(src_compare_list);
-
-    /* get chunk size for copying files (just hard-coded for now) */
-    uint64_t chunk_size = 1024 * 1024;
-
-    /* get the linked list of file chunks for the src and dest */
-    mfu_file_chunk* src_head = mfu_file_chunk_list_alloc(src_compare_list, chunk_size);
-    mfu_file_chunk* dst_head = mfu_file_chunk_list_alloc(dst_compare_list, chunk_size);
-
-    /* get a count of how many items are the compare list and total
-     * number of bytes we'll read */
-    uint64_t list_count = 0;
-    mfu_file_chunk* src_p = src_head;
-    while (src_p != NULL) {
-        list_count++;
-        src_p = src_p->next;
-    }
-
-    /* keys are the filename, so only bytes that belong to 
-     * the same file will be compared via a flag in the segmented scan */
-    char* keys = (char*) MFU_MALLOC(list_count * max_name);
+    /* pick chunk size for each file from the file size, total bytes,
+     * and number of ranks, using the copy chunk size as the minimum,
+     * src and dest lists have the same file sizes so they split the same */
+    mfu_chunk_opts_t chunk_opts;
+    chunk_opts.chunk_size = (uint64_t) mfu_copy_opts->chunk_size;
+    chunk_opts.adaptive   = mfu_copy_opts->adaptive_chunks;
+    chunk_opts.align      = 0;
+    chunk_opts.locality   = mfu_copy_opts->locality;
+    chunk_opts.node_aware = mfu_copy_opts->node_aware;
+    chunk_opts.node_ranks = mfu_copy_opts->node_ranks;
+    chunk_opts.file_cost  = mfu_copy_opts->file_cost;
+
+    /* get the arrays of file chunks for the src and dest */
+    mfu_file_chunk_array* src_chunks = mfu_file_chunk_array_alloc(src_compare_list, &chunk_opts);
+    mfu_file_chunk_array* dst_chunks = mfu_file_chunk_array_alloc(dst_compare_list, &chunk_opts);
+
+    /* get a count of how many items are the compare list */
+    uint64_t list_count = src_chunks->count;
+
+    /* keys are the rank and index of the owner of the file, which
+     * uniquely identify it, so only bytes that belong to the same file
+     * will be compared via a flag in the segmented scan, we use these
+     * rather than the file name so keys don't scale with the longest path */
+    uint64_t* keys = (uint64_t*) MFU_MALLOC(list_count * 2 * sizeof(uint64_t));
 
     /* vals pointer allocation for input to segmented scan, so 
      * dcmp_compare_data will return a 1 or 0 for each set of bytes */
@@ -825,12 +826,32 @@ static void dcmp_strmap_compare_data(
     int* ltr  = (int*) MFU_MALLOC(list_count * sizeof(int));
     int* rtl  = (int*) MFU_MALLOC(list_count * sizeof(int)); 
 
+    /* keep files open across sections, since a rank is often
+     * given several sections of the same file */
+    mfu_file_cache_t src_cache;
+    mfu_file_cache_t dst_cache;
+    mfu_file_cache_init(&src_cache, mfu_copy_opts->open_files, 0);
+    mfu_file_cache_init(&dst_cache, mfu_copy_opts->open_files, 0);
+
+    /* total up bytes to compare, so progress messages can estimate
+     * how much time is left */
+    uint64_t i;
+    uint64_t total_bytes = 0;
+    for (i = 0; i < list_count; i++) {
+        total_bytes += src_chunks->chunks[i].length;
+    }
+    uint64_t bytes = 0;
+    mfu_progress* prg = mfu_progress_start(mfu_progress_timeout, "Compared",
+        list_count, total_bytes, MPI_COMM_WORLD);
+
     /* compare bytes for each file section and set flag based on what we find */
-    uint64_t i = 0;
-    char* name_ptr = keys;
-    src_p = src_head;
-    mfu_file_chunk* dst_p = dst_head;
-    while (src_p != NULL) {
+    for (i = 0; i < list_count; i++) {
+        /* src and dest lists split the same, so sections line up */
+        const mfu_file_chunk_desc* src_p = &src_chunks->chunks[i];
+        const mfu_file_chunk_desc* dst_p = &dst_chunks->chunks[i];
+        const char* src_name = src_chunks->names[src_p->name_id];
+        const char* dst_name = dst_chunks->names[dst_p->name_id];
+
         /* get offset into file that we should compare (bytes) */
         off_t offset = (off_t)src_p->offset;
 
@@ -838,40 +859,52 @@ static void dcmp_strmap_compare_data(
         off_t length = (off_t)src_p->length;
         
         /* compare the contents of the files */
-        int rc = dcmp_compare_data(src_p->name, dst_p->name, offset, 
-                (size_t)length, 1048576, mfu_copy_opts);
+        int rc = dcmp_compare_data(src_name, dst_name, offset, 
+                (size_t)length, mfu_copy_opts->block_size, &src_cache, &dst_cache, mfu_copy_opts);
         if (rc == -1) {
             /* we hit an error while reading, consider files to be different,
              * they could be the same, but we'll draw attention to them this way */
             rc = 1;
             MFU_LOG(MFU_LOG_ERR,
               "Failed to open, lseek, or read %s and/or %s. Assuming contents are different.",
-                 src_p->name, dst_p->name);
+                 src_name, dst_name);
         }
 
         /* now record results of compare_data for sending to segmented scan */
-        strncpy(name_ptr, src_p->name, max_name);
+        keys[2 * i]     = src_p->rank_of_owner;
+        keys[2 * i + 1] = src_p->index_of_owner;
         vals[i] = rc;
 
         /* initialize our output values (have to do this because of exscan) */
         ltr[i] = 0;
         rtl[i] = 0;
 
-        /* move to the start of the next filename */
-        name_ptr += max_name;
-        i++;
-
-        /* update pointers for src and dest in linked list */
-        src_p = src_p->next;
-        dst_p = dst_p->next;
+        /* report progress */
+        bytes += (uint64_t)length;
+        mfu_progress_update(prg, i + 1, bytes);
     }
 
-    /* create type and comparison operation for file names for the segmented scan */
+    /* wait for other ranks to finish comparing */
+    mfu_progress_complete(&prg, list_count, bytes);
+
+    /* close files and report how often sections found them open */
+    mfu_file_cache_print(&src_cache, "Source");
+    mfu_file_cache_print(&dst_cache, "Destination");
+    mfu_file_cache_free(&src_cache);
+    mfu_file_cache_free(&dst_cache);
+
+    /* create type and comparison operation for owner rank and index */
     MPI_Datatype keytype;
+    MPI_Type_contiguous(2, MPI_UINT64_T, &keytype);
+    MPI_Type_commit(&keytype);
+
     DTCMP_Op keyop;
-    DTCMP_Str_create_ascend((int)max_name, &keytype, &keyop);
+    DTCMP_Op keyops[2];
+    keyops[0] = DTCMP_OP_UINT64T_ASCEND;
+    keyops[1] = DTCMP_OP_UINT64T_ASCEND;
+    DTCMP_Op_create_series(2, keyops, &keyop);
 
-    /* execute segmented scan of comparison flags across file names */
+    /* execute segmented scan of comparison flags across files */
     DTCMP_Segmented_exscanv((int)list_count, keys, keytype, keyop, vals, ltr, rtl, MPI_INT, MPI_LOR, DTCMP_FLAG_NONE, MPI_COMM_WORLD);
     for (i = 0; i < list_count; i++) {
         /* turn segmented exscan into scan by or'ing in our input */
@@ -906,10 +939,10 @@ static void dcmp_strmap_compare_data(
      * we increment the counter correspoinding to the "owner" of the file. After
      * going through all files, we then have a count of the number of files we 
      * will report for each rank */
-    i = 0;
     int disp = 0;
-    src_p = src_head;
-    while (src_p != NULL) {
+    for (i = 0; i < list_count; i++) {
+        const mfu_file_chunk_desc* src_p = &src_chunks->chunks[i];
+
         /* if we checked the last byte of the file, we need to send scan result to owner */
         if (src_p->offset + src_p->length >= src_p->file_size) {
             /* increment count of items that will be sent to owner */
@@ -925,10 +958,6 @@ static void dcmp_strmap_compare_data(
             /* advance to next value in buffer */
             disp += 2;
         }
-
-        /* advance in struct list and ltr array */
-        i++;
-        src_p = src_p->next;
     }
 
     /* compute send buffer displacements */
@@ -997,8 +1026,8 @@ static void dcmp_strmap_compare_data(
     mfu_free(&senddisps);
     mfu_free(&recvbuf);
     mfu_free(&sendbuf);
-    mfu_file_chunk_list_free(&src_head);
-    mfu_file_chunk_list_free(&dst_head);
+    mfu_file_chunk_array_free(&src_chunks);
+    mfu_file_chunk_array_free(&dst_chunks);
 
     return;
 }
@@ -2153,11 +2182,68 @@ int main(int argc, char **argv)
     /* flag for sync option */
     mfu_copy_opts->do_sync = 0;
 
+    /* Lustre grouplock ID, zero is an invalid ID */
+    mfu_copy_opts->grouplock_id = 0;
+
+    /* By default, statically assign file sections to processes */
+    mfu_copy_opts->dynamic = 0;
+
+    /* By default, split all files using the same chunk size */
+    mfu_copy_opts->adaptive_chunks = 0;
+
+    /* By default, copy all files through the chunked path */
+    mfu_copy_opts->small_file_size = 0;
+
+    /* By default, give work to all ranks on each node */
+    mfu_copy_opts->node_ranks = 0;
+
+    /* By default, count opening a file as costing as much as reading 1MB */
+    mfu_copy_opts->file_cost = 1024 * 1024;
+
+    /* By default, split files at chunk offsets without moving
+     * pieces to keep files whole on a rank */
+    mfu_copy_opts->locality = 0;
+
+    /* By default, divide work evenly among ranks regardless of node */
+    mfu_copy_opts->node_aware = 0;
+
+    /* By default, keep up to 64 source and 64 destination files open per rank */
+    mfu_copy_opts->open_files = 64;
+
+    /* By default, don't keep a checkpoint journal */
+    mfu_copy_opts->journal = NULL;
+    mfu_copy_opts->resume  = 0;
+
+    /* By default, copy data through read and write */
+    mfu_copy_opts->kernel_copy = 0;
+
+    /* By default, don't use io_uring */
+    mfu_copy_opts->queue_depth = 0;
+
+    /* By default, let destination files grow as data is written */
+    mfu_copy_opts->preallocate = 0;
+
+    /* By default, don't checksum files as they are copied */
+    mfu_copy_opts->manifest = NULL;
+
+    /* By default, syncfs the destination file system once from each node
+     * rather than fdatasync each destination file when it is closed */
+    mfu_copy_opts->durability = MFU_COPY_SYNC_FS;
+
+    /* By default, use 1MB blocks rather than timing reads to pick sizes */
+    mfu_copy_opts->block_size = FD_BLOCK_SIZE;
+    mfu_copy_opts->autotune = 0;
+
     int option_index = 0;
     static struct option long_options[] = {
         {"output",   1, 0, 'o'},
         {"text",     0, 0, 't'},
         {"base",     0, 0, 'b'},
+        {"progress", 1, 0, 'R'},
+        {"adaptive", 0, 0, 'A'},
+        {"autotune", 0, 0, 'T'},
+        {"locality", 0, 0, 'L'},
+        {"node-aware", 0, 0, 'W'},
         {"verbose",  0, 0, 'v'},
         {"debug",    0, 0, 'd'},
         {"help",     0, 0, 'h'},
@@ -2192,6 +2278,21 @@ int main(int argc, char **argv)
         case 'b':
             options.base++;
             break;
+        case 'R':
+            mfu_progress_timeout = atoi(optarg);
+            break;
+        case 'A':
+            mfu_copy_opts->adaptive_chunks = 1;
+            break;
+        case 'T':
+            mfu_copy_opts->autotune = 1;
+            break;
+        case 'L':
+            mfu_copy_opts->locality = 1;
+            break;
+        case 'W':
+            mfu_copy_opts->node_aware = 1;
+            break;
         case 'v':
             options.verbose++;
             mfu_debug_level = MFU_LOG_VERBOSE;
@@ -2271,6 +2372,11 @@ int main(int argc, char **argv)
     mfu_flist_walk_param_paths(1,  srcpath, walk_stat, dir_perm, flist1);
     mfu_flist_walk_param_paths(1, destpath, walk_stat, dir_perm, flist2);
 
+    /* pick block and chunk sizes by timing reads of source files */
+    if (mfu_copy_opts->autotune) {
+        mfu_flist_tune(flist1, mfu_copy_opts);
+    }
+
     /* store src and dest path strings */
     const char* path1 = srcpath->path;
     const char* path2 = destpath->path;
@@ -65,10 +65,28 @@ void print_usage(void)
 #ifdef LUSTRE_SUPPORT
     /* printf("  -g, --grouplock <id> - use Lustre grouplock when reading/writing file\n"); */
 #endif
+    printf("  -A, --adaptive      - pick chunk size for each file from file and job size\n");
+    printf("      --autotune      - pick block and chunk sizes by timing reads of source files\n");
+    printf("  -b, --batch <size>  - copy files smaller than size whole, in one pass each\n");
+    printf("  -c, --cost <size>   - cost of opening a file in bytes, to balance work (default 1MB)\n");
+    printf("  -D, --dynamic       - balance copy work across processes with work stealing\n");
+    printf("      --durability <mode> - flush data per file, per file system, or not at all: file|fs|none (default fs)\n");
     printf("  -i, --input <file>  - read source list from file\n");
+    printf("  -j, --journal <prefix> - record progress in per-process journals <prefix>.<rank>\n");
+    printf("  -k, --kernel-copy   - let the file system copy data with reflink or copy_file_range\n");
+    printf("      --locality      - keep files whole on a process when that costs little balance\n");
+    printf("  -m, --manifest <file> - write checksums of copied files to file\n");
+    printf("  -n, --per-node <N>  - limit number of processes per node that copy data\n");
+    printf("      --node-aware    - divide work evenly among nodes, then among processes on each\n");
+    printf("  -o, --open-files <N> - number of files each process keeps open (default 64)\n");
+    printf("      --progress <N>  - print progress every N seconds, 0 to disable (default 10)\n");
     printf("  -p, --preserve      - preserve permissions, ownership, timestamps, extended attributes\n");
+    printf("  -P, --preallocate   - allocate space for each destination file when it is created\n");
+    printf("  -q, --queue-depth <N> - keep N blocks per process in flight with io_uring\n");
+    printf("  -r, --resume        - skip work recorded in journal by an earlier run\n");
     printf("  -s, --synchronous   - use synchronous read/write calls (O_DIRECT)\n");
     printf("  -S, --sparse        - create sparse files when possible\n");
+    printf("      --verify <file> - check files against checksums in manifest file, no copy\n");
     printf("  -v, --verbose       - verbose output\n");
     printf("  -h, --help          - print usage\n");
     printf("\n");
@@ -79,7 +97,10 @@ int main(int argc, \
          char** argv)
 {
     /* initialize MPI */
-    MPI_Init(&argc, &argv);
+    /* copies may write data from a helper thread that never
+     * calls MPI, so only the main thread makes MPI calls */
+    int provided;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
     mfu_init();
 
     /* get our rank */
@@ -106,7 +127,7 @@ int main(int argc, \
     mfu_copy_opts->preserve = 0;
 
     /* Lustre grouplock ID */
-    mfu_copy_opts->grouplock_id;
+    mfu_copy_opts->grouplock_id = 0;
 
     /* By default, don't use O_DIRECT. */
     mfu_copy_opts->synchronous = 0;
@@ -117,24 +138,95 @@ int main(int argc, \
     /* By default, we want the sync option off */
     mfu_copy_opts->do_sync = 0;
 
+    /* By default, statically assign file sections to processes */
+    mfu_copy_opts->dynamic = 0;
+
+    /* By default, split all files using the same chunk size */
+    mfu_copy_opts->adaptive_chunks = 0;
+
+    /* By default, copy all files through the chunked path */
+    mfu_copy_opts->small_file_size = 0;
+
+    /* By default, give work to all ranks on each node */
+    mfu_copy_opts->node_ranks = 0;
+
+    /* By default, count opening a file as costing as much as copying 1MB */
+    mfu_copy_opts->file_cost = 1024 * 1024;
+
+    /* By default, split files at chunk offsets without moving
+     * pieces to keep files whole on a rank */
+    mfu_copy_opts->locality = 0;
+
+    /* By default, divide work evenly among ranks regardless of node */
+    mfu_copy_opts->node_aware = 0;
+
+    /* By default, keep up to 64 source and 64 destination files open per rank */
+    mfu_copy_opts->open_files = 64;
+
+    /* By default, don't keep a checkpoint journal */
+    mfu_copy_opts->journal = NULL;
+    mfu_copy_opts->resume  = 0;
+
+    /* By default, copy data through read and write */
+    mfu_copy_opts->kernel_copy = 0;
+
+    /* By default, don't use io_uring */
+    mfu_copy_opts->queue_depth = 0;
+
+    /* By default, let destination files grow as data is written */
+    mfu_copy_opts->preallocate = 0;
+
+    /* By default, don't checksum files as they are copied */
+    mfu_copy_opts->manifest = NULL;
+
+    /* By default, syncfs the destination file system once from each node
+     * rather than fdatasync each destination file when it is closed */
+    mfu_copy_opts->durability = MFU_COPY_SYNC_FS;
+
+    /* By default, use 1MB blocks rather than timing reads to pick sizes */
+    mfu_copy_opts->block_size = FD_BLOCK_SIZE;
+    mfu_copy_opts->autotune = 0;
+
+    /* manifest to check files against instead of copying */
+    char* verifyname = NULL;
+
     int option_index = 0;
     static struct option long_options[] = {
+        {"adaptive"             , no_argument      , 0, 'A'},
+        {"autotune"             , no_argument      , 0, 'T'},
+        {"batch"                , required_argument, 0, 'b'},
+        {"cost"                 , required_argument, 0, 'c'},
         {"debug"                , required_argument, 0, 'd'},
+        {"dynamic"              , no_argument      , 0, 'D'},
+        {"durability"           , required_argument, 0, 'U'},
         {"grouplock"            , required_argument, 0, 'g'},
         {"input"                , required_argument, 0, 'i'},
+        {"journal"              , required_argument, 0, 'j'},
+        {"kernel-copy"          , no_argument      , 0, 'k'},
+        {"locality"             , no_argument      , 0, 'L'},
+        {"manifest"             , required_argument, 0, 'm'},
+        {"per-node"             , required_argument, 0, 'n'},
+        {"node-aware"           , no_argument      , 0, 'W'},
+        {"open-files"           , required_argument, 0, 'o'},
         {"preserve"             , no_argument      , 0, 'p'},
+        {"preallocate"          , no_argument      , 0, 'P'},
+        {"progress"             , required_argument, 0, 'R'},
+        {"queue-depth"          , required_argument, 0, 'q'},
+        {"resume"               , no_argument      , 0, 'r'},
         {"synchronous"          , no_argument      , 0, 's'},
         {"sparse"               , no_argument      , 0, 'S'},
+        {"verify"               , required_argument, 0, 'V'},
         {"verbose"              , no_argument      , 0, 'v'},
         {"help"                 , no_argument      , 0, 'h'},
         {0                      , 0                , 0, 0  }
     };
 
     /* Parse options */
+    unsigned long long byte_val;
     int usage = 0;
     while(1) {
         int c = getopt_long(
-                    argc, argv, "d:g:hi:pusSv",
+                    argc, argv, "Ab:c:d:Dg:hi:j:km:n:o:pPq:rusSv",
                     long_options, &option_index
                 );
 
@@ -186,6 +278,57 @@ int main(int argc, \
                     }
                 }
                 break;
+            case 'A':
+                mfu_copy_opts->adaptive_chunks = 1;
+                if(rank == 0) {
+                    MFU_LOG(MFU_LOG_INFO, "Using adaptive chunk sizes.");
+                }
+                break;
+            case 'b':
+                if (mfu_abtoull(optarg, &byte_val) != MFU_SUCCESS) {
+                    if (rank == 0) {
+                        MFU_LOG(MFU_LOG_ERR, "Failed to parse batch file size: %s", optarg);
+                    }
+                    usage = 1;
+                }
+                mfu_copy_opts->small_file_size = (uint64_t) byte_val;
+                if(rank == 0) {
+                    MFU_LOG(MFU_LOG_INFO, "Copying files smaller than %llu bytes in batches.",
+                        byte_val);
+                }
+                break;
+            case 'c':
+                if (mfu_abtoull(optarg, &byte_val) != MFU_SUCCESS) {
+                    if (rank == 0) {
+                        MFU_LOG(MFU_LOG_ERR, "Failed to parse file cost: %s", optarg);
+                    }
+                    usage = 1;
+                }
+                mfu_copy_opts->file_cost = (uint64_t) byte_val;
+                break;
+            case 'D':
+                mfu_copy_opts->dynamic = 1;
+                if(rank == 0) {
+                    MFU_LOG(MFU_LOG_INFO, "Using dynamic work distribution.");
+                }
+                break;
+            case 'T':
+                mfu_copy_opts->autotune = 1;
+                break;
+            case 'U':
+                if (strcmp(optarg, "file") == 0) {
+                    mfu_copy_opts->durability = MFU_COPY_SYNC_FILE;
+                } else if (strcmp(optarg, "fs") == 0) {
+                    mfu_copy_opts->durability = MFU_COPY_SYNC_FS;
+                } else if (strcmp(optarg, "none") == 0) {
+                    mfu_copy_opts->durability = MFU_COPY_SYNC_NONE;
+                } else {
+                    if (rank == 0) {
+                        MFU_LOG(MFU_LOG_ERR, "Durability must be file, fs, or none: %s", optarg);
+                    }
+                    usage = 1;
+                }
+                break;
 #ifdef LUSTRE_SUPPORT
             case 'g':
                 mfu_copy_opts->grouplock_id = atoi(optarg);
@@ -201,12 +344,73 @@ int main(int argc, \
                     MFU_LOG(MFU_LOG_INFO, "Using input list.");
                 }
                 break;
+            case 'j':
+                mfu_copy_opts->journal = MFU_STRDUP(optarg);
+                if(rank == 0) {
+                    MFU_LOG(MFU_LOG_INFO, "Journaling progress to %s.RANK", optarg);
+                }
+                break;
+            case 'k':
+                mfu_copy_opts->kernel_copy = 1;
+                if(rank == 0) {
+                    MFU_LOG(MFU_LOG_INFO, "Copying data with reflink or copy_file_range when possible.");
+                }
+                break;
+            case 'L':
+                mfu_copy_opts->locality = 1;
+                break;
+            case 'm':
+                mfu_copy_opts->manifest = MFU_STRDUP(optarg);
+                if(rank == 0) {
+                    MFU_LOG(MFU_LOG_INFO, "Writing checksums to %s", optarg);
+                }
+                break;
+            case 'n':
+                mfu_copy_opts->node_ranks = atoi(optarg);
+                if(rank == 0) {
+                    MFU_LOG(MFU_LOG_INFO, "Copying with at most %d processes per node.",
+                        mfu_copy_opts->node_ranks);
+                }
+                break;
+            case 'W':
+                mfu_copy_opts->node_aware = 1;
+                break;
+            case 'o':
+                mfu_copy_opts->open_files = atoi(optarg);
+                if (mfu_copy_opts->open_files < 1) {
+                    if (rank == 0) {
+                        MFU_LOG(MFU_LOG_ERR, "Number of open files must be positive: %s", optarg);
+                    }
+                    usage = 1;
+                }
+                break;
+            case 'R':
+                mfu_progress_timeout = atoi(optarg);
+                break;
+            case 'q':
+                mfu_copy_opts->queue_depth = atoi(optarg);
+                if (mfu_copy_opts->queue_depth < 0) {
+                    if (rank == 0) {
+                        MFU_LOG(MFU_LOG_ERR, "Queue depth must not be negative: %s", optarg);
+                    }
+                    usage = 1;
+                }
+                break;
             case 'p':
                 mfu_copy_opts->preserve = 1;
                 if(rank == 0) {
                     MFU_LOG(MFU_LOG_INFO, "Preserving file attributes.");
                 }
                 break;
+            case 'P':
+                mfu_copy_opts->preallocate = 1;
+                if(rank == 0) {
+                    MFU_LOG(MFU_LOG_INFO, "Preallocating destination files.");
+                }
+                break;
+            case 'r':
+                mfu_copy_opts->resume = 1;
+                break;
             case 's':
                 mfu_copy_opts->synchronous = 1;
                 if(rank == 0) {
@@ -219,6 +423,9 @@ int main(int argc, \
                     MFU_LOG(MFU_LOG_INFO, "Using sparse file");
                 }
                 break;
+            case 'V':
+                verifyname = MFU_STRDUP(optarg);
+                break;
             case 'v':
                 mfu_debug_level = MFU_LOG_VERBOSE;
                 break;
@@ -235,6 +442,27 @@ int main(int argc, \
         }
     }
 
+    /* resuming needs a journal to resume from */
+    if (mfu_copy_opts->resume && mfu_copy_opts->journal == NULL) {
+        if (rank == 0) {
+            MFU_LOG(MFU_LOG_ERR, "--resume requires --journal");
+        }
+        usage = 1;
+    }
+
+    /* check files listed in a manifest written by an earlier copy,
+     * the manifest names the files, so no paths are needed */
+    if (verifyname != NULL && !usage) {
+        int rc = mfu_flist_verify_manifest(verifyname, mfu_copy_opts);
+        mfu_free(&verifyname);
+        mfu_free(&inputname);
+        mfu_free(&mfu_copy_opts->journal);
+        mfu_free(&mfu_copy_opts->manifest);
+        mfu_finalize();
+        MPI_Finalize();
+        return (rc == 0) ? 0 : 1;
+    }
+
     /* paths to walk come after the options */
     int numpaths = 0;
     int numpaths_src = 0;
@@ -314,6 +542,11 @@ int main(int argc, \
         mfu_flist_free(&input_flist);
     }
 
+    /* pick block and chunk sizes by timing reads of source files */
+    if (mfu_copy_opts->autotune) {
+        mfu_flist_tune(flist, mfu_copy_opts);
+    }
+
     /* copy flist into destination */ 
     mfu_flist_copy(flist, numpaths_src, paths, destpath, mfu_copy_opts);
 
@@ -329,6 +562,13 @@ int main(int argc, \
     /* free the input file name */
     mfu_free(&inputname);
 
+    /* free the journal prefix */
+    mfu_free(&mfu_copy_opts->journal);
+
+    /* free the manifest name */
+    mfu_free(&mfu_copy_opts->manifest);
+    mfu_free(&verifyname);
+
     /* shut down MPI */
     mfu_finalize();
     MPI_Finalize();
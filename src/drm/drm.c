@@ -41,6 +41,7 @@ static void print_usage(void)
     printf("      --match   <regex>  - apply command only to entries that match the regex\n");
     printf("      --name             - change regex to apply to entry name rather than full pathname\n");
     printf("      --dryrun           - print out list of files that would be deleted\n");
+    printf("      --progress <N>     - print progress every N seconds, 0 to disable (default 10)\n");
     printf("  -v, --verbose          - verbose output\n");
     printf("  -T, --traceless        - traceless mode, remove the file, but keep parent dir's mtime nochange\n");
     printf("  -h, --help             - print usage\n");
@@ -79,6 +80,7 @@ int main(int argc, char** argv)
         {"match",    1, 0, 'a'},
         {"name",     0, 0, 'n'},        
         {"dryrun",   0, 0, 'd'},
+        {"progress", 1, 0, 'R'},
         {"verbose",  0, 0, 'v'},
         {"traceless",  0, 0, 'T'},
         {"help",     0, 0, 'h'},
@@ -117,6 +119,9 @@ int main(int argc, char** argv)
             case 'd':
                 dryrun = 1;
                 break;            
+            case 'R':
+                mfu_progress_timeout = atoi(optarg);
+                break;
             case 'v':
                 mfu_debug_level = MFU_LOG_VERBOSE;
                 break;
@@ -21,6 +21,9 @@
 
 #include "mfu.h"
 
+/* max number of input and of output files each rank keeps open */
+#define DSTRIPE_OPEN_FILES (64)
+
 static void print_usage(void)
 {
     printf("\n");
@@ -30,6 +33,8 @@ static void print_usage(void)
     printf("  -c, --count <COUNT>    - stripe count (default -1)\n");
     printf("  -s, --size <SIZE>      - stripe size in bytes (default 1MB)\n");
     printf("  -m, --minsize <SIZE>   - minimum file size (default 0MB)\n");
+    printf("      --locality         - keep files whole on a process when that costs little balance\n");
+    printf("      --node-aware       - divide work evenly among nodes, then among processes on each\n");
     printf("  -r, --report           - display file size and stripe info\n");
     printf("  -v, --verbose          - verbose output\n");
     printf("  -h, --help             - print usage\n");
@@ -260,12 +265,12 @@ static mfu_flist filter_list(mfu_flist list, int stripe_count, uint64_t stripe_s
 }
 
 /* write a chunk of the file */
-static void write_file_chunk(mfu_file_chunk* p, const char* out_path)
+static void write_file_chunk(const mfu_file_chunk_desc* p, const char* in_path, const char* out_path,
+    mfu_file_cache_t* in_cache, mfu_file_cache_t* out_cache)
 {
     size_t chunk_size = 1024*1024;
     uint64_t base = (off_t)p->offset;
     uint64_t file_size = (off_t)p->file_size;
-    const char *in_path = p->name;
     uint64_t stripe_size = (off_t)p->length;
 
     /* if the file size is 0, there's no data to restripe */
@@ -282,8 +287,9 @@ static void write_file_chunk(mfu_file_chunk* p, const char* out_path)
         MPI_Abort(MPI_COMM_WORLD, 1);
     }
 
-    /* open input file for reading */
-    int in_fd = mfu_open(in_path, O_RDONLY);
+    /* open input file for reading, chunks of the same file often
+     * land on the same rank so reuse descriptors across chunks */
+    int in_fd = mfu_file_cache_open(in_cache, in_path, O_RDONLY, 0);
     if (in_fd < 0) {
         printf("Failed to open input file %s (%s)\n", in_path, strerror(errno));
         fflush(stdout);
@@ -291,7 +297,7 @@ static void write_file_chunk(mfu_file_chunk* p, const char* out_path)
     }
 
     /* open output file for writing */
-    int out_fd = mfu_open(out_path, O_WRONLY);
+    int out_fd = mfu_file_cache_open(out_cache, out_path, O_WRONLY, 0);
     if (out_fd < 0) {
         printf("Failed to open output file %s (%s)\n", out_path, strerror(errno));
         fflush(stdout);
@@ -394,10 +400,8 @@ static void write_file_chunk(mfu_file_chunk* p, const char* out_path)
         chunk_id++;
     }
 
-    /* close files */
-    mfu_fsync(out_path, out_fd);
-    mfu_close(out_path, out_fd);
-    mfu_close(in_path, in_fd);
+    /* files are closed when evicted from the caches,
+     * output files are fsync'd as they are closed */
 
     /* free buffer */
     mfu_free(&buf);
@@ -426,12 +430,18 @@ int main(int argc, char* argv[])
     uint64_t stripe_size = 1048576;
     uint64_t min_size = 0;
 
+    /* default to splitting files at chunk offsets evenly across ranks */
+    int locality = 0;
+    int node_aware = 0;
+
     static struct option long_options[] = {
         {"count",    1, 0, 'c'},
         {"size",     1, 0, 's'},
         {"minsize",  1, 0, 'm'},
         {"help",     0, 0, 'h'},
         {"report",   0, 0, 'r'},
+        {"locality", 0, 0, 'L'},
+        {"node-aware", 0, 0, 'W'},
         {0, 0, 0, 0}
     };
 
@@ -468,6 +478,14 @@ int main(int argc, char* argv[])
                     MPI_Abort(MPI_COMM_WORLD, 1);
                 }
                 break;
+            case 'L':
+                /* keep files whole on a rank */
+                locality = 1;
+                break;
+            case 'W':
+                /* divide work among nodes first */
+                node_aware = 1;
+                break;
             case 'r':
                 /* report striping info */
 		report = 1;
@@ -625,22 +643,42 @@ int main(int argc, char* argv[])
 
     MPI_Barrier(MPI_COMM_WORLD);
 
-    /* found a suffix, now we need to break our files into chunks based on stripe size */
-    mfu_file_chunk* file_chunks = mfu_file_chunk_list_alloc(filtered, stripe_size);
-    mfu_file_chunk* p = file_chunks;
-    while (p != NULL) {
+    /* found a suffix, now we need to break our files into chunks based on stripe size,
+     * large files are split into chunks of several stripes so we don't create
+     * millions of chunk records, but chunks always cover whole stripes */
+    mfu_chunk_opts_t chunk_opts;
+    chunk_opts.chunk_size = stripe_size;
+    chunk_opts.adaptive   = 1;
+    chunk_opts.align      = stripe_size;
+    chunk_opts.locality   = locality;
+    chunk_opts.node_aware = node_aware;
+    chunk_opts.node_ranks = 0;
+    chunk_opts.file_cost  = 0;
+    mfu_file_chunk_array* file_chunks = mfu_file_chunk_array_alloc(filtered, &chunk_opts);
+    mfu_file_cache_t in_cache;
+    mfu_file_cache_t out_cache;
+    mfu_file_cache_init(&in_cache, DSTRIPE_OPEN_FILES, 0);
+    mfu_file_cache_init(&out_cache, DSTRIPE_OPEN_FILES, 1);
+    uint64_t n;
+    for (n = 0; n < file_chunks->count; n++) {
+        const mfu_file_chunk_desc* p = &file_chunks->chunks[n];
+        const char* name = file_chunks->names[p->name_id];
+
         /* build path to temp file */
         char temp_path[PATH_MAX];
-        strcpy(temp_path, p->name);
+        strcpy(temp_path, name);
         strcat(temp_path, suffix);
 
-        /* write each chunk in our list */
-        write_file_chunk(p, temp_path);
-
-        /* move on to next file chunk */
-        p = p->next;
+        /* write each chunk in our array */
+        write_file_chunk(p, name, temp_path, &in_cache, &out_cache);
     }
-    mfu_file_chunk_list_free(&file_chunks);
+    mfu_file_chunk_array_free(&file_chunks);
+
+    /* close files before renaming them */
+    mfu_file_cache_print(&in_cache, "Input");
+    mfu_file_cache_print(&out_cache, "Output");
+    mfu_file_cache_free(&in_cache);
+    mfu_file_cache_free(&out_cache);
 
     MPI_Barrier(MPI_COMM_WORLD);
 
@@ -50,6 +50,12 @@ static void print_usage(void)
     printf("      --dryrun     - show differences, but do not synchronize files\n");
     printf("  -c, --contents   - read and compare file contents rather than compare size and mtime\n");
     printf("  -N, --no-delete  - don't delete extraneous files from target\n");
+    printf("      --adaptive   - pick chunk size for each file from file and job size\n");
+    printf("      --autotune   - pick block and chunk sizes by timing reads of source files\n");
+    printf("      --locality   - keep files whole on a process when that costs little balance\n");
+    printf("      --node-aware - divide work evenly among nodes, then among processes on each\n");
+    printf("      --durability <mode> - flush data per file, per file system, or not at all: file|fs|none (default fs)\n");
+    printf("      --progress <N> - print progress every N seconds, 0 to disable (default 10)\n");
     printf("  -v, --verbose    - verbose output\n");
     printf("  -h, --help       - print usage\n");
     printf("\n");
@@ -474,18 +480,19 @@ static int dsync_compare_data(
     off_t offset,
     size_t length,
     size_t buff_size,
+    mfu_file_cache_t* src_cache,
+    mfu_file_cache_t* dst_cache,
     mfu_copy_opts_t* mfu_copy_opts,
     uint64_t* count_bytes_read,
     uint64_t* count_bytes_written)
 {
-    /* open source file */
-    int src_fd = mfu_open(src_name, O_RDONLY);
+    /* open source file, or reuse descriptor from an earlier section */
+    int src_fd = mfu_file_cache_open(src_cache, src_name, O_RDONLY, 0);
     if (src_fd < 0) {
        /* log error if there is an open failure on the 
         * src side */
         MFU_LOG(MFU_LOG_ERR, "Failed to open %s, error msg: %s", 
           src_name, strerror(errno));
-        mfu_close(src_name, src_fd);
        return -1;
     }
 
@@ -495,13 +502,12 @@ static int dsync_compare_data(
         /* avoid opening file in write mode if on dry run */
         dst_flags = O_RDONLY;
     }
-    int dst_fd = mfu_open(dst_name, dst_flags);
+    int dst_fd = mfu_file_cache_open(dst_cache, dst_name, dst_flags, 0);
     if (dst_fd < 0) {
        /* log error if there is an open failure on the 
         * dst side */
         MFU_LOG(MFU_LOG_ERR, "Failed to open %s, error msg: %s", 
           dst_name, strerror(errno));
-        mfu_close(src_name, src_fd);
         return -1;
     }
 
@@ -518,8 +524,6 @@ static int dsync_compare_data(
         * src side */
         MFU_LOG(MFU_LOG_ERR, "Failed to lseek %s, offset: %x, error msg: %s",
           src_name, (unsigned long)offset, strerror(errno));
-        mfu_close(dst_name, dst_fd);
-        mfu_close(src_name, src_fd);
         return -1;
     }
     
@@ -529,8 +533,6 @@ static int dsync_compare_data(
         * dst side */
         MFU_LOG(MFU_LOG_ERR, "Failed to lseek %s, offset: %x, error msg: %s",  
           dst_name, (unsigned long)offset, strerror(errno));
-        mfu_close(dst_name, dst_fd);
-        mfu_close(src_name, src_fd);
         return -1;
     }
 
@@ -652,9 +654,7 @@ static int dsync_compare_data(
     mfu_free(&dest_buf);
     mfu_free(&src_buf);
 
-    /* close files */
-    mfu_close(dst_name, dst_fd);
-    mfu_close(src_name, src_fd);
+    /* files are left open in the caches for the next section */
 
     return rc;
 }
@@ -810,28 +810,30 @@ static void dsync_strmap_compare_data(
     uint64_t* count_bytes_read,
     uint64_t* count_bytes_written)
 {
-    /* get the largest filename */
-    uint64_t max_name = mfu_flist_file_max_name(src_compare_list);
-
-    /* get chunk size for copying files (just hard-coded for now) */
-    uint64_t chunk_size = 1024 * 1024;
-
-    /* get the linked list of file chunks for the src and dest */
-    mfu_file_chunk* src_head = mfu_file_chunk_list_alloc(src_compare_list, chunk_size);
-    mfu_file_chunk* dst_head = mfu_file_chunk_list_alloc(dst_compare_list, chunk_size);
-
-    /* get a count of how many items are the compare list and total
-     * number of bytes we'll read */
-    uint64_t list_count = 0;
-    mfu_file_chunk* src_p = src_head;
-    while (src_p != NULL) {
-        list_count++;
-        src_p = src_p->next;
-    }
-
-    /* keys are the filename, so only bytes that belong to 
-     * the same file will be compared via a flag in the segmented scan */
-    char* keys = (char*) MFU_MALLOC(list_count * max_name);
+    /* pick chunk size for each file from the file size, total bytes,
+     * and number of ranks, using the copy chunk size as the minimum,
+     * src and dest lists have the same file sizes so they split the same */
+    mfu_chunk_opts_t chunk_opts;
+    chunk_opts.chunk_size = (uint64_t) mfu_copy_opts->chunk_size;
+    chunk_opts.adaptive   = mfu_copy_opts->adaptive_chunks;
+    chunk_opts.align      = 0;
+    chunk_opts.locality   = mfu_copy_opts->locality;
+    chunk_opts.node_aware = mfu_copy_opts->node_aware;
+    chunk_opts.node_ranks = mfu_copy_opts->node_ranks;
+    chunk_opts.file_cost  = mfu_copy_opts->file_cost;
+
+    /* get the arrays of file chunks for the src and dest */
+    mfu_file_chunk_array* src_chunks = mfu_file_chunk_array_alloc(src_compare_list, &chunk_opts);
+    mfu_file_chunk_array* dst_chunks = mfu_file_chunk_array_alloc(dst_compare_list, &chunk_opts);
+
+    /* get a count of how many items are the compare list */
+    uint64_t list_count = src_chunks->count;
+
+    /* keys are the rank and index of the owner of the file, which
+     * uniquely identify it, so only bytes that belong to the same file
+     * will be compared via a flag in the segmented scan, we use these
+     * rather than the file name so keys don't scale with the longest path */
+    uint64_t* keys = (uint64_t*) MFU_MALLOC(list_count * 2 * sizeof(uint64_t));
 
     /* vals pointer allocation for input to segmented scan, so 
      * dsync_compare_data will return a 1 or 0 for each set of bytes */
@@ -840,12 +842,32 @@ static void dsync_strmap_compare_data(
     /* ltr pointer for the output of the left-to-right-segmented scan */
     int* ltr  = (int*) MFU_MALLOC(list_count * sizeof(int));
 
+    /* keep files open across sections, since a rank is often
+     * given several sections of the same file */
+    mfu_file_cache_t src_cache;
+    mfu_file_cache_t dst_cache;
+    mfu_file_cache_init(&src_cache, mfu_copy_opts->open_files, 0);
+    mfu_file_cache_init(&dst_cache, mfu_copy_opts->open_files, 0);
+
+    /* total up bytes to compare, so progress messages can estimate
+     * how much time is left */
+    uint64_t i;
+    uint64_t total_bytes = 0;
+    for (i = 0; i < list_count; i++) {
+        total_bytes += src_chunks->chunks[i].length;
+    }
+    uint64_t bytes = 0;
+    mfu_progress* prg = mfu_progress_start(mfu_progress_timeout, "Compared",
+        list_count, total_bytes, MPI_COMM_WORLD);
+
     /* compare bytes for each file section and set flag based on what we find */
-    uint64_t i = 0;
-    char* name_ptr = keys;
-    src_p = src_head;
-    mfu_file_chunk* dst_p = dst_head;
-    while (src_p != NULL) {
+    for (i = 0; i < list_count; i++) {
+        /* src and dest lists split the same, so sections line up */
+        const mfu_file_chunk_desc* src_p = &src_chunks->chunks[i];
+        const mfu_file_chunk_desc* dst_p = &dst_chunks->chunks[i];
+        const char* src_name = src_chunks->names[src_p->name_id];
+        const char* dst_name = dst_chunks->names[dst_p->name_id];
+
         /* get offset into file that we should compare (bytes) */
         off_t offset = (off_t)src_p->offset;
 
@@ -853,8 +875,8 @@ static void dsync_strmap_compare_data(
         off_t length = (off_t)src_p->length;
         
         /* compare the contents of the files */
-        int rc = dsync_compare_data(src_p->name, dst_p->name, offset, 
-                (size_t)length, 1048576, mfu_copy_opts,
+        int rc = dsync_compare_data(src_name, dst_name, offset, 
+                (size_t)length, mfu_copy_opts->block_size, &src_cache, &dst_cache, mfu_copy_opts,
                 count_bytes_read, count_bytes_written);
         if (rc == -1) {
             /* we hit an error while reading, consider files to be different,
@@ -862,7 +884,7 @@ static void dsync_strmap_compare_data(
             rc = 1;
             MFU_LOG(MFU_LOG_ERR,
               "Failed to open, lseek, or read %s and/or %s. Assuming contents are different.",
-                 src_p->name, dst_p->name);
+                 src_name, dst_name);
 
             /* consider this to be a fatal error if syncing */
             if (!options.dry_run) {
@@ -873,24 +895,36 @@ static void dsync_strmap_compare_data(
         }
 
         /* now record results of compare_data for sending to segmented scan */
-        strncpy(name_ptr, src_p->name, max_name);
+        keys[2 * i]     = src_p->rank_of_owner;
+        keys[2 * i + 1] = src_p->index_of_owner;
         vals[i] = rc;
 
-        /* move to the start of the next filename */
-        name_ptr += max_name;
-        i++;
-
-        /* update pointers for src and dest in linked list */
-        src_p = src_p->next;
-        dst_p = dst_p->next;
+        /* report progress */
+        bytes += (uint64_t)length;
+        mfu_progress_update(prg, i + 1, bytes);
     }
 
-    /* create type and comparison operation for file names for the segmented scan */
+    /* wait for other ranks to finish comparing */
+    mfu_progress_complete(&prg, list_count, bytes);
+
+    /* close files and report how often sections found them open */
+    mfu_file_cache_print(&src_cache, "Source");
+    mfu_file_cache_print(&dst_cache, "Destination");
+    mfu_file_cache_free(&src_cache);
+    mfu_file_cache_free(&dst_cache);
+
+    /* create type and comparison operation for owner rank and index */
     MPI_Datatype keytype;
+    MPI_Type_contiguous(2, MPI_UINT64_T, &keytype);
+    MPI_Type_commit(&keytype);
+
     DTCMP_Op keyop;
-    DTCMP_Str_create_ascend((int)max_name, &keytype, &keyop);
+    DTCMP_Op keyops[2];
+    keyops[0] = DTCMP_OP_UINT64T_ASCEND;
+    keyops[1] = DTCMP_OP_UINT64T_ASCEND;
+    DTCMP_Op_create_series(2, keyops, &keyop);
 
-    /* execute segmented scan of comparison flags across file names */
+    /* execute segmented scan of comparison flags across files */
     DTCMP_Segmented_scanv_ltr(
         (int)list_count, keys, keytype, keyop,
         vals, ltr, MPI_INT, MPI_LOR,
@@ -925,10 +959,10 @@ static void dsync_strmap_compare_data(
      * we increment the counter correspoinding to the "owner" of the file. After
      * going through all files, we then have a count of the number of files we 
      * will report for each rank */
-    i = 0;
     int disp = 0;
-    src_p = src_head;
-    while (src_p != NULL) {
+    for (i = 0; i < list_count; i++) {
+        const mfu_file_chunk_desc* src_p = &src_chunks->chunks[i];
+
         /* if we checked the last byte of the file, we need to send scan result to owner */
         if (src_p->offset + src_p->length >= src_p->file_size) {
             /* increment count of items that will be sent to owner */
@@ -944,10 +978,6 @@ static void dsync_strmap_compare_data(
             /* advance to next value in buffer */
             disp += 2;
         }
-
-        /* advance in struct list and ltr array */
-        i++;
-        src_p = src_p->next;
     }
 
     /* compute send buffer displacements */
@@ -1019,8 +1049,8 @@ static void dsync_strmap_compare_data(
     mfu_free(&senddisps);
     mfu_free(&recvbuf);
     mfu_free(&sendbuf);
-    mfu_file_chunk_list_free(&src_head);
-    mfu_file_chunk_list_free(&dst_head);
+    mfu_file_chunk_array_free(&src_chunks);
+    mfu_file_chunk_array_free(&dst_chunks);
 
     return;
 }
@@ -2373,7 +2403,10 @@ out:
 int main(int argc, char **argv)
 {
     /* initialize MPI and mfu libraries */
-    MPI_Init(&argc, &argv);
+    /* copies may write data from a helper thread that never
+     * calls MPI, so only the main thread makes MPI calls */
+    int provided;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
     mfu_init();
 
     /* get our rank and number of ranks */
@@ -2419,6 +2452,58 @@ int main(int argc, char **argv)
     /* flag to check for sync option */
     mfu_copy_opts->do_sync = 1;
 
+    /* Lustre grouplock ID, zero is an invalid ID */
+    mfu_copy_opts->grouplock_id = 0;
+
+    /* By default, statically assign file sections to processes */
+    mfu_copy_opts->dynamic = 0;
+
+    /* By default, split all files using the same chunk size */
+    mfu_copy_opts->adaptive_chunks = 0;
+
+    /* By default, copy all files through the chunked path */
+    mfu_copy_opts->small_file_size = 0;
+
+    /* By default, give work to all ranks on each node */
+    mfu_copy_opts->node_ranks = 0;
+
+    /* By default, count opening a file as costing as much as reading 1MB */
+    mfu_copy_opts->file_cost = 1024 * 1024;
+
+    /* By default, split files at chunk offsets without moving
+     * pieces to keep files whole on a rank */
+    mfu_copy_opts->locality = 0;
+
+    /* By default, divide work evenly among ranks regardless of node */
+    mfu_copy_opts->node_aware = 0;
+
+    /* By default, keep up to 64 source and 64 destination files open per rank */
+    mfu_copy_opts->open_files = 64;
+
+    /* By default, don't keep a checkpoint journal */
+    mfu_copy_opts->journal = NULL;
+    mfu_copy_opts->resume  = 0;
+
+    /* By default, copy data through read and write */
+    mfu_copy_opts->kernel_copy = 0;
+
+    /* By default, don't use io_uring */
+    mfu_copy_opts->queue_depth = 0;
+
+    /* By default, let destination files grow as data is written */
+    mfu_copy_opts->preallocate = 0;
+
+    /* By default, don't checksum files as they are copied */
+    mfu_copy_opts->manifest = NULL;
+
+    /* By default, syncfs the destination file system once from each node
+     * rather than fdatasync each destination file when it is closed */
+    mfu_copy_opts->durability = MFU_COPY_SYNC_FS;
+
+    /* By default, use 1MB blocks rather than timing reads to pick sizes */
+    mfu_copy_opts->block_size = FD_BLOCK_SIZE;
+    mfu_copy_opts->autotune = 0;
+
     int option_index = 0;
     static struct option long_options[] = {
         {"contents",  0, 0, 'c'},
@@ -2426,6 +2511,12 @@ int main(int argc, char **argv)
         {"no-delete", 0, 0, 'N'},
         {"output",    1, 0, 'o'},
         {"debug",     0, 0, 'd'},
+        {"progress",  1, 0, 'R'},
+        {"adaptive",  0, 0, 'A'},
+        {"autotune",  0, 0, 'T'},
+        {"durability", 1, 0, 'U'},
+        {"locality",  0, 0, 'L'},
+        {"node-aware", 0, 0, 'W'},
         {"verbose",   0, 0, 'v'},
         {"help",      0, 0, 'h'},
         {0, 0, 0, 0}
@@ -2465,6 +2556,35 @@ int main(int argc, char **argv)
         case 'd':
             options.debug++;
             break;
+        case 'R':
+            mfu_progress_timeout = atoi(optarg);
+            break;
+        case 'A':
+            mfu_copy_opts->adaptive_chunks = 1;
+            break;
+        case 'T':
+            mfu_copy_opts->autotune = 1;
+            break;
+        case 'U':
+            if (strcmp(optarg, "file") == 0) {
+                mfu_copy_opts->durability = MFU_COPY_SYNC_FILE;
+            } else if (strcmp(optarg, "fs") == 0) {
+                mfu_copy_opts->durability = MFU_COPY_SYNC_FS;
+            } else if (strcmp(optarg, "none") == 0) {
+                mfu_copy_opts->durability = MFU_COPY_SYNC_NONE;
+            } else {
+                if (rank == 0) {
+                    MFU_LOG(MFU_LOG_ERR, "Durability must be file, fs, or none: %s", optarg);
+                }
+                usage = 1;
+            }
+            break;
+        case 'L':
+            mfu_copy_opts->locality = 1;
+            break;
+        case 'W':
+            mfu_copy_opts->node_aware = 1;
+            break;
         case 'v':
             options.verbose++;
             mfu_debug_level = MFU_LOG_VERBOSE;
@@ -2541,6 +2661,11 @@ int main(int argc, char **argv)
     mfu_flist_walk_param_paths(1,  srcpath, walk_stat, dir_perm, flist1);
     mfu_flist_walk_param_paths(1, destpath, walk_stat, dir_perm, flist2);
 
+    /* pick block and chunk sizes by timing reads of source files */
+    if (mfu_copy_opts->autotune) {
+        mfu_flist_tune(flist1, mfu_copy_opts);
+    }
+
     /* store src and dest path strings */
     const char* path1 = srcpath->path;
     const char* path2 = destpath->path;
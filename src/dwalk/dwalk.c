@@ -328,18 +328,283 @@ out:
     return status;
 }
 
+#define MAX_PERCENTILES 64
+struct percentile_option {
+    char* field;
+    int count;
+    double quantiles[MAX_PERCENTILES];
+};
+
+struct top_option {
+    char* field;
+    uint64_t count;
+};
+
+/* format value of field for printing, times are printed as dates */
+static void format_field_value(const char* field, uint64_t val, char* buf, size_t bufsize)
+{
+    if (field[0] == '-') {
+        field++;
+    }
+
+    if (strcmp(field, "size") == 0) {
+        double val_tmp;
+        const char* val_units;
+        mfu_format_bytes(val, &val_tmp, &val_units);
+        snprintf(buf, bufsize, "%.3lf %s", val_tmp, val_units);
+    } else if (strcmp(field, "atime") == 0 ||
+               strcmp(field, "mtime") == 0 ||
+               strcmp(field, "ctime") == 0) {
+        time_t val_t = (time_t) val;
+        size_t rc = strftime(buf, bufsize - 1, "%FT%T", localtime(&val_t));
+        if (rc == 0) {
+            buf[0] = '\0';
+        }
+    } else {
+        snprintf(buf, bufsize, "%llu", (unsigned long long) val);
+    }
+}
+
+/* parse top option in the form <field>:<N> */
+static int top_parse(struct top_option* option, const char* string)
+{
+    int status = 0;
+    char* str = MFU_STRDUP(string);
+
+    option->field = NULL;
+    option->count = 0;
+
+    char* sep = strchr(str, ':');
+    if (sep == NULL) {
+        status = -1;
+        goto out;
+    }
+    *sep = '\0';
+
+    if (!mfu_flist_select_field_valid(str, 1)) {
+        status = -1;
+        goto out;
+    }
+
+    unsigned long long count;
+    if (mfu_abtoull(sep + 1, &count) != MFU_SUCCESS || count == 0) {
+        printf("Invalid count \"%s\"\n", sep + 1);
+        status = -1;
+        goto out;
+    }
+
+    option->field = MFU_STRDUP(str);
+    option->count = (uint64_t) count;
+
+out:
+    mfu_free(&str);
+    return status;
+}
+
+/* parse percentile option in the form <field>:<p>,<p>,... */
+static int percentile_parse(struct percentile_option* option, const char* string)
+{
+    int status = 0;
+    char* str = MFU_STRDUP(string);
+
+    option->field = NULL;
+    option->count = 0;
+
+    char* ptr = strchr(str, ':');
+    if (ptr == NULL) {
+        status = -1;
+        goto out;
+    }
+    *ptr = '\0';
+    ptr++;
+
+    if (!mfu_flist_select_field_valid(str, 0)) {
+        status = -1;
+        goto out;
+    }
+
+    while (ptr != NULL && *ptr != '\0') {
+        char* next = strchr(ptr, ',');
+        if (next != NULL) {
+            *next = '\0';
+            next++;
+        }
+
+        char* end;
+        double percent = strtod(ptr, &end);
+        if (end == ptr || *end != '\0' || percent < 0.0 || percent > 100.0) {
+            printf("Invalid percentile \"%s\"\n", ptr);
+            status = -1;
+            goto out;
+        }
+
+        if (option->count >= MAX_PERCENTILES) {
+            printf("Exceeded maximum number of percentiles: %d\n", MAX_PERCENTILES);
+            status = -1;
+            goto out;
+        }
+
+        option->quantiles[option->count] = percent / 100.0;
+        option->count++;
+
+        ptr = next;
+    }
+
+    if (option->count == 0) {
+        status = -1;
+        goto out;
+    }
+
+    option->field = MFU_STRDUP(str);
+
+out:
+    mfu_free(&str);
+    return status;
+}
+
+/* print the items with the largest (or smallest) values of a field */
+static void print_flist_top(struct top_option* option, mfu_flist flist, int rank)
+{
+    /* select items, these are all placed on rank 0 in order */
+    mfu_flist top = mfu_flist_topk(flist, option->field, option->count);
+
+    if (rank == 0) {
+        const char* field = option->field;
+        if (field[0] == '-') {
+            printf("Top %llu items by smallest %s:\n", (unsigned long long) option->count, field + 1);
+        } else {
+            printf("Top %llu items by largest %s:\n", (unsigned long long) option->count, field);
+        }
+
+        uint64_t idx;
+        uint64_t size = mfu_flist_size(top);
+        for (idx = 0; idx < size; idx++) {
+            /* lookup value of field for this item */
+            const char* name = field;
+            if (name[0] == '-') {
+                name++;
+            }
+            uint64_t val = 0;
+            if (strcmp(name, "size") == 0) {
+                val = mfu_flist_file_get_size(top, idx);
+            } else if (strcmp(name, "atime") == 0) {
+                val = mfu_flist_file_get_atime(top, idx);
+            } else if (strcmp(name, "mtime") == 0) {
+                val = mfu_flist_file_get_mtime(top, idx);
+            } else if (strcmp(name, "ctime") == 0) {
+                val = mfu_flist_file_get_ctime(top, idx);
+            } else if (strcmp(name, "uid") == 0) {
+                val = mfu_flist_file_get_uid(top, idx);
+            } else if (strcmp(name, "gid") == 0) {
+                val = mfu_flist_file_get_gid(top, idx);
+            }
+
+            char valstr[64];
+            format_field_value(field, val, valstr, sizeof(valstr));
+            printf("%6llu %20s %s\n", (unsigned long long)(idx + 1), valstr,
+                   mfu_flist_file_get_name(top, idx));
+        }
+    }
+
+    mfu_flist_free(&top);
+}
+
+/* print values of a field at given percentiles, for size we only
+ * consider regular files since directory sizes skew the results */
+static void print_flist_percentiles(struct percentile_option* option, mfu_flist flist, int rank)
+{
+    mfu_flist list = flist;
+    if (strcmp(option->field, "size") == 0) {
+        list = mfu_flist_subset(flist);
+        uint64_t idx;
+        uint64_t size = mfu_flist_size(flist);
+        for (idx = 0; idx < size; idx++) {
+            mode_t mode = (mode_t) mfu_flist_file_get_mode(flist, idx);
+            if (S_ISREG(mode)) {
+                mfu_flist_file_copy(flist, idx, list);
+            }
+        }
+        mfu_flist_summarize(list);
+    }
+
+    uint64_t vals[MAX_PERCENTILES];
+    int rc = mfu_flist_quantiles(list, option->field, option->count, option->quantiles, vals);
+    if (rc == MFU_SUCCESS && rank == 0) {
+        printf("Percentiles of %s:\n", option->field);
+        int i;
+        for (i = 0; i < option->count; i++) {
+            char valstr[64];
+            format_field_value(option->field, vals[i], valstr, sizeof(valstr));
+            printf("  %6.2f%% %s\n", option->quantiles[i] * 100.0, valstr);
+        }
+    }
+
+    if (list != flist) {
+        mfu_flist_free(&list);
+    }
+}
+
+/* print the n directories with the most bytes from a directory index */
+static void print_dirindex_top(const char* name, uint64_t n)
+{
+    uint64_t count;
+    mfu_dirindex_elem_t* elems;
+    if (mfu_flist_read_dirindex(name, n, &count, &elems) != MFU_SUCCESS) {
+        return;
+    }
+
+    if (mfu_rank == 0) {
+        printf("Largest directories in %s:\n", name);
+        if (count == 0) {
+            printf("  (none)\n");
+        }
+
+        uint64_t i;
+        for (i = 0; i < count; i++) {
+            mfu_dirindex_elem_t* elem = &elems[i];
+
+            double incl_size;
+            const char* incl_units;
+            mfu_format_bytes(elem->incl_bytes, &incl_size, &incl_units);
+
+            double excl_size;
+            const char* excl_units;
+            mfu_format_bytes(elem->excl_bytes, &excl_size, &excl_units);
+
+            printf("%.3lf %s (%llu items), own %.3lf %s (%llu items) %s\n",
+                incl_size, incl_units, (unsigned long long) elem->incl_items,
+                excl_size, excl_units, (unsigned long long) elem->excl_items,
+                elem->name
+            );
+        }
+        fflush(stdout);
+    }
+
+    mfu_flist_free_dirindex(count, &elems);
+}
+
 static void print_usage(void)
 {
     printf("\n");
     printf("Usage: dwalk [options] <path> ...\n");
+    printf("       dwalk --dirindex <file> --dirtop <N>\n");
     printf("\n");
     printf("Options:\n");
     printf("  -i, --input <file>                      - read list from file\n");
     printf("  -o, --output <file>                     - write processed list to file\n");
+    printf("  -D, --dirindex <file>                   - write per-directory totals to file\n");
+    printf("      --dirtop <N>                        - print N directories with most bytes from dirindex file\n");
+    printf("  -K, --shards <N>                        - write output as N shard files plus a manifest\n");
+    printf("  -c, --stripe-count <N>                  - stripe output files across N devices\n");
+    printf("  -z, --stripe-size <SIZE>                - stripe size for output files\n");
+    printf("  -b, --cb-buffer <SIZE>                  - collective buffer size for output files\n");
     printf("  -l, --lite                              - walk file system without stat\n");
     printf("  -s, --sort <fields>                     - sort output by comma-delimited fields\n");
     printf("  -d, --distribution <field>:<separators> - print distribution by field\n");
+    printf("  -T, --top <field>:<N>                   - print N items with largest field, '-' for smallest\n");
+    printf("  -P, --percentiles <field>:<percents>    - print field values at given percentiles\n");
     printf("  -p, --print                             - print files to screen\n");
+    printf("      --progress <N>                      - print progress every N seconds, 0 to disable (default 10)\n");
     printf("  -v, --verbose                           - verbose output\n");
     printf("  -h, --help                              - print usage\n");
     printf("\n");
@@ -375,21 +640,44 @@ int main(int argc, char** argv)
 
     char* inputname  = NULL;
     char* outputname = NULL;
+    char* dirindexname = NULL;
+    uint64_t dirtop = 0;
+    mfu_cache_opts_t cache_opts;
+    cache_opts.shards         = 0;
+    cache_opts.stripe_count   = 0;
+    cache_opts.stripe_size    = 0;
+    cache_opts.cb_buffer_size = 0;
+    unsigned long long bytes;
     char* sortfields = NULL;
     char* distribution = NULL;
+    char* top = NULL;
+    char* percentiles = NULL;
     int walk = 0;
     int print = 0;
     int text = 0;
     struct distribute_option option;
+    struct top_option top_option;
+    struct percentile_option percentile_option;
+    top_option.field = NULL;
+    percentile_option.field = NULL;
 
     int option_index = 0;
     static struct option long_options[] = {
         {"input",        1, 0, 'i'},
         {"output",       1, 0, 'o'},
+        {"dirindex",     1, 0, 'D'},
+        {"dirtop",       1, 0, 'E'},
+        {"shards",       1, 0, 'K'},
+        {"stripe-count", 1, 0, 'c'},
+        {"stripe-size",  1, 0, 'z'},
+        {"cb-buffer",    1, 0, 'b'},
         {"lite",         0, 0, 'l'},
         {"sort",         1, 0, 's'},
         {"distribution", 1, 0, 'd'},
+        {"top",          1, 0, 'T'},
+        {"percentiles",  1, 0, 'P'},
         {"print",        0, 0, 'p'},
+        {"progress",     1, 0, 'R'},
         {"verbose",      0, 0, 'v'},
         {"help",         0, 0, 'h'},
         {"text",         0, 0, 't'},
@@ -399,7 +687,7 @@ int main(int argc, char** argv)
     int usage = 0;
     while (1) {
         int c = getopt_long(
-                    argc, argv, "i:o:ls:d:pvht",
+                    argc, argv, "i:o:D:K:c:z:b:ls:d:T:P:pvht",
                     long_options, &option_index
                 );
 
@@ -414,6 +702,54 @@ int main(int argc, char** argv)
             case 'o':
                 outputname = MFU_STRDUP(optarg);
                 break;
+            case 'D':
+                dirindexname = MFU_STRDUP(optarg);
+                break;
+            case 'E':
+                dirtop = (uint64_t) strtoull(optarg, NULL, 10);
+                if (dirtop == 0) {
+                    if (rank == 0) {
+                        printf("Invalid number of directories: %s\n", optarg);
+                    }
+                    usage = 1;
+                }
+                break;
+            case 'K':
+                cache_opts.shards = atoi(optarg);
+                if (cache_opts.shards < 0) {
+                    if (rank == 0) {
+                        printf("Invalid number of shards: %s\n", optarg);
+                    }
+                    usage = 1;
+                }
+                break;
+            case 'c':
+                cache_opts.stripe_count = atoi(optarg);
+                if (cache_opts.stripe_count < 0) {
+                    if (rank == 0) {
+                        printf("Invalid stripe count: %s\n", optarg);
+                    }
+                    usage = 1;
+                }
+                break;
+            case 'z':
+                if (mfu_abtoull(optarg, &bytes) != MFU_SUCCESS) {
+                    if (rank == 0) {
+                        printf("Failed to parse stripe size: %s\n", optarg);
+                    }
+                    usage = 1;
+                }
+                cache_opts.stripe_size = (uint64_t) bytes;
+                break;
+            case 'b':
+                if (mfu_abtoull(optarg, &bytes) != MFU_SUCCESS) {
+                    if (rank == 0) {
+                        printf("Failed to parse collective buffer size: %s\n", optarg);
+                    }
+                    usage = 1;
+                }
+                cache_opts.cb_buffer_size = (uint64_t) bytes;
+                break;
             case 'l':
                 walk_stat = 0;
                 break;
@@ -423,9 +759,18 @@ int main(int argc, char** argv)
             case 'd':
                 distribution = MFU_STRDUP(optarg);
                 break;
+            case 'T':
+                top = MFU_STRDUP(optarg);
+                break;
+            case 'P':
+                percentiles = MFU_STRDUP(optarg);
+                break;
             case 'p':
                 print = 1;
                 break;
+            case 'R':
+                mfu_progress_timeout = atoi(optarg);
+                break;
             case 'v':
                 mfu_debug_level = MFU_LOG_VERBOSE;
                 break;
@@ -470,12 +815,21 @@ int main(int argc, char** argv)
     }
     else {
         /* if we're not walking, we must be reading,
-         * and for that we need a file */
-        if (inputname == NULL) {
+         * and for that we need a file, unless we're
+         * only printing from an existing directory index */
+        if (inputname == NULL && (dirindexname == NULL || dirtop == 0)) {
             usage = 1;
         }
     }
 
+    /* printing top directories needs an index to read */
+    if (dirtop > 0 && dirindexname == NULL) {
+        if (rank == 0) {
+            printf("--dirtop requires --dirindex\n");
+        }
+        usage = 1;
+    }
+
     /* if user is trying to sort, verify the sort fields are valid */
     if (sortfields != NULL) {
         int maxfields;
@@ -554,6 +908,25 @@ int main(int argc, char** argv)
         }
     }
 
+    /* top and percentile queries need stat data */
+    if (top != NULL) {
+        if (!walk_stat || top_parse(&top_option, top) != 0) {
+            if (rank == 0) {
+                printf("Invalid top argument: %s\n", top);
+            }
+            usage = 1;
+        }
+    }
+
+    if (percentiles != NULL) {
+        if (!walk_stat || percentile_parse(&percentile_option, percentiles) != 0) {
+            if (rank == 0) {
+                printf("Invalid percentiles argument: %s\n", percentiles);
+            }
+            usage = 1;
+        }
+    }
+
     if (usage) {
         if (rank == 0) {
             print_usage();
@@ -565,6 +938,24 @@ int main(int argc, char** argv)
     /* TODO: check stat fields fit within MPI types */
     // if (sizeof(st_uid) > uint64_t) error(); etc...
 
+    /* with no list to walk or read, report from the existing index */
+    if (!walk && inputname == NULL) {
+        print_dirindex_top(dirindexname, dirtop);
+
+        mfu_free(&percentile_option.field);
+        mfu_free(&top_option.field);
+        mfu_free(&percentiles);
+        mfu_free(&top);
+        mfu_free(&distribution);
+        mfu_free(&sortfields);
+        mfu_free(&dirindexname);
+        mfu_free(&outputname);
+
+        mfu_finalize();
+        MPI_Finalize();
+        return 0;
+    }
+
     /* create an empty file list */
     mfu_flist flist = mfu_flist_new();
 
@@ -599,21 +990,46 @@ int main(int argc, char** argv)
         print_flist_distribution(&option, &flist, rank);
     }
 
+    /* print items with largest or smallest values of a field */
+    if (top != NULL) {
+        print_flist_top(&top_option, flist, rank);
+    }
+
+    /* print values of a field at given percentiles */
+    if (percentiles != NULL) {
+        print_flist_percentiles(&percentile_option, flist, rank);
+    }
+
     /* write data to cache file */
     if (outputname != NULL) {
         if (!text) {
-            mfu_flist_write_cache(outputname, flist);
+            mfu_flist_write_cache_opts(outputname, flist, &cache_opts);
         } else {
             mfu_flist_write_text(outputname, flist);
         }
     }
 
+    /* write per-directory totals to index file */
+    if (dirindexname != NULL) {
+        mfu_flist_write_dirindex(dirindexname, flist);
+
+        /* print largest directories from the new index */
+        if (dirtop > 0) {
+            print_dirindex_top(dirindexname, dirtop);
+        }
+    }
+
     /* free users, groups, and files objects */
     mfu_flist_free(&flist);
 
     /* free memory allocated for options */
+    mfu_free(&percentile_option.field);
+    mfu_free(&top_option.field);
+    mfu_free(&percentiles);
+    mfu_free(&top);
     mfu_free(&distribution);
     mfu_free(&sortfields);
+    mfu_free(&dirindexname);
     mfu_free(&outputname);
     mfu_free(&inputname);
 
@@ -0,0 +1,101 @@
+/*
+ * Microbenchmark for mfu_is_zero, which dcp --sparse and dbcast use
+ * to find blocks of zeros.  Checks the result against a byte-at-a-time
+ * loop for every alignment and position of a nonzero byte, then times
+ * both on an all-zero buffer, the worst case since neither can stop early.
+ *
+ *   mpicc -O2 bench_is_zero.c -I<prefix>/include -L<prefix>/lib -lmfu -o bench_is_zero
+ *   ./bench_is_zero [block_size] [iterations]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "mfu.h"
+
+static int is_zero_bytes(const void* buf, size_t size)
+{
+    const unsigned char* p = (const unsigned char*) buf;
+    size_t i;
+    for (i = 0; i < size; i++) {
+        if (p[i] != 0) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1.0e-9;
+}
+
+static double bench(int (*fn)(const void*, size_t), const void* buf,
+    size_t size, int iters, int* sum)
+{
+    int i;
+    double start = now();
+    for (i = 0; i < iters; i++) {
+        *sum += fn(buf, size);
+    }
+    return now() - start;
+}
+
+int main(int argc, char* argv[])
+{
+    size_t size = 1024 * 1024;
+    int iters = 2000;
+    if (argc > 1) {
+        size = (size_t) strtoull(argv[1], NULL, 10);
+    }
+    if (argc > 2) {
+        iters = atoi(argv[2]);
+    }
+
+    unsigned char* buf = calloc(size + 64, 1);
+    if (buf == NULL) {
+        fprintf(stderr, "Failed to allocate %zu bytes\n", size + 64);
+        return 1;
+    }
+
+    /* check every alignment, length, and nonzero position
+     * over a range that covers the vector and word loops */
+    size_t align, len, pos;
+    for (align = 0; align < 33; align++) {
+        for (len = 0; len < 300 && len <= size; len++) {
+            unsigned char* p = buf + align;
+            if (! mfu_is_zero(p, len)) {
+                fprintf(stderr, "FAIL: zero buffer align=%zu len=%zu\n", align, len);
+                return 1;
+            }
+            for (pos = 0; pos < len; pos++) {
+                p[pos] = 1;
+                int ret = mfu_is_zero(p, len);
+                p[pos] = 0;
+                if (ret) {
+                    fprintf(stderr, "FAIL: align=%zu len=%zu pos=%zu\n", align, len, pos);
+                    return 1;
+                }
+            }
+        }
+    }
+    printf("PASS: results match for all alignments and positions\n");
+
+    /* time checks of an all-zero block */
+    int sum = 0;
+    double secs_bytes = bench(is_zero_bytes, buf, size, iters, &sum);
+    double secs_fast  = bench(mfu_is_zero,   buf, size, iters, &sum);
+
+    double mb = (double)size * (double)iters / (1024.0 * 1024.0);
+    printf("block size %zu bytes, %d iterations\n", size, iters);
+    printf("  byte loop:   %8.3f secs, %10.1f MB/s\n", secs_bytes, mb / secs_bytes);
+    printf("  mfu_is_zero: %8.3f secs, %10.1f MB/s (%.1fx)\n",
+        secs_fast, mb / secs_fast, secs_bytes / secs_fast);
+
+    free(buf);
+    return (sum == 2 * iters) ? 0 : 1;
+}
@@ -0,0 +1,147 @@
+#!/bin/bash
+
+##############################################################################
+# Description:
+#
+#   A test to check that dcp --journal and --resume pick up a copy
+#   that stopped partway, with a different number of processes.
+#   After a full copy with a journal, we cut the journal and the
+#   destination back as if the copy had failed in the data phase,
+#   modify one source file, and resume.  The resumed copy must match
+#   the source, including the modified file, which the journal says
+#   was already copied but whose mtime no longer matches.
+#
+##############################################################################
+
+# Turn on verbose output
+#set -x
+
+DCP_TEST_BIN=${DCP_TEST_BIN:-${1}}
+DCP_MPIRUN_BIN=${DCP_MPIRUN_BIN:-${2}}
+DCP_CMP_BIN=${DCP_CMP_BIN:-${3}}
+DCP_SRC_DIR=${DCP_SRC_DIR:-${4}}
+DCP_DEST_DIR=${DCP_DEST_DIR:-${5}}
+DCP_TMP_FILE=${DCP_TMP_FILE:-${6}}
+
+echo "Using dcp1 binary at: $DCP_TEST_BIN"
+echo "Using mpirun binary at: $DCP_MPIRUN_BIN"
+echo "Using cmp binary at: $DCP_CMP_BIN"
+echo "Using src directory at: $DCP_SRC_DIR"
+echo "Using dest directory at: $DCP_DEST_DIR"
+
+SRC=$DCP_SRC_DIR/$DCP_TMP_FILE
+DEST=$DCP_DEST_DIR/$DCP_TMP_FILE
+JOURNAL=$DCP_DEST_DIR/$DCP_TMP_FILE.journal
+
+# sizes of the large files, which must differ so we can find
+# each file's index in the journal from its size
+SIZE_A=$(( 9 * 1024 * 1024 + 3 ))
+SIZE_B=$(( 8 * 1024 * 1024 ))
+SIZE_C=$(( 6 * 1024 * 1024 ))
+HALF_B=$(( 4 * 1024 * 1024 ))
+
+function cleanup {
+	rm -rf $SRC
+	rm -rf $DEST
+	rm -f $JOURNAL.*
+}
+
+function check_copy {
+	for f in a b c small1 small2; do
+		$DCP_CMP_BIN $SRC/$f $DEST/$f
+		if [[ $? -ne 0 ]]; then
+			echo "CMP mismatch: $SRC/$f $DEST/$f."
+			cleanup
+			exit 1
+		fi
+	done
+}
+
+cleanup
+
+# Create source directory with three large files and two small ones.
+mkdir $SRC
+dd if=/dev/urandom of=$SRC/a bs=$SIZE_A count=1 iflag=fullblock
+dd if=/dev/urandom of=$SRC/b bs=$SIZE_B count=1 iflag=fullblock
+dd if=/dev/urandom of=$SRC/c bs=$SIZE_C count=1 iflag=fullblock
+dd if=/dev/urandom of=$SRC/small1 bs=1 count=100
+dd if=/dev/urandom of=$SRC/small2 bs=1 count=5000
+
+echo "Subtest 1, copy with a journal on 4 processes."
+$DCP_MPIRUN_BIN -np 4 $DCP_TEST_BIN -j $JOURNAL $SRC $DCP_DEST_DIR
+if [[ $? -ne 0 ]]; then
+	echo "Failed to run cmd: $DCP_MPIRUN_BIN -np 4 $DCP_TEST_BIN -j $JOURNAL $SRC $DCP_DEST_DIR"
+	cleanup
+	exit 1
+fi
+check_copy
+
+# Rewrite the journals as if the copy failed in the data phase: drop
+# the data and metadata phase records, every range of file a, and the
+# ranges of file b that reach past its first half, then leave part of
+# a record at the end of each journal.  Records are four native
+# 64-bit words: type, index, and two values.
+perl -e '
+	my ($size_a, $size_b, $half_b, @files) = @ARGV;
+	my (%recs, $idx_a, $idx_b);
+	for my $f (@files) {
+		open(my $fh, "<", $f) or die "open $f: $!";
+		binmode($fh);
+		local $/;
+		my $data = <$fh>;
+		close($fh);
+		my @r;
+		for (my $o = 0; $o + 32 <= length($data); $o += 32) {
+			my @w = unpack("Q4", substr($data, $o, 32));
+			push(@r, \@w);
+			if ($w[0] == 3 && $w[2] == $size_a) { $idx_a = $w[1]; }
+			if ($w[0] == 3 && $w[2] == $size_b) { $idx_b = $w[1]; }
+		}
+		$recs{$f} = \@r;
+	}
+	die "files not found in journal\n" unless defined($idx_a) && defined($idx_b);
+	for my $f (@files) {
+		open(my $fh, ">", $f) or die "open $f: $!";
+		binmode($fh);
+		for my $w (@{$recs{$f}}) {
+			next if $w->[0] == 2 && ($w->[1] == 4 || $w->[1] == 8);
+			next if $w->[0] == 4 && $w->[1] == $idx_a;
+			next if $w->[0] == 4 && $w->[1] == $idx_b && $w->[2] + $w->[3] > $half_b;
+			print $fh pack("Q4", @$w);
+		}
+		print $fh "\0" x 13;
+		close($fh);
+	}
+' $SIZE_A $SIZE_B $HALF_B $JOURNAL.*
+if [[ $? -ne 0 ]]; then
+	echo "Failed to rewrite journal $JOURNAL"
+	cleanup
+	exit 1
+fi
+
+# lose the data the journal no longer claims
+truncate -s 0 $DEST/a
+truncate -s $HALF_B $DEST/b
+
+# modify file c in the source after the journal recorded it as copied
+sleep 1
+dd if=/dev/urandom of=$SRC/c bs=4096 count=1 seek=10 conv=notrunc
+
+echo "Subtest 2, resume on 3 processes."
+$DCP_MPIRUN_BIN -np 3 $DCP_TEST_BIN -j $JOURNAL --resume $SRC $DCP_DEST_DIR
+if [[ $? -ne 0 ]]; then
+	echo "Failed to run cmd: $DCP_MPIRUN_BIN -np 3 $DCP_TEST_BIN -j $JOURNAL --resume $SRC $DCP_DEST_DIR"
+	cleanup
+	exit 1
+fi
+check_copy
+
+# the journal of the fourth process was folded into the others
+if [[ -e $JOURNAL.3 ]]; then
+	echo "Journal $JOURNAL.3 of the earlier run was not removed"
+	cleanup
+	exit 1
+fi
+
+cleanup
+exit 0
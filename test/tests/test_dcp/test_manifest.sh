@@ -0,0 +1,90 @@
+#!/bin/bash
+
+##############################################################################
+# Description:
+#
+#   A test to check that dcp -m writes a manifest that dcp --verify
+#   accepts for the copy, and that --verify fails once a byte of the
+#   destination is changed.
+#
+##############################################################################
+
+# Turn on verbose output
+#set -x
+
+DCP_TEST_BIN=${DCP_TEST_BIN:-${1}}
+DCP_MPIRUN_BIN=${DCP_MPIRUN_BIN:-${2}}
+DCP_CMP_BIN=${DCP_CMP_BIN:-${3}}
+DCP_SRC_DIR=${DCP_SRC_DIR:-${4}}
+DCP_DEST_DIR=${DCP_DEST_DIR:-${5}}
+DCP_TMP_FILE=${DCP_TMP_FILE:-${6}}
+
+echo "Using dcp1 binary at: $DCP_TEST_BIN"
+echo "Using mpirun binary at: $DCP_MPIRUN_BIN"
+echo "Using cmp binary at: $DCP_CMP_BIN"
+echo "Using src directory at: $DCP_SRC_DIR"
+echo "Using dest directory at: $DCP_DEST_DIR"
+
+MANIFEST=$DCP_DEST_DIR/$DCP_TMP_FILE.manifest
+
+function cleanup {
+	rm -rf $DCP_SRC_DIR/$DCP_TMP_FILE
+	rm -rf $DCP_DEST_DIR/$DCP_TMP_FILE
+	rm -f $MANIFEST
+}
+
+cleanup
+
+# Create a source directory with a large file split across processes,
+# a small file, and an empty file.
+mkdir $DCP_SRC_DIR/$DCP_TMP_FILE
+dd if=/dev/urandom of=$DCP_SRC_DIR/$DCP_TMP_FILE/large bs=1M count=8
+dd if=/dev/urandom of=$DCP_SRC_DIR/$DCP_TMP_FILE/small bs=1 count=1001
+touch $DCP_SRC_DIR/$DCP_TMP_FILE/empty
+
+$DCP_MPIRUN_BIN -np 3 $DCP_TEST_BIN -m $MANIFEST $DCP_SRC_DIR/$DCP_TMP_FILE $DCP_DEST_DIR
+if [[ $? -ne 0 ]]; then
+	echo "Failed to run cmd: $DCP_MPIRUN_BIN -np 3 $DCP_TEST_BIN -m $MANIFEST $DCP_SRC_DIR/$DCP_TMP_FILE $DCP_DEST_DIR"
+	cleanup
+	exit 1
+fi
+
+for f in large small empty; do
+	$DCP_CMP_BIN $DCP_SRC_DIR/$DCP_TMP_FILE/$f $DCP_DEST_DIR/$DCP_TMP_FILE/$f
+	if [[ $? -ne 0 ]]; then
+		echo "CMP mismatch: $DCP_SRC_DIR/$DCP_TMP_FILE/$f $DCP_DEST_DIR/$DCP_TMP_FILE/$f."
+		cleanup
+		exit 1
+	fi
+done
+
+LINES=`wc -l < $MANIFEST`
+if [[ $LINES -ne 3 ]]; then
+	echo "Manifest $MANIFEST has $LINES lines, expected 3"
+	cleanup
+	exit 1
+fi
+
+echo "Subtest 1, verify a correct copy."
+$DCP_MPIRUN_BIN -np 2 $DCP_TEST_BIN --verify $MANIFEST
+if [[ $? -ne 0 ]]; then
+	echo "Verify failed on correct copy: $DCP_MPIRUN_BIN -np 2 $DCP_TEST_BIN --verify $MANIFEST"
+	cleanup
+	exit 1
+fi
+
+echo "Subtest 2, verify after changing one byte."
+# flip the bits of one byte in the middle of the large file
+OFFSET=$(( 5 * 1024 * 1024 + 7 ))
+BYTE=`od -An -tu1 -j $OFFSET -N1 $DCP_DEST_DIR/$DCP_TMP_FILE/large | tr -d ' '`
+printf "\\$(printf '%03o' $(( 255 - BYTE )))" | \
+	dd of=$DCP_DEST_DIR/$DCP_TMP_FILE/large bs=1 seek=$OFFSET count=1 conv=notrunc
+$DCP_MPIRUN_BIN -np 2 $DCP_TEST_BIN --verify $MANIFEST
+if [[ $? -eq 0 ]]; then
+	echo "Verify passed on changed copy: $DCP_MPIRUN_BIN -np 2 $DCP_TEST_BIN --verify $MANIFEST"
+	cleanup
+	exit 1
+fi
+
+cleanup
+exit 0
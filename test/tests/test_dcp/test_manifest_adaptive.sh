@@ -0,0 +1,69 @@
+#!/bin/bash
+
+##############################################################################
+# Description:
+#
+#   A test to check that dcp --verify --adaptive accepts a correct copy
+#   of a file whose size is not a multiple of 8 bytes, with several
+#   process counts, so files are split at different offsets than in
+#   the copy that wrote the manifest.
+#
+##############################################################################
+
+# Turn on verbose output
+#set -x
+
+DCP_TEST_BIN=${DCP_TEST_BIN:-${1}}
+DCP_MPIRUN_BIN=${DCP_MPIRUN_BIN:-${2}}
+DCP_CMP_BIN=${DCP_CMP_BIN:-${3}}
+DCP_SRC_DIR=${DCP_SRC_DIR:-${4}}
+DCP_DEST_DIR=${DCP_DEST_DIR:-${5}}
+DCP_TMP_FILE=${DCP_TMP_FILE:-${6}}
+
+echo "Using dcp1 binary at: $DCP_TEST_BIN"
+echo "Using mpirun binary at: $DCP_MPIRUN_BIN"
+echo "Using cmp binary at: $DCP_CMP_BIN"
+echo "Using src directory at: $DCP_SRC_DIR"
+echo "Using dest directory at: $DCP_DEST_DIR"
+
+MANIFEST=$DCP_DEST_DIR/$DCP_TMP_FILE.manifest
+
+function cleanup {
+	rm -f $DCP_SRC_DIR/$DCP_TMP_FILE
+	rm -f $DCP_DEST_DIR/$DCP_TMP_FILE
+	rm -f $MANIFEST
+}
+
+cleanup
+
+# Create source file of 100M plus 5 bytes, large enough that adaptive
+# chunk sizes like file_size/ranks are bigger than the 1M minimum.
+dd if=/dev/urandom of=$DCP_SRC_DIR/$DCP_TMP_FILE bs=1M count=100
+dd if=/dev/urandom of=$DCP_SRC_DIR/$DCP_TMP_FILE bs=1 count=5 seek=104857600
+
+$DCP_MPIRUN_BIN -np 3 $DCP_TEST_BIN -m $MANIFEST $DCP_SRC_DIR/$DCP_TMP_FILE $DCP_DEST_DIR
+if [[ $? -ne 0 ]]; then
+	echo "Failed to run cmd: $DCP_MPIRUN_BIN -np 3 $DCP_TEST_BIN -m $MANIFEST $DCP_SRC_DIR/$DCP_TMP_FILE $DCP_DEST_DIR"
+	cleanup
+	exit 1
+fi
+
+$DCP_CMP_BIN $DCP_SRC_DIR/$DCP_TMP_FILE $DCP_DEST_DIR/$DCP_TMP_FILE
+if [[ $? -ne 0 ]]; then
+	echo "CMP mismatch: $DCP_SRC_DIR/$DCP_TMP_FILE $DCP_DEST_DIR/$DCP_TMP_FILE."
+	cleanup
+	exit 1
+fi
+
+for NP in 1 2 3 5; do
+	echo "Verifying with --adaptive on $NP processes."
+	$DCP_MPIRUN_BIN -np $NP $DCP_TEST_BIN --adaptive --verify $MANIFEST
+	if [[ $? -ne 0 ]]; then
+		echo "Verify failed on correct copy: $DCP_MPIRUN_BIN -np $NP $DCP_TEST_BIN --adaptive --verify $MANIFEST"
+		cleanup
+		exit 1
+	fi
+done
+
+cleanup
+exit 0
@@ -0,0 +1,76 @@
+#!/bin/bash
+
+##############################################################################
+# Description:
+#
+#   A test to check that dcp -S -P only allocates the data regions
+#   of a sparse source file, so the holes stay unallocated.
+#
+##############################################################################
+
+# Turn on verbose output
+#set -x
+
+DCP_TEST_BIN=${DCP_TEST_BIN:-${1}}
+DCP_MPIRUN_BIN=${DCP_MPIRUN_BIN:-${2}}
+DCP_CMP_BIN=${DCP_CMP_BIN:-${3}}
+DCP_SRC_DIR=${DCP_SRC_DIR:-${4}}
+DCP_DEST_DIR=${DCP_DEST_DIR:-${5}}
+DCP_TMP_FILE=${DCP_TMP_FILE:-${6}}
+
+echo "Using dcp1 binary at: $DCP_TEST_BIN"
+echo "Using mpirun binary at: $DCP_MPIRUN_BIN"
+echo "Using cmp binary at: $DCP_CMP_BIN"
+echo "Using src directory at: $DCP_SRC_DIR"
+echo "Using dest directory at: $DCP_DEST_DIR"
+
+rm -f $DCP_SRC_DIR/$DCP_TMP_FILE
+rm -f $DCP_DEST_DIR/$DCP_TMP_FILE
+
+# allocated bytes of a file
+function allocated {
+	echo $(( $(stat -c %b $1) * $(stat -c %B $1) ))
+}
+
+function cleanup {
+	rm -f $DCP_SRC_DIR/$DCP_TMP_FILE
+	rm -f $DCP_DEST_DIR/$DCP_TMP_FILE
+}
+
+# Create source file with 1M of data, a 1G hole, and 1M of data.
+dd if=/dev/urandom of=$DCP_SRC_DIR/$DCP_TMP_FILE bs=1M count=1
+dd if=/dev/urandom of=$DCP_SRC_DIR/$DCP_TMP_FILE bs=1M seek=1025 count=1
+
+# data plus some slack for file system metadata blocks
+LIMIT=$(( 8 * 1024 * 1024 ))
+
+SRC_ALLOC=`allocated $DCP_SRC_DIR/$DCP_TMP_FILE`
+if [[ $SRC_ALLOC -gt $LIMIT ]]; then
+	echo "Source filesystem $DCP_SRC_DIR does not create sparse files, skip testing"
+	cleanup
+	exit 0
+fi
+
+$DCP_MPIRUN_BIN -np 3 $DCP_TEST_BIN -S -P $DCP_SRC_DIR/$DCP_TMP_FILE $DCP_DEST_DIR
+if [[ $? -ne 0 ]]; then
+	echo "Failed to run cmd: $DCP_MPIRUN_BIN -np 3 $DCP_TEST_BIN -S -P $DCP_SRC_DIR/$DCP_TMP_FILE $DCP_DEST_DIR"
+	cleanup
+	exit 1
+fi
+
+$DCP_CMP_BIN $DCP_SRC_DIR/$DCP_TMP_FILE $DCP_DEST_DIR/$DCP_TMP_FILE
+if [[ $? -ne 0 ]]; then
+	echo "CMP mismatch: $DCP_SRC_DIR/$DCP_TMP_FILE $DCP_DEST_DIR/$DCP_TMP_FILE."
+	cleanup
+	exit 1
+fi
+
+DEST_ALLOC=`allocated $DCP_DEST_DIR/$DCP_TMP_FILE`
+if [[ $DEST_ALLOC -gt $LIMIT ]]; then
+	echo "Destination $DCP_DEST_DIR/$DCP_TMP_FILE has $DEST_ALLOC bytes allocated, expected at most $LIMIT"
+	cleanup
+	exit 1
+fi
+
+cleanup
+exit 0
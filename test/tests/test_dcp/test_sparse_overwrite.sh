@@ -0,0 +1,107 @@
+#!/bin/bash
+
+##############################################################################
+# Description:
+#
+#   A test to check that dcp -S copies a sparse file over an existing
+#   file that has no holes, so the data matches and the holes of the
+#   source end up unallocated in the destination.
+#
+##############################################################################
+
+# Turn on verbose output
+#set -x
+
+DCP_TEST_BIN=${DCP_TEST_BIN:-${1}}
+DCP_MPIRUN_BIN=${DCP_MPIRUN_BIN:-${2}}
+DCP_CMP_BIN=${DCP_CMP_BIN:-${3}}
+DCP_SRC_DIR=${DCP_SRC_DIR:-${4}}
+DCP_DEST_DIR=${DCP_DEST_DIR:-${5}}
+DCP_TMP_FILE=${DCP_TMP_FILE:-${6}}
+
+echo "Using dcp1 binary at: $DCP_TEST_BIN"
+echo "Using mpirun binary at: $DCP_MPIRUN_BIN"
+echo "Using cmp binary at: $DCP_CMP_BIN"
+echo "Using src directory at: $DCP_SRC_DIR"
+echo "Using dest directory at: $DCP_DEST_DIR"
+
+rm -f $DCP_SRC_DIR/$DCP_TMP_FILE
+rm -f $DCP_DEST_DIR/$DCP_TMP_FILE
+
+# allocated bytes of a file
+function allocated {
+	echo $(( $(stat -c %b $1) * $(stat -c %B $1) ))
+}
+
+function cleanup {
+	rm -f $DCP_SRC_DIR/$DCP_TMP_FILE
+	rm -f $DCP_DEST_DIR/$DCP_TMP_FILE
+}
+
+# data plus some slack for file system metadata blocks
+LIMIT=$(( 8 * 1024 * 1024 ))
+
+# Create source file with a 4M front hole, 1M of data, a 32M hole,
+# 1M of data, and a 32M end hole.
+function create_source {
+	dd if=/dev/urandom of=$DCP_SRC_DIR/$DCP_TMP_FILE bs=1M seek=4 count=1
+	dd if=/dev/urandom of=$DCP_SRC_DIR/$DCP_TMP_FILE bs=1M seek=37 count=1
+	dd if=/dev/urandom of=$DCP_SRC_DIR/$DCP_TMP_FILE bs=1M seek=70 count=0
+}
+
+# copy source over a destination filled with $1 MB of data, then
+# check contents and that holes were not left allocated
+function test_overwrite {
+	create_source
+
+	dd if=/dev/urandom of=$DCP_DEST_DIR/$DCP_TMP_FILE bs=1M count=$1
+	DEST_ALLOC=`allocated $DCP_DEST_DIR/$DCP_TMP_FILE`
+	if [[ $DEST_ALLOC -le $LIMIT ]]; then
+		echo "Failed to allocate $1 MB for $DCP_DEST_DIR/$DCP_TMP_FILE"
+		cleanup
+		exit 1
+	fi
+
+	$DCP_MPIRUN_BIN -np 3 $DCP_TEST_BIN -S $DCP_SRC_DIR/$DCP_TMP_FILE $DCP_DEST_DIR
+	if [[ $? -ne 0 ]]; then
+		echo "Failed to run cmd: $DCP_MPIRUN_BIN -np 3 $DCP_TEST_BIN -S $DCP_SRC_DIR/$DCP_TMP_FILE $DCP_DEST_DIR"
+		cleanup
+		exit 1
+	fi
+
+	$DCP_CMP_BIN $DCP_SRC_DIR/$DCP_TMP_FILE $DCP_DEST_DIR/$DCP_TMP_FILE
+	if [[ $? -ne 0 ]]; then
+		echo "CMP mismatch: $DCP_SRC_DIR/$DCP_TMP_FILE $DCP_DEST_DIR/$DCP_TMP_FILE."
+		cleanup
+		exit 1
+	fi
+
+	DEST_ALLOC=`allocated $DCP_DEST_DIR/$DCP_TMP_FILE`
+	if [[ $DEST_ALLOC -gt $LIMIT ]]; then
+		echo "Destination $DCP_DEST_DIR/$DCP_TMP_FILE has $DEST_ALLOC bytes allocated, expected at most $LIMIT"
+		cleanup
+		exit 1
+	fi
+
+	cleanup
+}
+
+# check that we can create sparse files at all
+create_source
+SRC_ALLOC=`allocated $DCP_SRC_DIR/$DCP_TMP_FILE`
+cleanup
+if [[ $SRC_ALLOC -gt $LIMIT ]]; then
+	echo "Source filesystem $DCP_SRC_DIR does not create sparse files, skip testing"
+	exit 0
+fi
+
+echo "Subtest 1, destination the same size as the source."
+test_overwrite 70
+
+echo "Subtest 2, destination larger than the source."
+test_overwrite 96
+
+echo "Subtest 3, destination smaller than the source."
+test_overwrite 16
+
+exit 0